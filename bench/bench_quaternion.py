@@ -0,0 +1,746 @@
+#!/usr/bin/env python
+#
+# This file is part of the Python quaternion module. It provides the benchmark
+# suite and performance regression harness.
+#
+# Copyright (c) 2024  Andrew C. Starritt
+#
+# The quaternion module is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# The quaternion module is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Contact details:
+# andrew.starritt@gmail.com
+# PO Box 3118, Prahran East, Victoria 3181, Australia.
+#
+""" Benchmarks for the quaternion module.
+
+    Usage:
+        python bench/bench_quaternion.py [options] [pattern ...]
+
+    Each benchmark reports the best time per operation over a number of
+    repeats. Patterns, e.g. 'scalar.*' or '*pickle*', select the benchmarks
+    to run, the default being all of them.
+
+    Options:
+        --list              list the benchmark names and exit
+        --repeat N          number of timing repeats (default 5)
+        --min-time T        minimum time per repeat, in seconds (default 0.05)
+        --save FILE         save the results as json, e.g. as a new baseline
+        --compare FILE      compare against results saved by --save; the exit
+                            status is 1 if any benchmark is slower than the
+                            baseline by more than the tolerance
+        --tolerance R       relative tolerance (default 0.25, i.e. 25%)
+
+    Use, e.g., taskset and a quiet machine for more repeatable results, and
+    only compare results from the same machine and build.
+"""
+
+import array
+import fnmatch
+import io
+import json
+import math
+import os
+import pickle
+import platform
+import sys
+import tempfile
+import time
+import timeit
+
+import quaternion as qn
+
+Qn = qn.Quaternion
+Qa = qn.QuaternionArray
+
+# Array sizes
+#
+SMALL = 1000
+LARGE = 100000
+
+_benchmarks = []
+
+
+def benchmark(name, ops=1):
+    """ Registers a benchmark. The decorated function is the setup, which is
+        called once, and returns the zero argument function to be timed.
+        ops is the number of operations per call, so that the reported time is
+        per operation, e.g. per item for array operations.
+    """
+    def decorator(setup):
+        _benchmarks.append((name, ops, setup))
+        return setup
+    return decorator
+
+
+def _items(n):
+    """ Returns a list of n distinct unit quaternions. """
+    return [Qn(angle=0.001 * j, axis=(1.0, 2.0 + j % 7, 3.0)) for j in range(n)]
+
+
+def _points(n):
+    return array.array('d', [0.001 * j for j in range(3 * n)])
+
+
+# -----------------------------------------------------------------------------
+# Scalar operations
+#
+p = Qn(1.0, 2.0, 3.0, 4.0)
+q = Qn(-0.5, 0.25, 1.5, -2.0)
+u = Qn(angle=0.7, axis=(1.0, 2.0, 3.0))
+
+
+@benchmark("scalar.add")
+def _():
+    return lambda: p + q
+
+
+@benchmark("scalar.mul")
+def _():
+    return lambda: p * q
+
+
+@benchmark("scalar.mul_float")
+def _():
+    return lambda: p * 2.5
+
+
+@benchmark("scalar.div")
+def _():
+    return lambda: p / q
+
+
+@benchmark("scalar.pow")
+def _():
+    return lambda: p ** 2.5
+
+
+@benchmark("scalar.abs")
+def _():
+    return lambda: abs(p)
+
+
+@benchmark("scalar.eq")
+def _():
+    return lambda: p == q
+
+
+@benchmark("scalar.hash")
+def _():
+    return lambda: hash(p)
+
+
+@benchmark("scalar.new.components")
+def _():
+    return lambda: Qn(1.0, 2.0, 3.0, 4.0)
+
+
+@benchmark("scalar.new.keywords")
+def _():
+    return lambda: Qn(w=1.0, x=2.0, y=3.0, z=4.0)
+
+
+@benchmark("scalar.new.real_vector")
+def _():
+    return lambda: Qn(real=1.0, imag=(2.0, 3.0, 4.0))
+
+
+@benchmark("scalar.new.angle_axis")
+def _():
+    return lambda: Qn(angle=0.7, axis=(1.0, 2.0, 3.0))
+
+
+@benchmark("scalar.new.matrix")
+def _():
+    m = u.matrix()
+    return lambda: Qn(matrix=m)
+
+
+@benchmark("scalar.new.complex")
+def _():
+    return lambda: Qn(1.0 + 2.0j)
+
+
+@benchmark("scalar.new.copy")
+def _():
+    return lambda: Qn(p)
+
+
+@benchmark("scalar.new.string")
+def _():
+    return lambda: Qn("1.5+2.25i-3j+4.125k")
+
+
+@benchmark("scalar.str")
+def _():
+    return lambda: str(p)
+
+
+@benchmark("scalar.repr")
+def _():
+    return lambda: repr(p)
+
+
+@benchmark("scalar.format")
+def _():
+    return lambda: format(p, ".3f")
+
+
+@benchmark("scalar.inverse")
+def _():
+    return lambda: p.inverse()
+
+
+@benchmark("scalar.normalise")
+def _():
+    return lambda: p.normalise()
+
+
+@benchmark("scalar.matrix")
+def _():
+    return lambda: u.matrix()
+
+
+@benchmark("scalar.rotate")
+def _():
+    point = (1.0, 2.0, 3.0)
+    return lambda: u.rotate(point)
+
+
+@benchmark("scalar.rotate_unit")
+def _():
+    point = (1.0, 2.0, 3.0)
+    return lambda: u.rotate(point, unit=True)
+
+
+@benchmark("scalar.rotator_call")
+def _():
+    point = (1.0, 2.0, 3.0)
+    r = u.rotator()
+    return lambda: r(point)
+
+
+@benchmark("scalar.pickle")
+def _():
+    return lambda: pickle.loads(pickle.dumps(p))
+
+
+# -----------------------------------------------------------------------------
+# Math functions - each applied to a single quaternion.
+#
+_unary = ["sqrt", "exp", "log", "log10", "cos", "sin", "tan", "acos", "asin", "atan",
+          "cosh", "sinh", "tanh", "acosh", "asinh", "atanh", "isfinite", "isinf", "isnan",
+          "polar", "axis", "phase"]
+
+for _name in _unary:
+    def _setup(f=getattr(qn, _name)):
+        a = Qn(0.5, 0.25, -0.125, 0.75)
+        return lambda: f(a)
+    benchmark("math." + _name)(_setup)
+
+
+@benchmark("math.rect")
+def _():
+    return lambda: qn.rect(2.0, 0.5, (1.0, 0.0, 0.0))
+
+
+@benchmark("math.isclose")
+def _():
+    return lambda: qn.isclose(p, q)
+
+
+@benchmark("math.dot")
+def _():
+    return lambda: qn.dot(p, q)
+
+
+@benchmark("math.lerp")
+def _():
+    return lambda: qn.lerp(p, q, 0.3)
+
+
+@benchmark("math.slerp")
+def _():
+    return lambda: qn.slerp(u, q.normalise(), 0.3)
+
+
+# The same functions applied to arrays - reported per item.
+#
+for _name in ["sqrt", "exp", "log", "sin", "cos", "atan", "tanh"]:
+    def _setup(f=getattr(qn, _name)):
+        a = Qa(_items(LARGE))
+        out = Qa(a)
+        return lambda: f(a, out=out)
+    benchmark("math.array." + _name, LARGE)(_setup)
+
+
+@benchmark("math.array.polar", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: qn.polar(a)
+
+
+# -----------------------------------------------------------------------------
+# Array operations - reported per item.
+#
+@benchmark("array.new.list", LARGE)
+def _():
+    items = _items(LARGE)
+    return lambda: Qa(items)
+
+
+@benchmark("array.new.buffer", LARGE)
+def _():
+    data = memoryview(Qa(_items(LARGE)).tobytes()).cast('d', (LARGE, 4))
+    return lambda: Qa(data)
+
+
+@benchmark("array.append", LARGE)
+def _():
+    items = _items(LARGE)
+
+    def run():
+        a = Qa()
+        append = a.append
+        for x in items:
+            append(x)
+    return run
+
+
+@benchmark("array.extend.list", LARGE)
+def _():
+    items = _items(LARGE)
+
+    def run():
+        a = Qa()
+        a.extend(items)
+    return run
+
+
+@benchmark("array.extend.array", LARGE)
+def _():
+    b = Qa(_items(LARGE))
+
+    def run():
+        a = Qa()
+        a.extend(b)
+    return run
+
+
+@benchmark("array.frombytes", LARGE)
+def _():
+    data = Qa(_items(LARGE)).tobytes()
+
+    def run():
+        a = Qa()
+        a.frombytes(data)
+    return run
+
+
+@benchmark("array.tobytes", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.tobytes()
+
+
+@benchmark("array.getitem", SMALL)
+def _():
+    a = Qa(_items(SMALL))
+    n = len(a)
+
+    def run():
+        for j in range(n):
+            a[j]
+    return run
+
+
+@benchmark("array.setitem", SMALL)
+def _():
+    a = Qa(_items(SMALL))
+    n = len(a)
+
+    def run():
+        for j in range(n):
+            a[j] = q
+    return run
+
+
+@benchmark("array.slice.get", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a[1:-1]
+
+
+@benchmark("array.slice.step", LARGE // 2)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a[::2]
+
+
+@benchmark("array.slice.set", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    b = Qa(a)
+
+    def run():
+        a[:] = b
+    return run
+
+
+@benchmark("array.view", 1)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.view(10, 1000)
+
+
+@benchmark("array.iterate", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+
+    def run():
+        for x in a:
+            pass
+    return run
+
+
+@benchmark("array.tolist", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.tolist()
+
+
+@benchmark("array.iter_chunks", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+
+    def run():
+        for c in a.iter_chunks(4096):
+            pass
+    return run
+
+
+@benchmark("array.tofile", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    f = tempfile.TemporaryFile()
+
+    def run():
+        f.seek(0)
+        a.tofile(f)
+    return run
+
+
+@benchmark("array.fromfile", LARGE)
+def _():
+    f = tempfile.TemporaryFile()
+    Qa(_items(LARGE)).tofile(f)
+
+    def run():
+        f.seek(0)
+        a = Qa()
+        a.fromfile(f, LARGE)
+    return run
+
+
+@benchmark("array.stream.write", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+
+    def run():
+        with qn.QuaternionArrayWriter(io.BytesIO()) as w:
+            w.write(a)
+    return run
+
+
+@benchmark("array.fromstrings", SMALL)
+def _():
+    text = Qa(_items(SMALL)).format()
+
+    def run():
+        a = Qa()
+        a.fromstrings(text)
+    return run
+
+
+@benchmark("array.format", SMALL)
+def _():
+    a = Qa(_items(SMALL))
+    return lambda: a.format()
+
+
+@benchmark("array.encode.f4", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.encode('f4')
+
+
+@benchmark("array.encode.u8", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.encode('u8')
+
+
+for _protocol in (2, 4, 5):
+    def _setup(protocol=_protocol):
+        a = Qa(_items(LARGE))
+        return lambda: pickle.loads(pickle.dumps(a, protocol=protocol))
+    benchmark("array.pickle.protocol%d" % _protocol, LARGE)(_setup)
+
+
+@benchmark("array.eq", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    b = Qa(a)
+    return lambda: a == b
+
+
+@benchmark("array.count", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.count(q)
+
+
+@benchmark("array.hashes", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.hashes()
+
+
+@benchmark("array.reverse", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.reverse()
+
+
+@benchmark("array.byteswap", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.byteswap()
+
+
+# Element-wise arithmetic and rotations
+#
+@benchmark("array.add", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.add(a)
+
+
+@benchmark("array.mul", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.mul(a)
+
+
+@benchmark("array.imul.quaternion", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.imul(u)
+
+
+@benchmark("array.div", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.div(a)
+
+
+@benchmark("array.mul.soa", LARGE)
+def _():
+    a = Qa(_items(LARGE), layout="soa")
+    return lambda: a.mul(a)
+
+
+@benchmark("array.inormalise", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.inormalise()
+
+
+@benchmark("array.irenormalise", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.irenormalise()
+
+
+@benchmark("array.norms", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.norms()
+
+
+@benchmark("array.sum", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.sum()
+
+
+@benchmark("array.cumprod", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.cumprod()
+
+
+@benchmark("array.average_rotation", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    return lambda: a.average_rotation()
+
+
+@benchmark("array.rotate_points", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    points = _points(LARGE)
+    out = array.array('d', points)
+    return lambda: a.rotate_points(points, out=out)
+
+
+@benchmark("array.rotate_points.unit", LARGE)
+def _():
+    a = Qa(_items(LARGE))
+    points = _points(LARGE)
+    out = array.array('d', points)
+    return lambda: a.rotate_points(points, out=out, unit=True)
+
+
+@benchmark("array.rotate_many", LARGE)
+def _():
+    points = _points(LARGE)
+    out = array.array('d', points)
+    return lambda: u.rotate_many(points, out=out)
+
+
+@benchmark("array.rotator.rotate_many", LARGE)
+def _():
+    points = _points(LARGE)
+    out = array.array('d', points)
+    r = u.rotator()
+    return lambda: r.rotate_many(points, out=out)
+
+
+@benchmark("array.interpolate", LARGE)
+def _():
+    keys = Qa(_items(100))
+    times = array.array('d', range(100))
+    samples = array.array('d', [99.0 * j / LARGE for j in range(LARGE)])
+    return lambda: qn.interpolate(keys, times, samples)
+
+
+# -----------------------------------------------------------------------------
+# Harness
+#
+def _time(fn, ops, repeat, min_time):
+    """ Returns the best time per operation, in seconds. """
+    timer = timeit.Timer(fn)
+
+    # Find the number of loops that takes at least min_time.
+    #
+    loops = 1
+    while True:
+        elapsed = timer.timeit(loops)
+        if elapsed >= min_time:
+            break
+        loops *= 2 if elapsed <= 0.0 else max(2, min(10, int(1.2 * min_time / elapsed)))
+
+    best = elapsed
+    for _ in range(repeat - 1):
+        best = min(best, timer.timeit(loops))
+
+    return best / (loops * ops)
+
+
+def _format_time(t):
+    for unit, scale in (("s", 1.0), ("ms", 1.0e3), ("us", 1.0e6)):
+        if t >= 1.0 / scale:
+            return "%8.3f %s" % (t * scale, unit)
+    return "%8.2f ns" % (t * 1.0e9)
+
+
+def _metadata():
+    return {"python": sys.version.split()[0],
+            "implementation": platform.python_implementation(),
+            "machine": platform.machine(),
+            "platform": platform.platform(),
+            "quaternion": qn.__version__,
+            "simd_backend": qn.simd_backend(),
+            "num_threads": qn.num_threads(),
+            "date": time.strftime("%Y-%m-%d %H:%M:%S")}
+
+
+def main(argv):
+    import argparse
+
+    parser = argparse.ArgumentParser(description="quaternion module benchmarks")
+    parser.add_argument("patterns", nargs="*", help="benchmark name patterns")
+    parser.add_argument("--list", action="store_true", help="list benchmarks and exit")
+    parser.add_argument("--repeat", type=int, default=5, help="number of repeats")
+    parser.add_argument("--min-time", type=float, default=0.05,
+                        help="minimum time per repeat, in seconds")
+    parser.add_argument("--save", metavar="FILE", help="save the results as json")
+    parser.add_argument("--compare", metavar="FILE", help="compare with saved results")
+    parser.add_argument("--tolerance", type=float, default=0.25,
+                        help="relative regression tolerance")
+    args = parser.parse_args(argv)
+
+    patterns = args.patterns or ["*"]
+    selected = [b for b in _benchmarks
+                if any(fnmatch.fnmatchcase(b[0], pat) for pat in patterns)]
+
+    if args.list:
+        for name, ops, setup in selected:
+            print(name)
+        return 0
+
+    baseline = None
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)["results"]
+
+    results = {}
+    regressions = []
+    for name, ops, setup in selected:
+        t = _time(setup(), ops, args.repeat, args.min_time)
+        results[name] = t
+
+        line = "%-34s %s" % (name, _format_time(t))
+        if baseline is not None and name in baseline:
+            ratio = t / baseline[name]
+            line += "   %6.2fx" % ratio
+            if ratio > 1.0 + args.tolerance:
+                line += "  slower"
+                regressions.append(name)
+            elif ratio < 1.0 / (1.0 + args.tolerance):
+                line += "  faster"
+        print(line)
+        sys.stdout.flush()
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"metadata": _metadata(), "results": results}, f,
+                      indent=1, sort_keys=True)
+            f.write("\n")
+
+    if regressions:
+        print()
+        print("%d benchmark(s) slower than the baseline by more than %.0f%%:" %
+              (len(regressions), 100.0 * args.tolerance))
+        for name in regressions:
+            print("   " + name)
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
+
+# end
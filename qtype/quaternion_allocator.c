@@ -0,0 +1,459 @@
+/* quaternion_allocator.c
+ *
+ * This file is part of the Python quaternion module. It provides the memory
+ * allocator used for QuaternionArray item buffers.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#include "quaternion_allocator.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#endif
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#if defined(MAP_ANONYMOUS)
+#define USE_MMAP 1
+#endif
+#endif
+
+/* Each buffer is preceded by a header which identifies the underlying raw
+ * block, and the allocator that allocated it.
+ */
+typedef struct {
+   void* raw;
+   size_t size;            /* raw block size */
+   const Py_quat_allocator* allocator;
+} BlockHeader;
+
+/* The raw block is this much larger than the buffer itself, which allows for
+ * the header and alignment of the buffer.
+ */
+#define OVERHEAD  (sizeof (BlockHeader) + QUAT_BUFFER_ALIGNMENT)
+
+
+/* -----------------------------------------------------------------------------
+ * The default allocator - just uses the Python memory allocator.
+ */
+static void*
+default_malloc (void* ctx, size_t size)
+{
+   return PyMem_Malloc (size);
+}
+
+static void*
+default_realloc (void* ctx, void* ptr, size_t old_size, size_t new_size)
+{
+   return PyMem_Realloc (ptr, new_size);
+}
+
+static void
+default_free (void* ctx, void* ptr, size_t size)
+{
+   PyMem_Free (ptr);
+}
+
+static const Py_quat_allocator default_allocator = {
+   NULL, "default", default_malloc, default_realloc, default_free
+};
+
+
+#if defined(USE_MMAP)
+/* -----------------------------------------------------------------------------
+ * The mmap based allocators. Blocks smaller than the threshold use the Python
+ * memory allocator, and larger blocks are directly mapped anonymous memory.
+ */
+typedef struct {
+   int flags;              /* MAP_PRIVATE or MAP_SHARED */
+   int advice;             /* madvise advice, or 0 for none */
+   size_t threshold;       /* minimum block size that is mapped */
+   size_t granule;         /* mapped lengths are a multiple of this, 0 means page size */
+} MapContext;
+
+/* -----------------------------------------------------------------------------
+ */
+static size_t
+map_length (MapContext* context, const size_t size)
+{
+   if (context->granule == 0) {
+      long page = 4096;
+#if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
+      page = sysconf (_SC_PAGESIZE);
+      if (page <= 0) page = 4096;
+#endif
+      context->granule = (size_t) page;
+   }
+   return ((size + context->granule - 1) / context->granule) * context->granule;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+map_advise (MapContext* context, void* ptr, const size_t length)
+{
+#if defined(HAVE_MADVISE)
+   if (context->advice) {
+      (void) madvise (ptr, length, context->advice);  /* just a hint */
+   }
+#endif
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void*
+map_malloc (void* ctx, size_t size)
+{
+   MapContext* context = (MapContext*) ctx;
+   size_t length;
+   void* result;
+
+   if (size < context->threshold) {
+      return PyMem_Malloc (size);
+   }
+
+   length = map_length (context, size);
+   result = mmap (NULL, length, PROT_READ | PROT_WRITE, context->flags | MAP_ANONYMOUS, -1, 0);
+   if (result == MAP_FAILED) {
+      return NULL;
+   }
+
+   map_advise (context, result, length);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+map_free (void* ctx, void* ptr, size_t size)
+{
+   MapContext* context = (MapContext*) ctx;
+
+   if (size < context->threshold) {
+      PyMem_Free (ptr);
+   } else {
+      munmap (ptr, map_length (context, size));
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void*
+map_realloc (void* ctx, void* ptr, size_t old_size, size_t new_size)
+{
+   MapContext* context = (MapContext*) ctx;
+   void* result;
+
+   if (old_size < context->threshold && new_size < context->threshold) {
+      return PyMem_Realloc (ptr, new_size);
+   }
+
+   if (old_size >= context->threshold && new_size >= context->threshold) {
+      const size_t old_length = map_length (context, old_size);
+      const size_t new_length = map_length (context, new_size);
+
+      if (old_length == new_length) {
+         return ptr;
+      }
+#if defined(MREMAP_MAYMOVE)
+      /* Shared anonymous memory is backed by a fixed size object, so it may
+       * not be grown by mremap.
+       */
+      if (context->flags == MAP_PRIVATE) {
+         result = mremap (ptr, old_length, new_length, MREMAP_MAYMOVE);
+         if (result == MAP_FAILED) {
+            return NULL;
+         }
+         map_advise (context, result, new_length);
+         return result;
+      }
+#endif
+   }
+
+   /* Moving between PyMem and mapped memory, or no mremap - allocate a new
+    * block and copy the contents.
+    */
+   result = map_malloc (ctx, new_size);
+   if (result) {
+      memcpy (result, ptr, old_size < new_size ? old_size : new_size);
+      map_free (ctx, ptr, old_size);
+   }
+   return result;
+}
+
+/* Private anonymous memory, advised to use transparent huge pages (2 MiB on
+ * x86-64 and aarch64) where available, for blocks of at least one huge page.
+ */
+#if defined(MADV_HUGEPAGE)
+#define HUGE_PAGE_SIZE  (2 << 20)
+
+static MapContext hugepage_context = {
+   MAP_PRIVATE, MADV_HUGEPAGE, HUGE_PAGE_SIZE, HUGE_PAGE_SIZE
+};
+
+static const Py_quat_allocator hugepage_allocator = {
+   &hugepage_context, "hugepage", map_malloc, map_realloc, map_free
+};
+#endif
+
+/* Shared anonymous memory, i.e. the items of arrays created before a fork are
+ * visible to, and may be modified by, both the parent and child processes.
+ */
+static MapContext shared_context = {
+   MAP_SHARED, 0, 0, 0
+};
+
+static const Py_quat_allocator shared_allocator = {
+   &shared_context, "shared", map_malloc, map_realloc, map_free
+};
+
+#endif  /* USE_MMAP */
+
+
+static const Py_quat_allocator* current = &default_allocator;
+
+
+/* -----------------------------------------------------------------------------
+ */
+void
+PyQuaternionArray_GetAllocator (Py_quat_allocator *allocator)
+{
+   *allocator = *current;
+}
+
+/* -----------------------------------------------------------------------------
+ * The copy is never freed, as there may be buffers that refer to it.
+ */
+int
+PyQuaternionArray_SetAllocator (const Py_quat_allocator *allocator)
+{
+   Py_quat_allocator* copy;
+
+   if (!allocator) {
+      current = &default_allocator;
+      return 0;
+   }
+
+   copy = PyMem_RawMalloc (sizeof (Py_quat_allocator));
+   if (!copy) {
+      PyErr_NoMemory ();
+      return -1;
+   }
+
+   *copy = *allocator;
+   current = copy;
+   return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns the aligned buffer address within the raw block.
+ */
+static char*
+aligned_buffer (void* raw)
+{
+   uintptr_t address = (uintptr_t) raw + sizeof (BlockHeader);
+   address = (address + QUAT_BUFFER_ALIGNMENT - 1) & ~((uintptr_t) QUAT_BUFFER_ALIGNMENT - 1);
+   return (char*) address;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void*
+_Py_quat_buffer_malloc (const size_t size)
+{
+   const Py_quat_allocator* allocator = current;
+   BlockHeader* header;
+   char* result;
+   void* raw;
+
+   if (size > (size_t) PY_SSIZE_T_MAX - OVERHEAD) {
+      return NULL;
+   }
+
+   raw = allocator->malloc (allocator->ctx, size + OVERHEAD);
+   if (!raw) {
+      return NULL;
+   }
+
+   result = aligned_buffer (raw);
+   header = (BlockHeader*) result - 1;
+   header->raw = raw;
+   header->size = size + OVERHEAD;
+   header->allocator = allocator;
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * The raw block may be reallocated with a different alignment, in which case the
+ * contents are moved to the new aligned position.
+ */
+void*
+_Py_quat_buffer_realloc (void* ptr, const size_t size)
+{
+   BlockHeader old;
+   BlockHeader* header;
+   size_t old_offset;
+   size_t number;
+   char* result;
+   void* raw;
+
+   if (!ptr) {
+      return _Py_quat_buffer_malloc (size);
+   }
+
+   if (size > (size_t) PY_SSIZE_T_MAX - OVERHEAD) {
+      return NULL;
+   }
+
+   old = *((BlockHeader*) ptr - 1);
+   old_offset = (char*) ptr - (char*) old.raw;
+
+   raw = old.allocator->realloc (old.allocator->ctx, old.raw, old.size, size + OVERHEAD);
+   if (!raw) {
+      return NULL;
+   }
+
+   result = aligned_buffer (raw);
+   if ((size_t) (result - (char*) raw) != old_offset) {
+      number = old.size - OVERHEAD;
+      if (number > size) number = size;
+      memmove (result, (char*) raw + old_offset, number);
+   }
+
+   header = (BlockHeader*) result - 1;
+   header->raw = raw;
+   header->size = size + OVERHEAD;
+   header->allocator = old.allocator;
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void
+_Py_quat_buffer_free (void* ptr)
+{
+   const BlockHeader* header;
+
+   if (!ptr) {
+      return;
+   }
+
+   header = (const BlockHeader*) ptr - 1;
+   header->allocator->free (header->allocator->ctx, header->raw, header->size);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Module functions
+ * -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(array_allocator_doc,
+             "array_allocator() -> str\n"
+             "\n"
+             "Returns the name of the allocator used for new QuaternionArray buffers.");
+
+static PyObject *
+array_allocator (PyObject *module, PyObject *noargs)
+{
+   return PyUnicode_FromString (current->name ? current->name : "custom");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(set_array_allocator_doc,
+             "set_array_allocator(name, /)\n"
+             "\n"
+             "Selects the allocator used for new QuaternionArray buffers, where name is\n"
+             "one of 'default', 'hugepage' or 'shared'. Existing buffers are unaffected.\n"
+             "The 'hugepage' allocator uses transparent huge pages for large buffers, and\n"
+             "the 'shared' allocator uses memory shared with forked child processes.\n"
+             "Not all allocators are available on all platforms.");
+
+static PyObject *
+set_array_allocator (PyObject *module, PyObject *arg)
+{
+   const Py_quat_allocator* allocator = NULL;
+   const char* name;
+
+   if (!PyUnicode_Check (arg)) {
+      PyErr_Format(PyExc_TypeError,
+                   "set_array_allocator() argument must be str, not '%.200s'",
+                   Py_TYPE(arg)->tp_name);
+      return NULL;
+   }
+
+   name = PyUnicode_AsUTF8 (arg);
+   if (!name)
+      return NULL;
+
+   if (strcmp (name, "default") == 0) {
+      allocator = &default_allocator;
+
+   } else if (strcmp (name, "hugepage") == 0) {
+#if defined(USE_MMAP) && defined(MADV_HUGEPAGE)
+      allocator = &hugepage_allocator;
+#endif
+
+   } else if (strcmp (name, "shared") == 0) {
+#if defined(USE_MMAP)
+      allocator = &shared_allocator;
+#endif
+
+   } else {
+      PyErr_Format(PyExc_ValueError,
+                   "set_array_allocator() argument must be one of 'default', 'hugepage' "
+                   "or 'shared' (got '%.200s')", name);
+      return NULL;
+   }
+
+   if (!allocator) {
+      PyErr_Format(PyExc_ValueError,
+                   "set_array_allocator() '%.200s' is not available on this platform", name);
+      return NULL;
+   }
+
+   current = allocator;
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef allocator_methods[] = {
+   {"array_allocator",     (PyCFunction)array_allocator,     METH_NOARGS, array_allocator_doc},
+   {"set_array_allocator", (PyCFunction)set_array_allocator, METH_O,      set_array_allocator_doc},
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ * Allow module definition code to access the allocator PyMethodDef.
+ */
+PyMethodDef* _PyQuaternionAllocatorMethods ()
+{
+   return allocator_methods;
+}
+
+/* end */
@@ -0,0 +1,76 @@
+/* quaternion_allocator.h
+ *
+ * This file is part of the Python quaternion module. It provides the memory
+ * allocator used for QuaternionArray item buffers.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#ifndef QUATERNION_ALLOCATOR_H
+#define QUATERNION_ALLOCATOR_H 1
+
+#include <Python.h>
+#include <stddef.h>
+
+/* Every QuaternionArray item buffer is aligned to a multiple of this, i.e. a
+ * cache line, and the width of the widest (AVX-512) vector registers.
+ */
+#define QUAT_BUFFER_ALIGNMENT  64
+
+/* A raw block allocator, as per PyMemAllocatorEx. The functions are always
+ * called with the GIL held. The size of the block is passed to realloc and free,
+ * for the benefit of allocators, such as mmap based ones, that need it.
+ * Alignment is handled by the caller, so blocks need only be suitably aligned for
+ * a double.
+ */
+typedef struct {
+   void *ctx;                 /* user context passed as first argument */
+   const char *name;          /* as returned by array_allocator() */
+   void* (*malloc) (void *ctx, size_t size);
+   void* (*realloc) (void *ctx, void *ptr, size_t old_size, size_t new_size);
+   void  (*free) (void *ctx, void *ptr, size_t size);
+} Py_quat_allocator;
+
+/* Get/set the allocator used for new QuaternionArray buffers. The allocator
+ * specification is copied, and a NULL allocator restores the default.
+ * Existing buffers continue to be reallocated and freed by whichever allocator
+ * allocated them, so the ctx (if any) must remain valid indefinitely.
+ * Set returns 0 on success, or -1 with a MemoryError set.
+ */
+PyAPI_FUNC (void) PyQuaternionArray_GetAllocator (Py_quat_allocator *allocator);
+PyAPI_FUNC (int)  PyQuaternionArray_SetAllocator (const Py_quat_allocator *allocator);
+
+/* Allocate, reallocate and free QUAT_BUFFER_ALIGNMENT aligned buffers.
+ * Allocate and reallocate return NULL on failure, but do not set an exception.
+ * Reallocation preserves the contents, up to the lesser of the old and new sizes.
+ * Free accepts NULL. These must be called with the GIL held.
+ */
+void* _Py_quat_buffer_malloc (const size_t size);
+void* _Py_quat_buffer_realloc (void* ptr, const size_t size);
+void  _Py_quat_buffer_free (void* ptr);
+
+/* Provides a reference to the module level functions provided by quaternion_allocator.c
+ */
+PyAPI_FUNC (PyMethodDef*) _PyQuaternionAllocatorMethods ();
+
+#endif  /* QUATERNION_ALLOCATOR_H */
@@ -29,12 +29,27 @@
 #include "quaternion_array.h"
 #include "quaternion_basic.h"
 #include "quaternion_array_iter.h"
+#include "quaternion_utilities.h"
+#include "quaternion_simd.h"
+#include "quaternion_parallel.h"
+#include "quaternion_allocator.h"
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
+/* Version 1 state holds the items as bytes, version 2 (protocol 5 and later)
+ * holds the items as a pickle.PickleBuffer, which may be sent out-of-band.
+ */
 static const long pickleFormatVersion = 1;
+static const long pickleBufferFormatVersion = 2;
+
+/* The bulk functions and kernels work on arrays of c quaternions, so SoA
+ * operands are staged through blocks of this many items.
+ */
+#define QA_BLOCK  128
 
 /* -----------------------------------------------------------------------------
  * Macro to check that the allocated memory is sensible.
@@ -51,11 +66,234 @@ static const long pickleFormatVersion = 1;
 }
 
 
+/* -----------------------------------------------------------------------------
+ * Macro to check that the items may be modified, i.e. the array is not a read
+ * only memory mapped array.
+ */
+#define WRITE_CHECK(pObj, errReturn) {                                        \
+   if (pObj->readonly) {                                                      \
+       PyErr_SetString(PyExc_TypeError,                                       \
+                       "cannot modify a read-only quaternion array");         \
+       return errReturn;                                                      \
+   }                                                                          \
+}
+
+
+static bool qa_unmap (PyQuaternionArrayObject* pObj);
+
+/* -----------------------------------------------------------------------------
+ * Macro to check that the array may be resized or have items removed.
+ * This is not allowed while another thread is using the array without the GIL,
+ * nor while the buffer or a component view is exported.
+ * A memory mapped array must first be copied into memory we own, which is only
+ * allowed for copy on write mappings.
+ */
+#define RESIZE_CHECK(pObj, errReturn) {                                       \
+   WRITE_CHECK(pObj, errReturn);                                              \
+   if (pObj->busy > 0 || pObj->exports > 0) {                                 \
+       PyErr_SetString(PyExc_BufferError,                                     \
+                       "cannot resize a quaternion array while it is in use"); \
+       return errReturn;                                                      \
+   }                                                                          \
+   if (pObj->mapping && !qa_unmap (pObj)) {                                   \
+       return errReturn;                                                      \
+   }                                                                          \
+}
+
+
 /* -----------------------------------------------------------------------------
  * Utility fuctions
  * -----------------------------------------------------------------------------
  */
 
+/* -----------------------------------------------------------------------------
+ * Storage layout access - these hide the difference between the AoS and SoA
+ * storage layouts. Returns item k.
+ */
+static inline Py_quaternion
+qa_get (const Py_quaternion_array *aval, const Py_ssize_t k)
+{
+   Py_quaternion result;
+
+   if (aval->layout == QA_LAYOUT_AOS) {
+      return aval->qvalArray [k];
+   }
+
+   result.w = QA_COLUMN(aval, 0) [k];
+   result.x = QA_COLUMN(aval, 1) [k];
+   result.y = QA_COLUMN(aval, 2) [k];
+   result.z = QA_COLUMN(aval, 3) [k];
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * Sets item k.
+ */
+static inline void
+qa_put (Py_quaternion_array *aval, const Py_ssize_t k, const Py_quaternion q)
+{
+   if (aval->layout == QA_LAYOUT_AOS) {
+      aval->qvalArray [k] = q;
+      return;
+   }
+
+   QA_COLUMN(aval, 0) [k] = q.w;
+   QA_COLUMN(aval, 1) [k] = q.x;
+   QA_COLUMN(aval, 2) [k] = q.y;
+   QA_COLUMN(aval, 3) [k] = q.z;
+}
+
+/* -----------------------------------------------------------------------------
+ * Note: q/r need not be aligned, e.g. when from/to a bytes buffer, hence memcpy.
+ */
+void
+PyQuaternionArrayGather (const Py_quaternion_array* aval, const Py_ssize_t index,
+                         Py_quaternion* r, const Py_ssize_t n)
+{
+   Py_ssize_t k;
+
+   if (n <= 0) return;
+
+   if (aval->layout == QA_LAYOUT_AOS) {
+      memmove(r, &aval->qvalArray [index], n * sizeof(Py_quaternion));
+      return;
+   }
+
+   for (k = 0; k < n; k++) {
+      Py_quaternion q = qa_get (aval, index + k);
+      memcpy(&r[k], &q, sizeof(Py_quaternion));
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void
+PyQuaternionArrayScatter (Py_quaternion_array* aval, const Py_ssize_t index,
+                          const Py_quaternion* q, const Py_ssize_t n)
+{
+   Py_ssize_t k;
+
+   if (n <= 0) return;
+
+   if (aval->layout == QA_LAYOUT_AOS) {
+      memmove(&aval->qvalArray [index], q, n * sizeof(Py_quaternion));
+      return;
+   }
+
+   for (k = 0; k < n; k++) {
+      Py_quaternion t;
+      memcpy(&t, &q[k], sizeof(Py_quaternion));
+      qa_put (aval, index + k, t);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Copies n items from source [src .. src+n-1] to dest [dst .. dst+n-1].
+ * Like memmove, this allows the source and destination items to overlap when
+ * source and dest are the same array.
+ */
+static void
+qa_move (Py_quaternion_array *dest, const Py_ssize_t dst,
+         const Py_quaternion_array *source, const Py_ssize_t src, const Py_ssize_t n)
+{
+   int c;
+
+   if (n <= 0) return;
+
+   if (source->layout == QA_LAYOUT_AOS) {
+      PyQuaternionArrayScatter (dest, dst, &source->qvalArray [src], n);
+
+   } else if (dest->layout == QA_LAYOUT_AOS) {
+      PyQuaternionArrayGather (source, src, &dest->qvalArray [dst], n);
+
+   } else {
+      for (c = 0; c < 4; c++) {
+         memmove(QA_COLUMN(dest, c) + dst, QA_COLUMN(source, c) + src, n * sizeof(double));
+      }
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Moves the first n items of the x, y and z SoA components, i.e. columns 1 to 3,
+ * in memory allocated for 4 x from doubles to where they are for 4 x to doubles.
+ */
+static void
+qa_repitch (double *data, const Py_ssize_t from, const Py_ssize_t to, const Py_ssize_t n)
+{
+   int c;
+
+   if (n <= 0) return;
+
+   if (to > from) {
+      for (c = 3; c >= 1; c--) {
+         memmove(data + c * to, data + c * from, n * sizeof(double));
+      }
+   } else {
+      for (c = 1; c <= 3; c++) {
+         memmove(data + c * to, data + c * from, n * sizeof(double));
+      }
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns the layout name.
+ */
+const char*
+PyQuaternionArrayLayoutName (const Py_quaternion_layout layout)
+{
+   return layout == QA_LAYOUT_SOA ? "soa" : "aos";
+}
+
+/* -----------------------------------------------------------------------------
+ * Decodes a layout name, None means the default AoS layout.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+bool
+PyQuaternionArrayDecodeLayout (PyObject *layoutObj, Py_quaternion_layout *layout)
+{
+   const char* name;
+
+   *layout = QA_LAYOUT_AOS;
+   if (!layoutObj || layoutObj == Py_None) return true;
+
+   if (!PyUnicode_Check(layoutObj)) {
+      PyErr_Format(PyExc_TypeError,
+                   "array layout must be a str (got type %s)",
+                   Py_TYPE(layoutObj)->tp_name);
+      return false;
+   }
+
+   name = PyUnicode_AsUTF8(layoutObj);
+   if (!name) return false;
+
+   if (strcmp(name, "aos") == 0) {
+      *layout = QA_LAYOUT_AOS;
+   } else if (strcmp(name, "soa") == 0) {
+      *layout = QA_LAYOUT_SOA;
+   } else {
+      PyErr_Format(PyExc_ValueError,
+                   "array layout must be 'aos' or 'soa' (got '%.200s')", name);
+      return false;
+   }
+   return true;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns a bytes object holding the items as an array of c quaternions.
+ */
+static PyObject *
+qa_to_bytes (const Py_quaternion_array *aval)
+{
+   PyObject *result;
+
+   result = PyBytes_FromStringAndSize(NULL, aval->count * sizeof(Py_quaternion));
+   if (result) {
+      PyQuaternionArrayGather (aval, 0, (Py_quaternion*) PyBytes_AS_STRING(result),
+                               aval->count);
+   }
+   return result;
+}
+
 /* -----------------------------------------------------------------------------
  * Returns a reference to a PyObject (PyQuaternionArray or subtype) set to aval
  */
@@ -85,27 +323,95 @@ quaternion_array_type_from_c_quaternion_array(const Py_quaternion_array aval)
    return op;
 }
 
+/* -----------------------------------------------------------------------------
+ * Allocation growth policy. When an array needs more room, the allocation grows
+ * geometrically, by the array's growth factor, so that appending items one at a
+ * time costs amortised O(1). The spare room is at least QA_MINIMUM_SPARE items
+ * and at most QA_MAXIMUM_SPARE items (128 MiB), beyond which growth is linear.
+ */
+#define QA_DEFAULT_GROWTH   1.5
+#define QA_MINIMUM_GROWTH   1.0
+#define QA_MAXIMUM_GROWTH   4.0
+#define QA_MINIMUM_SPARE    10
+#define QA_MAXIMUM_SPARE    (1 << 22)
+
+/* Returns the allocation for size items, including the spare room.
+ */
+static Py_ssize_t
+qa_grown_size(const Py_quaternion_array *aval, const Py_ssize_t size)
+{
+   static const Py_ssize_t maxNumber = PY_SSIZE_T_MAX / sizeof (Py_quaternion);
+   const double growth = aval->growth >= QA_MINIMUM_GROWTH ? aval->growth : QA_DEFAULT_GROWTH;
+   double spare;
+
+   spare = (growth - 1.0) * (double) size;
+   if (spare < QA_MINIMUM_SPARE) spare = QA_MINIMUM_SPARE;
+   if (spare > QA_MAXIMUM_SPARE) spare = QA_MAXIMUM_SPARE;
+
+   if (size > maxNumber - (Py_ssize_t) spare)
+      return size > maxNumber ? size : maxNumber;
+   return size + (Py_ssize_t) spare;
+}
+
 /* -----------------------------------------------------------------------------
  * When we do an initial allocation or need to do a reallocation, the
- * calculated size adds a bit of wiggle room to the minimum size.
+ * calculated size adds some spare room to the minimum size. If the current
+ * allocation is big enough, it is kept unless it is more than two growth steps
+ * larger than required, so that arrays that shrink and grow by a few items at a
+ * time are not reallocated each time.
  * Note: result is >= minimum_size
  */
 static Py_ssize_t
-qa_next_allocated_size(const Py_ssize_t minimum_size)
+qa_next_allocated_size(const Py_quaternion_array *aval, const Py_ssize_t minimum_size)
 {
-   Py_ssize_t result;
+   const Py_ssize_t result = qa_grown_size(aval, minimum_size);
 
-   result = (minimum_size * 11) / 10;  /* +10% */
-   if (result < minimum_size + 10) {
-       result = minimum_size + 10;     /* +10  */
+   if (aval->qvalArray && minimum_size <= aval->allocated &&
+       aval->allocated <= qa_grown_size(aval, result)) {
+      return aval->allocated;
    }
 
    return result;
 }
 
+/* -----------------------------------------------------------------------------
+ * Decodes a growth factor - None (the default) or a number from 1.0 to 4.0.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+static bool
+qa_decode_growth (PyObject *growthObj, double *growth)
+{
+   double value;
+
+   if (!growthObj || growthObj == Py_None) {
+      *growth = 0.0;
+      return true;
+   }
+
+   if (!PyFloat_Check(growthObj) && !PyLong_Check(growthObj)) {
+      PyErr_Format(PyExc_TypeError,
+                   "array growth must be a number or None (got type %s)",
+                   Py_TYPE(growthObj)->tp_name);
+      return false;
+   }
+
+   value = PyFloat_AsDouble(growthObj);
+   if (value == -1.0 && PyErr_Occurred())
+      return false;
+
+   if (!(value >= QA_MINIMUM_GROWTH && value <= QA_MAXIMUM_GROWTH)) {
+      PyErr_SetString(PyExc_ValueError, "array growth must be in the range 1.0 to 4.0");
+      return false;
+   }
+
+   *growth = value;
+   return true;
+}
+
 /* -----------------------------------------------------------------------------
  * Allocate/Reallocate value array buffer.
- * If exact false then then a bit of wiggle room is added to the re allocation (~10%).
+ * If exact false then then spare room is added to the re allocation, as per the
+ * growth policy above.
  * If exact true then then no wiggle room is added to the re allocation.
  * Returns true iff successful, otherwise reports error and returns false.
  */
@@ -119,7 +425,7 @@ qa_reallocate (Py_quaternion_array *aval, const Py_ssize_t new_size, const bool
    if (exact) {
       new_allocation = new_size;
    } else {
-      new_allocation = qa_next_allocated_size(new_size);
+      new_allocation = qa_next_allocated_size(aval, new_size);
    }
 
    /* Must always have at least reserved number of items.
@@ -132,161 +438,458 @@ qa_reallocate (Py_quaternion_array *aval, const Py_ssize_t new_size, const bool
       /* Re allocation- but only if really needed.
        */
       if (aval->allocated != new_allocation) {
+         /* SoA components must be moved to match the new allocation, the items
+          * beyond the old allocation, if any, are yet to be set.
+          */
+         const Py_ssize_t old_allocation = aval->allocated;
+         Py_ssize_t number = aval->count;
+         if (number > old_allocation) number = old_allocation;
+         if (number > new_allocation) number = new_allocation;
+
+         if (aval->layout == QA_LAYOUT_SOA && new_allocation < old_allocation) {
+            qa_repitch ((double*) aval->qvalArray, old_allocation, new_allocation, number);
+         }
+
+         Py_quaternion* qvalArray;
+         qvalArray = _Py_quat_buffer_realloc(aval->qvalArray,
+                                             new_allocation * sizeof(Py_quaternion));
+         if (!qvalArray) {
+            /* The existing buffer is retained, but SoA components may need to
+             * be restored to the old pitch.
+             */
+            if (aval->layout == QA_LAYOUT_SOA && new_allocation < old_allocation) {
+               qa_repitch ((double*) aval->qvalArray, new_allocation, old_allocation, number);
+            }
+            PyErr_Format(PyExc_MemoryError, "allocation for %ld quaternion items failed",
+                         new_allocation);
+            return false;
+         }
+
          aval->allocated = new_allocation;
-         aval->qvalArray = PyMem_REALLOC(aval->qvalArray,
-                                         aval->allocated * sizeof(Py_quaternion));
+         aval->qvalArray = qvalArray;
+
+         if (aval->layout == QA_LAYOUT_SOA && new_allocation > old_allocation) {
+            qa_repitch ((double*) aval->qvalArray, old_allocation, new_allocation, number);
+         }
       }
    } else {
       /* Initial allocation
        */
       aval->allocated = new_allocation;
-      aval->qvalArray = PyMem_MALLOC(aval->allocated * sizeof(Py_quaternion));
-
-   }
+      aval->qvalArray = _Py_quat_buffer_malloc(aval->allocated * sizeof(Py_quaternion));
 
-   if (!aval->qvalArray) {
-      PyErr_Format(PyExc_MemoryError, "allocation for %ld quaternion items failed",
-                   new_allocation);
-      return false;
+      if (!aval->qvalArray) {
+         PyErr_Format(PyExc_MemoryError, "allocation for %ld quaternion items failed",
+                      new_allocation);
+         return false;
+      }
    }
 
    return true;
 }
 
 /* -----------------------------------------------------------------------------
- * Validate and return the count of the number of items in the initializer.
- * Return -1 if any problem, such as non PyQuaternionObject-like objects, or
- * the initializer is not iterable.
  */
-static int
-qa_iterator_size(PyObject *initializer)
+PyObject *
+PyQuaternionArrayNew (const Py_ssize_t count, const Py_quaternion_layout layout)
 {
-   PyObject *iter = NULL;
-   PyQuaternionObject *pQuat = NULL;
-   PyObject *item = NULL;
-   int count;
+   PyObject *result;
+   Py_quaternion_array aval;
+   bool status;
 
-   if (!initializer) {  /* sanity check */
-      PyErr_SetString(PyExc_RuntimeError, "quaternion array program error.");
-      return -1;
+   aval.reserved = 0;
+   aval.growth = 0.0;
+   aval.allocated = 0;
+   aval.count = count;
+   aval.qvalArray = NULL;
+   aval.layout = layout;
+   status = qa_reallocate(&aval, aval.count, true);
+   if (!status)
+      return NULL;
+
+   memset (aval.qvalArray, 0, aval.allocated * sizeof(Py_quaternion));
+
+   result = quaternion_array_type_from_c_quaternion_array(aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
    }
+   return result;
+}
 
-   if (PyQuaternionArray_Check(initializer)) {
-      /* The initializer itself is a QuaternionArray object.
-       * We can short circuit a lot of vanilla logic.
-       */
-      PyQuaternionArrayObject* pObj;
-      pObj = (PyQuaternionArrayObject *)initializer;
-      SANITY_CHECK(pObj, -1);
+/* -----------------------------------------------------------------------------
+ */
+Py_quaternion_array *
+PyQuaternionArrayAcquire (PyObject *self, const bool writable)
+{
+   PyQuaternionArrayObject* pObj;
 
-      return pObj->aval.count;
+   if (!PyQuaternionArray_Check (self)) {
+      PyErr_Format(PyExc_TypeError, "expecting a QuaternionArray, not '%.200s'",
+                   Py_TYPE(self)->tp_name);
+      return NULL;
    }
 
-   iter = PyObject_GetIter(initializer);
-   if (!iter) {
-      PyErr_Format(PyExc_TypeError, "initializer is not iterable (type: '%s')",
-                   Py_TYPE(initializer)->tp_name);
-      return -1;
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   if (writable) {
+      WRITE_CHECK(pObj, NULL);
    }
 
+   pObj->busy++;
+   return &pObj->aval;
+}
 
-   /* Iterate once to get a count of the number of items, and  also ensure all
-    * the items are Quaternion or are castable to Quaternion i.e. int, float and
-    * complex types.
-    */
-   count = 0;
-   for (item = PyIter_Next(iter); item != NULL; item = PyIter_Next(iter)) {
-      /* Caste to a PyQuaternionObject otherwise retuns NULL
-       */
-      pQuat = (PyQuaternionObject*) PyObject_AsQuaternion(item);
-      if (!pQuat) {
-         PyErr_Format(PyExc_TypeError,
-                      "Quaternion argument expected (got type %s)",
-                      Py_TYPE(item)->tp_name);
-         return -1;
-      }
-      Py_DECREF (pQuat);
-      count++;
+/* -----------------------------------------------------------------------------
+ */
+void
+PyQuaternionArrayRelease (PyObject *self)
+{
+   ((PyQuaternionArrayObject *)self)->busy--;
+}
 
+/* -----------------------------------------------------------------------------
+ * Ensure there is room for at least required items, with a bit of wiggle room.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+static bool
+qa_ensure_allocated (Py_quaternion_array *aval, const Py_ssize_t required)
+{
+   if (aval->qvalArray && required <= aval->allocated) {
+      return true;
    }
-   return count;
+   return qa_reallocate (aval, required, false);
 }
 
 /* -----------------------------------------------------------------------------
- * NOTE: this should only be called if qa_iterator_size() returns >= 0.
- * This function, while it does some basic checking, does no reporting.
+ * Copies the items of a memory mapped array into memory we own, so that the array
+ * may be resized. The mapping is released.
+ * Only copy on write mappings, adopted pickle buffers and views may be copied
+ * like this - we must not quietly cut a shared mapping off from its file.
+ * Returns true iff successful, otherwise reports error and returns false.
  */
 static bool
-qa_extract_and_add(PyObject *initializer,
-                   Py_quaternion_array *aval)
+qa_unmap (PyQuaternionArrayObject* pObj)
 {
-   PyObject *iter = NULL;
-   PyQuaternionObject *pQuat = NULL;
-   PyObject *item = NULL;
-
-   if (!initializer)     return false;  /* sanity check */
-   if (!aval)            return false;  /* sanity check */
-   if (!aval->qvalArray) return false;  /* sanity check */
-
-   if (PyQuaternionArray_Check(initializer)) {
-      /* The initializer itself is a QuaternionArray object.
-       * We can short circuit a lot of vanilla logic.
-       */
-      PyQuaternionArrayObject* pObj;
-      Py_ssize_t number;
-
-      pObj = (PyQuaternionArrayObject *)initializer;
-      number = pObj->aval.count;
-
-      /* This works even when extending self.
-       */
-      memcpy(&aval->qvalArray [aval->count],
-             &pObj->aval.qvalArray [0],
-             number * sizeof (Py_quaternion));
+   Py_quaternion_array aval;
+   bool status;
 
-      aval->count += number;
-      return true;
+   if (pObj->mapMode == 's') {
+      PyErr_SetString(PyExc_BufferError, "cannot resize a shared memory quaternion array");
+      return false;
    }
 
-   iter = PyObject_GetIter(initializer);
-   if (!iter) return false;  /* belts 'n' braces sanity check */
+   if (pObj->mapMode != 'c' && pObj->mapMode != 'b' && pObj->mapMode != 'v') {
+      PyErr_Format(PyExc_BufferError,
+                   "cannot resize a memory mapped quaternion array (mode '%s')",
+                   pObj->mapMode == 'w' ? "r+" : "r");
+      return false;
+   }
 
-   for (item = PyIter_Next(iter); item != NULL; item = PyIter_Next(iter)) {
-      /* Caste to a PyQuaternionObject otherwise retuns NULL
-       */
-      pQuat = (PyQuaternionObject*) PyObject_AsQuaternion(item);
-      if (!pQuat) return false;  /* belts 'n' braces sanity check */
+   aval = pObj->aval;
+   aval.qvalArray = NULL;
+   status = qa_reallocate(&aval, aval.count, false);
+   if (!status)
+      return false;
 
-      aval->qvalArray [aval->count++] = pQuat->qval;
-      Py_DECREF (pQuat);
-   }
+   qa_move (&aval, 0, &pObj->aval, 0, aval.count);
 
+   PyBuffer_Release(&pObj->mapView);
+   Py_CLEAR(pObj->mapping);
+   pObj->aval = aval;
    return true;
 }
 
 /* -----------------------------------------------------------------------------
- * This is a wrapper around PySlice_AdjustIndices which does all the hard work.
- * The slice parameter must refer to a slice object.
+ * Decodes a buffer element format, i.e. an optional native byte order prefix
+ * followed by a single struct character, or 'Z' and a character for complex.
+ * Returns the struct character, or 0 when not a supported numeric format.
  */
-static bool
-qa_decode_slice (const Py_quaternion_array aval, PyObject *slice,
-                 Py_ssize_t *start, Py_ssize_t *stop,
-                 Py_ssize_t *step, Py_ssize_t *count)
+static char
+qa_buffer_format (const Py_buffer *view, bool *isComplex)
 {
-   if (!slice) return false;  /* sanity check */
+   const char *format = view->format ? view->format : "B";
+   Py_ssize_t size;
+   char c;
+
+#if PY_LITTLE_ENDIAN
+   if (format[0] == '<') format++;
+#else
+   if (format[0] == '>' || format[0] == '!') format++;
+#endif
+   if (format[0] == '@' || format[0] == '=') format++;
+
+   *isComplex = (format[0] == 'Z');
+   if (*isComplex) format++;
+
+   c = format[0];
+   if (c == '\0' || format[1] != '\0') return 0;
+
+   switch (c) {
+      case 'd': size = sizeof (double);             break;
+      case 'f': size = sizeof (float);              break;
+      case 'b': size = sizeof (signed char);        break;
+      case 'B': size = sizeof (unsigned char);      break;
+      case 'h': size = sizeof (short);              break;
+      case 'H': size = sizeof (unsigned short);     break;
+      case 'i': size = sizeof (int);                break;
+      case 'I': size = sizeof (unsigned int);       break;
+      case 'l': size = sizeof (long);               break;
+      case 'L': size = sizeof (unsigned long);      break;
+      case 'q': size = sizeof (long long);          break;
+      case 'Q': size = sizeof (unsigned long long); break;
+      default:  return 0;
+   }
 
-   /* First unpack the slice.
+   /* Standard sizes may differ from the native sizes, e.g. for '=l'.
     */
-   PySlice_Unpack(slice, start, stop, step);
-
-   if (*step == 0) {
-      PyErr_SetString (PyExc_ValueError, "slice step cannot be zero");
-      return false;
+   if (*isComplex) {
+      if (c != 'd' && c != 'f') return 0;
+      size *= 2;
    }
+   if (view->itemsize != size) return 0;
 
-   /* Next adjust taking into account the actual array length.
-    */
-   *count = PySlice_AdjustIndices (aval.count, start, stop, *step);
+   return c;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns the (possibly unaligned) buffer element at p as a double.
+ */
+#define QA_ELEMENT(ctype)  { ctype v; memcpy (&v, p, sizeof (v)); return (double) v; }
+
+static inline double
+qa_buffer_element (const char *p, const char c)
+{
+   switch (c) {
+      case 'd': QA_ELEMENT (double);
+      case 'f': QA_ELEMENT (float);
+      case 'b': QA_ELEMENT (signed char);
+      case 'B': QA_ELEMENT (unsigned char);
+      case 'h': QA_ELEMENT (short);
+      case 'H': QA_ELEMENT (unsigned short);
+      case 'i': QA_ELEMENT (int);
+      case 'I': QA_ELEMENT (unsigned int);
+      case 'l': QA_ELEMENT (long);
+      case 'L': QA_ELEMENT (unsigned long);
+      case 'q': QA_ELEMENT (long long);
+      case 'Q': QA_ELEMENT (unsigned long long);
+   }
+   return 0.0;
+}
+
+#undef QA_ELEMENT
+
+/* -----------------------------------------------------------------------------
+ * Appends the items of a numeric buffer to aval, without creating any per item
+ * Python objects. The supported buffers are:
+ *    1-D real     - each element is a real number, as when iterated;
+ *    1-D complex  - each element is a complex number, as when iterated;
+ *    2-D (n, 4)   - each row is w, x, y, z;
+ *    2-D (n, 3)   - each row is x, y, z, i.e. a pure quaternion;
+ *    2-D (n, 2)   - each row is a complex number, i.e. real, imag.
+ * Non contiguous buffers, e.g. numpy slices, are gathered using the strides.
+ * Returns 1 on success, 0 when obj is not a supported buffer (and no error is
+ * set), or -1 on failure, with error set.
+ */
+static int
+qa_extend_from_buffer (Py_quaternion_array *aval, PyObject *obj)
+{
+   Py_buffer view;
+   Py_ssize_t n;
+   Py_ssize_t width;
+   Py_ssize_t j;
+   Py_ssize_t s0;
+   Py_ssize_t s1;
+   bool isComplex;
+   char c;
+
+   if (PyObject_GetBuffer (obj, &view, PyBUF_RECORDS_RO) < 0) {
+      /* Not available as a strided buffer - just iterate.
+       */
+      PyErr_Clear ();
+      return 0;
+   }
+
+   c = qa_buffer_format (&view, &isComplex);
+
+   width = view.ndim == 1 ? (isComplex ? 2 : 1) : 0;
+   if (view.ndim == 2 && !isComplex &&
+       view.shape [1] >= 2 && view.shape [1] <= 4) {
+      width = view.shape [1];
+   }
+
+   if (!c || width == 0) {
+      PyBuffer_Release (&view);
+      return 0;
+   }
+
+   n = view.shape [0];
+   if (!qa_ensure_allocated (aval, aval->count + n)) {
+      PyBuffer_Release (&view);
+      return -1;
+   }
+
+   s0 = view.strides [0];
+   s1 = isComplex ? view.itemsize / 2 : (view.ndim == 2 ? view.strides [1] : 0);
+
+   if (c == 'd' && width == 4 && s0 == sizeof (Py_quaternion) && s1 == sizeof (double)) {
+      /* Contiguous quaternions - just copy.
+       */
+      PyQuaternionArrayScatter (aval, aval->count, (const Py_quaternion *) view.buf, n);
+
+   } else {
+      for (j = 0; j < n; j++) {
+         const char *p = (const char *) view.buf + j * s0;
+         Py_quaternion q = { 0.0, 0.0, 0.0, 0.0 };
+
+         switch (width) {
+            case 1:
+               q.w = qa_buffer_element (p, c);
+               break;
+            case 2:
+               /* Same as for a complex number, i.e. the imaginary part is j.
+                */
+               q.w = qa_buffer_element (p, c);
+               q.y = qa_buffer_element (p + s1, c);
+               break;
+            case 3:
+               q.x = qa_buffer_element (p, c);
+               q.y = qa_buffer_element (p + s1, c);
+               q.z = qa_buffer_element (p + 2 * s1, c);
+               break;
+            default:
+               q.w = qa_buffer_element (p, c);
+               q.x = qa_buffer_element (p + s1, c);
+               q.y = qa_buffer_element (p + 2 * s1, c);
+               q.z = qa_buffer_element (p + 3 * s1, c);
+               break;
+         }
+         qa_put (aval, aval->count + j, q);
+      }
+   }
+
+   aval->count += n;
+   PyBuffer_Release (&view);
+   return 1;
+}
+
+/* -----------------------------------------------------------------------------
+ * Converts the items of initializer, appending them to aval.
+ * The initializer may be a QuaternionArray; a numeric buffer object such as an
+ * array.array or a (n, 4) numpy array; or any other iterable of Quaternions,
+ * or of values castable to Quaternion, i.e. int, float and complex types.
+ * Other iterables are just iterated the once, and no intermediate Quaternion
+ * objects are created.
+ * Returns true iff successful, otherwise reports error and returns false, in
+ * which case aval->count is unchanged.
+ */
+static bool
+qa_extend_from (Py_quaternion_array *aval, PyObject *initializer)
+{
+   PyObject *seq = NULL;
+   PyObject **items;
+   Py_ssize_t n;
+   Py_ssize_t j;
+   int status;
+
+   if (!initializer) {  /* sanity check */
+      PyErr_SetString(PyExc_RuntimeError, "quaternion array program error.");
+      return false;
+   }
+
+   if (PyQuaternionArray_Check(initializer)) {
+      /* The initializer itself is a QuaternionArray object.
+       * We can short circuit a lot of vanilla logic.
+       */
+      PyQuaternionArrayObject* pObj;
+
+      pObj = (PyQuaternionArrayObject *)initializer;
+      SANITY_CHECK(pObj, false);
+      n = pObj->aval.count;
+
+      if (!qa_ensure_allocated (aval, aval->count + n))
+         return false;
+
+      /* This works even when extending self.
+       */
+      qa_move (aval, aval->count, &pObj->aval, 0, n);
+      aval->count += n;
+      return true;
+   }
+
+   /* A Quaternion supports the buffer API, but is not an iterable.
+    */
+   if (!PyQuaternion_Check(initializer) && PyObject_CheckBuffer(initializer)) {
+      status = qa_extend_from_buffer (aval, initializer);
+      if (status != 0)
+         return status > 0;
+   }
+
+   if (PyList_Check(initializer) || PyTuple_Check(initializer)) {
+      seq = initializer;
+      Py_INCREF(seq);
+   } else {
+      PyObject *iter = PyObject_GetIter(initializer);
+      if (!iter) {
+         PyErr_Format(PyExc_TypeError, "initializer is not iterable (type: '%s')",
+                      Py_TYPE(initializer)->tp_name);
+         return false;
+      }
+      seq = PySequence_List(iter);
+      Py_DECREF(iter);
+      if (!seq)
+         return false;
+   }
+
+   n = PySequence_Fast_GET_SIZE(seq);
+   items = PySequence_Fast_ITEMS(seq);
+
+   if (!qa_ensure_allocated (aval, aval->count + n)) {
+      Py_DECREF(seq);
+      return false;
+   }
+
+   for (j = 0; j < n; j++) {
+      Py_quaternion q;
+      if (!PyObject_AsCQuaternion(items [j], &q)) {
+         if (!PyErr_Occurred()) {
+            PyErr_Format(PyExc_TypeError,
+                         "Quaternion argument expected (got type %s)",
+                         Py_TYPE(items [j])->tp_name);
+         }
+         Py_DECREF(seq);
+         return false;
+      }
+      qa_put (aval, aval->count + j, q);
+   }
+
+   aval->count += n;
+   Py_DECREF(seq);
+   return true;
+}
+
+/* -----------------------------------------------------------------------------
+ * This is a wrapper around PySlice_AdjustIndices which does all the hard work.
+ * The slice parameter must refer to a slice object.
+ */
+static bool
+qa_decode_slice (const Py_quaternion_array aval, PyObject *slice,
+                 Py_ssize_t *start, Py_ssize_t *stop,
+                 Py_ssize_t *step, Py_ssize_t *count)
+{
+   if (!slice) return false;  /* sanity check */
+
+   /* First unpack the slice.
+    */
+   PySlice_Unpack(slice, start, stop, step);
+
+   if (*step == 0) {
+      PyErr_SetString (PyExc_ValueError, "slice step cannot be zero");
+      return false;
+   }
+
+   /* Next adjust taking into account the actual array length.
+    */
+   *count = PySlice_AdjustIndices (aval.count, start, stop, *step);
    return true;
 }
 
@@ -298,39 +901,32 @@ qa_decode_slice (const Py_quaternion_array aval, PyObject *slice,
 static PyObject *
 quaternion_array_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-   static char *kwlist[] = {"initializer", "reserve", 0};
+   static char *kwlist[] = {"initializer", "reserve", "layout", "growth", 0};
 
    PyObject *result = NULL;
    PyObject *initializer = NULL;
    PyObject *reserve = NULL;
+   PyObject *layout = NULL;
+   PyObject *growth = NULL;
    Py_quaternion_array aval;
-   Py_ssize_t initialNumber;
    bool status;
 
-   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO:QuaternionArray", kwlist,
-                                    &initializer, &reserve)) {
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOOO:QuaternionArray", kwlist,
+                                    &initializer, &reserve, &layout, &growth)) {
       return NULL;
    }
 
    aval.reserved = 0;      /* none unless we told otherwise */
+   aval.growth = 0.0;
+   aval.allocated = 0;
    aval.count = 0;         /* empty for now */
+   aval.qvalArray = NULL;
 
-   if (initializer) {
-      Py_ssize_t count;
-
-      count = qa_iterator_size (initializer);
-      if (count < 0) {
-         /* qa_iterator_size has already called PyErr_SetString/PyErr_Format.
-          */
-         return NULL;
-      }
+   if (!PyQuaternionArrayDecodeLayout (layout, &aval.layout))
+      return NULL;
 
-      initialNumber = qa_next_allocated_size (count);
-   } else {
-      /* No initializer
-       */
-      initialNumber = qa_next_allocated_size (0);  /* about 10 */
-   }
+   if (!qa_decode_growth (growth, &aval.growth))
+      return NULL;
 
    if (reserve) {
       if (!PyLong_Check(reserve)) {
@@ -349,20 +945,23 @@ quaternion_array_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
       }
    }
 
-   /* Allocate the storage
-    */
-   aval.qvalArray = NULL;
-   status = qa_reallocate(&aval, initialNumber, true);
-   if (!status)
-      return NULL;
-
-   /* Now re-iterate to extact the required values.
+   /* Allocate the storage and extact the required values, if any.
     */
    if (initializer) {
-      qa_extract_and_add (initializer, &aval);
+      status = qa_extend_from (&aval, initializer);
+   } else {
+      status = qa_reallocate(&aval, QA_MINIMUM_SPARE, true);
+   }
+
+   if (!status) {
+      _Py_quat_buffer_free(aval.qvalArray);
+      return NULL;
    }
 
    result = quaternion_array_subtype_from_c_quaternion_array(type, aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
    return result;
 }
 
@@ -374,8 +973,16 @@ quaternion_array_decalloc(PyObject* self)
    PyQuaternionArrayObject* pObj;
    pObj = (PyQuaternionArrayObject *)self;
 
+   if (pObj->mapping) {
+      /* The memory belongs to the mapping, not to us.
+       */
+      PyBuffer_Release(&pObj->mapView);
+      Py_CLEAR(pObj->mapping);
+      pObj->aval.qvalArray = NULL;
+   }
+
    if (pObj->aval.qvalArray) {
-      PyMem_FREE(pObj->aval.qvalArray);
+      _Py_quat_buffer_free(pObj->aval.qvalArray);
       pObj->aval.qvalArray = NULL;
    }
 }
@@ -400,7 +1007,7 @@ quaternion_array_str(PyObject* self)
    image[0] = '\0';
    strcat(image, "[");
    for (index = 0; index < pObj->aval.count; index++) {
-      Py_quaternion qval = pObj->aval.qvalArray [index];
+      Py_quaternion qval = qa_get (&pObj->aval, index);
       char *qstr;
       qstr = _Py_quat_to_string(qval, 'r', 0);
 
@@ -457,10 +1064,35 @@ quaternion_array_reduce (PyObject* self)
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
 
-   empty = Py_BuildValue("()");  /* empty arg list for construction */
+   /* The items of a shared memory array are not sent, just the means to
+    * attach to the same segment.
+    */
+   if (pObj->mapping && pObj->mapMode == 's') {
+      PyObject* func;
+      PyObject* name;
+      Py_ssize_t offset;
+
+      func = PyObject_GetAttrString((PyObject *)Py_TYPE(self), "from_shared_memory");
+      name = PyObject_GetAttrString(pObj->mapping, "name");
+      offset = (char*) pObj->aval.qvalArray - (char*) pObj->mapView.buf;
+      if (func && name) {
+         result = Py_BuildValue("O(Onnl)", func, name, offset, pObj->aval.count,
+                                (long) pObj->readonly);
+      }
+      Py_XDECREF(name);
+      Py_XDECREF(func);
+      return result;
+   }
+
+   /* Empty arg list for construction, other than the layout if needs be.
+    */
+   if (pObj->aval.layout == QA_LAYOUT_AOS) {
+      empty = Py_BuildValue("()");
+   } else {
+      empty = Py_BuildValue("(()is)", 0, PyQuaternionArrayLayoutName (pObj->aval.layout));
+   }
 
-   data = PyBytes_FromStringAndSize((char *) pObj->aval.qvalArray,
-                                     pObj->aval.count * sizeof(Py_quaternion));
+   data = qa_to_bytes (&pObj->aval);
 
    /* Form the state data tuple object.
     * Note: we don't preserve the actual number allocated.
@@ -472,6 +1104,107 @@ quaternion_array_reduce (PyObject* self)
    return result;
 }
 
+/* -----------------------------------------------------------------------------
+ * __reduce_ex__
+ */
+PyDoc_STRVAR(quaternion_array_reduce_ex_doc,
+             "__reduce_ex__(self, protocol, /)\n"
+             "Helper for pickle. For protocol 5 and later, the items of an 'aos' array\n"
+             "are provided as a pickle.PickleBuffer, so that they may be sent out-of-band,\n"
+             "and are not copied into an intermediate bytes object.");
+
+static PyObject *
+quaternion_array_reduce_ex (PyObject* self, PyObject* arg)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyObject* buffer;
+   int protocol;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   protocol = PyLong_AsLong(arg);
+   if (protocol == -1 && PyErr_Occurred())
+      return NULL;
+
+   /* The 'soa' items are not contiguous, so these are copied as per version 1.
+    */
+   if (protocol < 5 || pObj->aval.layout != QA_LAYOUT_AOS ||
+       (pObj->mapping && pObj->mapMode == 's')) {
+      return quaternion_array_reduce (self);
+   }
+
+   buffer = PyPickleBuffer_FromObject (self);
+   if (!buffer)
+      return NULL;
+
+   result = Py_BuildValue("O()(lnO)", Py_TYPE(self), pickleBufferFormatVersion,
+                          pObj->aval.reserved, buffer);
+   Py_DECREF(buffer);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * Sets the items from a version 2 state buffer, i.e. the unpickled PickleBuffer,
+ * which is either the bytes/bytearray read in-band, or an out-of-band buffer.
+ * Where the buffer is writable, suitably aligned and contiguous, and the array
+ * has the 'aos' layout of the state items, the array adopts it, much as per a
+ * copy on write memory mapped array, otherwise the items are copied.
+ */
+static PyObject *
+qa_setstate_buffer (PyQuaternionArrayObject* pObj, const Py_ssize_t reserved,
+                    PyObject* dataObj)
+{
+   Py_quaternion_array aval;
+   Py_buffer view;
+   bool status;
+
+   if (PyObject_GetBuffer(dataObj, &view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0) {
+      PyErr_Clear();
+      if (PyObject_GetBuffer(dataObj, &view, PyBUF_C_CONTIGUOUS) < 0)
+         return NULL;
+   }
+
+   if ((view.len % sizeof(Py_quaternion)) != 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "buffer length %ld not a multiple of quaternion size %ld",
+                   view.len, sizeof(Py_quaternion));
+      PyBuffer_Release(&view);
+      return NULL;
+   }
+
+   aval = pObj->aval;
+   aval.count = view.len / sizeof(Py_quaternion);
+   aval.reserved = reserved;
+
+   /* An adopted buffer has no spare space, so it is not adopted if more is
+    * reserved, as the array would be copied on the first append anyway.
+    */
+   if (!view.readonly && aval.count > 0 && aval.count >= reserved &&
+       aval.layout == QA_LAYOUT_AOS && ((uintptr_t) view.buf % sizeof (double)) == 0) {
+      _Py_quat_buffer_free(pObj->aval.qvalArray);
+      aval.allocated = aval.count;
+      aval.qvalArray = (Py_quaternion*) view.buf;
+      pObj->aval = aval;
+      pObj->mapping = view.obj;
+      Py_INCREF(pObj->mapping);
+      pObj->mapView = view;
+      pObj->mapMode = 'b';
+      Py_RETURN_NONE;
+   }
+
+   status = qa_reallocate(&aval, aval.count, false);
+   if (!status) {
+      PyBuffer_Release(&view);
+      return NULL;
+   }
+   pObj->aval = aval;
+   PyQuaternionArrayScatter (&pObj->aval, 0, (const Py_quaternion*) view.buf, aval.count);
+   PyBuffer_Release(&view);
+   Py_RETURN_NONE;
+}
+
 /* -----------------------------------------------------------------------------
  * __setstate__
  */
@@ -492,13 +1225,18 @@ quaternion_array_setstate(PyObject* self, PyObject *args)
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
 
    /* Extract the version, the number reserved and the data object.
     */
-   if (!PyArg_ParseTuple(args, "(llO):__setstate__",
+   if (!PyArg_ParseTuple(args, "(lnO):__setstate__",
                          &version, &reserved, &dataObj))
       return NULL;
 
+   if (version == pickleBufferFormatVersion) {
+      return qa_setstate_buffer (pObj, reserved, dataObj);
+   }
+
    if (!PyBytes_Check(dataObj)) {
       PyErr_Format(PyExc_TypeError,
                    "Expecting pickled quaternion array data to be type bytes (got type %s)",
@@ -533,7 +1271,7 @@ quaternion_array_setstate(PyObject* self, PyObject *args)
 
    /* Copy the data.
     */
-   memcpy(&pObj->aval.qvalArray[0], data, data_size);
+   PyQuaternionArrayScatter (&pObj->aval, 0, (const Py_quaternion*) data, pObj->aval.count);
 
    Py_RETURN_NONE;
 }
@@ -597,7 +1335,7 @@ quaternion_array_richcompare (PyObject *left, PyObject *right, int op)
        */
       Py_ssize_t k;
       for (k = 0; k < pObjL->aval.count; k++) {
-         equal = _Py_quat_eq(pObjL->aval.qvalArray[k], pObjR->aval.qvalArray[k]);
+         equal = _Py_quat_eq(qa_get (&pObjL->aval, k), qa_get (&pObjR->aval, k));
          if (!equal) break;
       }
    }
@@ -638,25 +1376,24 @@ quaternion_array_concat(PyObject *self, PyObject *arg)
    SANITY_CHECK(pArg, NULL);
 
    aval.reserved = 0;
+   aval.growth = 0.0;
    aval.allocated = 0;
    aval.count = pObj->aval.count + pArg->aval.count;
    aval.qvalArray = NULL;
+   aval.layout = pObj->aval.layout;
    status = qa_reallocate(&aval, aval.count, false);
    if (!status)
       return NULL;
 
    /* Now copy data
-    * void *memcpy(void *dest, const void *src, size_t n);
     */
-   memcpy(&aval.qvalArray[0],
-          &pObj->aval.qvalArray[0],
-          pObj->aval.count*sizeof(Py_quaternion));
-
-   memcpy(&aval.qvalArray[pObj->aval.count],
-          &pArg->aval.qvalArray[0],
-          pArg->aval.count*sizeof(Py_quaternion));
+   qa_move (&aval, 0, &pObj->aval, 0, pObj->aval.count);
+   qa_move (&aval, pObj->aval.count, &pArg->aval, 0, pArg->aval.count);
 
    result = quaternion_array_type_from_c_quaternion_array(aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
    return result;
 }
 
@@ -675,6 +1412,7 @@ quaternion_array_inplace_concat(PyObject *self, PyObject *arg)
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
 
    if (!PyQuaternionArray_Check(arg)) {
       PyErr_Format(PyExc_TypeError,
@@ -702,11 +1440,8 @@ quaternion_array_inplace_concat(PyObject *self, PyObject *arg)
 
    if (argCount > 0) {
       /* Now copy data and append
-       * void *memcpy(void *dest, const void *src, size_t n);
        */
-      memcpy(&pObj->aval.qvalArray[objCount],
-             &pArg->aval.qvalArray[0],
-             argCount*sizeof(Py_quaternion));
+      qa_move (&pObj->aval, objCount, &pArg->aval, 0, argCount);
    }
 
    Py_INCREF(self);   /** most important **/
@@ -730,23 +1465,25 @@ quaternion_array_repeat(PyObject *self, Py_ssize_t repeat)
 
    if (repeat < 0) repeat = 0;
    aval.reserved = 0;
+   aval.growth = 0.0;
    aval.allocated = 0;
    aval.count = pObj->aval.count * repeat;
    aval.qvalArray = NULL;
+   aval.layout = pObj->aval.layout;
    status = qa_reallocate(&aval, aval.count, false);
    if (!status)
       return NULL;
 
    /* Now copy data repeat times
-    * void *memcpy(void *dest, const void *src, size_t n);
     */
    for (k = 0; k < repeat; k++) {
-      memcpy(&aval.qvalArray[k*pObj->aval.count],
-             &pObj->aval.qvalArray[0],
-             pObj->aval.count*sizeof(Py_quaternion));
+      qa_move (&aval, k*pObj->aval.count, &pObj->aval, 0, pObj->aval.count);
    }
 
    result = quaternion_array_type_from_c_quaternion_array(aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
    return result;
 }
 
@@ -763,6 +1500,7 @@ quaternion_array_inplace_repeat (PyObject *self, Py_ssize_t repeat)
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
 
    objCount = pObj->aval.count;  /* save for later */
 
@@ -778,12 +1516,9 @@ quaternion_array_inplace_repeat (PyObject *self, Py_ssize_t repeat)
    }
 
    /* Now copy data repeat times
-    * void *memcpy(void *dest, const void *src, size_t n);
     */
    for (k = 1; k < repeat; k++) {
-      memcpy(&pObj->aval.qvalArray[k*objCount],
-             &pObj->aval.qvalArray[0],
-             objCount*sizeof(Py_quaternion));
+      qa_move (&pObj->aval, k*objCount, &pObj->aval, 0, objCount);
    }
 
    Py_INCREF(self);   /** most important **/
@@ -822,7 +1557,7 @@ PyQuaternionArrayGetItem(PyObject *self, Py_ssize_t index)
       return NULL;
    }
 
-   qval = pObj->aval.qvalArray [index];
+   qval = qa_get (&pObj->aval, index);
    result = PyQuaternion_FromCQuaternion(qval);
 
    return result;
@@ -844,6 +1579,7 @@ quaternion_array_append(PyObject *self, PyObject *args)
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
 
    /* Extract the value
     * Alas no Q option, so go via a vanilla object.
@@ -869,7 +1605,7 @@ quaternion_array_append(PyObject *self, PyObject *args)
          return NULL;
    }
 
-   pObj->aval.qvalArray[pObj->aval.count++] = pQuat->qval;
+   qa_put (&pObj->aval, pObj->aval.count++, pQuat->qval);
 
    Py_RETURN_NONE;
 }
@@ -892,6 +1628,7 @@ quaternion_array_insert(PyObject *self, PyObject *args)
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
 
    /* Extract the index and value
     * Alas no Q option, so go via a vanilla object.
@@ -941,20 +1678,14 @@ quaternion_array_insert(PyObject *self, PyObject *args)
    if (index >= pObj->aval.count) {
       /* This is essentially just an append.
         */
-      pObj->aval.qvalArray[pObj->aval.count++] = pQuatObj->qval;
+      qa_put (&pObj->aval, pObj->aval.count++, pQuatObj->qval);
    } else {
       /* This is an actual insert - shuffle up the data.
        */
       int numberToMove = pObj->aval.count - index;
 
-      /* memmove (*dest, *src, size)  - not can't use memcpy.
-       */
-      if (numberToMove > 0) {
-         memmove(&pObj->aval.qvalArray [index+1],
-                 &pObj->aval.qvalArray [index],
-                 numberToMove * sizeof(Py_quaternion));
-      }
-      pObj->aval.qvalArray[index] = pQuatObj->qval;
+      qa_move (&pObj->aval, index+1, &pObj->aval, index, numberToMove);
+      qa_put (&pObj->aval, index, pQuatObj->qval);
       pObj->aval.count++;
    }
 
@@ -973,11 +1704,11 @@ quaternion_array_extend(PyObject *self, PyObject *args)
 {
    PyQuaternionArrayObject* pObj;
    PyObject *initializer = NULL;
-   Py_ssize_t additional;
    bool status;
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
 
    /* Extract the initializer from the one element tuple
     */
@@ -986,48 +1717,236 @@ quaternion_array_extend(PyObject *self, PyObject *args)
 
    if (!initializer) return NULL;  /* sanity check */
 
-   additional = qa_iterator_size(initializer);
-   if (additional < 0) {
-      /* qa_iterator_size has already called PyErr_SetString/PyErr_Format.
-       */
+   status = qa_extend_from (&pObj->aval, initializer);
+   if (!status)
       return NULL;
-   }
 
-   /* Do we have enough room?
-    */
-   if (pObj->aval.count + additional > pObj->aval.allocated) {
-      /* Re allocate data
-       */
-      status = qa_reallocate(&pObj->aval, pObj->aval.count + additional, false);
-      if (!status)
-         return NULL;
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ * Parses a quaternion string into the next item of aval. The error message item
+ * number is relative to initial.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+static bool
+qa_append_string (Py_quaternion_array *aval, const char* s, const Py_ssize_t len,
+                  const Py_ssize_t initial)
+{
+   Py_quaternion qval;
+
+   if (!_Py_quat_from_string (s, len, &qval)) {
+      if (!PyErr_Occurred()) {
+         PyObject *text = PyUnicode_DecodeUTF8(s, len < 60 ? len : 60, "replace");
+         if (text) {
+            PyErr_Format(PyExc_ValueError,
+                         "fromstrings() item %ld is a malformed quaternion string: %R",
+                         aval->count - initial, text);
+            Py_DECREF(text);
+         }
+      }
+      return false;
    }
 
-   qa_extract_and_add(initializer, &pObj->aval);
+   if (!qa_ensure_allocated (aval, aval->count + 1))
+      return false;
 
-   Py_RETURN_NONE;
+   qa_put (aval, aval->count, qval);
+   aval->count++;
+   return true;
 }
 
 /* -----------------------------------------------------------------------------
+ * Parses the quaternion strings in the len characters of text, separated by sep,
+ * or by whitespace when sep is NULL. Empty strings are skipped.
+ * Returns true iff successful, otherwise reports error and returns false.
  */
-PyDoc_STRVAR(quaternion_array_frombytes_doc,
-             "frombytes(self, buffer, /)\n"
-             "Appends quaternions from the string, interpreting it as an array of machine values.");
+static bool
+qa_append_text (Py_quaternion_array *aval, const char* text, const Py_ssize_t len,
+                const char* sep, const Py_ssize_t seplen, const Py_ssize_t initial)
+{
+   const char* last = text + len;
+   const char* s = text;
+
+   while (s < last) {
+      const char* field = s;
+      const char* next;
+      const char* t;
+
+      if (sep) {
+         /* Find the next separator, starting with its first character.
+          */
+         next = s;
+         while ((next = memchr (next, sep[0], last - next)) &&
+                (last - next < seplen || memcmp (next, sep, seplen) != 0)) {
+            next++;
+         }
+         if (!next) next = last;
+         s = next < last ? next + seplen : last;
+      } else {
+         while (field < last && Py_ISSPACE(*field)) field++;
+         next = field;
+         while (next < last && !Py_ISSPACE(*next)) next++;
+         s = next;
+      }
+
+      for (t = field; t < next && Py_ISSPACE(*t); t++);
+      if (t == next) continue;   /* empty */
+
+      if (!qa_append_string (aval, field, next - field, initial))
+         return false;
+   }
+
+   return true;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_fromstrings_doc,
+             "fromstrings(self, data, sep='\\n', /)\n"
+             "Appends quaternions parsed from data, which is either a str or bytes-like object\n"
+             "holding quaternion strings, e.g. '1.2+3.4i+2.6j-2k', separated by sep, or\n"
+             "None for whitespace, or an iterable of str or bytes objects, each holding one\n"
+             "quaternion string. The strings are as accepted by Quaternion(), save that\n"
+             "underscores are not allowed. Empty strings in data, e.g. after a trailing\n"
+             "separator, are skipped. The items are parsed directly into the array, and\n"
+             "if any string is malformed, a ValueError is raised and no items are appended.");
 
 static PyObject *
-quaternion_array_frombytes(PyObject* self, PyObject *args)
+quaternion_array_fromstrings(PyObject* self, PyObject *args)
 {
    PyQuaternionArrayObject* pObj;
    PyObject *dataObj = NULL;
-   int bytesStatus;
-   int byteArrayStatus;
-   Py_ssize_t data_size = 0;
-   char* data = NULL;
-   Py_ssize_t additional;
-   bool status;
+   PyObject *sepObj = NULL;
+   const char* sep = "\n";
+   Py_ssize_t seplen = 1;
+   const Py_ssize_t initial = ((PyQuaternionArrayObject *)self)->aval.count;
+   bool status = false;
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
+
+   if (!PyArg_ParseTuple(args, "O|O:fromstrings", &dataObj, &sepObj))
+      return NULL;
+
+   if (sepObj == Py_None) {
+      sep = NULL;
+   } else if (sepObj) {
+      if (!PyUnicode_Check(sepObj)) {
+         PyErr_Format(PyExc_TypeError,
+                      "fromstrings() sep must be a str or None (got type %s)",
+                      Py_TYPE(sepObj)->tp_name);
+         return NULL;
+      }
+      sep = PyUnicode_AsUTF8AndSize(sepObj, &seplen);
+      if (!sep)
+         return NULL;
+      if (seplen == 0) {
+         PyErr_SetString(PyExc_ValueError, "fromstrings() empty separator");
+         return NULL;
+      }
+   }
+
+   /* Note: no Python code is run while parsing text, so the array can't change
+    * underfoot. The str, bytes and bytearray buffers are null terminated.
+    */
+   if (PyUnicode_Check(dataObj)) {
+      Py_ssize_t len;
+      const char* text = PyUnicode_AsUTF8AndSize(dataObj, &len);
+      status = text && qa_append_text (&pObj->aval, text, len, sep, seplen, initial);
+
+   } else if (PyBytes_Check(dataObj)) {
+      status = qa_append_text (&pObj->aval, PyBytes_AS_STRING(dataObj),
+                               PyBytes_GET_SIZE(dataObj), sep, seplen, initial);
+
+   } else if (PyByteArray_Check(dataObj)) {
+      status = qa_append_text (&pObj->aval, PyByteArray_AS_STRING(dataObj),
+                               PyByteArray_GET_SIZE(dataObj), sep, seplen, initial);
+
+   } else if (PyObject_CheckBuffer(dataObj)) {
+      /* Other buffers, e.g. mmap, are copied so as to be null terminated.
+       */
+      Py_buffer view;
+      char* text;
+
+      if (PyObject_GetBuffer(dataObj, &view, PyBUF_C_CONTIGUOUS) < 0)
+         return NULL;
+      text = PyMem_Malloc(view.len + 1);
+      if (text) {
+         memcpy (text, view.buf, view.len);
+         text [view.len] = '\0';
+         status = qa_append_text (&pObj->aval, text, view.len, sep, seplen, initial);
+         PyMem_Free(text);
+      } else {
+         PyErr_NoMemory();
+      }
+      PyBuffer_Release(&view);
+
+   } else {
+      /* An iterable of strings. Note: the iteration may run Python code, which
+       * is guarded against resizing the array by the busy count.
+       */
+      PyObject *iterator;
+      PyObject *item;
+
+      iterator = PyObject_GetIter(dataObj);
+      if (!iterator)
+         return NULL;
+
+      status = true;
+      pObj->busy++;
+      while (status && (item = PyIter_Next(iterator))) {
+         const char* text = NULL;
+         Py_ssize_t len = 0;
+
+         if (PyUnicode_Check(item)) {
+            text = PyUnicode_AsUTF8AndSize(item, &len);
+         } else if (PyBytes_Check(item)) {
+            text = PyBytes_AS_STRING(item);
+            len = PyBytes_GET_SIZE(item);
+         } else {
+            PyErr_Format(PyExc_TypeError,
+                         "fromstrings() items must be str or bytes (got type %s)",
+                         Py_TYPE(item)->tp_name);
+         }
+         status = text && qa_append_string (&pObj->aval, text, len, initial);
+         Py_DECREF(item);
+      }
+      pObj->busy--;
+      Py_DECREF(iterator);
+      if (PyErr_Occurred()) status = false;
+   }
+
+   if (!status) {
+      pObj->aval.count = initial;
+      return NULL;
+   }
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_frombytes_doc,
+             "frombytes(self, buffer, /)\n"
+             "Appends quaternions from the string, interpreting it as an array of machine values.");
+
+static PyObject *
+quaternion_array_frombytes(PyObject* self, PyObject *args)
+{
+   PyQuaternionArrayObject* pObj;
+   PyObject *dataObj = NULL;
+   int bytesStatus;
+   int byteArrayStatus;
+   Py_ssize_t data_size = 0;
+   char* data = NULL;
+   Py_ssize_t additional;
+   bool status;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
 
    /* Extract the bytes data object from the one element tuple.
     */
@@ -1086,7 +2005,8 @@ quaternion_array_frombytes(PyObject* self, PyObject *args)
 
    /* Copy the data
     */
-   memcpy(&pObj->aval.qvalArray[pObj->aval.count], data, data_size);
+   PyQuaternionArrayScatter (&pObj->aval, pObj->aval.count,
+                             (const Py_quaternion*) data, additional);
    pObj->aval.count += additional;
 
    Py_RETURN_NONE;
@@ -1120,6 +2040,7 @@ quaternion_array_fromfile(PyObject* self, PyObject *args)
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
 
    /* Extract the file data object number items from the tuple.
     */
@@ -1197,7 +2118,8 @@ quaternion_array_fromfile(PyObject* self, PyObject *args)
 
    /* Move the data
     */
-   memcpy(&pObj->aval.qvalArray[pObj->aval.count], data, data_size);
+   PyQuaternionArrayScatter (&pObj->aval, pObj->aval.count,
+                             (const Py_quaternion*) data, additional);
    pObj->aval.count += additional;
    Py_DECREF(bytesObj);
 
@@ -1213,467 +2135,3912 @@ quaternion_array_fromfile(PyObject* self, PyObject *args)
 
 
 /* -----------------------------------------------------------------------------
+ * Checks that the offset (in bytes) and count select items within a file or
+ * shared memory segment of the given size. A count of -1 is replaced by the
+ * number of items from the offset to the end.
+ * Returns true iff okay, otherwise reports error and returns false.
  */
-PyDoc_STRVAR(quaternion_array_info_doc,
-             "buffer_info(self, /)\n"
-             "Return a tuple (address, length) giving the current memory address and\n"
-             "the length in quaternions of the buffer used to hold array's contents.\n"
-             "\n"
-             "The length should be multiplied by the itemsize attribute to calculate\n"
-             "the buffer length in bytes.");
-
-static PyObject *
-quaternion_array_info(PyObject* self)
+static bool
+qa_check_extent (const char* fname, const char* what, const Py_ssize_t size,
+                 const Py_ssize_t offset, Py_ssize_t* count)
 {
-   PyObject *result = NULL;
-   PyQuaternionArrayObject* pObj;
-   Py_ssize_t address;
+   static const Py_ssize_t maxNumber = PY_SSIZE_T_MAX / sizeof (Py_quaternion);
 
-   pObj = (PyQuaternionArrayObject *)self;
-   // No SANITY_CHECK here
+   if (offset > size) {
+      PyErr_Format(PyExc_ValueError,
+                   "%s() offset %ld is beyond the end of the %s (size %ld)",
+                   fname, offset, what, size);
+      return false;
+   }
 
-   address = pObj->aval.count > 0 ? (Py_ssize_t) pObj->aval.qvalArray : 0;
-   result = Py_BuildValue("(ll)", address, pObj->aval.count);
+   if (*count == -1) {
+      if (((size - offset) % sizeof (Py_quaternion)) != 0) {
+         PyErr_Format(PyExc_ValueError,
+                      "%s() %s size less offset (%ld) not a multiple of quaternion size %d",
+                      fname, what, size - offset, (int) sizeof (Py_quaternion));
+         return false;
+      }
+      *count = (size - offset) / sizeof (Py_quaternion);
+   } else if (*count > maxNumber || *count * (Py_ssize_t) sizeof (Py_quaternion) > size - offset) {
+      PyErr_Format(PyExc_EOFError,
+                   "%s() %s too short for %ld quaternions at offset %ld (size %ld)",
+                   fname, what, *count, offset, size);
+      return false;
+   }
 
-   return result;
+   return true;
 }
 
 /* -----------------------------------------------------------------------------
  */
-PyDoc_STRVAR(quaternion_array_clear_doc,
-             "clear(self, /)\n"
-             "Remove all items from the array.");
+PyDoc_STRVAR(quaternion_array_mmap_doc,
+             "mmap(path, mode='r', offset=0, count=-1)\n"
+             "Return an array whose items are held in a memory mapped region of a file,\n"
+             "as written by tofile(), without reading the file.\n"
+             "\n"
+             "mode is one of 'r' (read only), 'r+' (changes are written to the file) or\n"
+             "'c' (copy on write, changes are not written to the file). offset, which must\n"
+             "be a multiple of 8, is the position in bytes of the first item. count is the\n"
+             "number of items, -1 means all the items up to the end of the file.\n"
+             "\n"
+             "A mapped array may not be resized, except in 'c' mode, in which case the\n"
+             "items are first copied into memory, leaving the mapping.");
 
 static PyObject *
-quaternion_array_clear(PyObject* self)
+quaternion_array_mmap(PyObject *cls, PyObject *args, PyObject *kwds)
 {
+   static char *kwlist[] = {"path", "mode", "offset", "count", NULL};
+
+   PyObject *result = NULL;
    PyQuaternionArrayObject* pObj;
+   PyObject *pathObj = NULL;
+   const char* mode = "r";
+   Py_ssize_t offset = 0;
+   Py_ssize_t count = -1;
+   char mapMode;
+   const char* access;
+   PyObject *ioModule = NULL;
+   PyObject *mmapModule = NULL;
+   PyObject *fileObj = NULL;
+   PyObject *sizeObj = NULL;
+   PyObject *accessObj = NULL;
+   PyObject *mmapFunc = NULL;
+   PyObject *mmapArgs = NULL;
+   PyObject *mmapKwds = NULL;
+   PyObject *mapping = NULL;
+   Py_buffer mapView;
+   Py_ssize_t size;
+   Py_quaternion_array aval;
+   int fd;
    bool status;
 
-   pObj = (PyQuaternionArrayObject *)self;
-   SANITY_CHECK(pObj, NULL);
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|snn:mmap", kwlist,
+                                    &pathObj, &mode, &offset, &count))
+      return NULL;
 
-   pObj->aval.count = 0;
-   status = qa_reallocate(&pObj->aval, 0, false);
-   if (!status)
+   if (strcmp (mode, "r") == 0) {
+      mapMode = 'r';
+      access = "ACCESS_READ";
+   } else if (strcmp (mode, "r+") == 0) {
+      mapMode = 'w';
+      access = "ACCESS_WRITE";
+   } else if (strcmp (mode, "c") == 0) {
+      mapMode = 'c';
+      access = "ACCESS_COPY";
+   } else {
+      PyErr_Format(PyExc_ValueError,
+                   "mmap() mode must be one of 'r', 'r+' or 'c' (got '%.200s')", mode);
       return NULL;
+   }
 
-   Py_RETURN_NONE;
+   if (offset < 0 || (offset % sizeof (double)) != 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "mmap() offset must be a non-negative multiple of %d (got %ld)",
+                   (int) sizeof (double), offset);
+      return NULL;
+   }
+
+   if (count < -1) {
+      PyErr_Format(PyExc_ValueError, "mmap() count must be -1 or more (got %ld)", count);
+      return NULL;
+   }
+
+   ioModule = PyImport_ImportModule("io");
+   if (!ioModule) goto done;
+
+   fileObj = PyObject_CallMethod(ioModule, "open", "Os", pathObj,
+                                 mapMode == 'w' ? "r+b" : "rb");
+   if (!fileObj) goto done;
+
+   sizeObj = PyObject_CallMethod(fileObj, "seek", "ii", 0, 2);
+   if (!sizeObj) goto done;
+   size = PyLong_AsSsize_t (sizeObj);
+   if (size == -1 && PyErr_Occurred()) goto done;
+
+   if (!qa_check_extent ("mmap", "file", size, offset, &count)) goto done;
+
+   aval.reserved = 0;
+   aval.growth = 0.0;
+   aval.allocated = count;
+   aval.count = count;
+   aval.qvalArray = NULL;
+   aval.layout = QA_LAYOUT_AOS;
+
+   if (count == 0) {
+      /* Zero length files can't be mapped, nor is there any need.
+       */
+      status = qa_reallocate(&aval, QA_MINIMUM_SPARE, true);
+      if (!status) goto done;
+      result = quaternion_array_subtype_from_c_quaternion_array((PyTypeObject *)cls, aval);
+      if (!result) {
+         _Py_quat_buffer_free(aval.qvalArray);
+         goto done;
+      }
+      ((PyQuaternionArrayObject *)result)->readonly = (mapMode == 'r');
+      goto done;
+   }
+
+   fd = PyObject_AsFileDescriptor (fileObj);
+   if (fd < 0) goto done;
+
+   mmapModule = PyImport_ImportModule("mmap");
+   if (!mmapModule) goto done;
+
+   accessObj = PyObject_GetAttrString(mmapModule, access);
+   if (!accessObj) goto done;
+
+   /* The mapping duplicates the file descriptor, so the file may be closed.
+    * The mapping length only needs to cover the selected items.
+    */
+   mmapArgs = Py_BuildValue("(in)", fd,
+                            offset + count * (Py_ssize_t) sizeof (Py_quaternion));
+   if (!mmapArgs) goto done;
+   mmapKwds = Py_BuildValue("{sO}", "access", accessObj);
+   if (!mmapKwds) goto done;
+   mmapFunc = PyObject_GetAttrString(mmapModule, "mmap");
+   if (!mmapFunc) goto done;
+
+   mapping = PyObject_Call(mmapFunc, mmapArgs, mmapKwds);
+   if (!mapping) goto done;
+
+   if (PyObject_GetBuffer(mapping, &mapView,
+                          mapMode == 'r' ? PyBUF_SIMPLE : PyBUF_WRITABLE) < 0)
+      goto done;
+
+   aval.qvalArray = (Py_quaternion*) ((char*) mapView.buf + offset);
+   result = quaternion_array_subtype_from_c_quaternion_array((PyTypeObject *)cls, aval);
+   if (!result) {
+      PyBuffer_Release(&mapView);
+      goto done;
+   }
+
+   pObj = (PyQuaternionArrayObject *)result;
+   pObj->mapping = mapping;
+   pObj->mapView = mapView;
+   pObj->mapMode = mapMode;
+   pObj->readonly = (mapMode == 'r');
+   mapping = NULL;  /* now owned by the array */
+
+done:
+   if (fileObj) {
+      /* Close the file, preserving any pending exception.
+       */
+      PyObject *type, *value, *traceback;
+      PyObject *closed;
+      PyErr_Fetch(&type, &value, &traceback);
+      closed = PyObject_CallMethod(fileObj, "close", NULL);
+      Py_XDECREF(closed);
+      if (type) {
+         PyErr_Restore(type, value, traceback);
+      } else if (!closed) {
+         Py_CLEAR(result);
+      }
+   }
+   Py_XDECREF(mapping);
+   Py_XDECREF(mmapFunc);
+   Py_XDECREF(mmapKwds);
+   Py_XDECREF(mmapArgs);
+   Py_XDECREF(accessObj);
+   Py_XDECREF(sizeObj);
+   Py_XDECREF(fileObj);
+   Py_XDECREF(mmapModule);
+   Py_XDECREF(ioModule);
+   return result;
 }
 
 /* -----------------------------------------------------------------------------
+ * Creates an array of the given type whose items are held in the buffer of shm,
+ * a multiprocessing.shared_memory.SharedMemory object (or similar).
  */
-PyDoc_STRVAR(quaternion_array_count_doc,
-             "count(self, q, /)\n"
-             "Return number of occurrences of q in the array.");
-
 static PyObject *
-quaternion_array_count(PyObject* self, PyObject *args)
+qa_from_shared_memory(PyTypeObject *type, PyObject *shm, const Py_ssize_t offset,
+                      Py_ssize_t count, const bool readonly, const char* fname)
 {
    PyObject *result = NULL;
    PyQuaternionArrayObject* pObj;
-   PyObject *valueObj;
-   PyQuaternionObject* pQuatObj;
-   Py_ssize_t count;
-   Py_ssize_t k;
+   PyObject *bufObj;
+   Py_buffer mapView;
+   Py_quaternion_array aval;
 
-   pObj = (PyQuaternionArrayObject *)self;
-   SANITY_CHECK(pObj, NULL);
+   if (offset < 0 || (offset % sizeof (double)) != 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "%s() offset must be a non-negative multiple of %d (got %ld)",
+                   fname, (int) sizeof (double), offset);
+      return NULL;
+   }
 
-   /* Extract the value
-    */
-   if (!PyArg_ParseTuple(args, "O:count", &valueObj))
+   if (count < -1) {
+      PyErr_Format(PyExc_ValueError, "%s() count must be -1 or more (got %ld)", fname, count);
       return NULL;
+   }
 
-   /* PyObject_AsQuaternion converts ints, floats, complex and quaternions
-    * into a quaternion or returns NULL.
-    */
-   pQuatObj = (PyQuaternionObject*) PyObject_AsQuaternion(valueObj);
-   if (!pQuatObj) {
-      PyErr_Format(PyExc_TypeError,
-                   "a Quaternion argument is required (got type %s)",
-                   Py_TYPE(valueObj)->tp_name);
+   bufObj = PyObject_GetAttrString(shm, "buf");
+   if (!bufObj)
+      return NULL;
+
+   if (PyObject_GetBuffer(bufObj, &mapView, readonly ? PyBUF_SIMPLE : PyBUF_WRITABLE) < 0) {
+      Py_DECREF(bufObj);
       return NULL;
    }
+   Py_DECREF(bufObj);  /* the view holds its own reference */
 
-   count = 0;
-   for (k = 0; k < pObj->aval.count; k++) {
-      if (_Py_quat_eq (pQuatObj->qval, pObj->aval.qvalArray[k])) {
-         count++;
-      }
+   if (!qa_check_extent (fname, "segment", mapView.len, offset, &count)) {
+      PyBuffer_Release(&mapView);
+      return NULL;
    }
 
-   result = PyLong_FromLong(count);
+   aval.reserved = 0;
+   aval.growth = 0.0;
+   aval.allocated = count;
+   aval.count = count;
+   aval.qvalArray = (Py_quaternion*) ((char*) mapView.buf + offset);
+   aval.layout = QA_LAYOUT_AOS;
+
+   result = quaternion_array_subtype_from_c_quaternion_array(type, aval);
+   if (!result) {
+      PyBuffer_Release(&mapView);
+      return NULL;
+   }
+
+   Py_INCREF(shm);
+   pObj = (PyQuaternionArrayObject *)result;
+   pObj->mapping = shm;
+   pObj->mapView = mapView;
+   pObj->mapMode = 's';
+   pObj->readonly = readonly;
    return result;
 }
 
 /* -----------------------------------------------------------------------------
+ * Calls multiprocessing.shared_memory.SharedMemory(*args, **kwds).
  */
-PyDoc_STRVAR(quaternion_array_index_doc,
-             "index(self, q, /)\n"
-             "Return index of first occurrence of q in the array.");
-
 static PyObject *
-quaternion_array_index(PyObject* self, PyObject *args)
+qa_shared_memory_call(PyObject *args, PyObject *kwds)
 {
    PyObject *result = NULL;
-   PyQuaternionArrayObject* pObj;
-   PyObject *valueObj;
-   PyQuaternionObject* pQuatObj;
-   Py_ssize_t index;
+   PyObject *module;
+   PyObject *func;
 
-   pObj = (PyQuaternionArrayObject *)self;
-   SANITY_CHECK(pObj, NULL);
-
-   /* Extract the value
-    */
-   if (!PyArg_ParseTuple(args, "O:index", &valueObj))
+   module = PyImport_ImportModule("multiprocessing.shared_memory");
+   if (!module)
       return NULL;
 
-   /* PyObject_AsQuaternion converts ints, floats, complex and quaternions
-    * into a quaternion or returns NULL.
-    */
-   pQuatObj = (PyQuaternionObject*) PyObject_AsQuaternion(valueObj);
-   if (!pQuatObj) {
-      PyErr_Format(PyExc_TypeError,
-                   "a Quaternion argument is required (got type %s)",
-                   Py_TYPE(valueObj)->tp_name);
-      return NULL;
+   func = PyObject_GetAttrString(module, "SharedMemory");
+   if (func) {
+      result = PyObject_Call(func, args, kwds);
+      Py_DECREF(func);
    }
+   Py_DECREF(module);
+   return result;
+}
 
-   for (index = 0; index < pObj->aval.count; index++) {
-      if (_Py_quat_eq (pQuatObj->qval, pObj->aval.qvalArray[index])) {
-         // Found it.
-         //
-         result = PyLong_FromLong(index);
-         break;
-      }
-   }
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_from_shared_memory_doc,
+             "from_shared_memory(shm, offset=0, count=-1, readonly=False)\n"
+             "Return an array whose items are held in a shared memory segment, without\n"
+             "copying them. shm is a multiprocessing.shared_memory.SharedMemory object, or\n"
+             "the name of an existing segment, e.g. as created in another process.\n"
+             "\n"
+             "offset, which must be a multiple of 8, is the position in bytes of the first\n"
+             "item. count is the number of items, -1 means all the items up to the end of\n"
+             "the segment. Changes to the items are visible to all processes using the\n"
+             "segment. The array may not be resized, and when pickled, only the segment\n"
+             "name, offset and count are sent.");
 
-   if (!result) {
-      PyErr_SetString(PyExc_ValueError, "array.index(q): q not in array.");
+static PyObject *
+quaternion_array_from_shared_memory(PyObject *cls, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"shm", "offset", "count", "readonly", NULL};
+
+   PyObject *result = NULL;
+   PyObject *shmObj = NULL;
+   Py_ssize_t offset = 0;
+   Py_ssize_t count = -1;
+   int readonly = 0;
 
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|nnp:from_shared_memory", kwlist,
+                                    &shmObj, &offset, &count, &readonly))
+      return NULL;
+
+   if (PyUnicode_Check(shmObj)) {
+      /* Attach to an existing segment by name.
+       */
+      PyObject *shmArgs = PyTuple_New(0);
+      PyObject *shmKwds = Py_BuildValue("{sO}", "name", shmObj);
+      if (shmArgs && shmKwds) {
+         shmObj = qa_shared_memory_call(shmArgs, shmKwds);
+      } else {
+         shmObj = NULL;
+      }
+      Py_XDECREF(shmKwds);
+      Py_XDECREF(shmArgs);
+      if (!shmObj)
+         return NULL;
+   } else {
+      Py_INCREF(shmObj);
    }
 
+   result = qa_from_shared_memory((PyTypeObject *)cls, shmObj, offset, count, readonly,
+                                  "from_shared_memory");
+   Py_DECREF(shmObj);
    return result;
 }
 
 /* -----------------------------------------------------------------------------
  */
-PyDoc_STRVAR(quaternion_array_pop_doc,
-             "pop(self, i=-1, /)\n"
-             "Return the i-th element and delete it from the array.\n"
-             "i defaults to -1.");
+PyDoc_STRVAR(quaternion_array_to_shared_memory_doc,
+             "to_shared_memory(self, name=None, /)\n"
+             "Return a copy of the array whose items are held in a newly created\n"
+             "multiprocessing.shared_memory.SharedMemory segment, as per from_shared_memory().\n"
+             "name is the segment name, None means a unique name is chosen. The segment is\n"
+             "available via the shared_memory attribute, and must be unlinked by the caller\n"
+             "when no longer needed.");
 
 static PyObject *
-quaternion_array_pop(PyObject* self, PyObject *args)
+quaternion_array_to_shared_memory(PyObject *self, PyObject *args)
 {
-   PyObject *result = NULL;
    PyQuaternionArrayObject* pObj;
-   PyObject* indexObj = NULL;
-   Py_ssize_t index;
-   Py_quaternion qval;
+   PyObject *result = NULL;
+   PyObject *nameObj = Py_None;
+   PyObject *shmArgs;
+   PyObject *shmKwds;
+   PyObject *shmObj;
+   Py_ssize_t nbytes;
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
 
-   /* Extract the optional index
-    */
-   if (!PyArg_ParseTuple(args, "|O:pop", &indexObj))
+   if (!PyArg_ParseTuple(args, "|O:to_shared_memory", &nameObj))
       return NULL;
 
-   if (indexObj) {
-      /* an index argument has been provided.
-       */
-      if (!PyLong_Check(indexObj)) {
-         PyErr_Format(PyExc_TypeError,
-                      "array indices must be integers (got type %s)",
-                      Py_TYPE(indexObj)->tp_name);
-         return NULL;
-      }
-      index = PyLong_AsSsize_t(indexObj);
+   /* A segment may not be empty, so allow at least one item.
+    */
+   nbytes = pObj->aval.count * (Py_ssize_t) sizeof (Py_quaternion);
+   if (nbytes == 0) nbytes = sizeof (Py_quaternion);
+
+   shmArgs = PyTuple_New(0);
+   shmKwds = Py_BuildValue("{sOsOsn}", "name", nameObj, "create", Py_True, "size", nbytes);
+   if (shmArgs && shmKwds) {
+      shmObj = qa_shared_memory_call(shmArgs, shmKwds);
    } else {
-      index = -1;  /* default */
+      shmObj = NULL;
    }
+   Py_XDECREF(shmKwds);
+   Py_XDECREF(shmArgs);
+   if (!shmObj)
+      return NULL;
 
-   /* negative means relative to end counting backward.
-    */
-   if (index < 0) index = pObj->aval.count + index;
+   result = qa_from_shared_memory(Py_TYPE(self), shmObj, 0, pObj->aval.count, false,
+                                  "to_shared_memory");
+   if (result) {
+      PyQuaternionArrayGather (&pObj->aval, 0,
+                               ((PyQuaternionArrayObject *)result)->aval.qvalArray,
+                               pObj->aval.count);
+   } else {
+      /* Don't leave an orphaned segment behind, preserving the pending exception.
+       */
+      PyObject *type, *value, *traceback;
+      PyObject *unlinked;
+      PyErr_Fetch(&type, &value, &traceback);
+      unlinked = PyObject_CallMethod(shmObj, "unlink", NULL);
+      Py_XDECREF(unlinked);
+      PyErr_Restore(type, value, traceback);
+   }
 
-   if ((index < 0) || (index >= pObj->aval.count)) {
-      PyErr_SetString(PyExc_IndexError,
-                      "pop index out of range");
+   Py_DECREF(shmObj);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyObject *
+PyQuaternionArrayView (PyObject *self, const Py_ssize_t start, const Py_ssize_t stop)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyQuaternionArrayObject* pView;
+   Py_quaternion_array aval;
+   Py_buffer mapView;
+
+   if (!PyQuaternionArray_Check(self)) {
+      PyErr_BadInternalCall();
       return NULL;
    }
 
-   /* Create popped quaternion as an object.
-    */
-   qval  = pObj->aval.qvalArray [index];
-   result = PyQuaternion_FromCQuaternion(qval);
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
 
-   /* Shuffle data down toward zero-th index.
-    * memmove (void *__dest, const void *__src, size_t __n)
+   if (start < 0 || start > stop || stop > pObj->aval.count) {
+      PyErr_Format(PyExc_IndexError,
+                   "array view %ld to %ld out of range (count %ld)",
+                   start, stop, pObj->aval.count);
+      return NULL;
+   }
+
+   /* The parent's buffer is exported for the lifetime of the view, which both
+    * keeps the parent alive and prevents it from being resized.
     */
-   int numberToMove = pObj->aval.count - index - 1;
-   if (numberToMove > 0) {
-      memmove(&pObj->aval.qvalArray [index],
-              &pObj->aval.qvalArray [index+1],
-              numberToMove * sizeof(Py_quaternion));
+   if (PyObject_GetBuffer(self, &mapView,
+                          pObj->readonly ? PyBUF_RECORDS_RO : PyBUF_RECORDS) < 0)
+      return NULL;
+
+   aval.reserved = 0;
+   aval.growth = pObj->aval.growth;
+   aval.count = stop - start;
+   aval.layout = pObj->aval.layout;
+   if (aval.layout == QA_LAYOUT_AOS) {
+      aval.allocated = aval.count;
+      aval.qvalArray = pObj->aval.qvalArray + start;
+   } else {
+      /* The SoA component pitch is that of the parent.
+       */
+      aval.allocated = pObj->aval.allocated;
+      aval.qvalArray = (Py_quaternion*) (QA_COLUMN(&pObj->aval, 0) + start);
+   }
+
+   result = quaternion_array_subtype_from_c_quaternion_array(Py_TYPE(self), aval);
+   if (!result) {
+      PyBuffer_Release(&mapView);
+      return NULL;
    }
-   pObj->aval.count--;
 
+   Py_INCREF(self);
+   pView = (PyQuaternionArrayObject *)result;
+   pView->mapping = self;
+   pView->mapView = mapView;
+   pView->mapMode = 'v';
+   pView->readonly = pObj->readonly;
    return result;
 }
 
 /* -----------------------------------------------------------------------------
  */
-PyDoc_STRVAR(quaternion_array_remove_doc,
-             "remove(self, q, /)\n"
-             "Remove the first occurrence of v in the array.");
+PyDoc_STRVAR(quaternion_array_view_doc,
+             "view(self, start=0, stop=None)\n"
+             "Return an array whose items are items start to stop - 1 of this array, as per\n"
+             "self[start:stop], but without copying them. The view has the same layout and\n"
+             "shares the items with this array, which is kept alive by the view, and which\n"
+             "may not be resized while the view exists. Changes to the items by either\n"
+             "array are visible to both. The view may be resized, in which case its items\n"
+             "are first copied into memory of its own, detaching it from this array.");
 
 static PyObject *
-quaternion_array_remove(PyObject* self, PyObject *args)
+quaternion_array_view(PyObject *self, PyObject *args, PyObject *kwds)
 {
+   static char *kwlist[] = {"start", "stop", NULL};
+
    PyQuaternionArrayObject* pObj;
-   PyObject *valueObj;
-   PyQuaternionObject* pQuatObj;
-   Py_ssize_t index;
+   PyObject *stopObj = Py_None;
+   Py_ssize_t start = 0;
+   Py_ssize_t stop;
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
 
-   /* Extract the value
-    */
-   if (!PyArg_ParseTuple(args, "O:remove", &valueObj))
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|nO:view", kwlist, &start, &stopObj))
       return NULL;
 
-   /* PyObject_AsQuaternion converts ints, floats, complex and quaternions
-    * into a quaternion or returns NULL.
+   stop = pObj->aval.count;
+   if (stopObj != Py_None) {
+      stop = PyNumber_AsSsize_t(stopObj, PyExc_OverflowError);
+      if (stop == -1 && PyErr_Occurred())
+         return NULL;
+   }
+
+   /* Negative start and stop values count back from the end, as per slices.
     */
-   pQuatObj = (PyQuaternionObject*) PyObject_AsQuaternion(valueObj);
-   if (!pQuatObj) {
-      PyErr_Format(PyExc_TypeError,
-                   "a Quaternion argument is required (got type %s)",
-                   Py_TYPE(valueObj)->tp_name);
-      return NULL;
+   if (PySlice_AdjustIndices(pObj->aval.count, &start, &stop, 1) == 0) {
+      stop = start;
    }
 
-   for (index = 0; index < pObj->aval.count; index++) {
-      if (_Py_quat_eq (pQuatObj->qval, pObj->aval.qvalArray[index])) {
-         /* Found it
-          *
-          * Shuffle data down toward zero-th index.
-          * memmove (void *__dest, const void *__src, size_t __n)
-          */
-         int numberToMove = pObj->aval.count - index - 1;
-         if (numberToMove > 0) {
-            memmove(&pObj->aval.qvalArray [index],
-                    &pObj->aval.qvalArray [index+1],
-                    numberToMove * sizeof(Py_quaternion));
-         }
-         pObj->aval.count--;
+   return PyQuaternionArrayView (self, start, stop);
+}
 
-         Py_RETURN_NONE;
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_tolist_doc,
+             "tolist(self, /)\n"
+             "Return a list of the items, as Quaternion objects.");
+
+static PyObject *
+quaternion_array_tolist(PyObject *self, PyObject *noargs)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   Py_quaternion block [QA_BLOCK];
+   Py_ssize_t j;
+   Py_ssize_t k;
+   Py_ssize_t m;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   result = PyList_New(pObj->aval.count);
+   if (!result)
+      return NULL;
+
+   for (j = 0; j < pObj->aval.count; j += m) {
+      m = pObj->aval.count - j;
+      if (m > QA_BLOCK) m = QA_BLOCK;
+      PyQuaternionArrayGather (&pObj->aval, j, block, m);
+
+      for (k = 0; k < m; k++) {
+         PyObject *item = PyQuaternion_FromCQuaternion (block [k]);
+         if (!item) {
+            Py_DECREF(result);
+            return NULL;
+         }
+         PyList_SET_ITEM(result, j + k, item);
       }
    }
 
-   PyErr_SetString(PyExc_ValueError, "array.remove(q): q not in array.");
-   return NULL;
+   return result;
 }
 
 /* -----------------------------------------------------------------------------
+ * A growable text buffer for format().
  */
-PyDoc_STRVAR(quaternion_array_reserve_doc,
-             "reserve(self, n, /)\n"
-             "reserve (pre-allocate) space for at least n items in the array.");
+typedef struct {
+   char* data;
+   size_t size;
+   size_t allocated;
+} qa_text_buffer;
+
+static bool
+qa_text_append (qa_text_buffer* text, const char* s, const size_t n)
+{
+   if (text->size + n > text->allocated) {
+      size_t allocated = text->allocated > 0 ? text->allocated : 4096;
+      char* data;
+
+      while (text->size + n > allocated) allocated *= 2;
+      data = PyMem_Realloc(text->data, allocated);
+      if (!data) {
+         PyErr_NoMemory();
+         return false;
+      }
+      text->data = data;
+      text->allocated = allocated;
+   }
+   memcpy (text->data + text->size, s, n);
+   text->size += n;
+   return true;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_format_doc,
+             "format(self, format_spec='', sep='\\n', brackets=True, as_bytes=False)\n"
+             "Return the items formatted as a single str, or bytes if as_bytes is true,\n"
+             "with the items separated by sep, e.g. '(1+2i+3j+4k)\\n(0+1i+0j-1k)'.\n"
+             "\n"
+             "format_spec applies to each component, and is of the form [.precision][type],\n"
+             "where type is one of 'e', 'E', 'f', 'F', 'g', 'G' or 'r' (the default, the\n"
+             "shortest repr form), e.g. '.3f'. When brackets is false, the items are not\n"
+             "enclosed in parentheses. The result may be parsed by fromstrings().");
 
 static PyObject *
-quaternion_array_reserve(PyObject *self, PyObject *args)
+quaternion_array_format(PyObject *self, PyObject *args, PyObject *kwds)
 {
+   static char *kwlist[] = {"format_spec", "sep", "brackets", "as_bytes", NULL};
+   static const char suffix [4] = { '\0', 'i', 'j', 'k' };
+
+   PyObject *result = NULL;
    PyQuaternionArrayObject* pObj;
-   PyObject* sizeObj;
-   Py_ssize_t new_reserve;
-   bool status;
+   const char* spec = "";
+   const char* sep = "\n";
+   size_t seplen;
+   int brackets = 1;
+   int asBytes = 0;
+   char code = 'r';
+   int precision = 0;
+   bool hasPrecision = false;
+   qa_text_buffer text = { NULL, 0, 0 };
+   const char* p;
+   Py_ssize_t j;
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
 
-   /* Extract the minimum required size.
-    */
-   if (!PyArg_ParseTuple(args, "O:reserve", &sizeObj))
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sspp:format", kwlist,
+                                    &spec, &sep, &brackets, &asBytes))
       return NULL;
+   seplen = strlen (sep);
 
-   if (!PyLong_Check(sizeObj)) {
-      PyErr_Format(PyExc_TypeError,
-                   "array sizes must be integers (got type %s)",
-                   Py_TYPE(sizeObj)->tp_name);
-      return NULL;
+   /* Decode the [.precision][type] format spec.
+    */
+   p = spec;
+   if (*p == '.') {
+      p++;
+      if (*p < '0' || *p > '9') goto bad_spec;
+      hasPrecision = true;
+      while (*p >= '0' && *p <= '9' && precision < 1000) {
+         precision = 10 * precision + (*p++ - '0');
+      }
+   }
+   if (*p != '\0') {
+      if (!strchr ("eEfFgGr", *p)) goto bad_spec;
+      code = *p++;
+   } else if (hasPrecision) {
+      code = 'g';
+   }
+   if (*p != '\0' || (code == 'r' && hasPrecision)) goto bad_spec;
+   if (!hasPrecision && code != 'r') precision = 6;
+
+   for (j = 0; j < pObj->aval.count; j++) {
+      const Py_quaternion q = qa_get (&pObj->aval, j);
+      const double values [4] = { q.w, q.x, q.y, q.z };
+      bool status = true;
+      int c;
+
+      if (j > 0) status = qa_text_append (&text, sep, seplen);
+      if (status && brackets) status = qa_text_append (&text, "(", 1);
+
+      for (c = 0; status && c < 4; c++) {
+         char* image = PyOS_double_to_string(values [c], code, precision,
+                                             c > 0 ? Py_DTSF_SIGN : 0, NULL);
+         if (!image) {
+            status = false;
+            break;
+         }
+         status = qa_text_append (&text, image, strlen (image)) &&
+                  (c == 0 || qa_text_append (&text, &suffix [c], 1));
+         PyMem_Free(image);
+      }
+
+      if (status && brackets) status = qa_text_append (&text, ")", 1);
+      if (!status) {
+         PyMem_Free(text.data);
+         return NULL;
+      }
    }
 
-   new_reserve = PyLong_AsSsize_t(sizeObj);
-   if (new_reserve < 0) {
-      PyErr_Format(PyExc_ValueError,
-                   "array reserved sizes can't be negative (got %ld)", new_reserve);
-      return NULL;
+   if (asBytes) {
+      result = PyBytes_FromStringAndSize(text.data, text.size);
+   } else {
+      result = PyUnicode_DecodeUTF8(text.data, text.size, NULL);
    }
+   PyMem_Free(text.data);
+   return result;
 
-   pObj->aval.reserved = new_reserve;
+bad_spec:
+   PyErr_Format(PyExc_ValueError,
+                "format() format_spec must be of the form [.precision][type] "
+                "(got '%.200s')", spec);
+   return NULL;
+}
 
-   /* Do we have enough room? Recall allocated >= count.
-    *** What about deallocation if/when reserve is smaller?
-    */
-   if (pObj->aval.allocated < pObj->aval.reserved) {
-      /* Re allocate data
-       */
-      status = qa_reallocate(&pObj->aval, pObj->aval.reserved, true);
-      if (!status)
-         return NULL;
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_iter_components_doc,
+             "iter_components(self, /)\n"
+             "Return an iterator over the items, yielding (w, x, y, z) tuples of floats.");
+
+static PyObject *
+quaternion_array_iter_components(PyObject *self, PyObject *noargs)
+{
+   return PyQuaternionArrayIterNew (self, QA_ITER_COMPONENTS, 1);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_iter_chunks_doc,
+             "iter_chunks(self, n, /)\n"
+             "Return an iterator over the items, yielding successive views (see view())\n"
+             "of n items, the last of which may be shorter.");
+
+static PyObject *
+quaternion_array_iter_chunks(PyObject *self, PyObject *args)
+{
+   Py_ssize_t n;
+
+   if (!PyArg_ParseTuple(args, "n:iter_chunks", &n))
+      return NULL;
+
+   if (n < 1) {
+      PyErr_Format(PyExc_ValueError, "iter_chunks() n must be positive (got %ld)", n);
+      return NULL;
    }
 
+   return PyQuaternionArrayIterNew (self, QA_ITER_CHUNKS, n);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_info_doc,
+             "buffer_info(self, /)\n"
+             "Return a tuple (address, length) giving the current memory address and\n"
+             "the length in quaternions of the buffer used to hold array's contents.\n"
+             "\n"
+             "The length should be multiplied by the itemsize attribute to calculate\n"
+             "the buffer length in bytes.");
+
+static PyObject *
+quaternion_array_info(PyObject* self)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   Py_ssize_t address;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   // No SANITY_CHECK here
+
+   address = pObj->aval.count > 0 ? (Py_ssize_t) pObj->aval.qvalArray : 0;
+   result = Py_BuildValue("(ll)", address, pObj->aval.count);
+
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_clear_doc,
+             "clear(self, /)\n"
+             "Remove all items from the array.");
+
+static PyObject *
+quaternion_array_clear(PyObject* self)
+{
+   PyQuaternionArrayObject* pObj;
+   bool status;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
+
+   pObj->aval.count = 0;
+   status = qa_reallocate(&pObj->aval, 0, false);
+   if (!status)
+      return NULL;
+
    Py_RETURN_NONE;
 }
 
 /* -----------------------------------------------------------------------------
+ * Each chunk counts its own occurrences, these are summed by the caller.
  */
-PyDoc_STRVAR(quaternion_array_reverse_doc,
-             "Reverse the order of the quaternions in the array.");
+typedef struct {
+   const Py_quaternion_array* aval;
+   Py_quaternion value;
+   Py_ssize_t counts [QUAT_PARALLEL_MAX_THREADS];
+} qa_count_context;
+
+static void
+qa_count_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_count_context* c = (qa_count_context*) context;
+   Py_ssize_t count = 0;
+   size_t k;
+
+   for (k = begin; k < end; k++) {
+      if (_Py_quat_eq (c->value, qa_get (c->aval, k))) {
+         count++;
+      }
+   }
+   c->counts [chunk] = count;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_count_doc,
+             "count(self, q, /)\n"
+             "Return number of occurrences of q in the array.");
+
 static PyObject *
-quaternion_array_reverse(PyObject* self)
+quaternion_array_count(PyObject* self, PyObject *args)
 {
+   PyObject *result = NULL;
    PyQuaternionArrayObject* pObj;
-   Py_ssize_t half;
-   Py_ssize_t left;
+   PyObject *valueObj;
+   PyQuaternionObject* pQuatObj;
+   qa_count_context context;
+   Py_ssize_t count;
+   int chunks;
+   int k;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   /* Extract the value
+    */
+   if (!PyArg_ParseTuple(args, "O:count", &valueObj))
+      return NULL;
+
+   /* PyObject_AsQuaternion converts ints, floats, complex and quaternions
+    * into a quaternion or returns NULL.
+    */
+   pQuatObj = (PyQuaternionObject*) PyObject_AsQuaternion(valueObj);
+   if (!pQuatObj) {
+      PyErr_Format(PyExc_TypeError,
+                   "a Quaternion argument is required (got type %s)",
+                   Py_TYPE(valueObj)->tp_name);
+      return NULL;
+   }
+
+   context.aval = &pObj->aval;
+   context.value = pQuatObj->qval;
+   Py_DECREF(pQuatObj);
+
+   pObj->busy++;
+   chunks = _Py_quat_parallel_run (qa_count_task, &context, pObj->aval.count);
+   pObj->busy--;
+
+   count = 0;
+   for (k = 0; k < chunks; k++) {
+      count += context.counts [k];
+   }
+
+   result = PyLong_FromLong(count);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * hashes
+ */
+typedef struct {
+   const Py_quaternion_array* aval;
+   PyObject* inst;
+   Py_hash_t* r;
+} qa_hashes_context;
+
+static void
+qa_hashes_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_hashes_context* c = (qa_hashes_context*) context;
+   size_t k;
+
+   for (k = begin; k < end; k++) {
+      c->r [k] = PyQuaternion_HashCQuaternion (qa_get (c->aval, k), c->inst);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_hashes_doc,
+             "hashes(self, out=None)\n"
+             "Return the hash of each item, i.e. hash(self[j]), as an array.array('q').\n"
+             "\n"
+             "When specified, out must be a writable buffer of len(self) 8 byte signed\n"
+             "integers, e.g. an array.array('q'), into which the hashes are written.\n"
+             "Items with NaN components hash as per the array object.");
+
+static PyObject *
+quaternion_array_hashes(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"out", NULL};
+
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyObject *outObj = NULL;
+   qa_hashes_context context;
+   Py_buffer out;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:hashes", kwlist, &outObj))
+      return NULL;
+
+   context.aval = &pObj->aval;
+   context.inst = self;
+
+   if (outObj && outObj != Py_None) {
+      if (PyObject_GetBuffer(outObj, &out,
+                             PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE) < 0)
+         return NULL;
+
+      if (out.itemsize != sizeof (Py_hash_t) || !out.format ||
+          !strchr ("qln", out.format [out.format [0] == '@' ? 1 : 0]) ||
+          out.len != pObj->aval.count * (Py_ssize_t) sizeof (Py_hash_t)) {
+         PyErr_Format(PyExc_ValueError,
+                      "hashes() out must be a buffer of %ld %d byte signed integers",
+                      pObj->aval.count, (int) sizeof (Py_hash_t));
+         PyBuffer_Release(&out);
+         return NULL;
+      }
+
+      context.r = (Py_hash_t*) out.buf;
+      pObj->busy++;
+      _Py_quat_parallel_run (qa_hashes_task, &context, pObj->aval.count);
+      pObj->busy--;
+
+      PyBuffer_Release(&out);
+      Py_INCREF(outObj);
+      return outObj;
+   }
+
+   context.r = PyMem_Malloc((pObj->aval.count + 1) * sizeof (Py_hash_t));
+   if (!context.r) {
+      return PyErr_NoMemory();
+   }
+
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_hashes_task, &context, pObj->aval.count);
+   pObj->busy--;
+
+   result = PyQuaternionUtil_NewArray ('q', context.r, pObj->aval.count * sizeof (Py_hash_t));
+   PyMem_Free(context.r);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * Each chunk finds its own first occurrence, or -1, the caller takes the first.
+ */
+typedef struct {
+   const Py_quaternion_array* aval;
+   Py_quaternion value;
+   Py_ssize_t index [QUAT_PARALLEL_MAX_THREADS];
+} qa_index_context;
+
+static void
+qa_index_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_index_context* c = (qa_index_context*) context;
+   size_t k;
+
+   c->index [chunk] = -1;
+   for (k = begin; k < end; k++) {
+      if (_Py_quat_eq (c->value, qa_get (c->aval, k))) {
+         c->index [chunk] = k;
+         break;
+      }
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_index_doc,
+             "index(self, q, /)\n"
+             "Return index of first occurrence of q in the array.");
+
+static PyObject *
+quaternion_array_index(PyObject* self, PyObject *args)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyObject *valueObj;
+   PyQuaternionObject* pQuatObj;
+   qa_index_context context;
+   int chunks;
+   int k;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   /* Extract the value
+    */
+   if (!PyArg_ParseTuple(args, "O:index", &valueObj))
+      return NULL;
+
+   /* PyObject_AsQuaternion converts ints, floats, complex and quaternions
+    * into a quaternion or returns NULL.
+    */
+   pQuatObj = (PyQuaternionObject*) PyObject_AsQuaternion(valueObj);
+   if (!pQuatObj) {
+      PyErr_Format(PyExc_TypeError,
+                   "a Quaternion argument is required (got type %s)",
+                   Py_TYPE(valueObj)->tp_name);
+      return NULL;
+   }
+
+   context.aval = &pObj->aval;
+   context.value = pQuatObj->qval;
+   Py_DECREF(pQuatObj);
+
+   pObj->busy++;
+   chunks = _Py_quat_parallel_run (qa_index_task, &context, pObj->aval.count);
+   pObj->busy--;
+
+   for (k = 0; k < chunks; k++) {
+      if (context.index [k] >= 0) {
+         // Found it.
+         //
+         result = PyLong_FromSsize_t(context.index [k]);
+         break;
+      }
+   }
+
+   if (!result) {
+      PyErr_SetString(PyExc_ValueError, "array.index(q): q not in array.");
+
+   }
+
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_pop_doc,
+             "pop(self, i=-1, /)\n"
+             "Return the i-th element and delete it from the array.\n"
+             "i defaults to -1.");
+
+static PyObject *
+quaternion_array_pop(PyObject* self, PyObject *args)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyObject* indexObj = NULL;
+   Py_ssize_t index;
+   Py_quaternion qval;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
+
+   /* Extract the optional index
+    */
+   if (!PyArg_ParseTuple(args, "|O:pop", &indexObj))
+      return NULL;
+
+   if (indexObj) {
+      /* an index argument has been provided.
+       */
+      if (!PyLong_Check(indexObj)) {
+         PyErr_Format(PyExc_TypeError,
+                      "array indices must be integers (got type %s)",
+                      Py_TYPE(indexObj)->tp_name);
+         return NULL;
+      }
+      index = PyLong_AsSsize_t(indexObj);
+   } else {
+      index = -1;  /* default */
+   }
+
+   /* negative means relative to end counting backward.
+    */
+   if (index < 0) index = pObj->aval.count + index;
+
+   if ((index < 0) || (index >= pObj->aval.count)) {
+      PyErr_SetString(PyExc_IndexError,
+                      "pop index out of range");
+      return NULL;
+   }
+
+   /* Create popped quaternion as an object.
+    */
+   qval  = qa_get (&pObj->aval, index);
+   result = PyQuaternion_FromCQuaternion(qval);
+
+   /* Shuffle data down toward zero-th index.
+    */
+   int numberToMove = pObj->aval.count - index - 1;
+   qa_move (&pObj->aval, index, &pObj->aval, index+1, numberToMove);
+   pObj->aval.count--;
+
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_remove_doc,
+             "remove(self, q, /)\n"
+             "Remove the first occurrence of v in the array.");
+
+static PyObject *
+quaternion_array_remove(PyObject* self, PyObject *args)
+{
+   PyQuaternionArrayObject* pObj;
+   PyObject *valueObj;
+   PyQuaternionObject* pQuatObj;
+   Py_quaternion qval;
+   Py_ssize_t index;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
+
+   /* Extract the value
+    */
+   if (!PyArg_ParseTuple(args, "O:remove", &valueObj))
+      return NULL;
+
+   /* PyObject_AsQuaternion converts ints, floats, complex and quaternions
+    * into a quaternion or returns NULL.
+    */
+   pQuatObj = (PyQuaternionObject*) PyObject_AsQuaternion(valueObj);
+   if (!pQuatObj) {
+      PyErr_Format(PyExc_TypeError,
+                   "a Quaternion argument is required (got type %s)",
+                   Py_TYPE(valueObj)->tp_name);
+      return NULL;
+   }
+
+   qval = pQuatObj->qval;
+   Py_DECREF(pQuatObj);
+
+   for (index = 0; index < pObj->aval.count; index++) {
+      if (_Py_quat_eq (qval, qa_get (&pObj->aval, index))) {
+         /* Found it
+          *
+          * Shuffle data down toward zero-th index.
+          */
+         int numberToMove = pObj->aval.count - index - 1;
+         qa_move (&pObj->aval, index, &pObj->aval, index+1, numberToMove);
+         pObj->aval.count--;
+
+         Py_RETURN_NONE;
+      }
+   }
+
+   PyErr_SetString(PyExc_ValueError, "array.remove(q): q not in array.");
+   return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_reserve_doc,
+             "reserve(self, n, /)\n"
+             "reserve (pre-allocate) space for at least n items in the array.");
+
+static PyObject *
+quaternion_array_reserve(PyObject *self, PyObject *args)
+{
+   PyQuaternionArrayObject* pObj;
+   PyObject* sizeObj;
+   Py_ssize_t new_reserve;
+   bool status;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   RESIZE_CHECK(pObj, NULL);
+
+   /* Extract the minimum required size.
+    */
+   if (!PyArg_ParseTuple(args, "O:reserve", &sizeObj))
+      return NULL;
+
+   if (!PyLong_Check(sizeObj)) {
+      PyErr_Format(PyExc_TypeError,
+                   "array sizes must be integers (got type %s)",
+                   Py_TYPE(sizeObj)->tp_name);
+      return NULL;
+   }
+
+   new_reserve = PyLong_AsSsize_t(sizeObj);
+   if (new_reserve < 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "array reserved sizes can't be negative (got %ld)", new_reserve);
+      return NULL;
+   }
+
+   pObj->aval.reserved = new_reserve;
+
+   /* Do we have enough room? Recall allocated >= count.
+    *** What about deallocation if/when reserve is smaller?
+    */
+   if (pObj->aval.allocated < pObj->aval.reserved) {
+      /* Re allocate data
+       */
+      status = qa_reallocate(&pObj->aval, pObj->aval.reserved, true);
+      if (!status)
+         return NULL;
+   }
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_shrink_to_fit_doc,
+             "shrink_to_fit(self, /)\n"
+             "Release any spare allocated space, i.e. reduce the allocation to the\n"
+             "larger of the number of items and the reserved size.");
+
+static PyObject *
+quaternion_array_shrink_to_fit(PyObject *self)
+{
+   PyQuaternionArrayObject* pObj;
+   Py_ssize_t required;
+   bool status;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   /* A memory mapped array has no spare space.
+    */
+   if (pObj->mapping) {
+      Py_RETURN_NONE;
+   }
+   RESIZE_CHECK(pObj, NULL);
+
+   required = pObj->aval.count > pObj->aval.reserved ? pObj->aval.count : pObj->aval.reserved;
+   if (pObj->aval.allocated != required) {
+      status = qa_reallocate(&pObj->aval, required, true);
+      if (!status)
+         return NULL;
+   }
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_set_growth_doc,
+             "set_growth(self, growth, /)\n"
+             "Set the factor by which the allocation grows when more space is needed,\n"
+             "from 1.0 (minimal spare space) to 4.0, or None for the default (1.5).\n"
+             "The current factor is available as the growth attribute.");
+
+static PyObject *
+quaternion_array_set_growth(PyObject *self, PyObject *arg)
+{
+   PyQuaternionArrayObject* pObj;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   if (!qa_decode_growth (arg, &pObj->aval.growth))
+      return NULL;
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ * Swaps items [begin, end) of the first half with the mirror items of the second half.
+ */
+static void
+qa_reverse_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   Py_quaternion_array* aval = (Py_quaternion_array*) context;
+   size_t left;
+
+   for (left = begin; left < end; left++) {
+      size_t right = aval->count - left - 1;
+      Py_quaternion tempLeft;
+
+      tempLeft = qa_get (aval, left);
+      qa_put (aval, left, qa_get (aval, right));
+      qa_put (aval, right, tempLeft);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_reverse_doc,
+             "Reverse the order of the quaternions in the array.");
+static PyObject *
+quaternion_array_reverse(PyObject* self)
+{
+   PyQuaternionArrayObject* pObj;
+   Py_ssize_t half;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   WRITE_CHECK(pObj, NULL);
+
+   half = pObj->aval.count / 2;  /* round-down when is good */
+
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_reverse_task, &pObj->aval, half);
+   pObj->busy--;
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ * Byteswaps n doubles.
+ */
+void
+PyQuaternionArrayByteswap (double *data, const size_t n)
+{
+   /* We "know" each double has 8 bytes.
+    */
+   typedef char bytedouble [8];
+
+   bytedouble *byteData;
+   size_t i;
+
+   byteData = (bytedouble *)data;
+   for (i = 0; i < n; i++) {
+      char *d = byteData[i];
+      char t;
+      t = d[0]; d[0] = d[7]; d[7] = t;
+      t = d[1]; d[1] = d[6]; d[6] = t;
+      t = d[2]; d[2] = d[5]; d[5] = t;
+      t = d[3]; d[3] = d[4]; d[4] = t;
+   }
+}
+
+static void
+qa_byteswap_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   Py_quaternion_array* aval = (Py_quaternion_array*) context;
+   int c;
+
+   if (aval->layout == QA_LAYOUT_AOS) {
+      /* We "know" each quaternion has 4 doubles.
+       */
+      PyQuaternionArrayByteswap ((double*) &aval->qvalArray [begin], 4 * (end - begin));
+   } else {
+      for (c = 0; c < 4; c++) {
+         PyQuaternionArrayByteswap (QA_COLUMN(aval, c) + begin, end - begin);
+      }
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_byteswap_doc,
+             "Byteswap all items of the array.");
+static PyObject *
+quaternion_array_byteswap(PyObject* self)
+{
+   PyQuaternionArrayObject* pObj;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   WRITE_CHECK(pObj, NULL);
+
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_byteswap_task, &pObj->aval, pObj->aval.count);
+   pObj->busy--;
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_tobytes_doc,
+             "Convert the array to an array of machine values "
+             "and return the bytes representation.");
+static PyObject *
+quaternion_array_tobytes(PyObject* self)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   result = qa_to_bytes (&pObj->aval);
+
+   return result;
+}
+
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_tofile_doc,
+             "tofile(self, f /)\n"
+             "Write all quaternions (as machine values) to the file object f.\n");
+
+/** Totally cribbed from array_array_tofile **/
+static PyObject *
+quaternion_array_tofile(PyObject* self, PyObject *args)
+{
+   _Py_IDENTIFIER(write);
+
+   PyQuaternionArrayObject* pObj;
+   PyObject *fileObj = NULL;
+   Py_ssize_t nbytes;
+   int blockSize;
+   Py_ssize_t nblocks;
+   Py_ssize_t i;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   /* Extract the file object from the one element tuple.
+    */
+   if (!PyArg_ParseTuple(args, "O:tofile", &fileObj))
+      return NULL;
+
+   nbytes = pObj->aval.count * sizeof (Py_quaternion);
+
+   /* Write 64K blocks at a time.
+    */
+   blockSize = 64*1024;
+
+   nblocks = (nbytes + blockSize - 1) / blockSize;  /* round up */
+   for (i = 0; i < nblocks; i++) {
+       Py_ssize_t size = blockSize;
+       PyObject *bytes;
+       PyObject *res;
+
+       /* Truncate last block it needs be.
+        */
+       if (i*blockSize + size > nbytes)
+           size = nbytes - i*blockSize;
+
+       /* blockSize is a multiple of the quaternion size.
+        */
+       bytes = PyBytes_FromStringAndSize(NULL, size);
+       if (bytes == NULL)
+           return NULL;
+       PyQuaternionArrayGather (&pObj->aval, i*blockSize / sizeof (Py_quaternion),
+                                (Py_quaternion*) PyBytes_AS_STRING(bytes),
+                                size / sizeof (Py_quaternion));
+       res = _PyObject_CallMethodId(fileObj, &PyId_write, "O", bytes);
+       Py_DECREF(bytes);
+
+       if (res == NULL)
+           return NULL;
+       Py_DECREF(res);  /* drop write result */
+   }
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ * Element-wise arithmetic
+ * -----------------------------------------------------------------------------
+ */
+typedef void (*qa_bulk_function) (const Py_quaternion* a, const size_t sa,
+                                  const Py_quaternion* b, const size_t sb,
+                                  Py_quaternion* r, const size_t n);
+
+typedef void (*qa_real_function) (const Py_quaternion* a, const double b,
+                                  Py_quaternion* r, const size_t n);
+
+
+/* Context for qa_bulk_task, which applies a bulk function to a chunk of items.
+ * An operand or result held in the SoA layout is specified by aSoa, bSoa or rSoa,
+ * otherwise these are NULL, and a, b and r point to the c quaternions.
+ * When realFunc is set, it is applied to a and real instead, and b is unused.
+ */
+typedef struct {
+   qa_bulk_function func;
+   qa_real_function realFunc;
+   double real;
+   const Py_quaternion* a;
+   size_t sa;
+   const Py_quaternion_array* aSoa;
+   const Py_quaternion* b;
+   size_t sb;
+   const Py_quaternion_array* bSoa;
+   Py_quaternion* r;
+   Py_quaternion_array* rSoa;
+} qa_bulk_context;
+
+static void
+qa_bulk_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_bulk_context* c = (qa_bulk_context*) context;
+   Py_quaternion ta [QA_BLOCK];
+   Py_quaternion tb [QA_BLOCK];
+   Py_quaternion tr [QA_BLOCK];
+   size_t j;
+   size_t m;
+
+   if (c->realFunc && !c->aSoa && !c->rSoa) {
+      c->realFunc (c->a + begin, c->real, c->r + begin, end - begin);
+      return;
+   }
+
+   if (!c->realFunc && !c->aSoa && !c->bSoa && !c->rSoa) {
+      c->func (c->a + begin * c->sa, c->sa, c->b + begin * c->sb, c->sb,
+               c->r + begin, end - begin);
+      return;
+   }
+
+   for (j = begin; j < end; j += m) {
+      const Py_quaternion* pa;
+      const Py_quaternion* pb;
+      Py_quaternion* pr;
+
+      m = end - j < QA_BLOCK ? end - j : QA_BLOCK;
+
+      if (c->aSoa) {
+         PyQuaternionArrayGather (c->aSoa, j, ta, m);
+         pa = ta;
+      } else {
+         pa = c->a + j * c->sa;
+      }
+
+      pr = c->rSoa ? tr : c->r + j;
+
+      if (c->realFunc) {
+         c->realFunc (pa, c->real, pr, m);
+      } else {
+         if (c->bSoa) {
+            PyQuaternionArrayGather (c->bSoa, j, tb, m);
+            pb = tb;
+         } else {
+            pb = c->b + j * c->sb;
+         }
+         c->func (pa, c->sa, pb, c->sb, pr, m);
+      }
+
+      if (c->rSoa) {
+         PyQuaternionArrayScatter (c->rSoa, j, tr, m);
+      }
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * The workhorse behind add, sub, mul, div and friends.
+ * The other operand may be a QuaternionArray of the same length, or anything
+ * that can be converted to a Quaternion, i.e. a Quaternion, complex, float or int.
+ * A float or int other is applied using realFunc, if specified, as per the mixed
+ * mode Quaternion operators; realFunc is always applied as realFunc (self, other).
+ * When reflected, other is the left hand operand.
+ * When inplace, the result is written back into self and None is returned,
+ * otherwise a new QuaternionArray object is returned.
+ */
+static PyObject *
+qa_arithmetic(PyObject *self, PyObject *args, const char* fname,
+              const qa_bulk_function func, const qa_real_function realFunc,
+              const bool reflected, const bool inplace)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyQuaternionArrayObject* pOther = NULL;
+   PyObject *other = NULL;
+   Py_quaternion qval;
+   double real = 0.0;
+   bool isReal = false;
+   const Py_quaternion* otherArray;
+   const Py_quaternion_array* otherSoa = NULL;
+   const Py_quaternion* selfArray;
+   const Py_quaternion_array* selfSoa = NULL;
+   size_t otherStride;
+   Py_quaternion_array aval;
+   qa_bulk_context context;
+   bool status;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   if (inplace) WRITE_CHECK(pObj, NULL);
+
+   if (!PyArg_UnpackTuple(args, fname, 1, 1, &other))
+      return NULL;
+
+   if (PyQuaternionArray_Check(other)) {
+      pOther = (PyQuaternionArrayObject *)other;
+      SANITY_CHECK(pOther, NULL);
+
+      if (pOther->aval.count != pObj->aval.count) {
+         PyErr_Format(PyExc_ValueError,
+                      "%s() array lengths differ (%ld and %ld)", fname,
+                      pObj->aval.count, pOther->aval.count);
+         return NULL;
+      }
+      otherArray = pOther->aval.qvalArray;
+      otherStride = 1;
+      if (pOther->aval.layout != QA_LAYOUT_AOS) {
+         otherArray = NULL;
+         otherSoa = &pOther->aval;
+      }
+
+   } else if (realFunc && (PyFloat_Check(other) || PyLong_Check(other))) {
+      /* Apply the same real value to each array item.
+       */
+      real = PyFloat_Check(other) ? PyFloat_AS_DOUBLE(other) : PyLong_AsDouble(other);
+      if (real == -1.0 && PyErr_Occurred())
+         return NULL;
+      isReal = true;
+      otherArray = NULL;
+      otherStride = 0;
+
+   } else if (PyObject_AsCQuaternion(other, &qval)) {
+      /* Apply the same quaternion value to each array item.
+       */
+      otherArray = &qval;
+      otherStride = 0;
+
+   } else {
+      PyErr_Format(PyExc_TypeError,
+                   "%s() argument must be a QuaternionArray, Quaternion or number (got type %s)",
+                   fname, Py_TYPE(other)->tp_name);
+      return NULL;
+   }
+
+   selfArray = pObj->aval.qvalArray;
+   if (pObj->aval.layout != QA_LAYOUT_AOS) {
+      selfArray = NULL;
+      selfSoa = &pObj->aval;
+   }
+
+   if (inplace) {
+      aval = pObj->aval;
+   } else {
+      aval.reserved = 0;
+      aval.growth = 0.0;
+      aval.allocated = 0;
+      aval.count = pObj->aval.count;
+      aval.qvalArray = NULL;
+      aval.layout = pObj->aval.layout;
+      status = qa_reallocate(&aval, aval.count, true);
+      if (!status)
+         return NULL;
+   }
+
+   context.func = func;
+   context.realFunc = isReal ? realFunc : NULL;
+   context.real = real;
+   if (reflected && !isReal) {
+      context.a = otherArray;
+      context.sa = otherStride;
+      context.aSoa = otherSoa;
+      context.b = selfArray;
+      context.sb = 1;
+      context.bSoa = selfSoa;
+   } else {
+      context.a = selfArray;
+      context.sa = 1;
+      context.aSoa = selfSoa;
+      context.b = otherArray;
+      context.sb = otherStride;
+      context.bSoa = otherSoa;
+   }
+   context.r = aval.layout == QA_LAYOUT_AOS ? aval.qvalArray : NULL;
+   context.rSoa = aval.layout == QA_LAYOUT_AOS ? NULL : &aval;
+
+   /* Large arrays are processed without the GIL, so neither array may be
+    * resized by another thread in the meantime.
+    */
+   pObj->busy++;
+   if (pOther) pOther->busy++;
+   _Py_quat_parallel_run (qa_bulk_task, &context, aval.count);
+   if (pOther) pOther->busy--;
+   pObj->busy--;
+
+   if (errno == EDOM) {
+      /* Only division sets EDOM.
+       */
+      if (!inplace) {
+         _Py_quat_buffer_free(aval.qvalArray);
+      }
+      PyErr_SetString(PyExc_ZeroDivisionError, "quaternion array division by zero");
+      return NULL;
+   }
+
+   if (inplace) {
+      Py_RETURN_NONE;
+   }
+
+   result = quaternion_array_type_from_c_quaternion_array(aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_add_doc,
+             "add(self, other, /)\n"
+             "Return a new array with items self[j] + other[j].\n"
+             "\n"
+             "other may be a QuaternionArray of the same length, in which case the operation\n"
+             "is applied item by item, or a Quaternion or a number, in which case the same\n"
+             "value is applied to each item.");
+
+static PyObject *
+quaternion_array_add(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "add", _Py_quat_simd_sum,
+                        _Py_quat_array_sum_real, false, false);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_sub_doc,
+             "sub(self, other, /)\n"
+             "Return a new array with items self[j] - other[j].\n"
+             "See add() for allowed other types.");
+
+static PyObject *
+quaternion_array_sub(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "sub", _Py_quat_simd_diff,
+                        _Py_quat_array_diff_real, false, false);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_rsub_doc,
+             "rsub(self, other, /)\n"
+             "Return a new array with items other[j] - self[j].\n"
+             "See add() for allowed other types.");
+
+static PyObject *
+quaternion_array_rsub(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "rsub", _Py_quat_simd_diff,
+                        _Py_quat_array_real_diff, true, false);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_mul_doc,
+             "mul(self, other, /)\n"
+             "Return a new array with items self[j] * other[j].\n"
+             "See add() for allowed other types.\n"
+             "Note: quaternion multiplication does not commute, see rmul().");
+
+static PyObject *
+quaternion_array_mul(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "mul", _Py_quat_simd_prod,
+                        _Py_quat_array_prod_real, false, false);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_rmul_doc,
+             "rmul(self, other, /)\n"
+             "Return a new array with items other[j] * self[j].\n"
+             "See add() for allowed other types.");
+
+static PyObject *
+quaternion_array_rmul(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "rmul", _Py_quat_simd_prod,
+                        _Py_quat_array_prod_real, true, false);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_div_doc,
+             "div(self, other, /)\n"
+             "Return a new array with items self[j] / other[j].\n"
+             "See add() for allowed other types.");
+
+static PyObject *
+quaternion_array_div(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "div", _Py_quat_array_quot,
+                        _Py_quat_array_quot_real, false, false);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_rdiv_doc,
+             "rdiv(self, other, /)\n"
+             "Return a new array with items other[j] / self[j].\n"
+             "See add() for allowed other types.");
+
+static PyObject *
+quaternion_array_rdiv(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "rdiv", _Py_quat_array_quot, NULL, true, false);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_iadd_doc,
+             "iadd(self, other, /)\n"
+             "In place add: self[j] = self[j] + other[j].\n"
+             "See add() for allowed other types.");
+
+static PyObject *
+quaternion_array_iadd(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "iadd", _Py_quat_simd_sum,
+                        _Py_quat_array_sum_real, false, true);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_isub_doc,
+             "isub(self, other, /)\n"
+             "In place subtract: self[j] = self[j] - other[j].\n"
+             "See add() for allowed other types.");
+
+static PyObject *
+quaternion_array_isub(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "isub", _Py_quat_simd_diff,
+                        _Py_quat_array_diff_real, false, true);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_imul_doc,
+             "imul(self, other, /)\n"
+             "In place multiply: self[j] = self[j] * other[j].\n"
+             "See add() for allowed other types.");
+
+static PyObject *
+quaternion_array_imul(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "imul", _Py_quat_simd_prod,
+                        _Py_quat_array_prod_real, false, true);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_idiv_doc,
+             "idiv(self, other, /)\n"
+             "In place divide: self[j] = self[j] / other[j].\n"
+             "See add() for allowed other types.\n"
+             "Note: on ZeroDivisionError the array has still been updated, with each item\n"
+             "divided by zero set to zero.");
+
+static PyObject *
+quaternion_array_idiv(PyObject *self, PyObject *args)
+{
+   return qa_arithmetic(self, args, "idiv", _Py_quat_array_quot,
+                        _Py_quat_array_quot_real, false, true);
+}
+
+/* -----------------------------------------------------------------------------
+ * Normalise items of pObj into r, which may be pObj's own array. When cheap is
+ * true, the items are just renormalised, as per _Py_quat_renormalise.
+ */
+typedef struct {
+   const Py_quaternion_array* a;
+   Py_quaternion_array* r;    /* same layout as a */
+   bool cheap;
+} qa_normalise_context;
+
+static void
+qa_normalise_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_normalise_context* c = (qa_normalise_context*) context;
+   void (*kernel) (const Py_quaternion*, Py_quaternion*, const size_t);
+   Py_quaternion t [QA_BLOCK];
+   size_t j;
+   size_t m;
+
+   kernel = c->cheap ? _Py_quat_array_renormalise : _Py_quat_simd_normalise;
+
+   if (c->a->layout == QA_LAYOUT_AOS) {
+      kernel (c->a->qvalArray + begin, c->r->qvalArray + begin, end - begin);
+      return;
+   }
+
+   for (j = begin; j < end; j += m) {
+      m = end - j < QA_BLOCK ? end - j : QA_BLOCK;
+      PyQuaternionArrayGather (c->a, j, t, m);
+      kernel (t, t, m);
+      PyQuaternionArrayScatter (c->r, j, t, m);
+   }
+}
+
+static void
+qa_normalise (PyQuaternionArrayObject* pObj, Py_quaternion_array* r, const bool cheap)
+{
+   qa_normalise_context context;
+
+   context.a = &pObj->aval;
+   context.r = r;
+   context.cheap = cheap;
+
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_normalise_task, &context, pObj->aval.count);
+   pObj->busy--;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_normalise_doc,
+             "normalise(self, /)\n"
+             "Return a new array with items self[j].normalise().");
+
+static PyObject *
+quaternion_array_normalise(PyObject *self)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   Py_quaternion_array aval;
+   bool status;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   aval.reserved = 0;
+   aval.growth = 0.0;
+   aval.allocated = 0;
+   aval.count = pObj->aval.count;
+   aval.qvalArray = NULL;
+   aval.layout = pObj->aval.layout;
+   status = qa_reallocate(&aval, aval.count, true);
+   if (!status)
+      return NULL;
+
+   qa_normalise (pObj, &aval, false);
+
+   result = quaternion_array_type_from_c_quaternion_array(aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_inormalise_doc,
+             "inormalise(self, /)\n"
+             "In place normalise: self[j] = self[j].normalise().");
+
+static PyObject *
+quaternion_array_inormalise(PyObject *self)
+{
+   PyQuaternionArrayObject* pObj;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   WRITE_CHECK(pObj, NULL);
+
+   qa_normalise (pObj, &pObj->aval, false);
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_irenormalise_doc,
+             "irenormalise(self, /)\n"
+             "In place cheap renormalise of unit quaternions, self[j] is scaled by\n"
+             "(3 - self[j].quadrance()) / 2. This is one Newton step towards unit\n"
+             "magnitude, with no square root or division, but is only suitable for items\n"
+             "close to unit magnitude, e.g. those that have drifted after composing many\n"
+             "rotations. A magnitude error of e becomes roughly 1.5*e**2.");
+
+static PyObject *
+quaternion_array_irenormalise(PyObject *self)
+{
+   PyQuaternionArrayObject* pObj;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+   WRITE_CHECK(pObj, NULL);
+
+   qa_normalise (pObj, &pObj->aval, true);
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ * Reductions - sum, product and the outer product sum used by average_rotation.
+ * The items are split into fixed size blocks, which depend only on the number
+ * of items, so that the results do not depend on the number of threads. Each
+ * block forms its own partial result, and these are combined, in block order,
+ * by the caller. Sums use Neumaier (improved Kahan) compensated summation, and
+ * the compensation of each block is carried into the final total.
+ */
+#define QA_REDUCE_BLOCKS      256   /* the maximum number of blocks */
+#define QA_REDUCE_MIN_BLOCK   4096  /* the minimum number of items per block */
+
+typedef enum {
+   QA_REDUCE_SUM,
+   QA_REDUCE_PRODUCT,
+   QA_REDUCE_OUTER
+} qa_reduce_kind;
+
+typedef struct {
+   qa_reduce_kind kind;
+   const Py_quaternion_array* aval;
+   const double* weights;     /* average_rotation only, may be NULL */
+   size_t size;               /* items per block */
+   Py_quaternion sums [QA_REDUCE_BLOCKS];
+   Py_quaternion comps [QA_REDUCE_BLOCKS];
+   double outer [QA_REDUCE_BLOCKS][4][4];
+} qa_reduce_context;
+
+static void
+qa_compensated_add (double *sum, double *comp, const double x)
+{
+   const double t = *sum + x;
+
+   if (fabs (*sum) >= fabs (x)) {
+      *comp += (*sum - t) + x;
+   } else {
+      *comp += (x - t) + *sum;
+   }
+   *sum = t;
+}
+
+/* Add q into sum/comp, component by component.
+ */
+static void
+qa_compensated_add_quat (Py_quaternion *sum, Py_quaternion *comp, const Py_quaternion q)
+{
+   qa_compensated_add (&sum->w, &comp->w, q.w);
+   qa_compensated_add (&sum->x, &comp->x, q.x);
+   qa_compensated_add (&sum->y, &comp->y, q.y);
+   qa_compensated_add (&sum->z, &comp->z, q.z);
+}
+
+/* A non-finite sum would make the compensation NaN, so just use the sum as is.
+ */
+static double
+qa_compensated_total (const double sum, const double comp)
+{
+   return Py_IS_FINITE (sum) ? sum + comp : sum;
+}
+
+/* Forms the partial result of block b, i.e. of items [begin, end).
+ */
+static void
+qa_reduce_block (qa_reduce_context* c, const size_t b, const size_t begin, const size_t end)
+{
+   static const Py_quaternion zero = { 0.0, 0.0, 0.0, 0.0 };
+   static const Py_quaternion one = { 1.0, 0.0, 0.0, 0.0 };
+
+   Py_quaternion t [QA_BLOCK];
+   Py_quaternion sum = zero;
+   Py_quaternion comp = zero;
+   Py_quaternion product = one;
+   double (*outer)[4] = c->outer [b];
+   size_t j;
+   size_t k;
+   size_t m;
+   int p, q;
+
+   for (p = 0; p < 4; p++) {
+      for (q = 0; q < 4; q++) {
+         outer [p][q] = 0.0;
+      }
+   }
+
+   for (j = begin; j < end; j += m) {
+      const Py_quaternion* pa;
+
+      m = end - j < QA_BLOCK ? end - j : QA_BLOCK;
+
+      if (c->aval->layout == QA_LAYOUT_AOS) {
+         pa = c->aval->qvalArray + j;
+      } else {
+         PyQuaternionArrayGather (c->aval, j, t, m);
+         pa = t;
+      }
+
+      switch (c->kind) {
+         case QA_REDUCE_SUM:
+            for (k = 0; k < m; k++) {
+               qa_compensated_add_quat (&sum, &comp, pa [k]);
+            }
+            break;
+
+         case QA_REDUCE_PRODUCT:
+            /* An ordered left fold - multiplication is associative but does
+             * not commute, so the block products are combined in order.
+             */
+            for (k = 0; k < m; k++) {
+               product = _Py_quat_prod (product, pa [k]);
+            }
+            break;
+
+         case QA_REDUCE_OUTER:
+            /* Sum of w.q.qT / |q|**2, i.e. of the normalised items.
+             * Zero and non-finite items are ignored.
+             */
+            for (k = 0; k < m; k++) {
+               const double v [4] = { pa [k].w, pa [k].x, pa [k].y, pa [k].z };
+               const double qd = _Py_quat_quadrance (pa [k]);
+               double scale;
+
+               if (!(qd > 0.0) || !Py_IS_FINITE (qd)) continue;
+               scale = (c->weights ? c->weights [j + k] : 1.0) / qd;
+               for (p = 0; p < 4; p++) {
+                  for (q = p; q < 4; q++) {
+                     outer [p][q] += scale * v [p] * v [q];
+                  }
+               }
+            }
+            break;
+      }
+   }
+
+   c->sums [b] = c->kind == QA_REDUCE_PRODUCT ? product : sum;
+   c->comps [b] = comp;
+}
+
+/* Processes the blocks that start within [begin, end).
+ */
+static void
+qa_reduce_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_reduce_context* c = (qa_reduce_context*) context;
+   const size_t n = (size_t) c->aval->count;
+   size_t b;
+
+   for (b = (begin + c->size - 1) / c->size; b * c->size < end; b++) {
+      const size_t first = b * c->size;
+      qa_reduce_block (c, b, first, n - first > c->size ? first + c->size : n);
+   }
+   errno = 0;
+}
+
+/* Runs the reduction and combines the block results into the first block's slot.
+ * For a product, sums [0] holds the result, for a sum, sums [0] holds the
+ * compensated total, and for the outer product, outer [0] holds the full matrix.
+ */
+static void
+qa_reduce (PyQuaternionArrayObject* pObj, qa_reduce_context* context)
+{
+   static const Py_quaternion zero = { 0.0, 0.0, 0.0, 0.0 };
+   static const Py_quaternion one = { 1.0, 0.0, 0.0, 0.0 };
+
+   const size_t n = (size_t) pObj->aval.count;
+   Py_quaternion sum;
+   Py_quaternion comp;
+   Py_quaternion product;
+   double outer [4][4];
+   size_t number;
+   size_t k;
+   int p, q;
+
+   context->aval = &pObj->aval;
+   context->size = (n + QA_REDUCE_BLOCKS - 1) / QA_REDUCE_BLOCKS;
+   if (context->size < QA_REDUCE_MIN_BLOCK) context->size = QA_REDUCE_MIN_BLOCK;
+   number = (n + context->size - 1) / context->size;
+
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_reduce_task, context, n);
+   pObj->busy--;
+
+   switch (context->kind) {
+      case QA_REDUCE_SUM:
+         /* Fold each block's (sum, compensation) pair into the total.
+          */
+         sum = zero;
+         comp = zero;
+         for (k = 0; k < number; k++) {
+            qa_compensated_add_quat (&sum, &comp, context->sums [k]);
+            comp.w += context->comps [k].w;
+            comp.x += context->comps [k].x;
+            comp.y += context->comps [k].y;
+            comp.z += context->comps [k].z;
+         }
+         context->sums [0].w = qa_compensated_total (sum.w, comp.w);
+         context->sums [0].x = qa_compensated_total (sum.x, comp.x);
+         context->sums [0].y = qa_compensated_total (sum.y, comp.y);
+         context->sums [0].z = qa_compensated_total (sum.z, comp.z);
+         break;
+
+      case QA_REDUCE_PRODUCT:
+         product = number > 0 ? context->sums [0] : one;
+         for (k = 1; k < number; k++) {
+            product = _Py_quat_prod (product, context->sums [k]);
+         }
+         context->sums [0] = product;
+         break;
+
+      case QA_REDUCE_OUTER:
+         for (p = 0; p < 4; p++) {
+            for (q = 0; q < 4; q++) {
+               outer [p][q] = 0.0;
+            }
+         }
+         for (k = 0; k < number; k++) {
+            for (p = 0; p < 4; p++) {
+               for (q = p; q < 4; q++) {
+                  outer [p][q] += context->outer [k][p][q];
+               }
+            }
+         }
+         for (p = 0; p < 4; p++) {
+            for (q = 0; q < 4; q++) {
+               context->outer [0][p][q] = q >= p ? outer [p][q] : outer [q][p];
+            }
+         }
+         break;
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_sum_doc,
+             "sum(self, /)\n"
+             "Return the sum of the items as a Quaternion, Quaternion(0) if the array\n"
+             "is empty. The sum is calculated using compensated summation, and does not\n"
+             "depend on the number of threads.");
+
+static PyObject *
+quaternion_array_sum(PyObject *self)
+{
+   PyQuaternionArrayObject* pObj;
+   qa_reduce_context context;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   context.kind = QA_REDUCE_SUM;
+   context.weights = NULL;
+   qa_reduce (pObj, &context);
+
+   return PyQuaternion_FromCQuaternion(context.sums [0]);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_product_doc,
+             "product(self, /)\n"
+             "Return the ordered product of the items, i.e. self[0] * self[1] * ...\n"
+             "as a Quaternion, Quaternion(1) if the array is empty.");
+
+static PyObject *
+quaternion_array_product(PyObject *self)
+{
+   PyQuaternionArrayObject* pObj;
+   qa_reduce_context context;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   context.kind = QA_REDUCE_PRODUCT;
+   context.weights = NULL;
+   qa_reduce (pObj, &context);
+
+   return PyQuaternion_FromCQuaternion(context.sums [0]);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_mean_doc,
+             "mean(self, /)\n"
+             "Return the arithmetic mean of the items as a Quaternion.\n"
+             "See also average_rotation().");
+
+static PyObject *
+quaternion_array_mean(PyObject *self)
+{
+   PyQuaternionArrayObject* pObj;
+   qa_reduce_context context;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   if (pObj->aval.count == 0) {
+      PyErr_SetString(PyExc_ValueError, "mean() of an empty array");
+      return NULL;
+   }
+
+   context.kind = QA_REDUCE_SUM;
+   context.weights = NULL;
+   qa_reduce (pObj, &context);
+
+   return PyQuaternion_FromCQuaternion(_Py_quat_quot_real (context.sums [0],
+                                                           (double) pObj->aval.count));
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_average_rotation_doc,
+             "average_rotation(self, weights=None)\n"
+             "Return the average rotation of the items, as a unit Quaternion with a\n"
+             "non-negative real part.\n"
+             "\n"
+             "This is the eigenvector, for the largest eigenvalue, of the weighted sum of\n"
+             "the outer products of the normalised items (Markley et al.), and so is not\n"
+             "affected by the sign of any item, i.e. q and -q are the same rotation.\n"
+             "\n"
+             "weights  - an optional buffer of len(self) doubles, e.g. an array.array('d').\n"
+             "Zero and non-finite items are ignored.");
+
+static PyObject *
+quaternion_array_average_rotation(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"weights", NULL};
+
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyObject *weightsObj = NULL;
+   qa_reduce_context context;
+   Py_buffer weights;
+   bool haveWeights = false;
+   double trace;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:average_rotation", kwlist, &weightsObj))
+      return NULL;
+
+   context.kind = QA_REDUCE_OUTER;
+   context.weights = NULL;
+
+   if (weightsObj && weightsObj != Py_None) {
+      if (!PyQuaternionUtil_GetDoubleBuffer(weightsObj, &weights, false, 1,
+                                            "average_rotation", "weights"))
+         return NULL;
+      haveWeights = true;
+
+      if (weights.len != pObj->aval.count * (Py_ssize_t) sizeof (double)) {
+         PyErr_Format(PyExc_ValueError,
+                      "average_rotation() weights length differs (%ld and %ld)",
+                      pObj->aval.count, weights.len / (Py_ssize_t) sizeof (double));
+         goto done;
+      }
+      context.weights = (const double*) weights.buf;
+   }
+
+   qa_reduce (pObj, &context);
+
+   /* The trace is the (weighted) number of items used.
+    */
+   trace = context.outer [0][0][0] + context.outer [0][1][1] +
+           context.outer [0][2][2] + context.outer [0][3][3];
+   if (!(trace > 0.0) || !Py_IS_FINITE (trace)) {
+      PyErr_SetString(PyExc_ValueError,
+                      "average_rotation() requires at least one non-zero item");
+      goto done;
+   }
+
+   result = PyQuaternion_FromCQuaternion(_Py_quat_principal_eigenvector (context.outer [0]));
+
+done:
+   if (haveWeights) PyBuffer_Release(&weights);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * argmin and argmax - each chunk finds the index of its first item with the
+ * smallest/largest norm, ignoring NaN items, or -1 if there are none.
+ */
+typedef struct {
+   const Py_quaternion_array* aval;
+   bool maximum;
+   Py_ssize_t index [QUAT_PARALLEL_MAX_THREADS];
+   double value [QUAT_PARALLEL_MAX_THREADS];
+} qa_extreme_context;
+
+static void
+qa_extreme_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_extreme_context* c = (qa_extreme_context*) context;
+   Py_ssize_t index = -1;
+   double value = 0.0;
+   size_t k;
+
+   for (k = begin; k < end; k++) {
+      const double v = _Py_quat_abs (qa_get (c->aval, k));
+
+      if (Py_IS_NAN (v)) continue;
+      if (index < 0 || (c->maximum ? v > value : v < value)) {
+         index = k;
+         value = v;
+      }
+   }
+
+   c->index [chunk] = index;
+   c->value [chunk] = value;
+   errno = 0;
+}
+
+static PyObject *
+qa_extreme (PyObject *self, const bool maximum, const char* fname)
+{
+   PyQuaternionArrayObject* pObj;
+   qa_extreme_context context;
+   Py_ssize_t index = -1;
+   double value = 0.0;
+   int chunks;
+   int k;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   context.aval = &pObj->aval;
+   context.maximum = maximum;
+
+   pObj->busy++;
+   chunks = _Py_quat_parallel_run (qa_extreme_task, &context, pObj->aval.count);
+   pObj->busy--;
+
+   /* Chunks are in index order, so on ties the earlier chunk wins.
+    */
+   for (k = 0; k < chunks; k++) {
+      const double v = context.value [k];
+      if (context.index [k] < 0) continue;
+      if (index < 0 || (maximum ? v > value : v < value)) {
+         index = context.index [k];
+         value = v;
+      }
+   }
+
+   if (index < 0) {
+      PyErr_Format(PyExc_ValueError, "%s() of an empty or all NaN array", fname);
+      return NULL;
+   }
+
+   return PyLong_FromSsize_t(index);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_argmin_doc,
+             "argmin(self, /)\n"
+             "Return the index of the first item with the smallest norm, i.e. abs(self[j]).\n"
+             "Items with NaN components are ignored.");
+
+static PyObject *
+quaternion_array_argmin(PyObject *self)
+{
+   return qa_extreme (self, false, "argmin");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_argmax_doc,
+             "argmax(self, /)\n"
+             "Return the index of the first item with the largest norm, i.e. abs(self[j]).\n"
+             "Items with NaN components are ignored.");
+
+static PyObject *
+quaternion_array_argmax(PyObject *self)
+{
+   return qa_extreme (self, true, "argmax");
+}
+
+/* -----------------------------------------------------------------------------
+ * Per item measures - norms, quadrances, dots and isclose.
+ */
+typedef enum {
+   QA_MEASURE_NORM,
+   QA_MEASURE_QUADRANCE,
+   QA_MEASURE_DOT,
+   QA_MEASURE_ISCLOSE
+} qa_measure_kind;
+
+typedef struct {
+   qa_measure_kind kind;
+   const Py_quaternion_array* a;
+   const Py_quaternion_array* b;    /* when NULL, value is used for each item */
+   Py_quaternion value;
+   double rel_tol;
+   double abs_tol;
+   double* r;                       /* all but isclose */
+   unsigned char* mask;             /* isclose */
+} qa_measure_context;
+
+static void
+qa_measure_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_measure_context* c = (qa_measure_context*) context;
+   Py_quaternion ta [QA_BLOCK];
+   Py_quaternion tb [QA_BLOCK];
+   size_t j;
+   size_t k;
+   size_t m;
+
+   for (j = begin; j < end; j += m) {
+      const Py_quaternion* pa;
+      const Py_quaternion* pb = NULL;
+
+      m = end - j < QA_BLOCK ? end - j : QA_BLOCK;
+
+      if (c->a->layout == QA_LAYOUT_AOS) {
+         pa = c->a->qvalArray + j;
+      } else {
+         PyQuaternionArrayGather (c->a, j, ta, m);
+         pa = ta;
+      }
+
+      if (c->b) {
+         if (c->b->layout == QA_LAYOUT_AOS) {
+            pb = c->b->qvalArray + j;
+         } else {
+            PyQuaternionArrayGather (c->b, j, tb, m);
+            pb = tb;
+         }
+      }
+
+      switch (c->kind) {
+         case QA_MEASURE_NORM:
+            for (k = 0; k < m; k++) {
+               c->r [j + k] = _Py_quat_abs (pa [k]);
+            }
+            break;
+
+         case QA_MEASURE_QUADRANCE:
+            for (k = 0; k < m; k++) {
+               c->r [j + k] = _Py_quat_quadrance (pa [k]);
+            }
+            break;
+
+         case QA_MEASURE_DOT:
+            for (k = 0; k < m; k++) {
+               c->r [j + k] = _Py_quat_dot_prod (pa [k], pb ? pb [k] : c->value);
+            }
+            break;
+
+         case QA_MEASURE_ISCLOSE:
+            for (k = 0; k < m; k++) {
+               c->mask [j + k] = _Py_quat_isclose (pa [k], pb ? pb [k] : c->value,
+                                                   c->rel_tol, c->abs_tol);
+            }
+            break;
+      }
+   }
+
+   /* Overflowed norms are just left as inf, as per abs().
+    */
+   errno = 0;
+}
+
+/* Runs the measure over self and other, which may be a QuaternionArray of the
+ * same length, a Quaternion or a number, or NULL when not applicable.
+ * Returns a new array.array object, with type code 'd', or 'B' for isclose.
+ */
+static PyObject *
+qa_measure (PyObject *self, qa_measure_context* context,
+            PyObject *other, const char* fname)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyQuaternionArrayObject* pOther = NULL;
+   const bool isMask = context->kind == QA_MEASURE_ISCLOSE;
+   const size_t itemSize = isMask ? sizeof (unsigned char) : sizeof (double);
+   void* buffer;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   context->a = &pObj->aval;
+   context->b = NULL;
+
+   if (!other) {
+      /* No other operand */
+
+   } else if (PyQuaternionArray_Check(other)) {
+      pOther = (PyQuaternionArrayObject *)other;
+      SANITY_CHECK(pOther, NULL);
+
+      if (pOther->aval.count != pObj->aval.count) {
+         PyErr_Format(PyExc_ValueError,
+                      "%s() array lengths differ (%ld and %ld)", fname,
+                      pObj->aval.count, pOther->aval.count);
+         return NULL;
+      }
+      context->b = &pOther->aval;
+
+   } else if (!PyObject_AsCQuaternion(other, &context->value)) {
+      PyErr_Format(PyExc_TypeError,
+                   "%s() argument must be a QuaternionArray, Quaternion or number (got type %s)",
+                   fname, Py_TYPE(other)->tp_name);
+      return NULL;
+   }
+
+   /* Allow for zero length arrays.
+    */
+   buffer = PyMem_Malloc((pObj->aval.count + 1) * itemSize);
+   if (!buffer) {
+      return PyErr_NoMemory();
+   }
+   context->r = (double*) buffer;
+   context->mask = (unsigned char*) buffer;
+
+   pObj->busy++;
+   if (pOther) pOther->busy++;
+   _Py_quat_parallel_run (qa_measure_task, context, pObj->aval.count);
+   if (pOther) pOther->busy--;
+   pObj->busy--;
+
+   result = PyQuaternionUtil_NewArray (isMask ? 'B' : 'd', buffer,
+                                       pObj->aval.count * itemSize);
+   PyMem_Free(buffer);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_norms_doc,
+             "norms(self, /)\n"
+             "Return the norm of each item, i.e. abs(self[j]), as an array.array('d').");
+
+static PyObject *
+quaternion_array_norms(PyObject *self)
+{
+   qa_measure_context context;
+
+   context.kind = QA_MEASURE_NORM;
+   return qa_measure (self, &context, NULL, "norms");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_quadrances_doc,
+             "quadrances(self, /)\n"
+             "Return the quadrance of each item, i.e. self[j].quadrance(), as an\n"
+             "array.array('d').");
+
+static PyObject *
+quaternion_array_quadrances(PyObject *self)
+{
+   qa_measure_context context;
+
+   context.kind = QA_MEASURE_QUADRANCE;
+   return qa_measure (self, &context, NULL, "quadrances");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_dots_doc,
+             "dots(self, other, /)\n"
+             "Return the dot product of each item, i.e. quaternion.dot(self[j], other[j]),\n"
+             "as an array.array('d').\n"
+             "\n"
+             "other may be a QuaternionArray of the same length, or a Quaternion or a\n"
+             "number, in which case the same value is applied to each item.");
+
+static PyObject *
+quaternion_array_dots(PyObject *self, PyObject *args)
+{
+   qa_measure_context context;
+   PyObject *other = NULL;
+
+   if (!PyArg_UnpackTuple(args, "dots", 1, 1, &other))
+      return NULL;
+
+   context.kind = QA_MEASURE_DOT;
+   return qa_measure (self, &context, other, "dots");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_isclose_doc,
+             "isclose(self, other, rel_tol=1.0e-09, abs_tol=0.0)\n"
+             "Return a mask, as an array.array('B') of 0s and 1s, with mask[j] set when\n"
+             "quaternion.isclose(self[j], other[j], rel_tol=rel_tol, abs_tol=abs_tol).\n"
+             "\n"
+             "other may be a QuaternionArray of the same length, or a Quaternion or a\n"
+             "number, in which case the same value is applied to each item.");
+
+static PyObject *
+quaternion_array_isclose(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"other", "rel_tol", "abs_tol", NULL};
+
+   qa_measure_context context;
+   PyObject *other = NULL;
+
+   context.rel_tol = 1.0e-09;
+   context.abs_tol = 0.0;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|dd:isclose", kwlist,
+                                    &other, &context.rel_tol, &context.abs_tol))
+      return NULL;
+
+   if (context.rel_tol < 0.0 || context.abs_tol < 0.0) {
+      PyErr_SetString(PyExc_ValueError, "isclose() tolerances must be non-negative");
+      return NULL;
+   }
+
+   context.kind = QA_MEASURE_ISCLOSE;
+   return qa_measure (self, &context, other, "isclose");
+}
+
+/* -----------------------------------------------------------------------------
+ * Cumulative products - cumprod and integrate.
+ *
+ * The Hamilton product is associative, so the scan is done in fixed size blocks
+ * of QA_SCAN_BLOCK items. The first pass finds the product of each block; the
+ * chunk that starts with block 0 knows each of its carries, and so also writes
+ * its results directly. The block products are then combined in order to give
+ * the carry into each block, from which the second pass writes the results for
+ * the remaining blocks.
+ * Renormalisation only scales, and as normalise (a * b) = normalise (a) *
+ * normalise (b), a block containing a renormalisation point just normalises
+ * its carry. The block boundaries, and hence the results, do not depend on the
+ * number of threads. Arrays of up to QA_SCAN_BLOCK items are a simple sequential
+ * scan; the results for longer arrays may differ from a sequential scan by
+ * rounding errors only.
+ */
+#define QA_SCAN_BLOCK  4096
+
+typedef struct {
+   Py_quaternion carry;             /* the result prior to the first item */
+   Py_quaternion total;             /* the product of the items, from one */
+   bool renormalised;               /* contains a renormalisation point */
+   bool written;                    /* results written by the first pass */
+} qa_scan_block;
+
+typedef struct {
+   const Py_quaternion_array* a;    /* the items, or NULL when omega is used */
+   const double* omega;             /* packed x, y, z angular rates */
+   double dt;
+   Py_quaternion initial;
+   size_t every;                    /* renormalise every so many items, 0 for never */
+   Py_quaternion_array* r;
+   size_t number;                   /* number of blocks */
+   qa_scan_block* blocks;
+} qa_scan_context;
+
+/* Returns the k-th item, i.e. a[k] or the rotation by omega[k] over dt.
+ */
+static Py_quaternion
+qa_scan_item (const qa_scan_context* c, const size_t k)
+{
+   Py_quaternion dq;
+   const double* w;
+   double rate;
+   double s;
+
+   if (c->a) return qa_get (c->a, k);
+
+   w = c->omega + 3*k;
+   rate = sqrt (w [0]*w [0] + w [1]*w [1] + w [2]*w [2]);
+   s = rate > 0.0 ? sin (0.5 * rate * c->dt) / rate : 0.5 * c->dt;
+
+   dq.w = cos (0.5 * rate * c->dt);
+   dq.x = s * w [0];
+   dq.y = s * w [1];
+   dq.z = s * w [2];
+   return dq;
+}
+
+/* Returns the next state, i.e. state * item, the k-th item, and sets renormalised
+ * if this is a renormalisation point.
+ */
+static Py_quaternion
+qa_scan_step (const qa_scan_context* c, const Py_quaternion state,
+              const Py_quaternion item, const size_t k, bool* renormalised)
+{
+   Py_quaternion result = _Py_quat_prod (state, item);
+
+   if (c->every > 0 && (k + 1) % c->every == 0) {
+      result = _Py_quat_normalise (result);
+      *renormalised = true;
+   }
+   return result;
+}
+
+/* Returns the carry into the block following block.
+ */
+static Py_quaternion
+qa_scan_next_carry (const qa_scan_block* block)
+{
+   Py_quaternion carry = block->carry;
+   if (block->renormalised) carry = _Py_quat_normalise (carry);
+   return _Py_quat_prod (carry, block->total);
+}
+
+/* Processes the blocks that start within [begin, end).
+ */
+static void
+qa_scan_first_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   static const Py_quaternion one = { 1.0, 0.0, 0.0, 0.0 };
+
+   qa_scan_context* c = (qa_scan_context*) context;
+   const size_t n = c->r->count;
+   bool known = begin == 0;         /* the carry into block b is known */
+   size_t b;
+
+   for (b = (begin + QA_SCAN_BLOCK - 1) / QA_SCAN_BLOCK; b * QA_SCAN_BLOCK < end; b++) {
+      qa_scan_block* block = &c->blocks [b];
+      const size_t first = b * QA_SCAN_BLOCK;
+      const size_t last = n - first > QA_SCAN_BLOCK ? first + QA_SCAN_BLOCK : n;
+      const bool final = b + 1 == c->number;
+      Py_quaternion state = block->carry;
+      Py_quaternion total = one;
+      bool renormalised = false;
+      size_t k;
+
+      if (known) {
+         /* The two chains are independent, so are interleaved at little cost.
+          */
+         for (k = first; k < last; k++) {
+            const Py_quaternion item = qa_scan_item (c, k);
+            state = qa_scan_step (c, state, item, k, &renormalised);
+            qa_put (c->r, k, state);
+            if (!final) total = qa_scan_step (c, total, item, k, &renormalised);
+         }
+      } else if (!final) {
+         for (k = first; k < last; k++) {
+            total = qa_scan_step (c, total, qa_scan_item (c, k), k, &renormalised);
+         }
+      }
+
+      block->total = total;
+      block->renormalised = renormalised;
+      block->written = known;
+      if (known && !final) c->blocks [b + 1].carry = qa_scan_next_carry (block);
+   }
+   errno = 0;
+}
+
+/* Writes the results for the unwritten blocks that start within [begin, end).
+ */
+static void
+qa_scan_second_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_scan_context* c = (qa_scan_context*) context;
+   const size_t n = c->r->count;
+   bool renormalised;
+   size_t b;
+
+   for (b = (begin + QA_SCAN_BLOCK - 1) / QA_SCAN_BLOCK; b * QA_SCAN_BLOCK < end; b++) {
+      const qa_scan_block* block = &c->blocks [b];
+      const size_t first = b * QA_SCAN_BLOCK;
+      const size_t last = n - first > QA_SCAN_BLOCK ? first + QA_SCAN_BLOCK : n;
+      Py_quaternion state = block->carry;
+      size_t k;
+
+      if (block->written) continue;
+
+      for (k = first; k < last; k++) {
+         state = qa_scan_step (c, state, qa_scan_item (c, k), k, &renormalised);
+         qa_put (c->r, k, state);
+      }
+   }
+   errno = 0;
+}
+
+/* The context's item source, initial and every must be set. Allocates and fills
+ * in a new array of n items.
+ * Returns true if all okay, otherwise sets an error and returns false.
+ */
+static bool
+qa_scan (qa_scan_context* c, Py_quaternion_array* aval, const Py_ssize_t n,
+         const Py_quaternion_layout layout)
+{
+   qa_scan_block single;
+   bool status;
+   size_t b;
+
+   aval->reserved = 0;
+   aval->growth = 0.0;
+   aval->allocated = 0;
+   aval->count = n;
+   aval->qvalArray = NULL;
+   aval->layout = layout;
+   status = qa_reallocate(aval, n, true);
+   if (!status)
+      return false;
+
+   if (n == 0)
+      return true;
+
+   c->r = aval;
+   c->number = (n + QA_SCAN_BLOCK - 1) / QA_SCAN_BLOCK;
+   if (c->number == 1) {
+      c->blocks = &single;
+   } else {
+      c->blocks = PyMem_Malloc (c->number * sizeof (qa_scan_block));
+      if (!c->blocks) {
+         _Py_quat_buffer_free(aval->qvalArray);
+         PyErr_NoMemory();
+         return false;
+      }
+   }
+   c->blocks [0].carry = c->initial;
+
+   _Py_quat_parallel_run (qa_scan_first_task, c, n);
+
+   if (!c->blocks [c->number - 1].written) {
+      for (b = 0; b + 1 < c->number; b++) {
+         c->blocks [b + 1].carry = qa_scan_next_carry (&c->blocks [b]);
+      }
+      _Py_quat_parallel_run (qa_scan_second_task, c, n);
+   }
+
+   if (c->blocks != &single) PyMem_Free (c->blocks);
+   return true;
+}
+
+/* Decodes the common initial and renormalise_every arguments.
+ */
+static bool
+qa_scan_arguments (qa_scan_context* c, PyObject *initialObj, const Py_ssize_t every,
+                   const char* fname)
+{
+   c->initial.w = 1.0;
+   c->initial.x = c->initial.y = c->initial.z = 0.0;
+
+   if (initialObj && initialObj != Py_None &&
+       !PyObject_AsCQuaternion(initialObj, &c->initial)) {
+      PyErr_Format(PyExc_TypeError,
+                   "%s() initial must be a Quaternion or number (got type %s)",
+                   fname, Py_TYPE(initialObj)->tp_name);
+      return false;
+   }
+
+   if (every < 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "%s() renormalise_every can't be negative (got %ld)", fname, every);
+      return false;
+   }
+   c->every = every;
+   return true;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_cumprod_doc,
+             "cumprod(self, initial=None, renormalise_every=0)\n"
+             "Return a new array of the cumulative products, r[j] = r[j-1] * self[j],\n"
+             "i.e. r[j] = initial * self[0] * ... * self[j].\n"
+             "\n"
+             "initial            - the initial Quaternion, defaults to Quaternion(1).\n"
+             "renormalise_every  - when non-zero, every renormalise_every-th result is\n"
+             "                     normalised, to stop drift when composing rotations.\n"
+             "\n"
+             "Large arrays are scanned in parallel, as multiplication is associative, in\n"
+             "fixed size blocks, so that the results do not depend on the number of threads.\n"
+             "For arrays of more than 4096 items, the results may differ from a sequential\n"
+             "product by rounding errors.");
+
+static PyObject *
+quaternion_array_cumprod(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"initial", "renormalise_every", NULL};
+
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyObject *initialObj = NULL;
+   Py_ssize_t every = 0;
+   qa_scan_context context;
+   Py_quaternion_array aval;
+   bool status;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|On:cumprod", kwlist,
+                                    &initialObj, &every))
+      return NULL;
+
+   if (!qa_scan_arguments (&context, initialObj, every, "cumprod"))
+      return NULL;
+
+   context.a = &pObj->aval;
+   context.omega = NULL;
+   context.dt = 0.0;
+
+   pObj->busy++;
+   status = qa_scan (&context, &aval, pObj->aval.count, pObj->aval.layout);
+   pObj->busy--;
+   if (!status)
+      return NULL;
+
+   result = quaternion_array_type_from_c_quaternion_array(aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_integrate_doc,
+             "integrate(omega, dt, initial=None, renormalise_every=0)\n"
+             "Return a new array of the orientations obtained by integrating the body\n"
+             "frame angular rates, i.e. r[j] = r[j-1] * dq[j], where dq[j] is the rotation\n"
+             "by abs(omega[j]) * dt about the omega[j] axis.\n"
+             "\n"
+             "omega              - a buffer of packed x, y, z angular rates (radians per\n"
+             "                     unit time), e.g. an array.array('d').\n"
+             "dt                 - the sample interval.\n"
+             "initial            - the initial orientation, defaults to Quaternion(1).\n"
+             "renormalise_every  - as per cumprod.\n"
+             "\n"
+             "The dq items are calculated as required, and are not stored.");
+
+static PyObject *
+quaternion_array_integrate(PyObject *cls, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"omega", "dt", "initial", "renormalise_every", NULL};
+
+   PyObject *result = NULL;
+   PyObject *omegaObj = NULL;
+   PyObject *initialObj = NULL;
+   Py_ssize_t every = 0;
+   qa_scan_context context;
+   Py_quaternion_array aval;
+   Py_buffer omega;
+   bool status;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "Od|On:integrate", kwlist,
+                                    &omegaObj, &context.dt, &initialObj, &every))
+      return NULL;
+
+   if (!qa_scan_arguments (&context, initialObj, every, "integrate"))
+      return NULL;
+
+   if (!PyQuaternionUtil_GetDoubleBuffer(omegaObj, &omega, false, 3, "integrate", "omega"))
+      return NULL;
+
+   context.a = NULL;
+   context.omega = (const double*) omega.buf;
+
+   status = qa_scan (&context, &aval, omega.len / (3 * sizeof (double)), QA_LAYOUT_AOS);
+   PyBuffer_Release(&omega);
+   if (!status)
+      return NULL;
+
+   result = quaternion_array_subtype_from_c_quaternion_array((PyTypeObject *)cls, aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * Bulk conversions to and from rotation matrices, axis/angle and Euler angles.
+ * The packed doubles are 9 (a Py_quat_matrix, i.e. row major), 3 (an axis or
+ * the Euler angles) and 1 (an angle) per item.
+ */
+typedef enum {
+   QA_TO_MATRIX,
+   QA_FROM_MATRIX,
+   QA_TO_AXIS_ANGLE,
+   QA_FROM_AXIS_ANGLE,
+   QA_TO_EULER,
+   QA_FROM_EULER
+} qa_convert_kind;
+
+typedef struct {
+   qa_convert_kind kind;
+   Py_quaternion_array* aval;
+   double* data;
+   double* angles;                  /* axis/angle only */
+   int axes [3];                    /* Euler only */
+} qa_convert_context;
+
+static void
+qa_convert_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_convert_context* c = (qa_convert_context*) context;
+   int error = 0;
+   size_t k;
+
+   for (k = begin; k < end; k++) {
+      Py_quaternion q;
+      Py_quat_triple axis;
+      double radius;
+      double phase;
+
+      switch (c->kind) {
+         case QA_TO_MATRIX:
+            _Py_quat_to_rotation_matrix (qa_get (c->aval, k), (Py_quat_matrix*) (c->data + 9*k));
+            break;
+
+         case QA_FROM_MATRIX:
+            qa_put (c->aval, k, _Py_quat_from_rotation_matrix ((Py_quat_matrix*) (c->data + 9*k)));
+            break;
+
+         case QA_TO_AXIS_ANGLE:
+            _Py_quat_into_polar (qa_get (c->aval, k), &radius, &axis, &phase);
+            c->data [3*k + 0] = axis.x;
+            c->data [3*k + 1] = axis.y;
+            c->data [3*k + 2] = axis.z;
+            c->angles [k] = 2.0 * phase;
+            break;
+
+         case QA_FROM_AXIS_ANGLE:
+            axis.x = c->data [3*k + 0];
+            axis.y = c->data [3*k + 1];
+            axis.z = c->data [3*k + 2];
+            errno = 0;
+            q = _Py_quat_calc_rotation (c->angles [k], axis);
+            if (errno == EDOM) error = EDOM;
+            qa_put (c->aval, k, q);
+            break;
+
+         case QA_TO_EULER:
+            _Py_quat_to_euler (qa_get (c->aval, k), c->axes, c->data + 3*k);
+            break;
+
+         case QA_FROM_EULER:
+            qa_put (c->aval, k, _Py_quat_from_euler (c->data + 3*k, c->axes));
+            break;
+      }
+   }
+
+   errno = error;
+}
+
+/* Decodes an Euler angle order, e.g. "zyx", into the context's axes.
+ * Returns true if all okay, otherwise sets an error and returns false.
+ */
+static bool
+qa_decode_order (qa_convert_context* c, const char* order, const char* fname)
+{
+   static const char names [] = "xyz";
+   int n;
+
+   for (n = 0; n < 3 && order [n]; n++) {
+      const char* p = strchr (names, order [n]);
+      if (!p) break;
+      c->axes [n] = (int) (p - names);
+   }
+
+   if (n != 3 || order [3] || c->axes [0] == c->axes [1] || c->axes [1] == c->axes [2]) {
+      PyErr_Format(PyExc_ValueError,
+                   "%s() order must be 3 of 'x', 'y' or 'z', with no two consecutive axes"
+                   " the same, e.g. 'zyx' or 'zxz' (got '%.200s')", fname, order);
+      return false;
+   }
+   return true;
+}
+
+/* Converts each item of self into group packed doubles, into out if specified,
+ * which must be a writable buffer of the required size, otherwise into a new
+ * array.array('d').
+ */
+static PyObject *
+qa_convert_to (PyObject *self, qa_convert_context* c, const Py_ssize_t group,
+               PyObject *out, const char* fname)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   Py_buffer view;
+   Py_ssize_t nbytes;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   c->aval = &pObj->aval;
+   nbytes = pObj->aval.count * group * (Py_ssize_t) sizeof (double);
+
+   if (out && out != Py_None) {
+      if (!PyQuaternionUtil_GetDoubleBuffer(out, &view, true, group, fname, "out"))
+         return NULL;
+
+      if (view.len != nbytes) {
+         PyErr_Format(PyExc_ValueError,
+                      "%s() out must be a buffer of %ld doubles (got %ld)", fname,
+                      pObj->aval.count * group, view.len / (Py_ssize_t) sizeof (double));
+         PyBuffer_Release(&view);
+         return NULL;
+      }
+      c->data = (double*) view.buf;
+
+      pObj->busy++;
+      _Py_quat_parallel_run (qa_convert_task, c, pObj->aval.count);
+      pObj->busy--;
+
+      PyBuffer_Release(&view);
+      Py_INCREF(out);
+      return out;
+   }
+
+   c->data = PyMem_Malloc(nbytes + sizeof (double));
+   if (!c->data) {
+      return PyErr_NoMemory();
+   }
+
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_convert_task, c, pObj->aval.count);
+   pObj->busy--;
+
+   result = PyQuaternionUtil_NewArray ('d', c->data, nbytes);
+   PyMem_Free(c->data);
+   return result;
+}
+
+/* Creates a new array of type with n items from the context's packed data.
+ */
+static PyObject *
+qa_convert_from (PyTypeObject *type, qa_convert_context* c, const Py_ssize_t n,
+                 const char* fname)
+{
+   PyObject *result = NULL;
+   Py_quaternion_array aval;
+   bool status;
+
+   aval.reserved = 0;
+   aval.growth = 0.0;
+   aval.allocated = 0;
+   aval.count = n;
+   aval.qvalArray = NULL;
+   aval.layout = QA_LAYOUT_AOS;
+   status = qa_reallocate(&aval, n, true);
+   if (!status)
+      return NULL;
+
+   c->aval = &aval;
+   _Py_quat_parallel_run (qa_convert_task, c, n);
+
+   if (errno == EDOM) {
+      /* Only from axis/angle sets EDOM.
+       */
+      _Py_quat_buffer_free(aval.qvalArray);
+      PyErr_Format(PyExc_ValueError, "%s() an axis has no direction - is zero", fname);
+      return NULL;
+   }
+
+   result = quaternion_array_subtype_from_c_quaternion_array(type, aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_to_matrices_doc,
+             "to_matrices(self, out=None)\n"
+             "Return the equivalent 3D rotation matrix of each item, i.e. self[j].matrix(),\n"
+             "as 9 packed doubles per item in row major order.\n"
+             "\n"
+             "out  - an optional writable buffer of 9 * len(self) doubles; when not\n"
+             "       specified a new array.array('d') is returned.\n"
+             "\n"
+             "As with matrix(), the items are not checked to be rotation quaternions.");
+
+static PyObject *
+quaternion_array_to_matrices(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"out", NULL};
+
+   PyObject *out = NULL;
+   qa_convert_context context;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:to_matrices", kwlist, &out))
+      return NULL;
+
+   context.kind = QA_TO_MATRIX;
+   return qa_convert_to (self, &context, 9, out, "to_matrices");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_from_matrices_doc,
+             "from_matrices(matrices, /)\n"
+             "Return a new array from a buffer of packed row major 3D rotation matrices,\n"
+             "i.e. 9 doubles per item, as per Quaternion(matrix=...).");
+
+static PyObject *
+quaternion_array_from_matrices(PyObject *cls, PyObject *args)
+{
+   PyObject *result = NULL;
+   PyObject *matricesObj = NULL;
+   qa_convert_context context;
+   Py_buffer view;
+
+   if (!PyArg_ParseTuple(args, "O:from_matrices", &matricesObj))
+      return NULL;
+
+   if (!PyQuaternionUtil_GetDoubleBuffer(matricesObj, &view, false, 9,
+                                         "from_matrices", "matrices"))
+      return NULL;
+
+   context.kind = QA_FROM_MATRIX;
+   context.data = (double*) view.buf;
+   result = qa_convert_from ((PyTypeObject *)cls, &context,
+                             view.len / (9 * sizeof (double)), "from_matrices");
+   PyBuffer_Release(&view);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_to_axis_angle_doc,
+             "to_axis_angle(self, /)\n"
+             "Return a tuple (axes, angles), where axes holds the packed x, y, z unit axis\n"
+             "of each item, and angles the rotation angle of each item, as array.array('d')\n"
+             "objects. For unit quaternions, these match axis() and angle().");
+
+static PyObject *
+quaternion_array_to_axis_angle(PyObject *self)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   qa_convert_context context;
+   PyObject *axes = NULL;
+   PyObject *angles = NULL;
+   Py_ssize_t n;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   n = pObj->aval.count;
+   context.kind = QA_TO_AXIS_ANGLE;
+   context.aval = &pObj->aval;
+   context.data = PyMem_Malloc((4 * n + 1) * sizeof (double));
+   if (!context.data) {
+      return PyErr_NoMemory();
+   }
+   context.angles = context.data + 3 * n;
+
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_convert_task, &context, n);
+   pObj->busy--;
+
+   axes = PyQuaternionUtil_NewArray ('d', context.data, 3 * n * sizeof (double));
+   angles = PyQuaternionUtil_NewArray ('d', context.angles, n * sizeof (double));
+   PyMem_Free(context.data);
+
+   if (axes && angles) {
+      result = PyTuple_Pack(2, axes, angles);
+   }
+   Py_XDECREF(axes);
+   Py_XDECREF(angles);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_from_axis_angle_doc,
+             "from_axis_angle(axes, angles, /)\n"
+             "Return a new array of rotation quaternions from a buffer of packed x, y, z\n"
+             "axes and a buffer of angles (radians), as per Quaternion(angle=, axis=).");
+
+static PyObject *
+quaternion_array_from_axis_angle(PyObject *cls, PyObject *args)
+{
+   PyObject *result = NULL;
+   PyObject *axesObj = NULL;
+   PyObject *anglesObj = NULL;
+   qa_convert_context context;
+   Py_buffer axes;
+   Py_buffer angles;
+   Py_ssize_t n;
+
+   if (!PyArg_ParseTuple(args, "OO:from_axis_angle", &axesObj, &anglesObj))
+      return NULL;
+
+   if (!PyQuaternionUtil_GetDoubleBuffer(axesObj, &axes, false, 3, "from_axis_angle", "axes"))
+      return NULL;
+
+   if (!PyQuaternionUtil_GetDoubleBuffer(anglesObj, &angles, false, 1, "from_axis_angle", "angles")) {
+      PyBuffer_Release(&axes);
+      return NULL;
+   }
+
+   n = axes.len / (3 * sizeof (double));
+   if (angles.len != n * (Py_ssize_t) sizeof (double)) {
+      PyErr_Format(PyExc_ValueError,
+                   "from_axis_angle() number of axes and angles differ (%ld and %ld)",
+                   n, angles.len / (Py_ssize_t) sizeof (double));
+   } else {
+      context.kind = QA_FROM_AXIS_ANGLE;
+      context.data = (double*) axes.buf;
+      context.angles = (double*) angles.buf;
+      result = qa_convert_from ((PyTypeObject *)cls, &context, n, "from_axis_angle");
+   }
+
+   PyBuffer_Release(&angles);
+   PyBuffer_Release(&axes);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_to_euler_doc,
+             "to_euler(self, order='zyx', out=None)\n"
+             "Return the Euler angles of each item, as 3 packed doubles per item.\n"
+             "\n"
+             "order  - the axes of the rotations, such that\n"
+             "            self[j] = R(a0, order[0]) * R(a1, order[1]) * R(a2, order[2])\n"
+             "         i.e. intrinsic rotations, where R(a, n) is the rotation by a about\n"
+             "         the n axis. Both Tait-Bryan, e.g. 'zyx' (yaw, pitch, roll), and\n"
+             "         proper Euler, e.g. 'zxz', orders are allowed.\n"
+             "out    - an optional writable buffer of 3 * len(self) doubles; when not\n"
+             "         specified a new array.array('d') is returned.\n"
+             "\n"
+             "The angles are in the range -pi to pi, at gimbal lock a2 is set to zero.");
+
+static PyObject *
+quaternion_array_to_euler(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"order", "out", NULL};
+
+   const char* order = "zyx";
+   PyObject *out = NULL;
+   qa_convert_context context;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sO:to_euler", kwlist, &order, &out))
+      return NULL;
+
+   if (!qa_decode_order (&context, order, "to_euler"))
+      return NULL;
+
+   context.kind = QA_TO_EULER;
+   return qa_convert_to (self, &context, 3, out, "to_euler");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_from_euler_doc,
+             "from_euler(angles, order='zyx')\n"
+             "Return a new array of rotation quaternions from a buffer of packed Euler\n"
+             "angles, 3 doubles per item. See to_euler for details of order.");
+
+static PyObject *
+quaternion_array_from_euler(PyObject *cls, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"angles", "order", NULL};
+
+   PyObject *result = NULL;
+   PyObject *anglesObj = NULL;
+   const char* order = "zyx";
+   qa_convert_context context;
+   Py_buffer view;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|s:from_euler", kwlist, &anglesObj, &order))
+      return NULL;
+
+   if (!qa_decode_order (&context, order, "from_euler"))
+      return NULL;
+
+   if (!PyQuaternionUtil_GetDoubleBuffer(anglesObj, &view, false, 3, "from_euler", "angles"))
+      return NULL;
+
+   context.kind = QA_FROM_EULER;
+   context.data = (double*) view.buf;
+   result = qa_convert_from ((PyTypeObject *)cls, &context,
+                             view.len / (3 * sizeof (double)), "from_euler");
+   PyBuffer_Release(&view);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * Bulk encoding to, and decoding from, the compact item encodings.
+ */
+typedef struct {
+   Py_quat_encoding encoding;
+   Py_quaternion_array* aval;
+   unsigned char* data;
+   size_t size;                     /* encoded item size */
+   bool decode;
+} qa_encode_context;
+
+static void
+qa_encode_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_encode_context* c = (qa_encode_context*) context;
+   Py_quaternion t [QA_BLOCK];
+   int error = 0;
+   size_t j;
+   size_t m;
+
+   for (j = begin; j < end; j += m) {
+      Py_quaternion* pa;
+
+      m = end - j < QA_BLOCK ? end - j : QA_BLOCK;
+      pa = c->aval->layout == QA_LAYOUT_AOS ? c->aval->qvalArray + j : t;
+
+      if (c->decode) {
+         _Py_quat_array_decode (c->data + j * c->size, pa, m, c->encoding);
+         if (pa == t) PyQuaternionArrayScatter (c->aval, j, t, m);
+      } else {
+         if (pa == t) PyQuaternionArrayGather (c->aval, j, t, m);
+         _Py_quat_array_encode (pa, c->data + j * c->size, m, c->encoding);
+         if (errno == EDOM) error = EDOM;
+      }
+   }
+
+   errno = error;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+bool
+PyQuaternionArrayDecodeEncoding (PyObject *encodingObj, Py_quat_encoding *encoding)
+{
+   static const Py_quat_encoding all [] = {
+      QUAT_ENCODING_F8, QUAT_ENCODING_F4, QUAT_ENCODING_U8, QUAT_ENCODING_U6
+   };
+   const char* name;
+   size_t j;
+
+   *encoding = QUAT_ENCODING_F8;
+   if (!encodingObj || encodingObj == Py_None) return true;
+
+   if (!PyUnicode_Check(encodingObj)) {
+      PyErr_Format(PyExc_TypeError,
+                   "encoding must be a str (got type %s)", Py_TYPE(encodingObj)->tp_name);
+      return false;
+   }
+
+   name = PyUnicode_AsUTF8(encodingObj);
+   if (!name) return false;
+
+   for (j = 0; j < sizeof (all) / sizeof (all [0]); j++) {
+      if (strcmp (name, _Py_quat_encoding_name (all [j])) == 0) {
+         *encoding = all [j];
+         return true;
+      }
+   }
+
+   PyErr_Format(PyExc_ValueError,
+                "encoding must be one of 'f8', 'f4', 'u8' or 'u6' (got '%.200s')", name);
+   return false;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_encode_doc,
+             "encode(self, encoding='f4', out=None)\n"
+             "Return the items in a compact encoding, as an array.array, 'f' for 'f4',\n"
+             "'d' for 'f8', otherwise 'B', or into out if specified, which must be a\n"
+             "writable buffer of the encoded size. The encodings are:\n"
+             "\n"
+             "  'f8' - 32 bytes per item, i.e. as per tobytes();\n"
+             "  'f4' - 16 bytes per item, single precision w, x, y, z values;\n"
+             "  'u8' - 8 bytes per item, a unit rotation with 20 bits per component;\n"
+             "  'u6' - 6 bytes per item, a unit rotation with 15 bits per component.\n"
+             "\n"
+             "The unit rotation encodings normalise each item, and may change its sign,\n"
+             "which does not change the rotation. A zero or non-finite item cannot be\n"
+             "encoded as a unit rotation, and raises ValueError.");
+
+static PyObject *
+quaternion_array_encode(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"encoding", "out", NULL};
+
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyObject *encodingObj = NULL;
+   PyObject *out = Py_None;
+   qa_encode_context context;
+   Py_buffer view;
+   Py_ssize_t nbytes;
+   char typecode;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO:encode", kwlist, &encodingObj, &out))
+      return NULL;
+
+   context.encoding = QUAT_ENCODING_F4;
+   if (encodingObj && !PyQuaternionArrayDecodeEncoding (encodingObj, &context.encoding))
+      return NULL;
+
+   context.aval = &pObj->aval;
+   context.size = _Py_quat_encoded_size (context.encoding);
+   context.decode = false;
+   nbytes = pObj->aval.count * (Py_ssize_t) context.size;
+
+   if (out != Py_None) {
+      if (PyObject_GetBuffer(out, &view, PyBUF_WRITABLE) < 0)
+         return NULL;
+      if (view.len != nbytes) {
+         PyErr_Format(PyExc_ValueError,
+                      "encode() out must be a buffer of %ld bytes (got %ld)", nbytes, view.len);
+         PyBuffer_Release(&view);
+         return NULL;
+      }
+      context.data = (unsigned char*) view.buf;
+   } else {
+      context.data = PyMem_Malloc(nbytes + sizeof (double));
+      if (!context.data)
+         return PyErr_NoMemory();
+   }
+
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_encode_task, &context, pObj->aval.count);
+   pObj->busy--;
+
+   if (errno == EDOM) {
+      PyErr_SetString(PyExc_ValueError,
+                      "encode() a zero or non-finite item cannot be encoded as a unit rotation");
+   } else if (out != Py_None) {
+      result = out;
+      Py_INCREF(result);
+   } else {
+      typecode = context.encoding == QUAT_ENCODING_F4 ? 'f' :
+                 context.encoding == QUAT_ENCODING_F8 ? 'd' : 'B';
+      result = PyQuaternionUtil_NewArray (typecode, context.data, nbytes);
+   }
+
+   if (out != Py_None) {
+      PyBuffer_Release(&view);
+   } else {
+      PyMem_Free(context.data);
+   }
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_decode_doc,
+             "decode(data, encoding='f4', layout='aos')\n"
+             "Return a new array of the items decoded from data, any contiguous buffer of\n"
+             "items in one of the encodings provided by encode().");
+
+static PyObject *
+quaternion_array_decode(PyObject *cls, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"data", "encoding", "layout", NULL};
+
+   PyObject *result = NULL;
+   PyObject *dataObj = NULL;
+   PyObject *encodingObj = NULL;
+   PyObject *layoutObj = NULL;
+   qa_encode_context context;
+   Py_quaternion_array aval;
+   Py_buffer view;
+   bool status;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO:decode", kwlist,
+                                    &dataObj, &encodingObj, &layoutObj))
+      return NULL;
+
+   context.encoding = QUAT_ENCODING_F4;
+   if (encodingObj && !PyQuaternionArrayDecodeEncoding (encodingObj, &context.encoding))
+      return NULL;
+
+   aval.reserved = 0;
+   aval.growth = 0.0;
+   aval.allocated = 0;
+   aval.count = 0;
+   aval.qvalArray = NULL;
+   if (!PyQuaternionArrayDecodeLayout (layoutObj, &aval.layout))
+      return NULL;
+
+   if (PyObject_GetBuffer(dataObj, &view, PyBUF_C_CONTIGUOUS) < 0)
+      return NULL;
+
+   context.size = _Py_quat_encoded_size (context.encoding);
+   if ((view.len % context.size) != 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "decode() data length %ld not a multiple of the '%s' item size %ld",
+                   view.len, _Py_quat_encoding_name (context.encoding), (long) context.size);
+      PyBuffer_Release(&view);
+      return NULL;
+   }
+
+   aval.count = view.len / context.size;
+   status = qa_reallocate(&aval, aval.count, true);
+   if (!status) {
+      PyBuffer_Release(&view);
+      return NULL;
+   }
+
+   context.aval = &aval;
+   context.data = (unsigned char*) view.buf;
+   context.decode = true;
+   _Py_quat_parallel_run (qa_encode_task, &context, aval.count);
+   PyBuffer_Release(&view);
+
+   result = quaternion_array_subtype_from_c_quaternion_array((PyTypeObject *)cls, aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * Apply a basic unary function to each item, for the math module functions.
+ */
+typedef struct {
+   Py_quat_unary_function func;
+   double scale;
+   const Py_quaternion_array* a;
+   Py_quaternion_array* r;    /* may differ in layout from a */
+} qa_apply_context;
+
+static void
+qa_apply_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   qa_apply_context* c = (qa_apply_context*) context;
+   Py_quaternion t [QA_BLOCK];
+   int error = 0;
+   size_t j;
+   size_t k;
+   size_t m;
+
+   for (j = begin; j < end; j += m) {
+      const Py_quaternion* pa;
+      Py_quaternion* pr;
+
+      m = end - j < QA_BLOCK ? end - j : QA_BLOCK;
+
+      if (c->a->layout == QA_LAYOUT_AOS) {
+         pa = c->a->qvalArray + j;
+      } else {
+         PyQuaternionArrayGather (c->a, j, t, m);
+         pa = t;
+      }
+      pr = c->r->layout == QA_LAYOUT_AOS ? c->r->qvalArray + j : t;
+
+      /* Errors are collected per block, not per item.
+       */
+      errno = 0;
+      for (k = 0; k < m; k++) {
+         pr [k] = c->func (pa [k]);
+      }
+      if (errno == EDOM) error = EDOM;
+
+      if (c->scale != 1.0) {
+         for (k = 0; k < m; k++) {
+            pr [k].w *= c->scale;
+            pr [k].x *= c->scale;
+            pr [k].y *= c->scale;
+            pr [k].z *= c->scale;
+         }
+      }
+
+      if (c->r->layout != QA_LAYOUT_AOS) {
+         PyQuaternionArrayScatter (c->r, j, t, m);
+      }
+   }
+
+   /* The underlying complex functions may also set ERANGE, but like the
+    * single quaternion functions, overflowed items are just left as inf.
+    */
+   errno = error;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyObject *
+PyQuaternionArrayApply (PyObject *self, const Py_quat_unary_function func,
+                        const double scale, PyObject *out, const char* fname)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayObject* pObj;
+   PyQuaternionArrayObject* pOut = NULL;
+   Py_quaternion_array aval;
+   qa_apply_context context;
+   bool status;
+
+   pObj = (PyQuaternionArrayObject *)self;
+   SANITY_CHECK(pObj, NULL);
+
+   if (out == Py_None) out = NULL;
+
+   if (out) {
+      if (!PyQuaternionArray_Check(out)) {
+         PyErr_Format(PyExc_TypeError,
+                      "%s() out must be a QuaternionArray (got type %s)",
+                      fname, Py_TYPE(out)->tp_name);
+         return NULL;
+      }
+      pOut = (PyQuaternionArrayObject *)out;
+      SANITY_CHECK(pOut, NULL);
+      WRITE_CHECK(pOut, NULL);
+
+      if (pOut->aval.count != pObj->aval.count) {
+         PyErr_Format(PyExc_ValueError,
+                      "%s() out length differs (%ld and %ld)", fname,
+                      pObj->aval.count, pOut->aval.count);
+         return NULL;
+      }
+      aval = pOut->aval;
+   } else {
+      aval.reserved = 0;
+      aval.growth = 0.0;
+      aval.allocated = 0;
+      aval.count = pObj->aval.count;
+      aval.qvalArray = NULL;
+      aval.layout = pObj->aval.layout;
+      status = qa_reallocate(&aval, aval.count, true);
+      if (!status)
+         return NULL;
+   }
 
-   pObj = (PyQuaternionArrayObject *)self;
-   SANITY_CHECK(pObj, NULL);
+   context.func = func;
+   context.scale = scale;
+   context.a = &pObj->aval;
+   context.r = &aval;
 
-   half = pObj->aval.count / 2;  /* round-down when is good */
+   pObj->busy++;
+   if (pOut) pOut->busy++;
+   _Py_quat_parallel_run (qa_apply_task, &context, aval.count);
+   if (pOut) pOut->busy--;
+   pObj->busy--;
 
-   for (left = 0; left < half; left++) {
-      Py_ssize_t right = pObj->aval.count - left - 1;
-      Py_quaternion tempLeft;
+   if (errno == EDOM) {
+      if (!pOut) {
+         _Py_quat_buffer_free(aval.qvalArray);
+      }
+      PyErr_Format(PyExc_ValueError, "%s() math domain error", fname);
+      return NULL;
+   }
 
-      tempLeft = pObj->aval.qvalArray [left];
-      pObj->aval.qvalArray [left] = pObj->aval.qvalArray [right];
-      pObj->aval.qvalArray [right] = tempLeft;
+   if (pOut) {
+      Py_INCREF(out);
+      return out;
    }
 
-   Py_RETURN_NONE;
+   result = quaternion_array_type_from_c_quaternion_array(aval);
+   if (!result) {
+      _Py_quat_buffer_free(aval.qvalArray);
+   }
+   return result;
 }
 
 /* -----------------------------------------------------------------------------
  */
-PyDoc_STRVAR(quaternion_array_byteswap_doc,
-             "Byteswap all items of the array.");
-static PyObject *
-quaternion_array_byteswap(PyObject* self)
+typedef struct {
+   const Py_quaternion_array* a;
+   double* radius;
+   double* phase;
+   double* axis;
+} qa_polar_context;
+
+static void
+qa_polar_task (void* context, const int chunk, const size_t begin, const size_t end)
 {
-   /* We "know" each quaternion has 4 doubles.
-    * And each double has 8 bytes.
-    */
-   typedef char bytequad [4][8];
+   qa_polar_context* c = (qa_polar_context*) context;
+   Py_quaternion t [QA_BLOCK];
+   size_t j;
+   size_t k;
+   size_t m;
 
-   PyQuaternionArrayObject* pObj;
-   bytequad *byteData;
-   Py_ssize_t i;
-   int j;
+   for (j = begin; j < end; j += m) {
+      const Py_quaternion* pa;
 
-   pObj = (PyQuaternionArrayObject *)self;
-   SANITY_CHECK(pObj, NULL);
+      m = end - j < QA_BLOCK ? end - j : QA_BLOCK;
+
+      if (c->a->layout == QA_LAYOUT_AOS) {
+         pa = c->a->qvalArray + j;
+      } else {
+         PyQuaternionArrayGather (c->a, j, t, m);
+         pa = t;
+      }
 
-   byteData = (bytequad *)pObj->aval.qvalArray;
-   for (i = 0; i < pObj->aval.count; i++) {
-      for (j = 0; j < 4; j++) {
-         char *d = byteData[i][j];
-         char t;
-         t = d[0]; d[0] = d[7]; d[7] = t;
-         t = d[1]; d[1] = d[6]; d[6] = t;
-         t = d[2]; d[2] = d[5]; d[5] = t;
-         t = d[3]; d[3] = d[4]; d[4] = t;
+      for (k = 0; k < m; k++) {
+         double radius;
+         Py_quat_triple axis;
+         double phase;
+         _Py_quat_into_polar (pa [k], &radius, &axis, &phase);
+
+         if (c->radius) c->radius [j + k] = radius;
+         if (c->phase) c->phase [j + k] = phase;
+         if (c->axis) {
+            c->axis [3*(j + k) + 0] = axis.x;
+            c->axis [3*(j + k) + 1] = axis.y;
+            c->axis [3*(j + k) + 2] = axis.z;
+         }
       }
    }
-
-   Py_RETURN_NONE;
 }
 
 /* -----------------------------------------------------------------------------
  */
-PyDoc_STRVAR(quaternion_array_tobytes_doc,
-             "Convert the array to an array of machine values "
-             "and return the bytes representation.");
-static PyObject *
-quaternion_array_tobytes(PyObject* self)
+void
+PyQuaternionArrayPolar (PyObject *self, double* radius, double* phase, double* axis)
 {
-   PyObject *result = NULL;
-   PyQuaternionArrayObject* pObj;
+   PyQuaternionArrayObject* pObj = (PyQuaternionArrayObject *)self;
+   qa_polar_context context;
 
-   pObj = (PyQuaternionArrayObject *)self;
-   SANITY_CHECK(pObj, NULL);
+   context.a = &pObj->aval;
+   context.radius = radius;
+   context.phase = phase;
+   context.axis = axis;
 
-   result = PyBytes_FromStringAndSize((char *) pObj->aval.qvalArray,
-                                      pObj->aval.count * sizeof(Py_quaternion));
-
-   return result;
+   pObj->busy++;
+   _Py_quat_parallel_run (qa_polar_task, &context, pObj->aval.count);
+   pObj->busy--;
 }
 
-
 /* -----------------------------------------------------------------------------
  */
-PyDoc_STRVAR(quaternion_array_tofile_doc,
-             "tofile(self, f /)\n"
-             "Write all quaternions (as machine values) to the file object f.\n");
+PyDoc_STRVAR(quaternion_array_rotate_points_doc,
+             "rotate_points(self, points, origin=None, out=None, unit=False)\n"
+             "Rotates each point, points[j], using the corresponding quaternion, self[j],\n"
+             "without creating any per point Python objects.\n"
+             "\n"
+             "points   - a buffer of len(self) packed x, y, z doubles, e.g. a bytes,\n"
+             "           bytearray, array.array('d') or memoryview object.\n"
+             "origin   - the point about which the rotations occur; when not specified or\n"
+             "           None the origin is deemed to be (0.0, 0.0, 0.0)\n"
+             "out      - an optional writable buffer, the same size as points, into which\n"
+             "           the rotated points are written. This may be points itself.\n"
+             "unit     - when true, the quaternions are assumed to be unit quaternions, and\n"
+             "           a faster rotation formula is used; the result is unspecified for\n"
+             "           quaternions that are not of unit magnitude\n"
+             "\n"
+             "Returns out if specified, otherwise a new array.array('d') object.\n"
+             "See also Quaternion.rotate_many().");
 
-/** Totally cribbed from array_array_tofile **/
 static PyObject *
-quaternion_array_tofile(PyObject* self, PyObject *args)
+quaternion_array_rotate_points(PyObject *self, PyObject *args, PyObject *kwds)
 {
-   _Py_IDENTIFIER(write);
-
+   PyObject *result = NULL;
    PyQuaternionArrayObject* pObj;
-   PyObject *fileObj = NULL;
-   Py_ssize_t nbytes;
-   int blockSize;
-   Py_ssize_t nblocks;
-   Py_ssize_t i;
 
    pObj = (PyQuaternionArrayObject *)self;
    SANITY_CHECK(pObj, NULL);
 
-   /* Extract the file object from the one element tuple.
-    */
-   if (!PyArg_ParseTuple(args, "O:tofile", &fileObj))
-      return NULL;
-
-   nbytes = pObj->aval.count * sizeof (Py_quaternion);
-
-   /* Write 64K blocks at a time.
-    */
-   blockSize = 64*1024;
-
-   nblocks = (nbytes + blockSize - 1) / blockSize;  /* round up */
-   for (i = 0; i < nblocks; i++) {
-       char* ptr = (char *)pObj->aval.qvalArray + i*blockSize;
-       Py_ssize_t size = blockSize;
-       PyObject *bytes;
-       PyObject *res;
-
-       /* Truncate last block it needs be.
-        */
-       if (i*blockSize + size > nbytes)
-           size = nbytes - i*blockSize;
-
-       bytes = PyBytes_FromStringAndSize(ptr, size);
-       if (bytes == NULL)
-           return NULL;
-       res = _PyObject_CallMethodId(fileObj, &PyId_write, "O", bytes);
-       Py_DECREF(bytes);
-
-       if (res == NULL)
-           return NULL;
-       Py_DECREF(res);  /* drop write result */
-   }
-
-   Py_RETURN_NONE;
+   pObj->busy++;
+   result = PyQuaternionUtil_RotatePoints (&pObj->aval, 1, args, kwds, "rotate_points");
+   pObj->busy--;
+   return result;
 }
 
 /* -----------------------------------------------------------------------------
@@ -1727,8 +6094,10 @@ quaternion_array_get_subscript(PyObject* self, PyObject* key)
       }
 
       aval.reserved = 0;
+      aval.growth = 0.0;
       aval.count = 0;
       aval.qvalArray = NULL;
+      aval.layout = pObj->aval.layout;
       status = qa_reallocate(&aval, count, false);
       if (!status)
          return NULL;
@@ -1736,13 +6105,16 @@ quaternion_array_get_subscript(PyObject* self, PyObject* key)
       for (j = 0; j < count; j++) {
           Py_ssize_t index = start + j*step;
           if ((index >= 0) && (index < pObj->aval.count)) { /* sanity check */
-             aval.qvalArray[aval.count++] = pObj->aval.qvalArray [index];
+             qa_put (&aval, aval.count++, qa_get (&pObj->aval, index));
           } else {
              DEBUG_TRACE ("out of range j: %ld  index: %ld\n", j, index);
           }
       }
 
       result = quaternion_array_type_from_c_quaternion_array(aval);
+      if (!result) {
+         _Py_quat_buffer_free(aval.qvalArray);
+      }
 
    } else  {
       /* Caller has got it wrong.
@@ -1760,9 +6132,12 @@ quaternion_array_get_subscript(PyObject* self, PyObject* key)
 
 /* -----------------------------------------------------------------------------
  * called by quaternion_array_set_subscript (__setitem__)
+ * When fixed is true, e.g. for a mapped array, the number of items must not
+ * change, i.e. the array must not be resized.
  */
 static bool
-qa_assign_slice(Py_quaternion_array *aval, PyObject* slice, PyObject* value)
+qa_assign_slice(Py_quaternion_array *aval, PyObject* slice, PyObject* value,
+                const bool fixed)
 {
    Py_ssize_t start;
    Py_ssize_t stop;
@@ -1771,19 +6146,40 @@ qa_assign_slice(Py_quaternion_array *aval, PyObject* slice, PyObject* value)
    bool status;
    Py_ssize_t number_assigned;
 
+   /* Convert the value into a C quaternion_array, which also determines the
+    * number of items being assigned. This is done first, as the conversion
+    * may run arbitrary Python code, which could resize the array.
+    */
+   Py_quaternion_array assigned;
+   assigned.reserved = 0;
+   assigned.growth = 0.0;
+   assigned.count = 0;
+   assigned.allocated = 0;
+   assigned.qvalArray = NULL;
+   assigned.layout = QA_LAYOUT_AOS;
+   status = qa_extend_from (&assigned, value);
+   if (!status) {
+      _Py_quat_buffer_free(assigned.qvalArray);
+      return false;
+   }
+   number_assigned = assigned.count;
+
    /* Deal with negative start and stop values and ensure still in range.
     */
    status = qa_decode_slice (*aval, slice, &start, &stop, &step, &number_replaced);
    if (!status) {
       /* qa_decode_slice has already called PyErr_SetString/PyErr_Format.
        */
+      _Py_quat_buffer_free(assigned.qvalArray);
       return false;
    }
 
-   number_assigned = qa_iterator_size(value);
-   if (number_assigned < 0) {
-      /* qa_iterator_size has already called PyErr_SetString/PyErr_Format.
-       */
+   if (fixed && (number_assigned != number_replaced)) {
+      PyErr_Format(PyExc_BufferError,
+                   "cannot resize a mapped quaternion array: attempt to assign "
+                   "sequence of size %ld to slice of size %ld",
+                   number_assigned, number_replaced);
+      _Py_quat_buffer_free(assigned.qvalArray);
       return false;
    }
 
@@ -1796,54 +6192,29 @@ qa_assign_slice(Py_quaternion_array *aval, PyObject* slice, PyObject* value)
 
       if (new_count > aval->allocated) {
          status = qa_reallocate(aval, new_count, false);
-         if (!status)
+         if (!status) {
+            _Py_quat_buffer_free(assigned.qvalArray);
             return false;
+         }
       }
 
       /* First shuffle up/down the tail end - if needs be.
-       * memmove (void *__dest, const void *__src, size_t __n)
        */
       if (number_assigned > number_replaced) {
          Py_ssize_t numberToMove = aval->count - stop;
          Py_ssize_t offset = number_assigned - number_replaced;
-         if (numberToMove > 0) {
-            memmove(&aval->qvalArray [stop + offset],
-                    &aval->qvalArray [stop],
-                    numberToMove * sizeof(Py_quaternion));
-         }
+         qa_move (aval, stop + offset, aval, stop, numberToMove);
 
       } else if (number_assigned < number_replaced) {
          Py_ssize_t numberToMove = aval->count - stop;
          Py_ssize_t offset = number_replaced - number_assigned;
-         if (numberToMove > 0) {  /* number replaced */
-            memmove(&aval->qvalArray [stop - offset],
-                    &aval->qvalArray [stop],
-                    numberToMove * sizeof(Py_quaternion));
-         }
+         qa_move (aval, stop - offset, aval, stop, numberToMove);
 
       } /* else  exact fit */
 
-      /* Create a C quaternion_array from the value so that we can use
-       * the qa_extract_and_add function.
-       */
-      Py_quaternion_array assigned;
-      assigned.reserved = 0;
-      assigned.count = 0;
-      assigned.allocated = 0;
-      assigned.qvalArray = NULL;
-      status = qa_reallocate(&assigned, number_assigned, true);
-      if (!status)
-         return false;
-      qa_extract_and_add(value, &assigned);
-
-      memcpy(&aval->qvalArray [start],
-             &assigned.qvalArray [0],
-             number_assigned * sizeof(Py_quaternion));
+      qa_move (aval, start, &assigned, 0, number_assigned);
       aval->count = new_count;
 
-      PyMem_Free(assigned.qvalArray);  // done with this.
-
-
    } else {
       /* extended slice assignment - sizes must match
        */
@@ -1851,34 +6222,22 @@ qa_assign_slice(Py_quaternion_array *aval, PyObject* slice, PyObject* value)
          PyErr_Format(PyExc_TypeError,
                       "array attempt to assign sequence of size %ld to extended slice of size %ld",
                       number_assigned, number_replaced);
+         _Py_quat_buffer_free(assigned.qvalArray);
          return false;
       }
 
-      /* Create a C quaternion_array from the value.
-       */
-      Py_quaternion_array assigned;
-      assigned.reserved = 0;
-      assigned.count = 0;
-      assigned.allocated = 0;
-      assigned.qvalArray = NULL;
-      status = qa_reallocate(&assigned, number_assigned, true);
-      if (!status)
-         return false;
-      qa_extract_and_add(value, &assigned);
-
       Py_ssize_t j;
       for (j = 0; j < number_assigned; j++) {
           Py_ssize_t index = start + j*step;
           if ((index >= 0) && (index < aval->count)) { /* sanity check */
-             aval->qvalArray [index] = assigned.qvalArray[j];
+             qa_put (aval, index, assigned.qvalArray[j]);
          } else {
              DEBUG_TRACE ("out of range j: %ld  index: %ld\n", j, index);
          }
       }
-
-      PyMem_Free(assigned.qvalArray);  // done with this.
    }
 
+   _Py_quat_buffer_free(assigned.qvalArray);  // done with this.
    return true;
 }
 
@@ -1918,15 +6277,10 @@ qa_remove_slice(Py_quaternion_array *aval, PyObject* slice)
    if (step == 1) {
       /* basic slice removal.
        * Shuffle down the tail end - if needs be.
-       * memmove (void *__dest, const void *__src, size_t __n)
        */
       Py_ssize_t numberToMove = aval->count - stop;
       Py_ssize_t offset = number_deleted;
-      if (numberToMove > 0) {  /* number delete */
-         memmove(&aval->qvalArray [stop - offset],
-                 &aval->qvalArray [stop],
-                 numberToMove * sizeof(Py_quaternion));
-      }
+      qa_move (aval, stop - offset, aval, stop, numberToMove);
 
    } else {
 
@@ -1937,12 +6291,15 @@ qa_remove_slice(Py_quaternion_array *aval, PyObject* slice)
          Py_ssize_t index = start + j*step;
          Py_ssize_t src = index + 1;
          Py_ssize_t dest = start + j*numberPerMovedStep;
+         Py_ssize_t number = numberPerMovedStep;
 
-         /* First shuffle down the content
-          * memmove (void *__dest, const void *__src, size_t __n)
+         /* First shuffle down the content - the last step may extend beyond
+          * the end of the array.
           */
-         memmove(&aval->qvalArray[dest], &aval->qvalArray[src],
-                 numberPerMovedStep * sizeof(Py_quaternion));
+         if (number > aval->count - src)
+            number = aval->count - src;
+         if (number > 0)
+            qa_move (aval, dest, aval, src, number);
       }
 
       /* Lastly shuffe the ramaining items if any.
@@ -1951,8 +6308,7 @@ qa_remove_slice(Py_quaternion_array *aval, PyObject* slice)
       Py_ssize_t numberToMove = aval->count - lastSrc;
       if (numberToMove > 0) {
          Py_ssize_t dest = start + number_deleted*numberPerMovedStep;
-         memmove(&aval->qvalArray[dest], &aval->qvalArray[lastSrc],
-                  numberToMove* sizeof(Py_quaternion));
+         qa_move (aval, dest, aval, lastSrc, numberToMove);
       }
    }
 
@@ -1970,25 +6326,45 @@ qa_remove_slice(Py_quaternion_array *aval, PyObject* slice)
    return true;
 }
 
+/* -----------------------------------------------------------------------------
+ * Returns true if assigning value to the slice would not change the number of
+ * items. A value of unknown length is assumed not to fit.
+ */
+static bool
+qa_slice_fits (PyQuaternionArrayObject* pObj, PyObject* slice, PyObject* value)
+{
+   Py_ssize_t start;
+   Py_ssize_t stop;
+   Py_ssize_t step;
+   Py_ssize_t number;
+   Py_ssize_t length;
+
+   if (!qa_decode_slice (pObj->aval, slice, &start, &stop, &step, &number)) {
+      PyErr_Clear();
+      return false;
+   }
+
+   length = PyObject_Length(value);
+   if (length < 0) {
+      PyErr_Clear();
+      return false;
+   }
+   return length == number;
+}
+
 /* -----------------------------------------------------------------------------
  * __setitem__ (value not null) and __delitem__ (value is null)
- *
- ** NOTE: We set error and return Py_None when there is a problem otherwise  **
- **       return NULL when all OK. This is OPPOSITE to every other function. **
- **       Maybe because this is a statement, e.g.  a[2:4] = (....)
+ * As per mp_ass_subscript, returns 0 when all OK, otherwise sets error and
+ * returns -1.
  */
-static PyObject *
+static int
 quaternion_array_set_subscript(PyObject* self, PyObject* key, PyObject* value)
 {
-   PyObject *result = NULL;
    PyQuaternionArrayObject* pObj;
    PyQuaternionObject* pQuat;
 
-   result = Py_None;   /* hypothesize failure */
-   Py_INCREF(result);
-
    pObj = (PyQuaternionArrayObject *)self;
-   SANITY_CHECK(pObj, result);
+   SANITY_CHECK(pObj, -1);
 
    if (PyLong_Check(key)) {
       /* Caller has supplied an index integer
@@ -2002,34 +6378,32 @@ quaternion_array_set_subscript(PyObject* self, PyObject* key, PyObject* value)
       if ((index < 0) || (index >= pObj->aval.count)) {
          PyErr_SetString(PyExc_IndexError,
                          "array index out of range");
-         return result; /** Py_None **/
+         return -1;
       }
 
       if (value) {
          /* __setitem__
           */
+         WRITE_CHECK(pObj, -1);
          pQuat = (PyQuaternionObject*) PyObject_AsQuaternion(value);
          if (!pQuat) {
             PyErr_Format(PyExc_TypeError,
                          "a Quaternion argument is required (got type %s)",
                          Py_TYPE(value)->tp_name);
-            return result; /** Py_None **/
+            return -1;
          }
 
-         pObj->aval.qvalArray[index] = pQuat->qval;
+         qa_put (&pObj->aval, index, pQuat->qval);
+         Py_DECREF(pQuat);
 
       } else {
          /* __delitem__
           *
           * Shuffle data down toward zero-th index.
-          * memmove (void *__dest, const void *__src, size_t __n)
           */
+         RESIZE_CHECK(pObj, -1);
          int numberToMove = pObj->aval.count - index - 1;
-         if (numberToMove > 0) {
-            memmove(&pObj->aval.qvalArray [index],
-                    &pObj->aval.qvalArray [index+1],
-                    numberToMove * sizeof(Py_quaternion));
-         }
+         qa_move (&pObj->aval, index, &pObj->aval, index+1, numberToMove);
          pObj->aval.count--;
       }
 
@@ -2038,8 +6412,19 @@ quaternion_array_set_subscript(PyObject* self, PyObject* key, PyObject* value)
        */
       bool status;
 
+      /* A same size assignment to a mapped array, e.g. a view, is made in place
+       * rather than copying the array out of the mapping. The length is only
+       * a hint - qa_assign_slice checks the actual number of items assigned.
+       */
+      const bool fixed = value && pObj->mapping && qa_slice_fits (pObj, key, value);
+      if (fixed) {
+         WRITE_CHECK(pObj, -1);
+      } else {
+         RESIZE_CHECK(pObj, -1);
+      }
+
       if (value) {
-         status = qa_assign_slice(&pObj->aval, key, value);
+         status = qa_assign_slice(&pObj->aval, key, value, fixed);
       } else {
          status = qa_remove_slice(&pObj->aval, key);
       }
@@ -2048,7 +6433,7 @@ quaternion_array_set_subscript(PyObject* self, PyObject* key, PyObject* value)
          /* qa_assign_slice/qa_remove_slice has already called
           * PyErr_SetString/PyErr_Format.
           */
-         return result; /** Py_None **/
+         return -1;
       }
 
    } else  {
@@ -2057,11 +6442,166 @@ quaternion_array_set_subscript(PyObject* self, PyObject* key, PyObject* value)
       PyErr_Format(PyExc_TypeError,
                    "array indices must be integers or slices (got type %s)",
                    Py_TYPE(key)->tp_name);
-      return result; /** Py_None **/
+      return -1;
+   }
+
+   return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Component views
+ * -----------------------------------------------------------------------------
+ * The w, x, y and z attributes provide zero-copy memoryview objects of the
+ * corresponding component of each item. As a memoryview must refer to the
+ * exporting object, these are exported by a minimal helper object which holds
+ * a reference to the array.
+ */
+typedef struct {
+   PyObject_HEAD
+   PyQuaternionArrayObject* array;
+   int component;              /* 0, 1, 2, 3 for w, x, y, z */
+   Py_ssize_t shape;           /* as exported */
+   Py_ssize_t stride;          /* as exported */
+} PyQuaternionArrayComponentObject;
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+quaternion_array_component_dealloc(PyQuaternionArrayComponentObject* self)
+{
+   Py_XDECREF(self->array);
+   Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/* -----------------------------------------------------------------------------
+ * A component of an AoS array is not contiguous, so requires a strides request.
+ */
+static int
+quaternion_array_component_getbuf (PyQuaternionArrayComponentObject *self,
+                                   Py_buffer *view, int flags)
+{
+   PyQuaternionArrayObject* pObj = self->array;
+   double* base;
+
+   SANITY_CHECK(pObj, -1);
+
+   if (pObj->readonly && (flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+      PyErr_SetString(PyExc_BufferError, "quaternion array is read-only");
+      return -1;
+   }
+
+   if (pObj->aval.layout == QA_LAYOUT_AOS) {
+      base = ((double*) pObj->aval.qvalArray) + self->component;
+      self->stride = sizeof (Py_quaternion);
+   } else {
+      base = QA_COLUMN(&pObj->aval, self->component);
+      self->stride = sizeof (double);
+   }
+   self->shape = pObj->aval.count;
+
+   if (self->stride != sizeof (double) &&
+       (((flags & PyBUF_STRIDES) != PyBUF_STRIDES) ||
+        ((flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS) ||
+        ((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS) ||
+        ((flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS))) {
+      PyErr_SetString(PyExc_BufferError,
+                      "quaternion array component is not contiguous");
+      return -1;
+   }
+
+   view->buf = (void *) base;
+   view->obj = (PyObject*)self;
+   Py_INCREF(self);
+   view->len = self->shape * sizeof (double);
+   view->readonly = pObj->readonly;
+   view->ndim = 1;
+   view->itemsize = sizeof (double);
+   view->suboffsets = NULL;
+   view->shape = NULL;
+   if ((flags & PyBUF_ND) == PyBUF_ND) {
+      view->shape = &self->shape;
+   }
+   view->strides = NULL;
+   if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) {
+      view->strides = &self->stride;
+   }
+   view->format = NULL;
+   view->internal = NULL;
+   if ((flags & PyBUF_FORMAT) == PyBUF_FORMAT) {
+      view->format = "d";
    }
 
-   Py_DECREF (result); /** Py_None **/
-   result = NULL;
+   /* While exported, the array may not be resized.
+    */
+   pObj->exports++;
+   return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+quaternion_array_component_relbuf (PyQuaternionArrayComponentObject *self, Py_buffer *view)
+{
+   self->array->exports--;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyBufferProcs QuaternionArrayComponentAsBuffer = {
+    (getbufferproc)quaternion_array_component_getbuf,
+    (releasebufferproc)quaternion_array_component_relbuf
+};
+
+PyDoc_STRVAR(quaternion_array_component_doc,
+             "__ArrayComponent () -> buffer exporter\n"
+             "Used internally to export a component of a QuaternionArray.\n"
+             "\n");
+
+static PyTypeObject QuaternionArrayComponentType = {
+   PyVarObject_HEAD_INIT(NULL, 0)
+   "quaternion.__ArrayComponent",                  /* tp_name */
+   sizeof(PyQuaternionArrayComponentObject),       /* tp_basicsize */
+   0,                                              /* tp_itemsize */
+   (destructor)quaternion_array_component_dealloc, /* tp_dealloc */
+   0,                                              /* tp_print */
+   0,                                              /* tp_getattr */
+   0,                                              /* tp_setattr */
+   0,                                              /* tp_reserved / tp_as_async */
+   (reprfunc)0,                                    /* tp_repr */
+   0,                                              /* tp_as_number */
+   0,                                              /* tp_as_sequence */
+   0,                                              /* tp_as_mapping */
+   (hashfunc)0,                                    /* tp_hash */
+   0,                                              /* tp_call */
+   (reprfunc)0,                                    /* tp_str */
+   (getattrofunc)0,                                /* tp_getattro */
+   0,                                              /* tp_setattro */
+   &QuaternionArrayComponentAsBuffer,              /* tp_as_buffer */
+   Py_TPFLAGS_DEFAULT,                             /* tp_flags */
+   quaternion_array_component_doc,                 /* tp_doc */
+};
+
+/* -----------------------------------------------------------------------------
+ * Returns a memoryview of the specified component of each item.
+ */
+static PyObject *
+qa_component_view (PyQuaternionArrayObject* pObj, const int component)
+{
+   PyObject *result = NULL;
+   PyQuaternionArrayComponentObject* exporter;
+
+   exporter = PyObject_New(PyQuaternionArrayComponentObject, &QuaternionArrayComponentType);
+   if (!exporter)
+      return NULL;
+
+   Py_INCREF(pObj);
+   exporter->array = pObj;
+   exporter->component = component;
+   exporter->shape = 0;
+   exporter->stride = 0;
+
+   result = PyMemoryView_FromObject((PyObject *)exporter);
+   Py_DECREF(exporter);
    return result;
 }
 
@@ -2096,6 +6636,30 @@ quaternion_array_getattro(PyObject *self, PyObject *attr)
          else if (strcmp(name, "reserved") == 0) {
             result = PyLong_FromLong(pObj->aval.reserved);
          }
+         else if (strcmp(name, "growth") == 0) {
+            result = PyFloat_FromDouble(pObj->aval.growth >= QA_MINIMUM_GROWTH ?
+                                        pObj->aval.growth : QA_DEFAULT_GROWTH);
+         }
+         else if (strcmp(name, "readonly") == 0) {
+            result = PyBool_FromLong(pObj->readonly);
+         }
+         else if (strcmp(name, "base") == 0) {
+            result = (pObj->mapping && pObj->mapMode == 'v') ? pObj->mapping : Py_None;
+            Py_INCREF(result);
+         }
+         else if (strcmp(name, "shared_memory") == 0) {
+            result = (pObj->mapping && pObj->mapMode == 's') ? pObj->mapping : Py_None;
+            Py_INCREF(result);
+         }
+         else if (strcmp(name, "layout") == 0) {
+            result = PyUnicode_FromString(PyQuaternionArrayLayoutName (pObj->aval.layout));
+         }
+         else if (name[0] >= 'w' && name[0] <= 'z' && name[1] == '\0') {
+            /* w, x, y, z  => 0, 1, 2, 3
+             */
+            result = qa_component_view (pObj, (name[0] - 'w'));
+            if (!result) return NULL;
+         }
       }
    }
 
@@ -2117,13 +6681,19 @@ quaternion_array_getattro(PyObject *self, PyObject *attr)
 
 
 /* -----------------------------------------------------------------------------
- * Cribbed from array.array (3.12) - it seems to work even if the doco for each
- * view field is a bit vague.
+ * The array is exported as a 2-D (count, 4) array of doubles, i.e. format "d",
+ * such that consumers (numpy, memoryview.cast etc.) can use the data in place.
+ * For the AoS layout, the strides are (32, 8), and the buffer is C contiguous.
+ * For the SoA layout, the strides are (8, allocated * 8), so consumers must
+ * request a strided buffer - contiguous requests are refused.
+ * The shape and strides are allocated, and freed by quaternion_array_buffer_relbuf.
  */
 static int quaternion_array_buffer_getbuf (PyQuaternionArrayObject *self,
                                            Py_buffer *view, int flags)
 {
    static Py_quaternion emptybuf = { 0.0, 0.0, 0.0, 0.0 };
+   const bool soa = self->aval.layout == QA_LAYOUT_SOA;
+   Py_ssize_t *shape = NULL;
 
    if (view == NULL) {
       PyErr_SetString(PyExc_BufferError,
@@ -2131,6 +6701,32 @@ static int quaternion_array_buffer_getbuf (PyQuaternionArrayObject *self,
       return -1;
    }
 
+   if (self->readonly && (flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+      PyErr_SetString(PyExc_BufferError, "quaternion array is read-only");
+      return -1;
+   }
+
+   if (soa && (((flags & PyBUF_STRIDES) != PyBUF_STRIDES) ||
+               ((flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS) ||
+               ((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS) ||
+               ((flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS))) {
+      PyErr_SetString(PyExc_BufferError,
+                      "soa layout quaternion array is not contiguous, use tobytes()");
+      return -1;
+   }
+
+   if ((flags & PyBUF_ND) == PyBUF_ND) {
+      shape = PyMem_Malloc(4 * sizeof(Py_ssize_t));
+      if (!shape) {
+         PyErr_NoMemory();
+         return -1;
+      }
+      shape[0] = self->aval.count;
+      shape[1] = 4;
+      shape[2] = soa ? (Py_ssize_t) sizeof (double) : (Py_ssize_t) sizeof (Py_quaternion);
+      shape[3] = soa ? self->aval.allocated * sizeof (double) : (Py_ssize_t) sizeof (double);
+   }
+
    view->buf = (void *)(self->aval.qvalArray);
    view->obj = (PyObject*)self;
    Py_INCREF(self);
@@ -2139,32 +6735,38 @@ static int quaternion_array_buffer_getbuf (PyQuaternionArrayObject *self,
    }
 
    view->len = self->aval.count * sizeof (Py_quaternion);
-   view->readonly = 0;
-   view->ndim = 1;
-   view->itemsize = sizeof (Py_quaternion);
+   view->readonly = self->readonly;
+   view->itemsize = sizeof (double);
    view->suboffsets = NULL;
-   view->shape = NULL;
-   if ((flags & PyBUF_ND) == PyBUF_ND) {
-      view->shape = &((PyVarObject*)self)->ob_size;
-   }
+   view->internal = shape;
+
+   /* Without PyBUF_ND, the buffer is just presented as contiguous bytes.
+    */
+   view->ndim = shape ? 2 : 1;
+   view->shape = shape ? &shape[0] : NULL;
    view->strides = NULL;
-   if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) {
-      view->strides = &(view->itemsize);
+   if (shape && (flags & PyBUF_STRIDES) == PyBUF_STRIDES) {
+      view->strides = &shape[2];
    }
    view->format = NULL;
-   view->internal = NULL;
    if ((flags & PyBUF_FORMAT) == PyBUF_FORMAT) {
-      view->format = "B";
+      view->format = "d";
    }
 
+   /* While exported, the array may not be resized.
+    */
+   self->exports++;
    return 0;
 }
 
 /* -----------------------------------------------------------------------------
  */
-static void quaternion_array_buffer_relbuf (PyQuaternionObject *self, Py_buffer *view)
+static void quaternion_array_buffer_relbuf (PyQuaternionArrayObject *self, Py_buffer *view)
 {
-// printf ("%s:%d\n", __FUNCTION__, __LINE__);
+   if (view->internal) {
+      PyMem_Free(view->internal);  /* shape and strides */
+   }
+   self->exports--;
 }
 
 
@@ -2176,23 +6778,95 @@ static void quaternion_array_buffer_relbuf (PyQuaternionObject *self, Py_buffer
  */
 static PyMethodDef quaternion_array_methods [] = {
    {"__reduce__",   (PyCFunction)quaternion_array_reduce,    METH_NOARGS,  quaternion_array_reduce_doc    },
+   {"__reduce_ex__",(PyCFunction)quaternion_array_reduce_ex, METH_O,       quaternion_array_reduce_ex_doc },
    {"__setstate__", (PyCFunction)quaternion_array_setstate,  METH_VARARGS, quaternion_array_setstate_doc  },
+   {"add",          (PyCFunction)quaternion_array_add,       METH_VARARGS, quaternion_array_add_doc       },
    {"append",       (PyCFunction)quaternion_array_append,    METH_VARARGS, quaternion_array_append_doc    },
+   {"argmax",       (PyCFunction)quaternion_array_argmax,    METH_NOARGS,  quaternion_array_argmax_doc    },
+   {"argmin",       (PyCFunction)quaternion_array_argmin,    METH_NOARGS,  quaternion_array_argmin_doc    },
+   {"average_rotation", (PyCFunction)quaternion_array_average_rotation, METH_VARARGS |
+                                                              METH_KEYWORDS, quaternion_array_average_rotation_doc },
    {"buffer_info",  (PyCFunction)quaternion_array_info,      METH_NOARGS,  quaternion_array_info_doc      },
    {"byteswap",     (PyCFunction)quaternion_array_byteswap,  METH_NOARGS,  quaternion_array_byteswap_doc  },
    {"clear",        (PyCFunction)quaternion_array_clear,     METH_NOARGS,  quaternion_array_clear_doc     },
    {"count",        (PyCFunction)quaternion_array_count,     METH_VARARGS, quaternion_array_count_doc     },
+   {"cumprod",      (PyCFunction)quaternion_array_cumprod,   METH_VARARGS | METH_KEYWORDS,
+                                                                            quaternion_array_cumprod_doc   },
+   {"decode",       (PyCFunction)quaternion_array_decode,    METH_VARARGS | METH_KEYWORDS |
+                                                              METH_CLASS,   quaternion_array_decode_doc    },
+   {"div",          (PyCFunction)quaternion_array_div,       METH_VARARGS, quaternion_array_div_doc       },
+   {"dots",         (PyCFunction)quaternion_array_dots,      METH_VARARGS, quaternion_array_dots_doc      },
+   {"encode",       (PyCFunction)quaternion_array_encode,    METH_VARARGS | METH_KEYWORDS,
+                                                                            quaternion_array_encode_doc    },
    {"extend",       (PyCFunction)quaternion_array_extend,    METH_VARARGS, quaternion_array_extend_doc    },
+   {"format",       (PyCFunction)quaternion_array_format,    METH_VARARGS | METH_KEYWORDS,
+                                                                            quaternion_array_format_doc    },
+   {"from_axis_angle", (PyCFunction)quaternion_array_from_axis_angle, METH_VARARGS |
+                                                              METH_CLASS,   quaternion_array_from_axis_angle_doc },
+   {"from_euler",   (PyCFunction)quaternion_array_from_euler, METH_VARARGS | METH_KEYWORDS |
+                                                              METH_CLASS,   quaternion_array_from_euler_doc },
+   {"from_matrices", (PyCFunction)quaternion_array_from_matrices, METH_VARARGS |
+                                                              METH_CLASS,   quaternion_array_from_matrices_doc },
+   {"from_shared_memory", (PyCFunction)quaternion_array_from_shared_memory, METH_VARARGS |
+                                             METH_KEYWORDS | METH_CLASS,
+                                                              quaternion_array_from_shared_memory_doc },
    {"frombytes",    (PyCFunction)quaternion_array_frombytes, METH_VARARGS, quaternion_array_frombytes_doc },
    {"fromfile",     (PyCFunction)quaternion_array_fromfile,  METH_VARARGS, quaternion_array_fromfile_doc  },
+   {"fromstrings",  (PyCFunction)quaternion_array_fromstrings, METH_VARARGS,
+                                                                            quaternion_array_fromstrings_doc },
+   {"hashes",       (PyCFunction)quaternion_array_hashes,    METH_VARARGS | METH_KEYWORDS,
+                                                                            quaternion_array_hashes_doc    },
+   {"iadd",         (PyCFunction)quaternion_array_iadd,      METH_VARARGS, quaternion_array_iadd_doc      },
+   {"idiv",         (PyCFunction)quaternion_array_idiv,      METH_VARARGS, quaternion_array_idiv_doc      },
+   {"imul",         (PyCFunction)quaternion_array_imul,      METH_VARARGS, quaternion_array_imul_doc      },
    {"index",        (PyCFunction)quaternion_array_index,     METH_VARARGS, quaternion_array_index_doc     },
+   {"inormalise",   (PyCFunction)quaternion_array_inormalise, METH_NOARGS, quaternion_array_inormalise_doc },
+   {"irenormalise", (PyCFunction)quaternion_array_irenormalise, METH_NOARGS,
+                                                              quaternion_array_irenormalise_doc },
    {"insert",       (PyCFunction)quaternion_array_insert,    METH_VARARGS, quaternion_array_insert_doc    },
+   {"integrate",    (PyCFunction)quaternion_array_integrate, METH_VARARGS | METH_KEYWORDS |
+                                                              METH_CLASS,   quaternion_array_integrate_doc },
+   {"isclose",      (PyCFunction)quaternion_array_isclose,   METH_VARARGS | METH_KEYWORDS,
+                                                                            quaternion_array_isclose_doc   },
+   {"isub",         (PyCFunction)quaternion_array_isub,      METH_VARARGS, quaternion_array_isub_doc      },
+   {"iter_chunks",  (PyCFunction)quaternion_array_iter_chunks, METH_VARARGS,
+                                                                            quaternion_array_iter_chunks_doc },
+   {"iter_components", (PyCFunction)quaternion_array_iter_components, METH_NOARGS,
+                                                              quaternion_array_iter_components_doc },
+   {"mean",         (PyCFunction)quaternion_array_mean,      METH_NOARGS,  quaternion_array_mean_doc      },
+   {"mmap",         (PyCFunction)quaternion_array_mmap,      METH_VARARGS | METH_KEYWORDS |
+                                                              METH_CLASS,   quaternion_array_mmap_doc      },
+   {"mul",          (PyCFunction)quaternion_array_mul,       METH_VARARGS, quaternion_array_mul_doc       },
+   {"normalise",    (PyCFunction)quaternion_array_normalise, METH_NOARGS,  quaternion_array_normalise_doc },
+   {"norms",        (PyCFunction)quaternion_array_norms,     METH_NOARGS,  quaternion_array_norms_doc     },
    {"pop",          (PyCFunction)quaternion_array_pop,       METH_VARARGS, quaternion_array_pop_doc       },
+   {"product",      (PyCFunction)quaternion_array_product,   METH_NOARGS,  quaternion_array_product_doc   },
+   {"quadrances",   (PyCFunction)quaternion_array_quadrances, METH_NOARGS, quaternion_array_quadrances_doc },
+   {"rdiv",         (PyCFunction)quaternion_array_rdiv,      METH_VARARGS, quaternion_array_rdiv_doc      },
    {"remove",       (PyCFunction)quaternion_array_remove,    METH_VARARGS, quaternion_array_remove_doc    },
    {"reserve",      (PyCFunction)quaternion_array_reserve,   METH_VARARGS, quaternion_array_reserve_doc   },
    {"reverse",      (PyCFunction)quaternion_array_reverse,   METH_NOARGS,  quaternion_array_reverse_doc   },
+   {"rmul",         (PyCFunction)quaternion_array_rmul,      METH_VARARGS, quaternion_array_rmul_doc      },
+   {"rotate_points",(PyCFunction)quaternion_array_rotate_points, METH_VARARGS |
+                                                              METH_KEYWORDS, quaternion_array_rotate_points_doc },
+   {"rsub",         (PyCFunction)quaternion_array_rsub,      METH_VARARGS, quaternion_array_rsub_doc      },
+   {"set_growth",   (PyCFunction)quaternion_array_set_growth, METH_O,       quaternion_array_set_growth_doc },
+   {"shrink_to_fit", (PyCFunction)quaternion_array_shrink_to_fit, METH_NOARGS, quaternion_array_shrink_to_fit_doc },
+   {"sub",          (PyCFunction)quaternion_array_sub,       METH_VARARGS, quaternion_array_sub_doc       },
+   {"sum",          (PyCFunction)quaternion_array_sum,       METH_NOARGS,  quaternion_array_sum_doc       },
+   {"to_axis_angle", (PyCFunction)quaternion_array_to_axis_angle, METH_NOARGS,
+                                                                            quaternion_array_to_axis_angle_doc },
+   {"to_euler",     (PyCFunction)quaternion_array_to_euler,  METH_VARARGS | METH_KEYWORDS,
+                                                                            quaternion_array_to_euler_doc  },
+   {"to_matrices",  (PyCFunction)quaternion_array_to_matrices, METH_VARARGS | METH_KEYWORDS,
+                                                                            quaternion_array_to_matrices_doc },
+   {"to_shared_memory", (PyCFunction)quaternion_array_to_shared_memory, METH_VARARGS,
+                                                              quaternion_array_to_shared_memory_doc },
    {"tobytes",      (PyCFunction)quaternion_array_tobytes,   METH_NOARGS,  quaternion_array_tobytes_doc   },
    {"tofile",       (PyCFunction)quaternion_array_tofile,    METH_VARARGS, quaternion_array_tofile_doc    },
+   {"tolist",       (PyCFunction)quaternion_array_tolist,    METH_NOARGS,  quaternion_array_tolist_doc    },
+   {"view",         (PyCFunction)quaternion_array_view,      METH_VARARGS | METH_KEYWORDS,
+                                                                            quaternion_array_view_doc      },
    { NULL, NULL, 0, NULL}  /* sentinel */
 };
 
@@ -2236,7 +6910,7 @@ static PyBufferProcs QuaternionArrayAsBuffer = {
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(quaternion_array_doc,
-             "QuaternionArray([initializer],[reserve]) -> quaternion array\n"
+             "QuaternionArray([initializer],[reserve],[layout],[growth]) -> quaternion array\n"
              "\n"
              "The QuaternionArray docuentation is still work in progress.\n"
              "\n"
@@ -2247,12 +6921,27 @@ PyDoc_STRVAR(quaternion_array_doc,
              "                       (number of items) of the internal buffer to be specified.\n"
              "   clear()   - removes all items from the array.\n"
              "   reserve() - (re)specifies (and re-extends if necessary) the internal buffer.\n"
+             "   shrink_to_fit() - releases any spare allocated space.\n"
+             "   view()    - a zero-copy view of a range of items.\n"
+             "   iter_components(), iter_chunks() - iterate over (w, x, y, z) tuples or views.\n"
+             "   set_growth() - sets the allocation growth factor, also growth=... above.\n"
+             "   layout    - the storage layout, one of 'aos', i.e. an array of quaternions\n"
+             "               (the default), or 'soa', i.e. separate w, x, y and z arrays.\n"
+             "\n"
+             "Element-wise arithmetic\n"
+             "As + and * provide concatenation and repetition, element-wise arithmetic is\n"
+             "provided by methods. The other operand may be a QuaternionArray of the same\n"
+             "length, a Quaternion or a number:\n"
+             "   add(), sub(), mul(), div()  - return a new array, e.g. self[j] * other[j]\n"
+             "   rsub(), rmul(), rdiv()      - reflected operations, e.g. other[j] * self[j]\n"
+             "   iadd(), isub(), imul(), idiv() - in place operations.\n"
+             "   normalise(), inormalise()   - normalise each item.\n"
+             "   irenormalise()              - cheap renormalise of near unit items.\n"
              "\n"
              "and two additional attributes: allocated and reserved - see below.\n"
              "\n"
              "Still to be implemented:\n"
              "   fromlist()\n"
-             "   tolist()\n"
              "\n"
              "Iteration\n"
              "The QuaternionArray object fully supports iteraltion.\n"
@@ -2261,7 +6950,11 @@ PyDoc_STRVAR(quaternion_array_doc,
              "allocated - the length in quaternions of the buffer allocated. This is\n"
              "            always greater than or equal to the actual number of quaternions\n"
              "            values held in the array.\n"
+             "base      - the array of which this array is a view, otherwise None.\n"
+             "growth    - the factor by which the allocation grows when more space is needed.\n"
              "itemsize  - the length in bytes of one quaternion array element.\n"
+             "layout    - the storage layout, 'aos' or 'soa'.\n"
+             "w, x, y, z - zero-copy memoryview objects of each item's w, x, y or z component.\n"
              "reserved  - the minimum buffer size allocation."
              );
 
@@ -2316,6 +7009,14 @@ PyTypeObject* PyQuaternionArrayType()
    return &QuaternionArrayType;
 }
 
+/* -----------------------------------------------------------------------------
+ * Allow module definiton code to access the component view exporter PyTypeObject.
+ */
+PyTypeObject* PyQuaternionArrayComponentType()
+{
+   return &QuaternionArrayComponentType;
+}
+
 /* -----------------------------------------------------------------------------
  */
 bool PyQuaternionArray_Check(PyObject *op)
@@ -33,15 +33,32 @@
 #include <stdbool.h>
 #include "quaternion_object.h"
 
+/* Storage layouts
+ * QA_LAYOUT_AOS - an array of structures, i.e. interleaved w, x, y, z quaternions.
+ * QA_LAYOUT_SOA - a structure of arrays, i.e. qvalArray holds 4 x allocated doubles,
+ *                 being all the w components, then the x, then y, then z components.
+ */
+typedef enum {
+   QA_LAYOUT_AOS = 0,
+   QA_LAYOUT_SOA
+} Py_quaternion_layout;
+
 /* basic c type
  */
 typedef struct {
    Py_ssize_t reserved;        /* minimum number of buffer entries to be allocated */
+   double growth;              /* allocation growth factor, 1.0 to 4.0, or 0.0 for the default */
    Py_ssize_t allocated;       /* number of buffer entries/space available/allocated */
    Py_ssize_t count;           /* count of number actually in use <= number allocated */
    Py_quaternion* qvalArray;   /* pointer to a dynamically allocated array of c quaternions */
+   Py_quaternion_layout layout;
 } Py_quaternion_array;
 
+/* Returns a pointer to the first of the allocated SoA w (0), x (1), y (2) or z (3)
+ * components.
+ */
+#define QA_COLUMN(aval, c)  (((double*) (aval)->qvalArray) + (c) * (aval)->allocated)
+
 
 /* -----------------------------------------------------------------------------
  * PyQuaternionArrayObject : the Quaternion Array PyObject definition
@@ -51,15 +68,101 @@ typedef struct {
    PyObject_HEAD
    /* Type-specific fields go here. */
    Py_quaternion_array aval;
+   Py_ssize_t busy;            /* number of operations using aval without the GIL */
+   Py_ssize_t exports;         /* number of buffer exports - includes component views */
+   PyObject* mapping;          /* mmap.mmap, SharedMemory or other object holding the items */
+   Py_buffer mapView;          /* the mapping's buffer - only valid when mapping is set */
+   char mapMode;               /* mmap mode: 'r' read only, 'w' shared or 'c' copy on write,
+                                * 's' for a shared memory segment, 'b' for an adopted
+                                * (unpickled) buffer, or 'v' for a view of another array */
+   bool readonly;              /* the items may not be modified */
 } PyQuaternionArrayObject;
 
 
 PyAPI_FUNC (PyObject *)
 PyQuaternionArrayGetItem(PyObject *self, Py_ssize_t index);
 
+/* Returns a new QuaternionArray of count zero items, or NULL with error set.
+ */
+PyAPI_FUNC (PyObject *)
+PyQuaternionArrayNew (const Py_ssize_t count, const Py_quaternion_layout layout);
+
+/* Returns a new QuaternionArray view of items start to stop - 1 of self, which
+ * shares self's items (see view()), or NULL with error set.
+ */
+PyAPI_FUNC (PyObject *)
+PyQuaternionArrayView (PyObject *self, const Py_ssize_t start, const Py_ssize_t stop);
+
+/* Provides direct access to the items of self, a QuaternionArray, for use by C
+ * code, which may then release the GIL. The array is marked busy, so it may not
+ * be resized (but the items may be modified), until PyQuaternionArrayRelease is
+ * called. When writable is true, the array must not be read only.
+ * Returns the array, or NULL with error set.
+ */
+PyAPI_FUNC (Py_quaternion_array *)
+PyQuaternionArrayAcquire (PyObject *self, const bool writable);
+
+PyAPI_FUNC (void)
+PyQuaternionArrayRelease (PyObject *self);
+
+/* Copies n items, starting at index, to/from an array of c quaternions,
+ * irrespective of the storage layout.
+ */
+PyAPI_FUNC (void)
+PyQuaternionArrayGather (const Py_quaternion_array* aval, const Py_ssize_t index,
+                         Py_quaternion* r, const Py_ssize_t n);
+
+PyAPI_FUNC (void)
+PyQuaternionArrayScatter (Py_quaternion_array* aval, const Py_ssize_t index,
+                          const Py_quaternion* q, const Py_ssize_t n);
+
+/* Returns the layout name, i.e. 'aos' or 'soa'.
+ */
+PyAPI_FUNC (const char*)
+PyQuaternionArrayLayoutName (const Py_quaternion_layout layout);
+
+/* Decodes a layout name, None (or NULL) means the default AoS layout.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+PyAPI_FUNC (bool)
+PyQuaternionArrayDecodeLayout (PyObject *layoutObj, Py_quaternion_layout *layout);
+
+/* Decodes an encoding name, None (or NULL) means the default 'f8' encoding.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+PyAPI_FUNC (bool)
+PyQuaternionArrayDecodeEncoding (PyObject *encodingObj, Py_quat_encoding *encoding);
+
+/* Reverses the byte order of each of n doubles.
+ */
+PyAPI_FUNC (void)
+PyQuaternionArrayByteswap (double *data, const size_t n);
+
+/* A basic function of one quaternion, e.g. _Py_quat_exp.
+ */
+typedef Py_quaternion (*Py_quat_unary_function) (const Py_quaternion a);
+
+/* Applies func to each item of self (a QuaternionArray), multiplying each result
+ * by scale. The results are written to out, which must be a QuaternionArray of
+ * the same length as self (and may be self), or when out is NULL or None, to a
+ * new QuaternionArray. Returns a new reference to out or the new array.
+ * Raises ValueError if func sets errno to EDOM for any item.
+ */
+PyAPI_FUNC (PyObject *)
+PyQuaternionArrayApply (PyObject *self, const Py_quat_unary_function func,
+                        const double scale, PyObject *out, const char* fname);
+
+/* Converts each item of self (a QuaternionArray) into polar coordinates.
+ * Any of radius, phase (1 double per item) or axis (3 doubles per item)
+ * may be NULL if not required.
+ */
+PyAPI_FUNC (void)
+PyQuaternionArrayPolar (PyObject *self, double* radius, double* phase, double* axis);
+
 /* Used by module setup
  */
 PyAPI_FUNC (PyTypeObject*) PyQuaternionArrayType ();
+PyAPI_FUNC (PyTypeObject*) PyQuaternionArrayComponentType ();
 
 /* QuaternionArray type check functions
  * We use functions as opposed to macros like the complex type
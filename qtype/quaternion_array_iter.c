@@ -30,13 +30,13 @@
 #include "quaternion_basic.h"
 
 /* -----------------------------------------------------------------------------
- * tp_iter of PyQuaternionArray
  */
 PyObject *
-PyQuaternionArrayIter(PyObject *qaobj)
+PyQuaternionArrayIterNew(PyObject *qaobj, const Py_quaternion_iter_kind kind,
+                         const Py_ssize_t chunk)
 {
-    PyObject *obj = NULL;
-    PyQuaternionArrayIterObject *iter = NULL;
+   PyObject *obj = NULL;
+   PyQuaternionArrayIterObject *iter = NULL;
 
    if (!PyQuaternionArray_Check(qaobj)) {
       PyErr_BadInternalCall();
@@ -52,45 +52,127 @@ PyQuaternionArrayIter(PyObject *qaobj)
 
    iter->index = 0;
    iter->qaobj = (PyQuaternionArrayObject *)qaobj;
+   iter->kind = kind;
+   iter->chunk = chunk > 0 ? chunk : 1;
    Py_INCREF(qaobj);
 
    return (PyObject *)iter;
 }
 
+/* -----------------------------------------------------------------------------
+ * tp_iter of PyQuaternionArray
+ */
+PyObject *
+PyQuaternionArrayIter(PyObject *qaobj)
+{
+   return PyQuaternionArrayIterNew(qaobj, QA_ITER_ITEMS, 1);
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns the (w, x, y, z) tuple of floats for q.
+ */
+static PyObject *
+quaternion_array_iter_components(const Py_quaternion q)
+{
+   PyObject *result;
+   const double values [4] = { q.w, q.x, q.y, q.z };
+   int j;
+
+   result = PyTuple_New(4);
+   if (!result)
+      return NULL;
+
+   for (j = 0; j < 4; j++) {
+      PyObject *item = PyFloat_FromDouble(values [j]);
+      if (!item) {
+         Py_DECREF(result);
+         return NULL;
+      }
+      PyTuple_SET_ITEM(result, j, item);
+   }
+   return result;
+}
+
 /* -----------------------------------------------------------------------------
  * tp_iternext
+ * Note: being our own tp_iternext, self is known to be an iterator object, and
+ * qaobj was checked when the iterator was created.
  */
 static PyObject *
 quaternion_array_iter_next(PyObject* self)
 {
-   PyQuaternionArrayIterObject *iter = NULL;
-   PyQuaternionArrayObject *qaobj = NULL;
+   PyQuaternionArrayIterObject *iter = (PyQuaternionArrayIterObject *)self;
+   PyQuaternionArrayObject *qaobj = iter->qaobj;
+   PyObject *result;
+   Py_quaternion qval;
+   Py_ssize_t number;
 
-   /* Check self is what we expect.
-    */
-   if (!self || !PyQuaternionArrayIter_Check(self)) {
-      PyErr_BadInternalCall();
+   if (!qaobj)
       return NULL;
-   }
-   iter = (PyQuaternionArrayIterObject *)self;
 
-   /* Check the array object is what we expect.
+   /* The array may have been shrunk since the last step.
     */
-   qaobj = iter->qaobj;
-   if (!qaobj || !PyQuaternionArray_Check((PyObject *)qaobj)) {
-      PyErr_BadInternalCall();
+   if (iter->index >= qaobj->aval.count) {
+      /* The iteration is over - release the array.
+       */
+      iter->qaobj = NULL;
+      Py_DECREF(qaobj);
       return NULL;
    }
 
-   if (iter->index < qaobj->aval.count) {
-      return PyQuaternionArrayGetItem ((PyObject *)qaobj, iter->index++);
+   switch (iter->kind) {
+      case QA_ITER_COMPONENTS:
+         PyQuaternionArrayGather (&qaobj->aval, iter->index, &qval, 1);
+         result = quaternion_array_iter_components (qval);
+         number = 1;
+         break;
+
+      case QA_ITER_CHUNKS:
+         number = qaobj->aval.count - iter->index;
+         if (number > iter->chunk) number = iter->chunk;
+         result = PyQuaternionArrayView ((PyObject *)qaobj, iter->index, iter->index + number);
+         break;
+
+      default:
+         PyQuaternionArrayGather (&qaobj->aval, iter->index, &qval, 1);
+         result = PyQuaternion_FromCQuaternion (qval);
+         number = 1;
+         break;
    }
 
-   /* The iteration of over.
-    */
-   return NULL;
+   if (result) {
+      iter->index += number;
+   }
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_iter_length_hint_doc,
+             "Private method returning an estimate of len(list(it)).");
+
+static PyObject *
+quaternion_array_iter_length_hint(PyQuaternionArrayIterObject* self, PyObject *noargs)
+{
+   Py_ssize_t number = 0;
+
+   if (self->qaobj && self->index < self->qaobj->aval.count) {
+      number = self->qaobj->aval.count - self->index;
+      if (self->kind == QA_ITER_CHUNKS) {
+         number = (number + self->chunk - 1) / self->chunk;
+      }
+   }
+   return PyLong_FromSsize_t(number);
 }
 
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef quaternion_array_iter_methods[] = {
+   {"__length_hint__", (PyCFunction)quaternion_array_iter_length_hint, METH_NOARGS,
+                                                         quaternion_array_iter_length_hint_doc },
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
 /* -----------------------------------------------------------------------------
  * tp_dealloc
  */
@@ -98,6 +180,7 @@ static void
 quaternion_array_iter_dealloc(PyQuaternionArrayIterObject* self)
 {
    Py_XDECREF(self->qaobj);
+   Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
 /* -----------------------------------------------------------------------------
@@ -135,7 +218,7 @@ static PyTypeObject QuaternionArrayIterType = {
    0,                                         /* tp_weaklistoffset */
    PyObject_SelfIter,                         /* tp_iter */
    (iternextfunc)quaternion_array_iter_next,  /* tp_iternext */
-   0,                                         /* tp_methods */
+   quaternion_array_iter_methods,             /* tp_methods */
 };
 
 
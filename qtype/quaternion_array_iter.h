@@ -32,19 +32,38 @@
 #include <Python.h>
 #include "quaternion_array.h"
 
+/* What each step of the iteration yields.
+ */
+typedef enum {
+   QA_ITER_ITEMS = 0,                 /* Quaternion items */
+   QA_ITER_COMPONENTS,                /* (w, x, y, z) tuples of floats */
+   QA_ITER_CHUNKS                     /* QuaternionArray views of up to chunk items */
+} Py_quaternion_iter_kind;
+
 /* -----------------------------------------------------------------------------
  */
 typedef struct {
    PyObject_HEAD
    /* Type-specific fields go here. */
    Py_ssize_t index;                  /* used by __iter__ and __next__ */
-   PyQuaternionArrayObject* qaobj;    /* the associated QuaternionArray object */
+   PyQuaternionArrayObject* qaobj;    /* the associated QuaternionArray object,
+                                       * NULL once the iteration is over */
+   Py_quaternion_iter_kind kind;
+   Py_ssize_t chunk;                  /* chunk size, QA_ITER_CHUNKS only */
 } PyQuaternionArrayIterObject;
 
 
+/* tp_iter of QuaternionArray, i.e. iterating over the items.
+ */
 PyAPI_FUNC (PyObject *)
 PyQuaternionArrayIter(PyObject *qaobj);
 
+/* Returns a new iterator of the given kind, or NULL with error set.
+ */
+PyAPI_FUNC (PyObject *)
+PyQuaternionArrayIterNew(PyObject *qaobj, const Py_quaternion_iter_kind kind,
+                         const Py_ssize_t chunk);
+
 /* Used by module setup
  */
 PyAPI_FUNC (PyTypeObject*) PyQuaternionArrayIterType ();
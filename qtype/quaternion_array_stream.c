@@ -0,0 +1,1310 @@
+/* quaternion_array_stream.c
+ *
+ * This file is part of the Python quaternion module. It provides the
+ * QuaternionArrayReader and QuaternionArrayWriter types, which stream
+ * QuaternionArray items to and from files in fixed size chunks.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#include "quaternion_array_stream.h"
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+/* The stream file header, all values are in the byte order of the writer:
+ *
+ *    offset  size  value
+ *         0     8  magic "QUATARRY"
+ *         8     2  format version, 1 or 2
+ *        10     1  byte order of the items, '<' little or '>' big endian
+ *        11     1  layout of the written arrays, 'a' aos or 's' soa
+ *        12     4  item size, i.e. 32, or the encoded item size
+ *        16     8  number of items, or all ones if not known
+ *        24     2  version 2 only, item encoding, "f4", "u8" or "u6"
+ *        26     6  reserved, zero
+ *
+ * The items follow, in the same format as tofile(), irrespective of the layout.
+ * Version 1 is written for the default 'f8' encoding, so that such streams
+ * remain readable by older readers, otherwise the items are as per encode().
+ */
+#define STREAM_MAGIC          "QUATARRY"
+#define STREAM_VERSION        2
+#define STREAM_ENCODING_OFFSET  24
+#define STREAM_COUNT_OFFSET   16
+#define STREAM_UNKNOWN_COUNT  UINT64_MAX
+
+#define DEFAULT_CHUNK         65536
+
+/* Number of items written at a time for 'soa' arrays (64K bytes).
+ */
+#define WRITE_BLOCK           2048
+
+#if PY_LITTLE_ENDIAN
+#define NATIVE_BYTEORDER  '<'
+#else
+#define NATIVE_BYTEORDER  '>'
+#endif
+
+
+/* -----------------------------------------------------------------------------
+ * Utility functions
+ * -----------------------------------------------------------------------------
+ */
+
+/* -----------------------------------------------------------------------------
+ * Reverses the order of n bytes in place.
+ */
+static void
+stream_swap_bytes (void* data, const size_t n)
+{
+   unsigned char* d = (unsigned char*) data;
+   size_t i;
+
+   for (i = 0; i < n / 2; i++) {
+      unsigned char t = d[i];
+      d[i] = d[n - 1 - i];
+      d[n - 1 - i] = t;
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Opens a path for binary reading or writing, unless it is already a file, i.e.
+ * has the named method. Returns a new reference, or NULL with error set.
+ */
+static PyObject *
+stream_open (PyObject* pathOrFile, const char* method, const char* mode, bool* owned)
+{
+   PyObject* ioModule;
+   PyObject* result;
+
+   if (PyObject_HasAttrString(pathOrFile, method)) {
+      *owned = false;
+      Py_INCREF(pathOrFile);
+      return pathOrFile;
+   }
+
+   ioModule = PyImport_ImportModule("io");
+   if (!ioModule)
+      return NULL;
+
+   result = PyObject_CallMethod(ioModule, "open", "Os", pathOrFile, mode);
+   Py_DECREF(ioModule);
+   *owned = true;
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ * Closes the file if owned, and releases it.
+ * Returns 0 if successful, otherwise -1 with error set.
+ */
+static int
+stream_release (PyObject** file, const bool owned)
+{
+   PyObject* closed;
+   PyObject* f = *file;
+
+   *file = NULL;
+   if (!f || !owned) {
+      Py_XDECREF(f);
+      return 0;
+   }
+
+   closed = PyObject_CallMethod(f, "close", NULL);
+   Py_DECREF(f);
+   if (!closed)
+      return -1;
+   Py_DECREF(closed);
+   return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Reads up to nbytes into buffer, directly via the file's readinto method.
+ * Returns the number of bytes read, which is less than nbytes only at the end
+ * of the file, or -1 with error set.
+ */
+static Py_ssize_t
+stream_readinto (PyObject* file, char* buffer, const Py_ssize_t nbytes)
+{
+   Py_ssize_t total = 0;
+
+   while (total < nbytes) {
+      PyObject* view;
+      PyObject* obj;
+      Py_ssize_t number;
+
+      view = PyMemoryView_FromMemory(buffer + total, nbytes - total, PyBUF_WRITE);
+      if (!view)
+         return -1;
+      obj = PyObject_CallMethod(file, "readinto", "O", view);
+      Py_DECREF(view);
+      if (!obj)
+         return -1;
+
+      if (obj == Py_None) {
+         /* Non-blocking and no data available - treat as end of file.
+          */
+         Py_DECREF(obj);
+         break;
+      }
+
+      number = PyLong_AsSsize_t(obj);
+      Py_DECREF(obj);
+      if (number == -1 && PyErr_Occurred())
+         return -1;
+
+      if (number < 0 || number > nbytes - total) {
+         PyErr_Format(PyExc_OSError, "readinto() returned invalid length %ld", number);
+         return -1;
+      }
+
+      if (number == 0) break;   /* end of file */
+      total += number;
+   }
+
+   return total;
+}
+
+/* -----------------------------------------------------------------------------
+ * Writes nbytes from buffer, directly via the file's write method.
+ * Returns 0 if successful, otherwise -1 with error set.
+ */
+static int
+stream_write (PyObject* file, const char* buffer, const Py_ssize_t nbytes)
+{
+   Py_ssize_t total = 0;
+
+   while (total < nbytes) {
+      PyObject* view;
+      PyObject* obj;
+      Py_ssize_t number;
+
+      view = PyMemoryView_FromMemory((char*) buffer + total, nbytes - total, PyBUF_READ);
+      if (!view)
+         return -1;
+      obj = PyObject_CallMethod(file, "write", "O", view);
+      Py_DECREF(view);
+      if (!obj)
+         return -1;
+
+      if (obj == Py_None) {
+         /* Not all file like objects return the length - assume all written.
+          */
+         Py_DECREF(obj);
+         break;
+      }
+
+      number = PyLong_AsSsize_t(obj);
+      Py_DECREF(obj);
+      if (number == -1 && PyErr_Occurred())
+         return -1;
+
+      if (number <= 0 || number > nbytes - total) {
+         PyErr_Format(PyExc_OSError, "write() returned invalid length %ld", number);
+         return -1;
+      }
+      total += number;
+   }
+
+   return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * QuaternionArrayReader
+ * -----------------------------------------------------------------------------
+ */
+
+/* -----------------------------------------------------------------------------
+ * Reads and checks the header. If useLayout is true, the layout is taken from
+ * the header.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+static bool
+reader_read_header (PyQuaternionArrayReaderObject* self, const bool useLayout)
+{
+   unsigned char header [QUAT_STREAM_HEADER_SIZE];
+   uint16_t version;
+   uint32_t itemsize;
+   uint64_t count;
+   Py_ssize_t number;
+
+   number = stream_readinto (self->file, (char*) header, QUAT_STREAM_HEADER_SIZE);
+   if (number < 0)
+      return false;
+
+   if (number < QUAT_STREAM_HEADER_SIZE || memcmp (header, STREAM_MAGIC, 8) != 0) {
+      PyErr_SetString(PyExc_ValueError, "not a quaternion array stream (bad header)");
+      return false;
+   }
+
+   self->byteorder = (char) header[10];
+   if (self->byteorder != '<' && self->byteorder != '>') {
+      PyErr_Format(PyExc_ValueError,
+                   "quaternion array stream has invalid byte order '%c'", self->byteorder);
+      return false;
+   }
+   self->swap = (self->byteorder != NATIVE_BYTEORDER);
+
+   memcpy (&version, &header[8], sizeof (version));
+   memcpy (&itemsize, &header[12], sizeof (itemsize));
+   memcpy (&count, &header[STREAM_COUNT_OFFSET], sizeof (count));
+   if (self->swap) {
+      stream_swap_bytes (&version, sizeof (version));
+      stream_swap_bytes (&itemsize, sizeof (itemsize));
+      stream_swap_bytes (&count, sizeof (count));
+   }
+
+   if (version == 0 || version > STREAM_VERSION) {
+      PyErr_Format(PyExc_ValueError,
+                   "quaternion array stream format version %d not supported (expecting %d)",
+                   (int) version, STREAM_VERSION);
+      return false;
+   }
+   self->version = version;
+
+   self->encoding = QUAT_ENCODING_F8;
+   if (version >= 2) {
+      PyObject* nameObj;
+      bool status;
+
+      nameObj = PyUnicode_FromStringAndSize((const char*) &header[STREAM_ENCODING_OFFSET], 2);
+      if (!nameObj) {
+         PyErr_Clear();
+         PyErr_SetString(PyExc_ValueError, "quaternion array stream has invalid encoding");
+         return false;
+      }
+      status = PyQuaternionArrayDecodeEncoding (nameObj, &self->encoding);
+      Py_DECREF(nameObj);
+      if (!status)
+         return false;
+   }
+
+   if (itemsize != _Py_quat_encoded_size (self->encoding)) {
+      PyErr_Format(PyExc_ValueError,
+                   "quaternion array stream item size %ld not supported (expecting %d)",
+                   (long) itemsize, (int) _Py_quat_encoded_size (self->encoding));
+      return false;
+   }
+
+   if (count == STREAM_UNKNOWN_COUNT) {
+      self->count = -1;
+   } else if (count > (uint64_t) (PY_SSIZE_T_MAX / sizeof (Py_quaternion))) {
+      PyErr_SetString(PyExc_ValueError, "quaternion array stream count is too large");
+      return false;
+   } else {
+      self->count = (Py_ssize_t) count;
+   }
+
+   if (useLayout) {
+      self->layout = header[11] == 's' ? QA_LAYOUT_SOA : QA_LAYOUT_AOS;
+   }
+   return true;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns true if chunk may be refilled with want items, i.e. no one else refers
+ * to it and it is big enough.
+ */
+static bool
+reader_reusable (PyQuaternionArrayReaderObject* self, PyObject* chunk, const Py_ssize_t want)
+{
+   PyQuaternionArrayObject* pObj = (PyQuaternionArrayObject *)chunk;
+
+   return chunk && Py_REFCNT(chunk) == 1 &&
+          pObj->aval.allocated >= want && pObj->exports == 0 && pObj->busy == 0 &&
+          !pObj->mapping && !pObj->readonly && pObj->aval.layout == self->layout;
+}
+
+/* -----------------------------------------------------------------------------
+ * Reads up to want items. When reuse is true, the previous chunk is refilled if
+ * no one else refers to it, otherwise a new array is returned.
+ * Returns a new reference, or NULL with no error set at the end of the stream,
+ * or with error set.
+ */
+static PyObject *
+reader_read_chunk (PyQuaternionArrayReaderObject* self, Py_ssize_t want, const bool reuse)
+{
+   PyObject* result = NULL;
+   PyQuaternionArrayObject* pObj;
+   Py_ssize_t total;
+
+   if (!self->file) {
+      PyErr_SetString(PyExc_ValueError, "I/O operation on closed QuaternionArrayReader");
+      return NULL;
+   }
+
+   if (self->count >= 0 && want > self->count - self->position) {
+      want = self->count - self->position;
+   }
+   if (want <= 0) {
+      return NULL;
+   }
+
+   if (self->layout == QA_LAYOUT_SOA && !self->scratch) {
+      self->scratch = PyMem_Malloc(self->chunk * sizeof (Py_quaternion));
+      if (!self->scratch) {
+         PyErr_NoMemory();
+         return NULL;
+      }
+   }
+
+   if (self->encoding != QUAT_ENCODING_F8 && !self->raw) {
+      self->raw = PyMem_Malloc(self->chunk * _Py_quat_encoded_size (self->encoding));
+      if (!self->raw) {
+         PyErr_NoMemory();
+         return NULL;
+      }
+   }
+
+   /* The last two chunks are kept, as when iterating, the caller typically still
+    * refers to the last chunk, but has released the one before.
+    */
+   if (reuse) {
+      if (reader_reusable (self, self->previous, want)) {
+         PyObject* temp = self->previous;
+         self->previous = self->current;
+         self->current = temp;
+      }
+
+      if (reader_reusable (self, self->current, want)) {
+         result = self->current;
+         Py_INCREF(result);
+         ((PyQuaternionArrayObject *)result)->aval.count = want;
+      }
+   }
+
+   if (!result) {
+      result = PyQuaternionArrayNew (want, self->layout);
+      if (!result)
+         return NULL;
+      if (reuse) {
+         Py_XSETREF(self->previous, self->current);
+         self->current = result;
+         Py_INCREF(result);
+      }
+   }
+   pObj = (PyQuaternionArrayObject *)result;
+
+   /* An 'aos' array is read directly into its buffer, a 'soa' array is staged
+    * through the scratch buffer. Encoded items are first read into the raw
+    * buffer, and decoded from there.
+    */
+   total = 0;
+   while (total < want) {
+      const size_t size = _Py_quat_encoded_size (self->encoding);
+      Py_ssize_t number = want - total;
+      Py_ssize_t nbytes;
+      Py_quaternion* buffer;
+      char* target;
+
+      if (self->layout == QA_LAYOUT_SOA) {
+         buffer = self->scratch;
+      } else {
+         buffer = pObj->aval.qvalArray + total;
+      }
+      if (self->layout == QA_LAYOUT_SOA || self->raw) {
+         if (number > self->chunk) number = self->chunk;
+      }
+      target = self->raw ? (char*) self->raw : (char*) buffer;
+
+      nbytes = stream_readinto (self->file, target, number * size);
+      if (nbytes < 0) {
+         Py_DECREF(result);
+         return NULL;
+      }
+
+      if ((nbytes % size) != 0) {
+         PyErr_Format(PyExc_ValueError,
+                      "quaternion array stream ends with a partial item (%ld bytes)",
+                      (long) (nbytes % size));
+         Py_DECREF(result);
+         return NULL;
+      }
+      nbytes /= size;
+
+      if (self->encoding == QUAT_ENCODING_F8) {
+         if (self->swap)
+            PyQuaternionArrayByteswap ((double*) buffer, 4 * nbytes);
+      } else {
+         /* The unit rotation encodings are always little endian.
+          */
+         if (self->swap && self->encoding == QUAT_ENCODING_F4) {
+            Py_ssize_t k;
+            for (k = 0; k < 4 * nbytes; k++)
+               stream_swap_bytes (self->raw + 4 * k, 4);
+         }
+         _Py_quat_array_decode (self->raw, buffer, nbytes, self->encoding);
+      }
+
+      if (self->layout == QA_LAYOUT_SOA) {
+         PyQuaternionArrayScatter (&pObj->aval, total, buffer, nbytes);
+      }
+
+      total += nbytes;
+      if (nbytes < number) break;   /* end of file */
+   }
+
+   pObj->aval.count = total;
+   self->position += total;
+
+   if (total < want && self->count >= 0) {
+      PyErr_Format(PyExc_EOFError,
+                   "quaternion array stream too short (read %ld of %ld items)",
+                   self->position, self->count);
+      Py_DECREF(result);
+      return NULL;
+   }
+
+   if (total == 0) {
+      Py_DECREF(result);
+      return NULL;
+   }
+
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+quaternion_array_reader_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"file", "chunk", "layout", NULL};
+
+   PyQuaternionArrayReaderObject* self;
+   PyObject* fileObj = NULL;
+   PyObject* layoutObj = Py_None;
+   Py_ssize_t chunk = DEFAULT_CHUNK;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|nO:QuaternionArrayReader", kwlist,
+                                    &fileObj, &chunk, &layoutObj))
+      return NULL;
+
+   if (chunk < 1 || chunk > (Py_ssize_t) (PY_SSIZE_T_MAX / sizeof (Py_quaternion))) {
+      PyErr_Format(PyExc_ValueError,
+                   "QuaternionArrayReader() chunk must be positive (got %ld)", chunk);
+      return NULL;
+   }
+
+   self = (PyQuaternionArrayReaderObject *) type->tp_alloc(type, 0);
+   if (!self)
+      return NULL;
+
+   self->file = NULL;
+   self->owned = false;
+   self->swap = false;
+   self->byteorder = NATIVE_BYTEORDER;
+   self->version = STREAM_VERSION;
+   self->layout = QA_LAYOUT_AOS;
+   self->chunk = chunk;
+   self->count = -1;
+   self->position = 0;
+   self->current = NULL;
+   self->previous = NULL;
+   self->scratch = NULL;
+   self->encoding = QUAT_ENCODING_F8;
+   self->raw = NULL;
+
+   if (!PyQuaternionArrayDecodeLayout (layoutObj, &self->layout)) {
+      Py_DECREF(self);
+      return NULL;
+   }
+
+   self->file = stream_open (fileObj, "readinto", "rb", &self->owned);
+   if (!self->file || !reader_read_header (self, layoutObj == Py_None)) {
+      Py_DECREF(self);
+      return NULL;
+   }
+
+   return (PyObject *) self;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+quaternion_array_reader_dealloc(PyQuaternionArrayReaderObject* self)
+{
+   PyObject *type, *value, *traceback;
+
+   PyErr_Fetch(&type, &value, &traceback);
+   if (stream_release (&self->file, self->owned) < 0) {
+      PyErr_WriteUnraisable((PyObject *) self);
+   }
+   PyErr_Restore(type, value, traceback);
+
+   Py_CLEAR(self->current);
+   Py_CLEAR(self->previous);
+   PyMem_Free(self->scratch);
+   self->scratch = NULL;
+   PyMem_Free(self->raw);
+   self->raw = NULL;
+   Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+/* -----------------------------------------------------------------------------
+ * tp_iternext
+ */
+static PyObject *
+quaternion_array_reader_next(PyQuaternionArrayReaderObject* self)
+{
+   return reader_read_chunk (self, self->chunk, true);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_reader_read_doc,
+             "read(self, n=-1, /)\n"
+             "Return a new QuaternionArray of up to n items read from the stream, -1 means\n"
+             "all the remaining items. The array is empty at the end of the stream.");
+
+static PyObject *
+quaternion_array_reader_read(PyQuaternionArrayReaderObject* self, PyObject *args)
+{
+   PyObject* result;
+   Py_ssize_t n = -1;
+
+   if (!PyArg_ParseTuple(args, "|n:read", &n))
+      return NULL;
+
+   if (n < -1) {
+      PyErr_Format(PyExc_ValueError, "read() n must be -1 or more (got %ld)", n);
+      return NULL;
+   }
+
+   if (n == -1 && self->count >= 0) {
+      n = self->count - self->position;
+   }
+
+   if (n >= 0) {
+      result = reader_read_chunk (self, n, false);
+      if (!result && !PyErr_Occurred()) {
+         result = PyQuaternionArrayNew (0, self->layout);
+      }
+      return result;
+   }
+
+   /* The number of items is not known - read chunk by chunk.
+    */
+   result = PyQuaternionArrayNew (0, self->layout);
+   while (result) {
+      PyObject* chunk;
+      PyObject* extended;
+
+      chunk = reader_read_chunk (self, self->chunk, true);
+      if (!chunk) {
+         if (PyErr_Occurred()) Py_CLEAR(result);
+         break;
+      }
+
+      extended = PyObject_CallMethod(result, "extend", "O", chunk);
+      Py_DECREF(chunk);
+      if (!extended) {
+         Py_CLEAR(result);
+         break;
+      }
+      Py_DECREF(extended);
+   }
+
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_reader_close_doc,
+             "close(self, /)\n"
+             "Close the stream, and the file if it was opened by the reader.");
+
+static PyObject *
+quaternion_array_reader_close(PyQuaternionArrayReaderObject* self, PyObject *noargs)
+{
+   Py_CLEAR(self->current);
+   Py_CLEAR(self->previous);
+   PyMem_Free(self->scratch);
+   self->scratch = NULL;
+   PyMem_Free(self->raw);
+   self->raw = NULL;
+   if (stream_release (&self->file, self->owned) < 0)
+      return NULL;
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+quaternion_array_reader_enter(PyObject* self, PyObject *noargs)
+{
+   Py_INCREF(self);
+   return self;
+}
+
+static PyObject *
+quaternion_array_reader_exit(PyQuaternionArrayReaderObject* self, PyObject *args)
+{
+   PyObject* closed;
+
+   closed = quaternion_array_reader_close(self, NULL);
+   if (!closed)
+      return NULL;
+   Py_DECREF(closed);
+   Py_RETURN_FALSE;
+}
+
+/* -----------------------------------------------------------------------------
+ * Attributes
+ */
+static PyObject *
+quaternion_array_reader_get_count(PyQuaternionArrayReaderObject* self, void *closure)
+{
+   if (self->count < 0) {
+      Py_RETURN_NONE;
+   }
+   return PyLong_FromSsize_t(self->count);
+}
+
+static PyObject *
+quaternion_array_reader_get_position(PyQuaternionArrayReaderObject* self, void *closure)
+{
+   return PyLong_FromSsize_t(self->position);
+}
+
+static PyObject *
+quaternion_array_reader_get_chunk(PyQuaternionArrayReaderObject* self, void *closure)
+{
+   return PyLong_FromSsize_t(self->chunk);
+}
+
+static PyObject *
+quaternion_array_reader_get_byteorder(PyQuaternionArrayReaderObject* self, void *closure)
+{
+   return PyUnicode_FromString(self->byteorder == '<' ? "little" : "big");
+}
+
+static PyObject *
+quaternion_array_reader_get_version(PyQuaternionArrayReaderObject* self, void *closure)
+{
+   return PyLong_FromLong(self->version);
+}
+
+static PyObject *
+quaternion_array_reader_get_layout(PyQuaternionArrayReaderObject* self, void *closure)
+{
+   return PyUnicode_FromString(PyQuaternionArrayLayoutName (self->layout));
+}
+
+static PyObject *
+quaternion_array_reader_get_encoding(PyQuaternionArrayReaderObject* self, void *closure)
+{
+   return PyUnicode_FromString(_Py_quat_encoding_name (self->encoding));
+}
+
+static PyObject *
+quaternion_array_reader_get_closed(PyQuaternionArrayReaderObject* self, void *closure)
+{
+   return PyBool_FromLong(self->file == NULL);
+}
+
+static PyGetSetDef quaternion_array_reader_getset[] = {
+   {"count",     (getter)quaternion_array_reader_get_count,     NULL,
+    "number of items in the stream, or None if not known", NULL},
+   {"position",  (getter)quaternion_array_reader_get_position,  NULL,
+    "number of items read so far", NULL},
+   {"chunk",     (getter)quaternion_array_reader_get_chunk,     NULL,
+    "number of items per chunk", NULL},
+   {"byteorder", (getter)quaternion_array_reader_get_byteorder, NULL,
+    "byte order of the stream items, 'little' or 'big'", NULL},
+   {"version",   (getter)quaternion_array_reader_get_version,   NULL,
+    "stream header format version", NULL},
+   {"layout",    (getter)quaternion_array_reader_get_layout,    NULL,
+    "layout of the returned arrays", NULL},
+   {"encoding",  (getter)quaternion_array_reader_get_encoding,  NULL,
+    "encoding of the stream items, 'f8', 'f4', 'u8' or 'u6'", NULL},
+   {"closed",    (getter)quaternion_array_reader_get_closed,    NULL,
+    "True if the stream is closed", NULL},
+   {NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef quaternion_array_reader_methods[] = {
+   {"read",      (PyCFunction)quaternion_array_reader_read,  METH_VARARGS,
+                                                              quaternion_array_reader_read_doc  },
+   {"close",     (PyCFunction)quaternion_array_reader_close, METH_NOARGS,
+                                                              quaternion_array_reader_close_doc },
+   {"__enter__", (PyCFunction)quaternion_array_reader_enter, METH_NOARGS,  NULL },
+   {"__exit__",  (PyCFunction)quaternion_array_reader_exit,  METH_VARARGS, NULL },
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_reader_doc,
+             "QuaternionArrayReader(file, chunk=65536, layout=None)\n"
+             "Reads a quaternion array stream, as written by QuaternionArrayWriter.\n"
+             "\n"
+             "file is a path, or a binary file object that provides readinto(). Iterating\n"
+             "over the reader yields QuaternionArray chunks of up to chunk items. The items\n"
+             "are read directly into the chunk's buffer, and chunks are refilled if no\n"
+             "other reference to them is held. The items are byteswapped only if written\n"
+             "on a machine of the other byte order. layout is 'aos' or 'soa', None means\n"
+             "the layout recorded in the stream header.");
+
+static PyTypeObject QuaternionArrayReaderType = {
+   PyVarObject_HEAD_INIT(NULL, 0)
+   "quaternion.QuaternionArrayReader",          /* tp_name */
+   sizeof(PyQuaternionArrayReaderObject),       /* tp_basicsize */
+   0,                                           /* tp_itemsize */
+   (destructor)quaternion_array_reader_dealloc, /* tp_dealloc */
+   0,                                           /* tp_print */
+   0,                                           /* tp_getattr */
+   0,                                           /* tp_setattr */
+   0,                                           /* tp_reserved / tp_as_async */
+   (reprfunc)0,                                 /* tp_repr */
+   0,                                           /* tp_as_number */
+   0,                                           /* tp_as_sequence */
+   0,                                           /* tp_as_mapping */
+   (hashfunc)0,                                 /* tp_hash */
+   0,                                           /* tp_call */
+   (reprfunc)0,                                 /* tp_str */
+   (getattrofunc)0,                             /* tp_getattro */
+   0,                                           /* tp_setattro */
+   0,                                           /* tp_as_buffer */
+   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,    /* tp_flags */
+   quaternion_array_reader_doc,                 /* tp_doc */
+   0,                                           /* tp_traverse */
+   0,                                           /* tp_clear */
+   0,                                           /* tp_richcompare */
+   0,                                           /* tp_weaklistoffset */
+   PyObject_SelfIter,                           /* tp_iter */
+   (iternextfunc)quaternion_array_reader_next,  /* tp_iternext */
+   quaternion_array_reader_methods,             /* tp_methods */
+   0,                                           /* tp_members */
+   quaternion_array_reader_getset,              /* tp_getset */
+   0,                                           /* tp_base */
+   0,                                           /* tp_dict */
+   0,                                           /* tp_descr_get */
+   0,                                           /* tp_descr_set */
+   0,                                           /* tp_dictoffset */
+   0,                                           /* tp_init */
+   (allocfunc)PyType_GenericAlloc,              /* tp_alloc */
+   (newfunc)quaternion_array_reader_new,        /* tp_new */
+   PyObject_Del                                 /* tp_free */
+};
+
+
+/* -----------------------------------------------------------------------------
+ * QuaternionArrayWriter
+ * -----------------------------------------------------------------------------
+ */
+
+/* -----------------------------------------------------------------------------
+ * Writes the header, with the number of items unknown.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+static bool
+writer_write_header (PyQuaternionArrayWriterObject* self)
+{
+   unsigned char header [QUAT_STREAM_HEADER_SIZE];
+   const uint16_t version = self->encoding == QUAT_ENCODING_F8 ? 1 : STREAM_VERSION;
+   const uint32_t itemsize = _Py_quat_encoded_size (self->encoding);
+   const uint64_t count = STREAM_UNKNOWN_COUNT;
+
+   memset (header, 0, sizeof (header));
+   memcpy (&header[0], STREAM_MAGIC, 8);
+   memcpy (&header[8], &version, sizeof (version));
+   header[10] = NATIVE_BYTEORDER;
+   header[11] = self->layout == QA_LAYOUT_SOA ? 's' : 'a';
+   memcpy (&header[12], &itemsize, sizeof (itemsize));
+   memcpy (&header[STREAM_COUNT_OFFSET], &count, sizeof (count));
+   if (version >= 2) {
+      memcpy (&header[STREAM_ENCODING_OFFSET], _Py_quat_encoding_name (self->encoding), 2);
+   }
+
+   return stream_write (self->file, (const char*) header, QUAT_STREAM_HEADER_SIZE) == 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Records the number of items written in the header, if the file is seekable.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+static bool
+writer_update_count (PyQuaternionArrayWriterObject* self)
+{
+   const uint64_t count = (uint64_t) self->count;
+   PyObject* endObj;
+   PyObject* obj;
+   int status;
+
+   if (self->headerOffset < 0) {
+      return true;
+   }
+
+   endObj = PyObject_CallMethod(self->file, "tell", NULL);
+   if (!endObj)
+      return false;
+
+   obj = PyObject_CallMethod(self->file, "seek", "n",
+                             self->headerOffset + STREAM_COUNT_OFFSET);
+   if (!obj) {
+      Py_DECREF(endObj);
+      return false;
+   }
+   Py_DECREF(obj);
+
+   status = stream_write (self->file, (const char*) &count, sizeof (count));
+
+   obj = PyObject_CallMethod(self->file, "seek", "O", endObj);
+   Py_DECREF(endObj);
+   if (!obj)
+      return false;
+   Py_DECREF(obj);
+
+   return status == 0;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+quaternion_array_writer_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"file", "layout", "encoding", NULL};
+
+   PyQuaternionArrayWriterObject* self;
+   PyObject* fileObj = NULL;
+   PyObject* layoutObj = Py_None;
+   PyObject* encodingObj = Py_None;
+   PyObject* obj;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO:QuaternionArrayWriter", kwlist,
+                                    &fileObj, &layoutObj, &encodingObj))
+      return NULL;
+
+   self = (PyQuaternionArrayWriterObject *) type->tp_alloc(type, 0);
+   if (!self)
+      return NULL;
+
+   self->file = NULL;
+   self->owned = false;
+   self->layout = QA_LAYOUT_AOS;
+   self->count = 0;
+   self->headerOffset = -1;
+   self->encoding = QUAT_ENCODING_F8;
+
+   if (!PyQuaternionArrayDecodeLayout (layoutObj, &self->layout) ||
+       !PyQuaternionArrayDecodeEncoding (encodingObj, &self->encoding)) {
+      Py_DECREF(self);
+      return NULL;
+   }
+
+   self->file = stream_open (fileObj, "write", "wb", &self->owned);
+   if (!self->file) {
+      Py_DECREF(self);
+      return NULL;
+   }
+
+   /* The count can only be filled in later if the file is seekable.
+    */
+   if (PyObject_HasAttrString(self->file, "seekable")) {
+      obj = PyObject_CallMethod(self->file, "seekable", NULL);
+      if (!obj) {
+         Py_DECREF(self);
+         return NULL;
+      }
+
+      if (PyObject_IsTrue(obj)) {
+         Py_DECREF(obj);
+         obj = PyObject_CallMethod(self->file, "tell", NULL);
+         if (!obj) {
+            Py_DECREF(self);
+            return NULL;
+         }
+         self->headerOffset = PyLong_AsSsize_t(obj);
+      }
+      Py_DECREF(obj);
+      if (self->headerOffset == -1 && PyErr_Occurred()) {
+         Py_DECREF(self);
+         return NULL;
+      }
+   }
+
+   if (!writer_write_header (self)) {
+      Py_DECREF(self);
+      return NULL;
+   }
+
+   return (PyObject *) self;
+}
+
+/* -----------------------------------------------------------------------------
+ * Updates the header and flushes and releases the file.
+ * Returns 0 if successful, otherwise -1 with error set.
+ */
+static int
+writer_finish (PyQuaternionArrayWriterObject* self)
+{
+   bool status;
+   PyObject* obj;
+
+   if (!self->file) {
+      return 0;
+   }
+
+   status = writer_update_count (self);
+   if (status) {
+      obj = PyObject_CallMethod(self->file, "flush", NULL);
+      Py_XDECREF(obj);
+      status = (obj != NULL);
+   }
+
+   if (!status) {
+      /* Still release the file, preserving the original exception.
+       */
+      PyObject *type, *value, *traceback;
+      PyErr_Fetch(&type, &value, &traceback);
+      if (stream_release (&self->file, self->owned) < 0) {
+         PyErr_Clear();
+      }
+      PyErr_Restore(type, value, traceback);
+      return -1;
+   }
+
+   return stream_release (&self->file, self->owned);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+quaternion_array_writer_dealloc(PyQuaternionArrayWriterObject* self)
+{
+   PyObject *type, *value, *traceback;
+
+   PyErr_Fetch(&type, &value, &traceback);
+   if (writer_finish (self) < 0) {
+      PyErr_WriteUnraisable((PyObject *) self);
+   }
+   PyErr_Restore(type, value, traceback);
+
+   Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+/* -----------------------------------------------------------------------------
+ * Writes the items of a QuaternionArray.
+ * Returns true iff successful, otherwise reports error and returns false.
+ */
+static bool
+writer_write_array (PyQuaternionArrayWriterObject* self, PyObject* arrayObj)
+{
+   PyQuaternionArrayObject* pObj;
+   const size_t size = _Py_quat_encoded_size (self->encoding);
+   Py_quaternion* block;
+   unsigned char* raw = NULL;
+   Py_ssize_t j;
+   int status = 0;
+
+   if (!self->file) {
+      PyErr_SetString(PyExc_ValueError, "I/O operation on closed QuaternionArrayWriter");
+      return false;
+   }
+
+   if (!PyQuaternionArray_Check(arrayObj)) {
+      PyErr_Format(PyExc_TypeError,
+                   "QuaternionArrayWriter.write() argument must be QuaternionArray, not '%.200s'",
+                   Py_TYPE(arrayObj)->tp_name);
+      return false;
+   }
+   pObj = (PyQuaternionArrayObject *)arrayObj;
+
+   if (pObj->aval.layout == QA_LAYOUT_AOS && self->encoding == QUAT_ENCODING_F8) {
+      /* The items are written directly from the array's buffer, which is
+       * exported for the duration, so the array can't be resized meanwhile.
+       */
+      Py_buffer view;
+      if (PyObject_GetBuffer(arrayObj, &view, PyBUF_SIMPLE) < 0)
+         return false;
+      status = stream_write (self->file, (const char*) view.buf, view.len);
+      PyBuffer_Release(&view);
+      if (status < 0)
+         return false;
+      self->count += view.len / sizeof (Py_quaternion);
+      return true;
+   }
+
+   block = PyMem_Malloc(WRITE_BLOCK * sizeof (Py_quaternion));
+   if (self->encoding != QUAT_ENCODING_F8) {
+      raw = PyMem_Malloc(WRITE_BLOCK * size);
+   }
+   if (!block || (self->encoding != QUAT_ENCODING_F8 && !raw)) {
+      PyMem_Free(block);
+      PyErr_NoMemory();
+      return false;
+   }
+
+   /* The file's write method may run arbitrary code, so the array is marked as
+    * busy to guard against it being resized meanwhile.
+    */
+   pObj->busy++;
+   for (j = 0; j < pObj->aval.count && status == 0; j += WRITE_BLOCK) {
+      Py_ssize_t n = pObj->aval.count - j;
+      const char* data = (const char*) block;
+
+      if (n > WRITE_BLOCK) n = WRITE_BLOCK;
+      PyQuaternionArrayGather (&pObj->aval, j, block, n);
+
+      if (raw) {
+         _Py_quat_array_encode (block, raw, n, self->encoding);
+         if (errno == EDOM) {
+            PyErr_SetString(PyExc_ValueError,
+                            "QuaternionArrayWriter.write() a zero or non-finite item cannot be "
+                            "encoded as a unit rotation");
+            status = -1;
+            break;
+         }
+         data = (const char*) raw;
+      }
+
+      status = stream_write (self->file, data, n * size);
+      if (status == 0) self->count += n;
+   }
+   pObj->busy--;
+
+   PyMem_Free(raw);
+   PyMem_Free(block);
+   return status == 0;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_writer_write_doc,
+             "write(self, a, /)\n"
+             "Append the items of the QuaternionArray a to the stream.");
+
+static PyObject *
+quaternion_array_writer_write(PyQuaternionArrayWriterObject* self, PyObject *arg)
+{
+   if (!writer_write_array (self, arg))
+      return NULL;
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_writer_writelines_doc,
+             "writelines(self, arrays, /)\n"
+             "Append the items of each QuaternionArray in the iterable arrays to the stream.");
+
+static PyObject *
+quaternion_array_writer_writelines(PyQuaternionArrayWriterObject* self, PyObject *arg)
+{
+   PyObject* iterator;
+   PyObject* item;
+
+   iterator = PyObject_GetIter(arg);
+   if (!iterator)
+      return NULL;
+
+   while ((item = PyIter_Next(iterator))) {
+      const bool status = writer_write_array (self, item);
+      Py_DECREF(item);
+      if (!status) {
+         Py_DECREF(iterator);
+         return NULL;
+      }
+   }
+   Py_DECREF(iterator);
+
+   if (PyErr_Occurred())
+      return NULL;
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_writer_flush_doc,
+             "flush(self, /)\n"
+             "Flush the file.");
+
+static PyObject *
+quaternion_array_writer_flush(PyQuaternionArrayWriterObject* self, PyObject *noargs)
+{
+   if (!self->file) {
+      PyErr_SetString(PyExc_ValueError, "I/O operation on closed QuaternionArrayWriter");
+      return NULL;
+   }
+   return PyObject_CallMethod(self->file, "flush", NULL);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_writer_close_doc,
+             "close(self, /)\n"
+             "Record the number of items in the header (if the file is seekable), and close\n"
+             "the stream, and the file if it was opened by the writer.");
+
+static PyObject *
+quaternion_array_writer_close(PyQuaternionArrayWriterObject* self, PyObject *noargs)
+{
+   if (writer_finish (self) < 0)
+      return NULL;
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+quaternion_array_writer_enter(PyObject* self, PyObject *noargs)
+{
+   Py_INCREF(self);
+   return self;
+}
+
+static PyObject *
+quaternion_array_writer_exit(PyQuaternionArrayWriterObject* self, PyObject *args)
+{
+   if (writer_finish (self) < 0)
+      return NULL;
+   Py_RETURN_FALSE;
+}
+
+/* -----------------------------------------------------------------------------
+ * Attributes
+ */
+static PyObject *
+quaternion_array_writer_get_count(PyQuaternionArrayWriterObject* self, void *closure)
+{
+   return PyLong_FromSsize_t(self->count);
+}
+
+static PyObject *
+quaternion_array_writer_get_layout(PyQuaternionArrayWriterObject* self, void *closure)
+{
+   return PyUnicode_FromString(PyQuaternionArrayLayoutName (self->layout));
+}
+
+static PyObject *
+quaternion_array_writer_get_encoding(PyQuaternionArrayWriterObject* self, void *closure)
+{
+   return PyUnicode_FromString(_Py_quat_encoding_name (self->encoding));
+}
+
+static PyObject *
+quaternion_array_writer_get_closed(PyQuaternionArrayWriterObject* self, void *closure)
+{
+   return PyBool_FromLong(self->file == NULL);
+}
+
+static PyGetSetDef quaternion_array_writer_getset[] = {
+   {"count",  (getter)quaternion_array_writer_get_count,  NULL,
+    "number of items written so far", NULL},
+   {"layout", (getter)quaternion_array_writer_get_layout, NULL,
+    "layout recorded in the stream header", NULL},
+   {"encoding", (getter)quaternion_array_writer_get_encoding, NULL,
+    "encoding of the written items", NULL},
+   {"closed", (getter)quaternion_array_writer_get_closed, NULL,
+    "True if the stream is closed", NULL},
+   {NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef quaternion_array_writer_methods[] = {
+   {"write",      (PyCFunction)quaternion_array_writer_write,      METH_O,
+                                                        quaternion_array_writer_write_doc      },
+   {"writelines", (PyCFunction)quaternion_array_writer_writelines, METH_O,
+                                                        quaternion_array_writer_writelines_doc },
+   {"flush",      (PyCFunction)quaternion_array_writer_flush,      METH_NOARGS,
+                                                        quaternion_array_writer_flush_doc      },
+   {"close",      (PyCFunction)quaternion_array_writer_close,      METH_NOARGS,
+                                                        quaternion_array_writer_close_doc      },
+   {"__enter__",  (PyCFunction)quaternion_array_writer_enter,      METH_NOARGS,  NULL },
+   {"__exit__",   (PyCFunction)quaternion_array_writer_exit,       METH_VARARGS, NULL },
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_array_writer_doc,
+             "QuaternionArrayWriter(file, layout='aos')\n"
+             "Writes a quaternion array stream, as read by QuaternionArrayReader.\n"
+             "\n"
+             "file is a path, or a binary file object that provides write(). A header,\n"
+             "recording the byte order and layout, is written first. The items of 'aos'\n"
+             "arrays are written directly from the array's buffer. When the file is\n"
+             "seekable, the number of items is recorded in the header on close(),\n"
+             "otherwise the reader reads until the end of the file.");
+
+static PyTypeObject QuaternionArrayWriterType = {
+   PyVarObject_HEAD_INIT(NULL, 0)
+   "quaternion.QuaternionArrayWriter",          /* tp_name */
+   sizeof(PyQuaternionArrayWriterObject),       /* tp_basicsize */
+   0,                                           /* tp_itemsize */
+   (destructor)quaternion_array_writer_dealloc, /* tp_dealloc */
+   0,                                           /* tp_print */
+   0,                                           /* tp_getattr */
+   0,                                           /* tp_setattr */
+   0,                                           /* tp_reserved / tp_as_async */
+   (reprfunc)0,                                 /* tp_repr */
+   0,                                           /* tp_as_number */
+   0,                                           /* tp_as_sequence */
+   0,                                           /* tp_as_mapping */
+   (hashfunc)0,                                 /* tp_hash */
+   0,                                           /* tp_call */
+   (reprfunc)0,                                 /* tp_str */
+   (getattrofunc)0,                             /* tp_getattro */
+   0,                                           /* tp_setattro */
+   0,                                           /* tp_as_buffer */
+   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,    /* tp_flags */
+   quaternion_array_writer_doc,                 /* tp_doc */
+   0,                                           /* tp_traverse */
+   0,                                           /* tp_clear */
+   0,                                           /* tp_richcompare */
+   0,                                           /* tp_weaklistoffset */
+   0,                                           /* tp_iter */
+   0,                                           /* tp_iternext */
+   quaternion_array_writer_methods,             /* tp_methods */
+   0,                                           /* tp_members */
+   quaternion_array_writer_getset,              /* tp_getset */
+   0,                                           /* tp_base */
+   0,                                           /* tp_dict */
+   0,                                           /* tp_descr_get */
+   0,                                           /* tp_descr_set */
+   0,                                           /* tp_dictoffset */
+   0,                                           /* tp_init */
+   (allocfunc)PyType_GenericAlloc,              /* tp_alloc */
+   (newfunc)quaternion_array_writer_new,        /* tp_new */
+   PyObject_Del                                 /* tp_free */
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Allow module definiton code to access the reader and writer PyTypeObjects.
+ */
+PyTypeObject* PyQuaternionArrayReaderType()
+{
+   return &QuaternionArrayReaderType;
+}
+
+PyTypeObject* PyQuaternionArrayWriterType()
+{
+   return &QuaternionArrayWriterType;
+}
+
+/* end */
@@ -0,0 +1,82 @@
+/* quaternion_array_stream.h
+ *
+ * This file is part of the Python quaternion module. It provides the
+ * QuaternionArrayReader and QuaternionArrayWriter types, which stream
+ * QuaternionArray items to and from files in fixed size chunks.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#ifndef QUATERNION_ARRAY_STREAM_H
+#define QUATERNION_ARRAY_STREAM_H 1
+
+#include <Python.h>
+#include <stdbool.h>
+#include "quaternion_array.h"
+
+/* The stream file header size in bytes - the items that follow the header are
+ * as per tofile(), so the items start at a multiple of the item size.
+ */
+#define QUAT_STREAM_HEADER_SIZE  32
+
+/* -----------------------------------------------------------------------------
+ */
+typedef struct {
+   PyObject_HEAD
+   /* Type-specific fields go here. */
+   PyObject* file;                    /* binary file object, NULL once closed */
+   bool owned;                        /* the file was opened by us */
+   bool swap;                         /* the items are in the other byte order */
+   char byteorder;                    /* '<' little or '>' big endian */
+   int version;                       /* header format version */
+   Py_quaternion_layout layout;       /* the layout of the returned chunks */
+   Py_ssize_t chunk;                  /* the number of items per chunk */
+   Py_ssize_t count;                  /* the number of items, -1 if unknown */
+   Py_ssize_t position;               /* the number of items read so far */
+   PyObject* current;                 /* the last chunk, reused where possible */
+   PyObject* previous;                /* the chunk before that, likewise */
+   Py_quaternion* scratch;            /* staging buffer for 'soa' chunks */
+   Py_quat_encoding encoding;         /* the stream item encoding */
+   unsigned char* raw;                /* staging buffer for encoded items */
+} PyQuaternionArrayReaderObject;
+
+/* -----------------------------------------------------------------------------
+ */
+typedef struct {
+   PyObject_HEAD
+   /* Type-specific fields go here. */
+   PyObject* file;                    /* binary file object, NULL once closed */
+   bool owned;                        /* the file was opened by us */
+   Py_quaternion_layout layout;       /* the layout recorded in the header */
+   Py_quat_encoding encoding;         /* the item encoding recorded in the header */
+   Py_ssize_t count;                  /* the number of items written so far */
+   Py_ssize_t headerOffset;           /* file position of the header, -1 if not seekable */
+} PyQuaternionArrayWriterObject;
+
+
+/* Used by module setup
+ */
+PyAPI_FUNC (PyTypeObject*) PyQuaternionArrayReaderType ();
+PyAPI_FUNC (PyTypeObject*) PyQuaternionArrayWriterType ();
+
+#endif  /* QUATERNION_ARRAY_STREAM_H */
@@ -31,6 +31,9 @@
 #include <stdarg.h>
 #include <Python.h>
 #include <complex.h>
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
 
 static const char* red   = "\033[31;1m";
 static const char* green = "\033[32;1m";
@@ -330,6 +333,164 @@ char * _Py_quat_to_string2 (const int size,
 }
 
 
+/* -----------------------------------------------------------------------------
+ * A valid quaternion string usually takes one of these forms:
+ *
+ *    <float><signed-float>i<signed-float>j<signed-float>k
+ *    <float><signed-float>i<signed-float>j
+ *    <float><signed-float>i<signed-float>k
+ *    <float><signed-float>j<signed-float>k
+ *    <float><signed-float>i
+ *    <float><signed-float>j
+ *    <float><signed-float>k
+ *    <float>
+ *
+ *    <float>i<signed-float>j<signed-float>k
+ *    <float>i<signed-float>j
+ *    <float>i<signed-float>k
+ *    <float>j<signed-float>k
+ *
+ *    <float>i
+ *    <float>j
+ *    <float>k
+ *
+ * where <float> represents any numeric string that's accepted by the
+ * float constructor (including 'nan', 'inf', 'infinity', etc.), and
+ * <signed-float> is any string of the form <float> whose first
+ * character is '+' or '-'.
+ *
+ * i, j and k may be 'i', 'j', 'k' and/or 'I', 'J', 'K'
+ * any real, i, j, k components may be ommitted, but must always be in order.
+ *
+ * Leading/trailing spaces allowed
+ * Leading/trailing "(" and ")" allowed.
+ *
+ * This mirrors the complex type behaviour.
+ *
+ * Only the len characters from s are interpreted, however the string must be
+ * terminated (by a null or otherwise) somewhere at or after s + len.
+ */
+bool _Py_quat_from_string (const char* s, const size_t len, Py_quaternion* result)
+{
+   const char *last = s + len;
+   double r=0.0, x=0.0, y=0.0, z=0.0;
+   double dval;
+   int got_bracket=0;
+   char *end;
+   int e;
+   int allowed;
+   int at_least_one;
+
+   /* position on first non-blank */
+   while (s < last && Py_ISSPACE(*s))
+      s++;
+
+   if (s < last && *s == '(') {
+      /* Skip over possible bracket from repr(). */
+      got_bracket = 1;
+      s++;
+      while (s < last && Py_ISSPACE(*s))
+         s++;
+   }
+
+   allowed = 1;
+   at_least_one = 0;
+   for (e = 0; e < 4; e++) {
+
+      if (s >= last) {
+         return false;
+      }
+
+      /* first look for forms starting with <float> */
+      dval = PyOS_string_to_double(s, &end, NULL);
+      if (dval == -1.0 && PyErr_Occurred()) {
+         if (PyErr_ExceptionMatches(PyExc_ValueError))
+            PyErr_Clear();
+         else
+            return false;
+      }
+
+      if (end == s || end > last) {
+         /* We did not read a float, or it runs beyond the string */
+         return false;
+      }
+
+      s = end;   /* skip to end of the float */
+
+      if ((allowed <= 1) && (s == last ||
+          ((*s != 'i')  && (*s != 'I')  &&
+           (*s != 'j')  && (*s != 'J')  &&
+           (*s != 'k')  && (*s != 'K')))) {
+         r = dval;
+         at_least_one = 1;
+         allowed = 2;
+      } else if (s == last) {
+         return false;
+      } else if ((allowed <= 2) && (*s == 'i' || *s == 'I')) {
+         s++;
+         x = dval;
+         at_least_one = 1;
+         allowed = 3;
+      } else if ((allowed <= 3) && (*s == 'j' || *s == 'J')) {
+         s++;
+         y = dval;
+         at_least_one = 1;
+         allowed = 4;
+      } else if ((allowed <= 4) && (*s == 'k' || *s == 'K')) {
+         s++;
+         z = dval;
+         at_least_one = 1;
+         allowed = 5;
+      } else {
+         return false;
+      }
+
+      if (s == last) {
+         break;
+      }
+
+      if (Py_ISSPACE(*s) || (*s == ')')) {
+         break;
+      }
+
+      if ((allowed <= 5) && (*s == '+' || *s == '-')) {
+         /* okay */
+      } else {
+         return false;
+      }
+   }
+
+   /* dissallow empty string */
+   if (!at_least_one)
+      return false;
+
+   /* trailing whitespace and closing bracket */
+   while (s < last && Py_ISSPACE(*s))
+      s++;
+
+   if (got_bracket) {
+      /* if there was an opening parenthesis, then the corresponding
+          closing parenthesis should be right here */
+      if (s == last || *s != ')')
+         return false;
+      s++;
+      while (s < last && Py_ISSPACE(*s))
+         s++;
+   }
+
+   /* we should now be at the end of the string */
+   if (s != last) {
+      return false;
+   }
+
+   result->w = r;
+   result->x = x;
+   result->y = y;
+   result->z = z;
+   return true;
+}
+
+
 /* -----------------------------------------------------------------------------
  *  true if all parts finite
  */
@@ -468,6 +629,72 @@ Py_quaternion _Py_quat_quot (const Py_quaternion a, const Py_quaternion b)
    return r;
 }
 
+/* -----------------------------------------------------------------------------
+ * Real operand forms of the above, i.e. where one operand has no imaginary parts.
+ * Returns: a + b
+ */
+Py_quaternion _Py_quat_sum_real (const Py_quaternion a, const double b)
+{
+   Py_quaternion r = a;
+   r.w = a.w + b;
+   return r;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns: a - b
+ */
+Py_quaternion _Py_quat_diff_real (const Py_quaternion a, const double b)
+{
+   Py_quaternion r = a;
+   r.w = a.w - b;
+   return r;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns: a - b, where a is real
+ */
+Py_quaternion _Py_quat_real_diff (const double a, const Py_quaternion b)
+{
+   Py_quaternion r;
+   r.w = a - b.w;
+   r.x = - b.x;
+   r.y = - b.y;
+   r.z = - b.z;
+   return r;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns: a * b, which for a real b does commute.
+ */
+Py_quaternion _Py_quat_prod_real (const Py_quaternion a, const double b)
+{
+   Py_quaternion r;
+   r.w = a.w * b;
+   r.x = a.x * b;
+   r.y = a.y * b;
+   r.z = a.z * b;
+   return r;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns: a / b, sets errno to EDOM if b is zero.
+ */
+Py_quaternion _Py_quat_quot_real (const Py_quaternion a, const double b)
+{
+   Py_quaternion r;
+
+   if (b == 0.0) {
+      errno = EDOM;
+      r.w = r.x = r.y = r.z = 0.0;
+   } else {
+      r.w = a.w / b;
+      r.x = a.x / b;
+      r.y = a.y / b;
+      r.z = a.z / b;
+   }
+   return r;
+}
+
 /* -----------------------------------------------------------------------------
  * Returns: -a
  */
@@ -768,6 +995,35 @@ double _Py_quat_dot_prod (const Py_quaternion a, const Py_quaternion b)
 }
 
 
+/* -----------------------------------------------------------------------------
+ * Returns: true if a and b are close as per math.isclose, i.e. the difference is
+ * within rel_tol of the larger magnitude, or within abs_tol.
+ * The tolerances are assumed to be non-negative.
+ */
+bool _Py_quat_isclose (const Py_quaternion a, const Py_quaternion b,
+                       const double rel_tol, const double abs_tol)
+{
+   double diff;
+
+   /* Short circuit exact equality - needed to catch two infinities of
+    * the same sign. And perhaps speeds things up a bit sometimes.
+    */
+   if (_Py_quat_eq (a, b))
+      return true;
+
+   /* This catches the case of two infinities of opposite sign, or
+    * one infinity and one finite number. Two infinities of opposite
+    * sign would otherwise have an infinite relative tolerance.
+    */
+   if (_Py_quat_isinf (a) || _Py_quat_isinf (b))
+      return false;
+
+   diff = _Py_quat_abs (_Py_quat_diff (a, b));
+   return (diff <= rel_tol * _Py_quat_abs (a)) ||
+          (diff <= rel_tol * _Py_quat_abs (b)) ||
+          (diff <= abs_tol);
+}
+
 /* -----------------------------------------------------------------------------
  * Returns: linear interpolation between two quaternions - simple
  */
@@ -862,6 +1118,40 @@ Py_quaternion _Py_quat_slerp (const Py_quaternion a_in, const Py_quaternion b, c
    return r;
 }
 
+/* -----------------------------------------------------------------------------
+ * Returns: spherical linear interpolation between two unit quaternions.
+ * As per _Py_quat_slerp, but as |a| = |b| = 1, cos(theta) is just the dot product.
+ */
+Py_quaternion _Py_quat_unit_slerp (const Py_quaternion a_in, const Py_quaternion b,
+                                   const double t)
+{
+   Py_quaternion r;
+   Py_quaternion a = a_in;
+   double sa = 1.0 - t;
+   double sb = t;
+   double cos_theta = _Py_quat_dot_prod (a, b);
+
+   if (cos_theta < 0.0) {
+      cos_theta = -cos_theta;
+      a = _Py_quat_neg (a);
+   }
+
+   if (cos_theta < 0.99996) {
+      double theta = acos (cos_theta);
+      double sin_theta = sin (theta);
+
+      sa = sin(sa * theta) / sin_theta;
+      sb = sin(sb * theta) / sin_theta;
+   }
+
+   r.w = sa*a.w + sb*b.w;
+   r.x = sa*a.x + sb*b.x;
+   r.y = sa*a.y + sb*b.y;
+   r.z = sa*a.z + sb*b.z;
+
+   return r;
+}
+
 
 /* -----------------------------------------------------------------------------
  * Returns: rotation quaternion value
@@ -930,6 +1220,52 @@ void _Py_quat_to_rotation_matrix (const Py_quaternion a,
    matrix->r33 = 2 * (a.w * a.w + a.z * a.z) - 1.0;
 }
 
+/* -----------------------------------------------------------------------------
+ * As _Py_quat_to_rotation_matrix, but does not assume |a| = 1. The matrix is that
+ * of the product a * p * a^, i.e. a rotation scaled by |a|**2, so that applying
+ * it to a point replicates _Py_quat_rotate.
+ */
+void _Py_quat_to_scaled_rotation_matrix (const Py_quaternion a,
+                                         Py_quat_matrix* matrix)
+{
+   const double ww = a.w * a.w;
+   const double xx = a.x * a.x;
+   const double yy = a.y * a.y;
+   const double zz = a.z * a.z;
+
+   matrix->r11 = ww + xx - yy - zz;
+   matrix->r12 = 2 * (a.x * a.y - a.w * a.z);
+   matrix->r13 = 2 * (a.x * a.z + a.w * a.y);
+
+   matrix->r21 = 2 * (a.x * a.y + a.w * a.z);
+   matrix->r22 = ww - xx + yy - zz;
+   matrix->r23 = 2 * (a.y * a.z - a.w * a.x);
+
+   matrix->r31 = 2 * (a.x * a.z - a.w * a.y);
+   matrix->r32 = 2 * (a.y * a.z + a.w * a.x);
+   matrix->r33 = ww - xx - yy + zz;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns: 3-tuple representing the point rotated about origin by the matrix,
+ * i.e. origin + matrix . (point - origin)
+ */
+Py_quat_triple _Py_quat_matrix_rotate (const Py_quat_matrix* matrix,
+                                       const Py_quat_triple point,
+                                       const Py_quat_triple origin)
+{
+   Py_quat_triple r;
+   const double px = point.x - origin.x;
+   const double py = point.y - origin.y;
+   const double pz = point.z - origin.z;
+
+   r.x = (matrix->r11 * px) + (matrix->r12 * py) + (matrix->r13 * pz) + origin.x;
+   r.y = (matrix->r21 * px) + (matrix->r22 * py) + (matrix->r23 * pz) + origin.y;
+   r.z = (matrix->r31 * px) + (matrix->r32 * py) + (matrix->r33 * pz) + origin.z;
+
+   return r;
+}
+
 /* -----------------------------------------------------------------------------
  * Composes a quaternion from a 3D rotation matrix
  * Based on:
@@ -985,6 +1321,195 @@ Py_quaternion _Py_quat_from_rotation_matrix (const Py_quat_matrix* matrix)
    return r;
 }
 
+/* -----------------------------------------------------------------------------
+ * Returns: angle wrapped into the range -pi to +pi
+ */
+static double wrap_angle (const double angle)
+{
+   double r = angle;
+   if (r > Py_MATH_PI) r -= 2.0 * Py_MATH_PI;
+   if (r < -Py_MATH_PI) r += 2.0 * Py_MATH_PI;
+   return r;
+}
+
+/* -----------------------------------------------------------------------------
+ * Based on:
+ * Bernardes E, Viollet S (2022) Quaternion to Euler angles conversion: A direct,
+ * general and computationally efficient method. PLoS ONE 17(11): e0276302.
+ *
+ * The method is expressed in terms of extrinsic rotations, so is applied with
+ * the axes, and hence the angles, reversed. Both proper Euler (e.g. zxz) and
+ * Tait-Bryan (e.g. zyx) sequences are handled. At gimbal lock, the last angle
+ * is set to zero.
+ */
+void _Py_quat_to_euler (const Py_quaternion a, const int axes [3], double angles [3])
+{
+   const double q [3] = { a.x, a.y, a.z };
+   const int i = axes [2];
+   const int j = axes [1];
+   int k = axes [0];
+   bool symmetric;
+   int sign;
+   double ea, eb, ec, ed;
+   double first, middle, last;
+   double halfSum, halfDiff;
+
+   symmetric = (i == k);
+   if (symmetric) k = 3 - i - j;
+   sign = (i - j) * (j - k) * (k - i) / 2;
+
+   if (symmetric) {
+      ea = a.w;
+      eb = q [i];
+      ec = q [j];
+      ed = q [k] * sign;
+   } else {
+      ea = a.w - q [j];
+      eb = q [i] + q [k] * sign;
+      ec = q [j] + a.w;
+      ed = q [k] * sign - q [i];
+   }
+
+   middle = 2.0 * atan2 (hypot (ec, ed), hypot (ea, eb));
+   halfSum = atan2 (eb, ea);
+   halfDiff = atan2 (ed, ec);
+
+   if (fabs (middle) <= 1.0e-7) {
+      first = 0.0;
+      last = 2.0 * halfSum;
+   } else if (fabs (middle - Py_MATH_PI) <= 1.0e-7) {
+      first = 0.0;
+      last = 2.0 * halfDiff;
+   } else {
+      first = halfSum - halfDiff;
+      last = halfSum + halfDiff;
+   }
+
+   if (!symmetric) {
+      last *= sign;
+      middle -= Py_MATH_PI / 2.0;
+   }
+
+   angles [0] = wrap_angle (last);
+   angles [1] = wrap_angle (middle);
+   angles [2] = wrap_angle (first);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+Py_quaternion _Py_quat_from_euler (const double angles [3], const int axes [3])
+{
+   Py_quaternion r;
+   int n;
+
+   r.w = 1.0;
+   r.x = r.y = r.z = 0.0;
+
+   for (n = 0; n < 3; n++) {
+      Py_quaternion e;
+      double v [3] = { 0.0, 0.0, 0.0 };
+
+      v [axes [n]] = sin (angles [n] / 2.0);
+      e.w = cos (angles [n] / 2.0);
+      e.x = v [0];
+      e.y = v [1];
+      e.z = v [2];
+      r = _Py_quat_prod (r, e);
+   }
+
+   return r;
+}
+
+/* -----------------------------------------------------------------------------
+ * Uses cyclic Jacobi rotations, which are robust and for a 4x4 matrix converge
+ * in a handful of sweeps. Used for the Markley rotation average, for which m is
+ * the (weighted) sum of the outer products q.qT.
+ */
+Py_quaternion _Py_quat_principal_eigenvector (const double m [4][4])
+{
+   Py_quaternion result;
+   double a [4][4];
+   double v [4][4];
+   double e [4];
+   int sweep;
+   int best;
+   int i, j, k;
+
+   for (i = 0; i < 4; i++) {
+      for (j = 0; j < 4; j++) {
+         a [i][j] = m [i][j];
+         v [i][j] = (i == j) ? 1.0 : 0.0;
+      }
+   }
+
+   for (sweep = 0; sweep < 50; sweep++) {
+      double off = 0.0;
+      double all = 0.0;
+
+      for (i = 0; i < 4; i++) {
+         for (j = 0; j < 4; j++) {
+            all += a [i][j] * a [i][j];
+            if (i != j) off += a [i][j] * a [i][j];
+         }
+      }
+      if (off <= DBL_EPSILON * DBL_EPSILON * all) break;
+
+      for (i = 0; i < 3; i++) {
+         for (j = i + 1; j < 4; j++) {
+            double theta, t, c, s;
+
+            if (a [i][j] == 0.0) continue;
+
+            /* Choose the rotation that zeros a[i][j], using the smaller angle.
+             */
+            theta = (a [j][j] - a [i][i]) / (2.0 * a [i][j]);
+            t = 1.0 / (fabs (theta) + sqrt (theta * theta + 1.0));
+            if (theta < 0.0) t = -t;
+            c = 1.0 / sqrt (t * t + 1.0);
+            s = t * c;
+
+            for (k = 0; k < 4; k++) {
+               double aki = a [k][i];
+               double akj = a [k][j];
+               a [k][i] = c * aki - s * akj;
+               a [k][j] = s * aki + c * akj;
+            }
+            for (k = 0; k < 4; k++) {
+               double aik = a [i][k];
+               double ajk = a [j][k];
+               a [i][k] = c * aik - s * ajk;
+               a [j][k] = s * aik + c * ajk;
+            }
+            for (k = 0; k < 4; k++) {
+               double vki = v [k][i];
+               double vkj = v [k][j];
+               v [k][i] = c * vki - s * vkj;
+               v [k][j] = s * vki + c * vkj;
+            }
+         }
+      }
+   }
+
+   best = 0;
+   for (i = 0; i < 4; i++) {
+      e [i] = a [i][i];
+      if (e [i] > e [best]) best = i;
+   }
+
+   result.w = v [0][best];
+   result.x = v [1][best];
+   result.y = v [2][best];
+   result.z = v [3][best];
+
+   /* q and -q represent the same rotation, prefer the non-negative real part.
+    */
+   if (result.w < 0.0) {
+      result = _Py_quat_neg (result);
+   }
+
+   return _Py_quat_normalise (result);
+}
+
 
 /* -----------------------------------------------------------------------------
  * Returns: 3-tuple representing rotation of point about origin
@@ -1019,6 +1544,39 @@ Py_quat_triple _Py_quat_rotate (const Py_quaternion a,
    return r;
 }
 
+/* -----------------------------------------------------------------------------
+ * Returns: 3-tuple representing rotation of point about origin by the unit
+ * quaternion a. This avoids the two full products of _Py_quat_rotate using:
+ *
+ *    t = 2 (v x p)
+ *    r = p + w.t + v x t
+ *
+ * where v is the imaginary part of a. Note: if a is not a unit quaternion, the
+ * result is not the same as _Py_quat_rotate, which also scales by |a|**2.
+ */
+Py_quat_triple _Py_quat_unit_rotate (const Py_quaternion a,
+                                     const Py_quat_triple point,
+                                     const Py_quat_triple origin)
+{
+   Py_quat_triple r;
+   double px, py, pz;
+   double tx, ty, tz;
+
+   px = point.x - origin.x;
+   py = point.y - origin.y;
+   pz = point.z - origin.z;
+
+   tx = 2.0 * ((a.y * pz) - (a.z * py));
+   ty = 2.0 * ((a.z * px) - (a.x * pz));
+   tz = 2.0 * ((a.x * py) - (a.y * px));
+
+   r.x = px + (a.w * tx) + ((a.y * tz) - (a.z * ty)) + origin.x;
+   r.y = py + (a.w * ty) + ((a.z * tx) - (a.x * tz)) + origin.y;
+   r.z = pz + (a.w * tz) + ((a.x * ty) - (a.y * tx)) + origin.z;
+
+   return r;
+}
+
 /* -----------------------------------------------------------------------------
  * Decomposes a quaternion into its polar format
  * a  ->  m * (cos(angle) + unit.sin(angle))
@@ -1234,6 +1792,413 @@ Py_quaternion _Py_quat_atanh (const Py_quaternion a)
    return use_complex_func (a, catanh);
 }
 
+/* -----------------------------------------------------------------------------
+ * BULK FUNCTIONS
+ * -----------------------------------------------------------------------------
+ * These apply the basic binary operations item by item, i.e.
+ *    r[j] = a[j*sa] op b[j*sb]    for j = 0 .. n-1
+ * A stride of 0 applies a single quaternion to every item of the other operand.
+ * The result may be the same array as a and/or b.
+ */
+void _Py_quat_array_sum (const Py_quaternion* a, const size_t sa,
+                         const Py_quaternion* b, const size_t sb,
+                         Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_sum (a[j*sa], b[j*sb]);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_array_diff (const Py_quaternion* a, const size_t sa,
+                          const Py_quaternion* b, const size_t sb,
+                          Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_diff (a[j*sa], b[j*sb]);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_array_prod (const Py_quaternion* a, const size_t sa,
+                          const Py_quaternion* b, const size_t sb,
+                          Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_prod (a[j*sa], b[j*sb]);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Note: errno is set to EDOM if any b item is zero, and the corresponding
+ * result item is set to zero. The remaining items are still calculated.
+ */
+void _Py_quat_array_quot (const Py_quaternion* a, const size_t sa,
+                          const Py_quaternion* b, const size_t sb,
+                          Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_quot (a[j*sa], b[j*sb]);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Real operand forms of the above: r[j] = a[j] op b
+ * These are written out in full, rather than calling _Py_quat_sum_real etc.,
+ * so that the compiler can vectorise the loops. The operations are the same, so
+ * the results are identical.
+ */
+void _Py_quat_array_sum_real (const Py_quaternion* a, const double b,
+                              Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j].w = a[j].w + b;
+      r[j].x = a[j].x;
+      r[j].y = a[j].y;
+      r[j].z = a[j].z;
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_array_diff_real (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j].w = a[j].w - b;
+      r[j].x = a[j].x;
+      r[j].y = a[j].y;
+      r[j].z = a[j].z;
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Note: r[j] = b - a[j]
+ */
+void _Py_quat_array_real_diff (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j].w = b - a[j].w;
+      r[j].x = - a[j].x;
+      r[j].y = - a[j].y;
+      r[j].z = - a[j].z;
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_array_prod_real (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j].w = a[j].w * b;
+      r[j].x = a[j].x * b;
+      r[j].y = a[j].y * b;
+      r[j].z = a[j].z * b;
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Note: errno is set to EDOM if b is zero, and all result items are set to zero.
+ */
+void _Py_quat_array_quot_real (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n)
+{
+   size_t j;
+
+   if (b == 0.0) {
+      errno = EDOM;
+      for (j = 0; j < n; j++) {
+         r[j].w = r[j].x = r[j].y = r[j].z = 0.0;
+      }
+      return;
+   }
+
+   for (j = 0; j < n; j++) {
+      r[j].w = a[j].w / b;
+      r[j].x = a[j].x / b;
+      r[j].y = a[j].y / b;
+      r[j].z = a[j].z / b;
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Normalises n items, r[j] = normalise (a[j]). As per _Py_quat_normalise, zero
+ * items remain zero. The result may be the same array as a.
+ */
+void _Py_quat_array_normalise (const Py_quaternion* a, Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_normalise (a[j]);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns: a scaled by one Newton step towards unit magnitude, i.e. by
+ * (3 - |a|**2) / 2. There is no square root or division, and the remaining
+ * magnitude error is roughly the square of the original, so this is only suitable
+ * for items already close to unit magnitude, e.g. after composing rotations.
+ */
+Py_quaternion _Py_quat_renormalise (const Py_quaternion a)
+{
+   const double s = 0.5 * (3.0 - _Py_quat_quadrance (a));
+   return _Py_quat_prod_real (a, s);
+}
+
+/* -----------------------------------------------------------------------------
+ * Renormalises n items, r[j] = renormalise (a[j]). The result may be the same
+ * array as a.
+ */
+void _Py_quat_array_renormalise (const Py_quaternion* a, Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_renormalise (a[j]);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Rotates n points about origin, i.e. r[j] = rotate (a[j*sa], points[j], origin)
+ * The result may be the same array as points.
+ */
+void _Py_quat_array_rotate (const Py_quaternion* a, const size_t sa,
+                            const Py_quat_triple* points,
+                            Py_quat_triple* r, const size_t n,
+                            const Py_quat_triple origin)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_rotate (a[j*sa], points[j], origin);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Rotates n points about origin using the one matrix, i.e.
+ * r[j] = matrix_rotate (matrix, points[j], origin). The result may be the same
+ * array as points.
+ */
+void _Py_quat_array_matrix_rotate (const Py_quat_matrix* matrix,
+                                   const Py_quat_triple* points,
+                                   Py_quat_triple* r, const size_t n,
+                                   const Py_quat_triple origin)
+{
+   const Py_quat_matrix m = *matrix;
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_matrix_rotate (&m, points[j], origin);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * As _Py_quat_array_rotate, but using _Py_quat_unit_rotate.
+ */
+void _Py_quat_array_unit_rotate (const Py_quaternion* a, const size_t sa,
+                                 const Py_quat_triple* points,
+                                 Py_quat_triple* r, const size_t n,
+                                 const Py_quat_triple origin)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      r[j] = _Py_quat_unit_rotate (a[j*sa], points[j], origin);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Compact encodings
+ * -----------------------------------------------------------------------------
+ */
+size_t _Py_quat_encoded_size (const Py_quat_encoding encoding)
+{
+   switch (encoding) {
+      case QUAT_ENCODING_F4: return 4 * sizeof (float);
+      case QUAT_ENCODING_U8: return 8;
+      case QUAT_ENCODING_U6: return 6;
+      default:               return sizeof (Py_quaternion);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+const char* _Py_quat_encoding_name (const Py_quat_encoding encoding)
+{
+   switch (encoding) {
+      case QUAT_ENCODING_F4: return "f4";
+      case QUAT_ENCODING_U8: return "u8";
+      case QUAT_ENCODING_U6: return "u6";
+      default:               return "f8";
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * The smallest three components of a unit quaternion are in the range
+ * -1/sqrt(2) to +1/sqrt(2), each is scaled to the range 0 to 2^bits - 1.
+ * Returns false if a is zero or not finite, in which case the identity rotation
+ * is encoded.
+ */
+static bool
+smallest_three_encode (const Py_quaternion a, const int bits, uint64_t* packed)
+{
+   const double scale = (double) ((1u << bits) - 1);
+   const double norm = _Py_quat_abs (a);
+   double c [4] = { a.w, a.x, a.y, a.z };
+   uint64_t result;
+   int largest;
+   int shift;
+   int j;
+
+   if (!(norm > 0.0) || !isfinite (norm)) {
+      c[0] = 1.0;
+      c[1] = c[2] = c[3] = 0.0;
+   } else {
+      for (j = 0; j < 4; j++) c[j] /= norm;
+   }
+
+   largest = 0;
+   for (j = 1; j < 4; j++) {
+      if (fabs (c[j]) > fabs (c[largest])) largest = j;
+   }
+
+   result = (uint64_t) largest;
+   shift = 2;
+   for (j = 0; j < 4; j++) {
+      double v;
+      if (j == largest) continue;
+      v = c[largest] < 0.0 ? -c[j] : c[j];
+      v = floor ((v * sqrt (2.0) + 1.0) * 0.5 * scale + 0.5);
+      if (v < 0.0) v = 0.0;
+      if (v > scale) v = scale;
+      result |= ((uint64_t) v) << shift;
+      shift += bits;
+   }
+
+   *packed = result;
+   return norm > 0.0 && isfinite (norm);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static Py_quaternion
+smallest_three_decode (const uint64_t packed, const int bits)
+{
+   const uint64_t mask = (((uint64_t) 1) << bits) - 1;
+   const double scale = (double) mask;
+   const int largest = (int) (packed & 3);
+   double c [4];
+   double sumsq = 0.0;
+   int shift = 2;
+   int j;
+   Py_quaternion result;
+
+   for (j = 0; j < 4; j++) {
+      if (j == largest) continue;
+      c[j] = ((double) ((packed >> shift) & mask) / scale * 2.0 - 1.0) / sqrt (2.0);
+      sumsq += c[j] * c[j];
+      shift += bits;
+   }
+   c[largest] = sumsq < 1.0 ? sqrt (1.0 - sumsq) : 0.0;
+
+   result.w = c[0];
+   result.x = c[1];
+   result.y = c[2];
+   result.z = c[3];
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_array_encode (const Py_quaternion* a, void* r, const size_t n,
+                            const Py_quat_encoding encoding)
+{
+   unsigned char* bytes = (unsigned char*) r;
+   float* floats = (float*) r;
+   int error = 0;
+   size_t j;
+   int k;
+
+   switch (encoding) {
+      case QUAT_ENCODING_F4:
+         for (j = 0; j < n; j++) {
+            floats [4*j + 0] = (float) a[j].w;
+            floats [4*j + 1] = (float) a[j].x;
+            floats [4*j + 2] = (float) a[j].y;
+            floats [4*j + 3] = (float) a[j].z;
+         }
+         break;
+
+      case QUAT_ENCODING_U8:
+      case QUAT_ENCODING_U6: {
+         const int size = encoding == QUAT_ENCODING_U8 ? 8 : 6;
+         const int bits = encoding == QUAT_ENCODING_U8 ? 20 : 15;
+         for (j = 0; j < n; j++) {
+            uint64_t packed;
+            if (!smallest_three_encode (a[j], bits, &packed)) error = EDOM;
+            for (k = 0; k < size; k++) {
+               bytes [size*j + k] = (unsigned char) (packed >> (8*k));
+            }
+         }
+         break;
+      }
+
+      default:
+         memmove (r, a, n * sizeof (Py_quaternion));
+         break;
+   }
+
+   errno = error;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_array_decode (const void* a, Py_quaternion* r, const size_t n,
+                            const Py_quat_encoding encoding)
+{
+   const unsigned char* bytes = (const unsigned char*) a;
+   const float* floats = (const float*) a;
+   size_t j;
+   int k;
+
+   switch (encoding) {
+      case QUAT_ENCODING_F4:
+         for (j = 0; j < n; j++) {
+            r[j].w = floats [4*j + 0];
+            r[j].x = floats [4*j + 1];
+            r[j].y = floats [4*j + 2];
+            r[j].z = floats [4*j + 3];
+         }
+         break;
+
+      case QUAT_ENCODING_U8:
+      case QUAT_ENCODING_U6: {
+         const int size = encoding == QUAT_ENCODING_U8 ? 8 : 6;
+         const int bits = encoding == QUAT_ENCODING_U8 ? 20 : 15;
+         for (j = 0; j < n; j++) {
+            uint64_t packed = 0;
+            for (k = 0; k < size; k++) {
+               packed |= ((uint64_t) bytes [size*j + k]) << (8*k);
+            }
+            r[j] = smallest_three_decode (packed, bits);
+         }
+         break;
+      }
+
+      default:
+         memmove (r, a, n * sizeof (Py_quaternion));
+         break;
+   }
+}
+
 /* -----------------------------------------------------------------------------
  * Debugging helper
  */
@@ -30,6 +30,7 @@
 #define QUATERNION_BASIC_H 1
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -88,6 +89,13 @@ char * _Py_quat_to_string2 (const int size,
                             const char* py,
                             const char* pz);
 
+/* Parses the len characters from s as a quaternion string, e.g. "1+2i-3j+4k",
+   as per Quaternion("..."), but without underscores.
+   Returns true iff successful, otherwise false, with an exception set only if
+   the failure was other than a malformed string, e.g. no memory.
+*/
+bool _Py_quat_from_string (const char* s, const size_t len, Py_quaternion* result);
+
 
 /* Infinities and NaNs
  */
@@ -123,6 +131,13 @@ Py_quaternion _Py_quat_prod (const Py_quaternion a, const Py_quaternion b);
 /* note: division is a * inverse(b) */
 Py_quaternion _Py_quat_quot (const Py_quaternion a, const Py_quaternion b);
 
+/* real operand forms, i.e. just 1 or 4 floating point operations */
+Py_quaternion _Py_quat_sum_real  (const Py_quaternion a, const double b);
+Py_quaternion _Py_quat_diff_real (const Py_quaternion a, const double b);
+Py_quaternion _Py_quat_real_diff (const double a, const Py_quaternion b);
+Py_quaternion _Py_quat_prod_real (const Py_quaternion a, const double b);
+Py_quaternion _Py_quat_quot_real (const Py_quaternion a, const double b);
+
 /* calc a ** b - two special forms */
 Py_quaternion _Py_quat_pow1  (const Py_quaternion a, const double b);
 Py_quaternion _Py_quat_pow2  (const double a, const Py_quaternion b);
@@ -131,11 +146,27 @@ Py_quaternion _Py_quat_pow2  (const double a, const Py_quaternion b);
  */
 double _Py_quat_quadrance (const Py_quaternion a);
 double _Py_quat_dot_prod  (const Py_quaternion a, const Py_quaternion b);
+bool   _Py_quat_isclose   (const Py_quaternion a, const Py_quaternion b,
+                          const double rel_tol, const double abs_tol);
 Py_quaternion _Py_quat_lerp (const Py_quaternion a, const Py_quaternion b, const double t);
 Py_quaternion _Py_quat_slerp (const Py_quaternion a, const Py_quaternion b, const double t);
 
+/* Unit quaternion variants - a and b are assumed to be of unit magnitude, so the
+ * magnitudes need not be calculated. For a unit quaternion, the inverse is just
+ * the conjugate. Renormalise is a cheap correction for items that have drifted
+ * slightly from unit magnitude - use normalise for anything else.
+ */
+Py_quaternion _Py_quat_unit_slerp (const Py_quaternion a, const Py_quaternion b,
+                                   const double t);
+Py_quaternion _Py_quat_renormalise (const Py_quaternion a);
+
 /* Rotation related functions
  */
+/* Returns the unit eigenvector, as a quaternion (w, x, y, z) with w >= 0, for the
+ * largest eigenvalue of the real symmetric 4x4 matrix m.
+ */
+Py_quaternion _Py_quat_principal_eigenvector (const double m [4][4]);
+
 Py_quaternion _Py_quat_calc_rotation (const double angle,
                                       const Py_quat_triple axis);
 
@@ -145,15 +176,40 @@ void _Py_quat_to_rotation_matrix (const Py_quaternion a,
                                   Py_quat_matrix* matrix);
 
 
+/* As above, but without assuming a is a unit quaternion, i.e. the matrix includes
+ * the |a|**2 scaling of a * p * a^, and so replicates _Py_quat_rotate.
+ */
+void _Py_quat_to_scaled_rotation_matrix (const Py_quaternion a,
+                                         Py_quat_matrix* matrix);
+
+/* Returns origin + matrix . (point - origin)
+ */
+Py_quat_triple _Py_quat_matrix_rotate (const Py_quat_matrix* matrix,
+                                       const Py_quat_triple point,
+                                       const Py_quat_triple origin);
+
 /* Create a quaternion from a 3D rotation matrix
  */
 Py_quaternion _Py_quat_from_rotation_matrix (const Py_quat_matrix* matrix);
 
+/* Euler angle conversions - axes are 0, 1 or 2 for x, y and z, and no two
+ * consecutive axes are the same. The rotation is the product of the elementary
+ * rotations, i.e. rotation (angles [0], axes [0]) * ... * rotation (angles [2], axes [2])
+ */
+void _Py_quat_to_euler (const Py_quaternion a, const int axes [3], double angles [3]);
+Py_quaternion _Py_quat_from_euler (const double angles [3], const int axes [3]);
+
 
 Py_quat_triple _Py_quat_rotate (const Py_quaternion a,
                                 const Py_quat_triple point,
                                 const Py_quat_triple origin);
 
+/* As _Py_quat_rotate, for unit quaternion a only - approximately half the flops.
+ */
+Py_quat_triple _Py_quat_unit_rotate (const Py_quaternion a,
+                                     const Py_quat_triple point,
+                                     const Py_quat_triple origin);
+
 /* To/from polar
  * unit is an imaginary unit vector.
  */
@@ -188,6 +244,109 @@ Py_quaternion _Py_quat_asinh (const Py_quaternion a);
 Py_quaternion _Py_quat_acosh (const Py_quaternion a);
 Py_quaternion _Py_quat_atanh (const Py_quaternion a);
 
+/* Bulk functions - these apply the basic binary operations to n items, i.e.
+ * r[j] = a[j*sa] op b[j*sb]. The strides sa and sb are expressed in items,
+ * and a stride of 0 allows a single quaternion to be applied to every item.
+ * The result array r may be the same as a and/or b.
+ */
+void _Py_quat_array_sum  (const Py_quaternion* a, const size_t sa,
+                          const Py_quaternion* b, const size_t sb,
+                          Py_quaternion* r, const size_t n);
+
+void _Py_quat_array_diff (const Py_quaternion* a, const size_t sa,
+                          const Py_quaternion* b, const size_t sb,
+                          Py_quaternion* r, const size_t n);
+
+void _Py_quat_array_prod (const Py_quaternion* a, const size_t sa,
+                          const Py_quaternion* b, const size_t sb,
+                          Py_quaternion* r, const size_t n);
+
+/* sets errno = EDOM if any b item is zero */
+void _Py_quat_array_quot (const Py_quaternion* a, const size_t sa,
+                          const Py_quaternion* b, const size_t sb,
+                          Py_quaternion* r, const size_t n);
+
+/* Real operand bulk functions, i.e. r[j] = a[j] op b, or r[j] = b op a[j] for
+ * _Py_quat_array_real_diff. These give the same results as the corresponding
+ * single item real operand functions.
+ */
+void _Py_quat_array_sum_real  (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n);
+
+void _Py_quat_array_diff_real (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n);
+
+void _Py_quat_array_real_diff (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n);
+
+void _Py_quat_array_prod_real (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n);
+
+/* sets errno = EDOM if b is zero */
+void _Py_quat_array_quot_real (const Py_quaternion* a, const double b,
+                               Py_quaternion* r, const size_t n);
+
+/* normalises n items, r[j] = normalise (a[j]) */
+void _Py_quat_array_normalise (const Py_quaternion* a, Py_quaternion* r, const size_t n);
+
+/* renormalises n items, r[j] = renormalise (a[j]) */
+void _Py_quat_array_renormalise (const Py_quaternion* a, Py_quaternion* r, const size_t n);
+
+/* rotates n points about origin, r[j] = rotate (a[j*sa], points[j], origin) */
+void _Py_quat_array_rotate (const Py_quaternion* a, const size_t sa,
+                            const Py_quat_triple* points,
+                            Py_quat_triple* r, const size_t n,
+                            const Py_quat_triple origin);
+
+/* as above, for unit quaternions, r[j] = unit_rotate (a[j*sa], points[j], origin) */
+void _Py_quat_array_unit_rotate (const Py_quaternion* a, const size_t sa,
+                                 const Py_quat_triple* points,
+                                 Py_quat_triple* r, const size_t n,
+                                 const Py_quat_triple origin);
+
+/* rotates n points about origin, r[j] = matrix_rotate (matrix, points[j], origin) */
+void _Py_quat_array_matrix_rotate (const Py_quat_matrix* matrix,
+                                   const Py_quat_triple* points,
+                                   Py_quat_triple* r, const size_t n,
+                                   const Py_quat_triple origin);
+
+/* Compact item encodings, used to store or transmit quaternions in less than
+ * the native 32 bytes:
+ *
+ *    F8  32 bytes, native doubles, i.e. as Py_quaternion
+ *    F4  16 bytes, native floats
+ *    U8   8 bytes, unit rotation, "smallest three" with 20 bits per component
+ *    U6   6 bytes, unit rotation, "smallest three" with 15 bits per component
+ *
+ * The unit rotation encodings normalise each item, and as q and -q represent the
+ * same rotation, the sign is chosen to make the largest component positive.
+ * The index of the largest component and the other three components, scaled to
+ * the range 0 to 2^bits - 1, are packed into a little endian integer.
+ */
+typedef enum {
+   QUAT_ENCODING_F8 = 0,
+   QUAT_ENCODING_F4,
+   QUAT_ENCODING_U8,
+   QUAT_ENCODING_U6
+} Py_quat_encoding;
+
+/* Returns the encoded size of one item in bytes */
+size_t _Py_quat_encoded_size (const Py_quat_encoding encoding);
+
+/* Returns the encoding name, i.e. "f8", "f4", "u8" or "u6" */
+const char* _Py_quat_encoding_name (const Py_quat_encoding encoding);
+
+/* Encodes n items into r, which must have room for n encoded items.
+ * Sets errno = EDOM if, for a unit rotation encoding, any item is zero or not
+ * finite - such items are encoded as the identity rotation.
+ */
+void _Py_quat_array_encode (const Py_quaternion* a, void* r, const size_t n,
+                            const Py_quat_encoding encoding);
+
+/* Decodes n encoded items from a into r */
+void _Py_quat_array_decode (const void* a, Py_quaternion* r, const size_t n,
+                            const Py_quat_encoding encoding);
+
 /* Some debuging helper functionality
  */
 void _Py_quat_debug_trace(const char* function,
@@ -0,0 +1,156 @@
+/* quaternion_capi.h
+ *
+ * This file is part of the Python quaternion module. It provides the C API
+ * exported, as the quaternion._C_API capsule, for use by other extension
+ * modules, in the same manner as the datetime module's PyDateTime_CAPI.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ *
+ * Usage, from another extension module:
+ *
+ *    #include "quaternion_capi.h"
+ *
+ *    In the module init function:
+ *       if (!PyQuaternion_IMPORT) return NULL;
+ *
+ *    Thereafter, e.g.:
+ *       Py_quaternion_array* aval = PyQuaternionAPI->Array_Acquire (obj, true);
+ *       if (!aval) return NULL;
+ *       if (aval->layout != QA_LAYOUT_AOS) {
+ *          PyQuaternionAPI->Array_Release (obj);
+ *          PyErr_SetString (PyExc_ValueError, "an 'aos' layout array is required");
+ *          return NULL;
+ *       }
+ *       Py_BEGIN_ALLOW_THREADS
+ *       PyQuaternionAPI->Array_Normalise (aval->qvalArray, aval->qvalArray, aval->count);
+ *       Py_END_ALLOW_THREADS
+ *       PyQuaternionAPI->Array_Release (obj);
+ *
+ * Note: the batch kernels operate on 'aos' layout items, i.e. Py_quaternion
+ * arrays; 'soa' layout arrays may be staged using Array_Gather/Array_Scatter.
+ * Apart from Array_Acquire and Array_Release, which need the GIL, the batch
+ * kernels may be called without the GIL, and do not raise exceptions.
+ */
+
+#ifndef QUATERNION_CAPI_H
+#define QUATERNION_CAPI_H 1
+
+#include <Python.h>
+#include <stdbool.h>
+#include "quaternion_array.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The capsule name, and the API version. Functions are only ever added to the
+ * end of PyQuaternion_CAPI, and version is incremented when they are. Callers
+ * should check that version is at least that which they require.
+ */
+#define PyQuaternion_CAPSULE_NAME  "quaternion._C_API"
+#define PyQuaternion_CAPI_VERSION  1
+
+typedef void (*Py_quat_binary_kernel) (const Py_quaternion* a, const size_t sa,
+                                       const Py_quaternion* b, const size_t sb,
+                                       Py_quaternion* r, const size_t n);
+
+typedef void (*Py_quat_normalise_kernel) (const Py_quaternion* a,
+                                          Py_quaternion* r, const size_t n);
+
+typedef void (*Py_quat_rotate_kernel) (const Py_quaternion* a, const size_t sa,
+                                       const Py_quat_triple* points,
+                                       Py_quat_triple* r, const size_t n,
+                                       const Py_quat_triple origin);
+
+typedef struct {
+   int version;                       /* PyQuaternion_CAPI_VERSION */
+   size_t size;                       /* sizeof (PyQuaternion_CAPI) */
+
+   /* Type objects */
+   PyTypeObject* QuaternionType;
+   PyTypeObject* QuaternionArrayType;
+   PyTypeObject* RotatorType;
+
+   /* Quaternion converters - as per quaternion_object.h */
+   PyObject*     (*Quaternion_FromCQuaternion) (const Py_quaternion qval);
+   Py_quaternion (*Quaternion_AsCQuaternion) (PyObject* op);
+   bool          (*Object_AsCQuaternion) (PyObject* obj, Py_quaternion* qval);
+
+   /* QuaternionArray access - as per quaternion_array.h */
+   PyObject*            (*Array_New) (const Py_ssize_t count, const Py_quaternion_layout layout);
+   Py_quaternion_array* (*Array_Acquire) (PyObject* self, const bool writable);
+   void                 (*Array_Release) (PyObject* self);
+   void                 (*Array_Gather) (const Py_quaternion_array* aval, const Py_ssize_t index,
+                                         Py_quaternion* r, const Py_ssize_t n);
+   void                 (*Array_Scatter) (Py_quaternion_array* aval, const Py_ssize_t index,
+                                          const Py_quaternion* q, const Py_ssize_t n);
+
+   /* Batch kernels - as per quaternion_basic.h, using the SIMD backend where
+    * available. Quot sets errno = EDOM when dividing by zero.
+    */
+   Py_quat_binary_kernel    Array_Sum;
+   Py_quat_binary_kernel    Array_Diff;
+   Py_quat_binary_kernel    Array_Prod;
+   Py_quat_binary_kernel    Array_Quot;
+   Py_quat_normalise_kernel Array_Normalise;
+   Py_quat_normalise_kernel Array_Renormalise;
+   Py_quat_rotate_kernel    Array_Rotate;
+   Py_quat_rotate_kernel    Array_UnitRotate;
+   void (*Array_MatrixRotate) (const Py_quat_matrix* matrix,
+                               const Py_quat_triple* points,
+                               Py_quat_triple* r, const size_t n,
+                               const Py_quat_triple origin);
+   void (*Array_Encode) (const Py_quaternion* a, void* r, const size_t n,
+                         const Py_quat_encoding encoding);
+   void (*Array_Decode) (const void* a, Py_quaternion* r, const size_t n,
+                         const Py_quat_encoding encoding);
+
+   /* Single item functions */
+   Py_quaternion  (*Prod) (const Py_quaternion a, const Py_quaternion b);
+   Py_quaternion  (*Quot) (const Py_quaternion a, const Py_quaternion b);
+   Py_quaternion  (*Inverse) (const Py_quaternion a);
+   Py_quaternion  (*Normalise) (const Py_quaternion a);
+   Py_quaternion  (*Slerp) (const Py_quaternion a, const Py_quaternion b, const double t);
+   Py_quaternion  (*UnitSlerp) (const Py_quaternion a, const Py_quaternion b, const double t);
+   Py_quat_triple (*Rotate) (const Py_quaternion a, const Py_quat_triple point,
+                             const Py_quat_triple origin);
+   void           (*ToRotationMatrix) (const Py_quaternion a, Py_quat_matrix* matrix);
+} PyQuaternion_CAPI;
+
+
+#ifndef QUATERNION_MODULE
+/* For use by other extension modules - this is set by PyQuaternion_IMPORT, which
+ * evaluates to NULL, with an exception set, if the module can't be imported.
+ */
+static PyQuaternion_CAPI* PyQuaternionAPI = NULL;
+
+#define PyQuaternion_IMPORT                                                    \
+   (PyQuaternionAPI = (PyQuaternion_CAPI*) PyCapsule_Import (PyQuaternion_CAPSULE_NAME, 0))
+
+#endif  /* QUATERNION_MODULE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* QUATERNION_CAPI_H */
@@ -0,0 +1,527 @@
+/* quaternion_interpolate.c
+ *
+ * This file is part of the Python quaternion module. It provides the batch
+ * interpolation of a QuaternionArray of keyframes at a vector of sample times.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#include "quaternion_interpolate.h"
+#include "quaternion_basic.h"
+#include "quaternion_array.h"
+#include "quaternion_parallel.h"
+#include "quaternion_utilities.h"
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+/* Results are written to SoA output arrays in blocks of this many items.
+ */
+#define INTERPOLATE_BLOCK  128
+
+typedef enum {
+   INTERPOLATE_SLERP = 0,
+   INTERPOLATE_NLERP,
+   INTERPOLATE_SQUAD
+} Interpolate_method;
+
+/* The terms of a spherical interpolation from a to b which do not depend upon t.
+ * When sin_theta is 0.0, the interpolation is just linear.
+ */
+typedef struct {
+   Py_quaternion a;
+   Py_quaternion b;
+   double theta;
+   double sin_theta;
+} Slerp_terms;
+
+/* The cached terms of the segment from keys[index] to keys[index + 1].
+ */
+typedef struct {
+   Py_ssize_t index;          /* -1 when not yet set */
+   double t0;                 /* time of keys[index] */
+   double dt;                 /* time interval to keys[index + 1] */
+   Slerp_terms keys;          /* the keys, keys.a negated if need be */
+   Slerp_terms controls;      /* squad only: the inner control points */
+} Segment_cache;
+
+typedef struct {
+   Interpolate_method method;
+   bool unit;                 /* the keys are unit quaternions */
+   const Py_quaternion_array* keys;
+   const double* times;
+   Py_ssize_t n;              /* number of keys and times */
+   const double* samples;
+   Py_quaternion_array* r;
+} Interpolate_context;
+
+
+/* -----------------------------------------------------------------------------
+ * Calculates the slerp terms. This follows _Py_quat_slerp, so that the results
+ * of slerp_eval are the same as _Py_quat_slerp (a, b, t).
+ * When shortest is true, a is negated if need be, so as to go the short way round.
+ * When unit is true, a and b are unit quaternions, and as per _Py_quat_unit_slerp,
+ * the magnitudes are not calculated.
+ */
+static void
+slerp_setup (Slerp_terms* s, const Py_quaternion a, const Py_quaternion b,
+             const bool shortest, const bool unit)
+{
+   double k = unit ? 1.0 : _Py_quat_abs (a) * _Py_quat_abs (b);
+
+   s->a = a;
+   s->b = b;
+   s->theta = 0.0;
+   s->sin_theta = 0.0;
+
+   if (k > 0.0) {
+      double dp = _Py_quat_dot_prod (a, b);
+      double cos_theta;
+
+      if (shortest && dp < 0.0) {
+         dp = -dp;
+         s->a = _Py_quat_neg (a);
+      }
+
+      /* Go with linear interpolation when theta is close to zero (or to 180
+       * degrees when not taking the shortest path).
+       */
+      cos_theta = dp / k;
+      if (cos_theta < 0.99996 && cos_theta > -0.99996) {
+         s->theta = acos (cos_theta);
+         s->sin_theta = sin (s->theta);
+      }
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static Py_quaternion
+slerp_eval (const Slerp_terms* s, const double t)
+{
+   Py_quaternion r;
+   double sa = 1.0 - t;
+   double sb = t;
+
+   if (s->sin_theta != 0.0) {
+      sa = sin (sa * s->theta) / s->sin_theta;
+      sb = sin (sb * s->theta) / s->sin_theta;
+   }
+
+   r.w = sa*s->a.w + sb*s->b.w;
+   r.x = sa*s->a.x + sb*s->b.x;
+   r.y = sa*s->a.y + sb*s->b.y;
+   r.z = sa*s->a.z + sb*s->b.z;
+
+   return r;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static Py_quaternion
+key_at (const Py_quaternion_array* keys, const Py_ssize_t j)
+{
+   Py_quaternion q;
+   PyQuaternionArrayGather (keys, j, &q, 1);
+   return q;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns q or -q, whichever is closer to ref.
+ */
+static Py_quaternion
+same_hemisphere (const Py_quaternion q, const Py_quaternion ref)
+{
+   return _Py_quat_dot_prod (q, ref) < 0.0 ? _Py_quat_neg (q) : q;
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns the squad inner control point for q, given the previous and next keys:
+ *    q * exp (-(log (q^-1 * next) + log (q^-1 * prev)) / 4)
+ * For a unit quaternion q, the inverse is just the conjugate.
+ */
+static Py_quaternion
+squad_control (const Py_quaternion prev, const Py_quaternion q, const Py_quaternion next,
+               const bool unit)
+{
+   Py_quaternion qi = unit ? _Py_quat_conjugate (q) : _Py_quat_inverse (q);
+   Py_quaternion ln = _Py_quat_log (_Py_quat_prod (qi, next));
+   Py_quaternion lp = _Py_quat_log (_Py_quat_prod (qi, prev));
+   Py_quaternion e;
+
+   e.w = -0.25 * (ln.w + lp.w);
+   e.x = -0.25 * (ln.x + lp.x);
+   e.y = -0.25 * (ln.y + lp.y);
+   e.z = -0.25 * (ln.z + lp.z);
+
+   return _Py_quat_prod (q, _Py_quat_exp (e));
+}
+
+/* -----------------------------------------------------------------------------
+ * Sets up the cache for the segment from keys[j] to keys[j + 1].
+ */
+static void
+segment_setup (Segment_cache* cache, const Interpolate_context* c, const Py_ssize_t j)
+{
+   Py_quaternion q1 = key_at (c->keys, j);
+   Py_quaternion q2 = key_at (c->keys, j + 1);
+
+   cache->index = j;
+   cache->t0 = c->times [j];
+   cache->dt = c->times [j + 1] - c->times [j];
+
+   if (c->method != INTERPOLATE_SQUAD) {
+      slerp_setup (&cache->keys, q1, q2, true, c->unit);
+      return;
+   }
+
+   /* Use the neighbouring keys closest to q1 and q2 respectively.
+    * At the ends, the control point is just the key itself.
+    */
+   q2 = same_hemisphere (q2, q1);
+   slerp_setup (&cache->keys, q1, q2, false, c->unit);
+
+   Py_quaternion s1 = q1;
+   Py_quaternion s2 = q2;
+
+   if (j > 0) {
+      Py_quaternion q0 = same_hemisphere (key_at (c->keys, j - 1), q1);
+      s1 = squad_control (q0, q1, q2, c->unit);
+   }
+
+   if (j + 2 < c->n) {
+      Py_quaternion q3 = same_hemisphere (key_at (c->keys, j + 2), q2);
+      s2 = squad_control (q1, q2, q3, c->unit);
+   }
+
+   slerp_setup (&cache->controls, s1, s2, false, c->unit);
+}
+
+/* -----------------------------------------------------------------------------
+ * Returns j such that times[j] <= t < times[j + 1], where t is strictly within
+ * the time range. The hint, typically the previous segment, is checked first,
+ * as samples are usually in time order.
+ */
+static Py_ssize_t
+find_segment (const double* times, const Py_ssize_t n, const Py_ssize_t hint,
+              const double t)
+{
+   Py_ssize_t lo = 0;
+   Py_ssize_t hi = n - 1;
+
+   if (hint >= 0) {
+      if (times [hint] <= t && t < times [hint + 1]) return hint;
+      if (hint + 2 < n && times [hint + 1] <= t && t < times [hint + 2]) return hint + 1;
+   }
+
+   /* Binary search - invariant: times[lo] <= t < times[hi]
+    */
+   while (hi - lo > 1) {
+      Py_ssize_t mid = lo + (hi - lo) / 2;
+      if (times [mid] <= t) {
+         lo = mid;
+      } else {
+         hi = mid;
+      }
+   }
+
+   return lo;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static Py_quaternion
+interpolate_sample (const Interpolate_context* c, Segment_cache* cache, const double t)
+{
+   Py_quaternion r;
+   Py_ssize_t j;
+   double u;
+
+   if (isnan (t)) {
+      r.w = r.x = r.y = r.z = Py_NAN;
+      return r;
+   }
+
+   /* Samples outside of the time range are clamped to the first/last key.
+    */
+   if (c->n == 1 || t <= c->times [0]) {
+      return key_at (c->keys, 0);
+   }
+   if (t >= c->times [c->n - 1]) {
+      return key_at (c->keys, c->n - 1);
+   }
+
+   j = find_segment (c->times, c->n, cache->index, t);
+   if (j != cache->index) {
+      segment_setup (cache, c, j);
+   }
+
+   u = (t - cache->t0) / cache->dt;
+
+   switch (c->method) {
+      case INTERPOLATE_NLERP:
+         r = _Py_quat_normalise (_Py_quat_lerp (cache->keys.a, cache->keys.b, u));
+         break;
+
+      case INTERPOLATE_SQUAD:
+         {
+            Slerp_terms outer;
+            slerp_setup (&outer, slerp_eval (&cache->keys, u),
+                         slerp_eval (&cache->controls, u), false, c->unit);
+            r = slerp_eval (&outer, 2.0 * u * (1.0 - u));
+         }
+         break;
+
+      case INTERPOLATE_SLERP:
+      default:
+         r = slerp_eval (&cache->keys, u);
+         break;
+   }
+
+   return r;
+}
+
+/* -----------------------------------------------------------------------------
+ * Each chunk has its own segment cache.
+ */
+static void
+interpolate_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   Interpolate_context* c = (Interpolate_context*) context;
+   Py_quaternion t [INTERPOLATE_BLOCK];
+   Segment_cache cache;
+   size_t j;
+   size_t k;
+   size_t m;
+
+   cache.index = -1;
+
+   for (j = begin; j < end; j += m) {
+      Py_quaternion* pr;
+
+      m = end - j < INTERPOLATE_BLOCK ? end - j : INTERPOLATE_BLOCK;
+      pr = c->r->layout == QA_LAYOUT_AOS ? c->r->qvalArray + j : t;
+
+      for (k = 0; k < m; k++) {
+         pr [k] = interpolate_sample (c, &cache, c->samples [j + k]);
+      }
+
+      if (c->r->layout != QA_LAYOUT_AOS) {
+         PyQuaternionArrayScatter (c->r, j, t, m);
+      }
+   }
+
+   /* nlerp of a zero key sets EDOM - just leave the normalised result as is.
+    */
+   errno = 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Module functions
+ * -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(interpolate_doc,
+             "interpolate(keys, times, samples, method='slerp', out=None, unit=False)\n"
+             "\n"
+             "Interpolates the keyframe QuaternionArray keys at each of the sample times,\n"
+             "and returns a QuaternionArray of the interpolated values.\n"
+             "\n"
+             "   keys\n"
+             "       a QuaternionArray of the keyframes, nominally rotation quaternions\n"
+             "\n"
+             "   times\n"
+             "       a bytes-like object of doubles, e.g. array.array('d'), being the\n"
+             "       strictly increasing time of each key\n"
+             "\n"
+             "   samples\n"
+             "       a bytes-like object of doubles, being the sample times\n"
+             "\n"
+             "   method\n"
+             "       'slerp', 'nlerp' (normalised linear) or 'squad' (spherical cubic)\n"
+             "\n"
+             "   out\n"
+             "       a QuaternionArray, of the same length as samples, to receive the\n"
+             "       results; this is then returned instead of a new array\n"
+             "\n"
+             "   unit\n"
+             "       when true, the keys are assumed to be unit quaternions, and the\n"
+             "       magnitude calculations are skipped; the results are unspecified for\n"
+             "       keys that are not of unit magnitude\n"
+             "\n"
+             "Samples before the first, or after the last, key time are clamped to the\n"
+             "first or last key. Samples need not be in time order, but in order samples\n"
+             "are faster, as the per segment terms are then calculated just the once.\n");
+
+static PyObject *
+interpolate (PyObject *module, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"keys", "times", "samples", "method", "out", "unit", NULL};
+   static const char* fname = "quaternion.interpolate";
+
+   PyObject *result = NULL;
+   PyObject *keysObj = NULL;
+   PyObject *timesObj = NULL;
+   PyObject *samplesObj = NULL;
+   PyObject *outObj = NULL;
+   const char *methodName = "slerp";
+   PyQuaternionArrayObject *pKeys;
+   PyQuaternionArrayObject *pOut;
+   Py_buffer times;
+   Py_buffer samples;
+   Interpolate_context context;
+   Py_ssize_t nsamples;
+   Py_ssize_t j;
+   int unit = 0;
+   int status;
+
+   status = PyArg_ParseTupleAndKeywords
+         (args, kwds, "OOO|sOp:quaternion.interpolate", kwlist,
+          &keysObj, &timesObj, &samplesObj, &methodName, &outObj, &unit);
+   if (!status) {
+      return NULL;
+   }
+
+   context.unit = unit;
+
+   if (strcmp (methodName, "slerp") == 0) {
+      context.method = INTERPOLATE_SLERP;
+   } else if (strcmp (methodName, "nlerp") == 0) {
+      context.method = INTERPOLATE_NLERP;
+   } else if (strcmp (methodName, "squad") == 0) {
+      context.method = INTERPOLATE_SQUAD;
+   } else {
+      PyErr_Format(PyExc_ValueError,
+                   "%s() method must be 'slerp', 'nlerp' or 'squad', not '%.200s'",
+                   fname, methodName);
+      return NULL;
+   }
+
+   if (!PyQuaternionArray_Check (keysObj)) {
+      PyErr_Format(PyExc_TypeError,
+                   "%s() keys must be a QuaternionArray, not '%.200s'",
+                   fname, Py_TYPE(keysObj)->tp_name);
+      return NULL;
+   }
+   pKeys = (PyQuaternionArrayObject *) keysObj;
+
+   if (pKeys->aval.count < 1) {
+      PyErr_Format(PyExc_ValueError, "%s() requires at least one key", fname);
+      return NULL;
+   }
+
+   if (outObj == Py_None) outObj = NULL;
+   if (outObj && !PyQuaternionArray_Check (outObj)) {
+      PyErr_Format(PyExc_TypeError,
+                   "%s() out must be a QuaternionArray, not '%.200s'",
+                   fname, Py_TYPE(outObj)->tp_name);
+      return NULL;
+   }
+
+   if (!PyQuaternionUtil_GetDoubleBuffer (timesObj, &times, false, 1, fname, "times")) {
+      return NULL;
+   }
+
+   if (!PyQuaternionUtil_GetDoubleBuffer (samplesObj, &samples, false, 1, fname, "samples")) {
+      PyBuffer_Release(&times);
+      return NULL;
+   }
+
+   context.keys = &pKeys->aval;
+   context.times = (const double*) times.buf;
+   context.n = pKeys->aval.count;
+   context.samples = (const double*) samples.buf;
+   nsamples = samples.len / sizeof (double);
+
+   if (times.len / (Py_ssize_t) sizeof (double) != context.n) {
+      PyErr_Format(PyExc_ValueError,
+                   "%s() number of times (%ld) differs from the number of keys (%ld)",
+                   fname, times.len / (Py_ssize_t) sizeof (double), context.n);
+      goto done;
+   }
+
+   for (j = 0; j < context.n; j++) {
+      if (!isfinite (context.times [j]) ||
+          (j > 0 && !(context.times [j] > context.times [j - 1]))) {
+         PyErr_Format(PyExc_ValueError,
+                      "%s() times must be finite and strictly increasing (at index %ld)",
+                      fname, j);
+         goto done;
+      }
+   }
+
+   if (outObj) {
+      pOut = (PyQuaternionArrayObject *) outObj;
+      if (pOut->readonly) {
+         PyErr_Format(PyExc_TypeError, "%s() out is a read-only QuaternionArray", fname);
+         goto done;
+      }
+      if (pOut->aval.count != nsamples) {
+         PyErr_Format(PyExc_ValueError,
+                      "%s() out length (%ld) differs from the number of samples (%ld)",
+                      fname, pOut->aval.count, nsamples);
+         goto done;
+      }
+      result = outObj;
+      Py_INCREF(result);
+   } else {
+      result = PyQuaternionArrayNew (nsamples, pKeys->aval.layout);
+      if (!result) {
+         goto done;
+      }
+      pOut = (PyQuaternionArrayObject *) result;
+   }
+
+   context.r = &pOut->aval;
+
+   /* Large sample sets are processed without the GIL, so neither array may
+    * be resized by another thread in the meantime.
+    */
+   pKeys->busy++;
+   pOut->busy++;
+   _Py_quat_parallel_run (interpolate_task, &context, nsamples);
+   pOut->busy--;
+   pKeys->busy--;
+
+done:
+   PyBuffer_Release(&samples);
+   PyBuffer_Release(&times);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef interpolate_methods[] = {
+   {"interpolate", (PyCFunction)interpolate, METH_VARARGS | METH_KEYWORDS, interpolate_doc},
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ * Allow module definition code to access the interpolate PyMethodDef.
+ */
+PyMethodDef* _PyQuaternionInterpolateMethods ()
+{
+   return interpolate_methods;
+}
+
+/* end */
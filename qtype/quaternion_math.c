@@ -27,6 +27,7 @@
 #include <Python.h>
 #include "quaternion_basic.h"
 #include "quaternion_object.h"
+#include "quaternion_array.h"
 #include "quaternion_utilities.h"
 #include <stdio.h>
 #include <stdbool.h>
@@ -34,34 +35,72 @@
 
 
 
-/* Forward declaration
+/* Forward declarations
  */
 static bool two_qarg_validation (PyObject *a, PyObject *b,
                                  Py_quaternion *qa,
                                  Py_quaternion *qb,
                                  const char *name);
 
+static bool qmath_parse_args (PyObject *const *args, Py_ssize_t nargs,
+                              PyObject *kwnames, const Py_ssize_t maxargs,
+                              PyObject **arg, PyObject **base, PyObject **out,
+                              const char *name);
+
+static PyObject *qmath_out_error (PyObject *arg, const char *name);
+
+static bool qmath_parse_fast (PyObject *const *args, Py_ssize_t nargs,
+                              PyObject *kwnames, const char *const *keywords,
+                              const Py_ssize_t nrequired, PyObject **values,
+                              const char *fname);
+
+static bool qmath_as_double (PyObject *obj, double *value);
+
+/* Appended to the doc string of each function that also accepts an array.
+ */
+#define ARRAY_DOC                                                                 \
+   "\n\n"                                                                         \
+   "q may also be a QuaternionArray, in which case the function is applied to\n"  \
+   "each item, and the results are returned in a new QuaternionArray, or are\n"   \
+   "written into out (a QuaternionArray of the same length) when specified."
+
 
 /* -----------------------------------------------------------------------------
  */
 #define BASIC_ONE_ARGUMENT_FUNCTION(name)                                      \
                                                                                \
 static PyObject *                                                              \
-qmath_##name(PyObject *module, PyObject *arg)                                  \
+qmath_##name(PyObject *module, PyObject *const *args, Py_ssize_t nargs,        \
+             PyObject *kwnames)                                                \
 {                                                                              \
    PyObject * result = NULL;                                                   \
+   PyObject * arg = NULL;                                                      \
+   PyObject * out = NULL;                                                      \
    Py_quaternion q;                                                            \
    Py_quaternion r;                                                            \
    bool s;                                                                     \
                                                                                \
+   s = qmath_parse_args (args, nargs, kwnames, 1, &arg, NULL, &out, #name);    \
+   if (!s) {                                                                   \
+      return NULL;                                                             \
+   }                                                                           \
+                                                                               \
+   if (PyQuaternionArray_Check (arg)) {                                        \
+      return PyQuaternionArrayApply (arg, _Py_quat_##name, 1.0, out, #name);   \
+   }                                                                           \
+                                                                               \
+   if (out) {                                                                  \
+      return qmath_out_error (arg, #name);                                     \
+   }                                                                           \
+                                                                               \
    s = PyObject_AsCQuaternion (arg, &q);                                       \
    if (s) {                                                                    \
       r = _Py_quat_##name (q);                                                 \
       result = PyQuaternion_FromCQuaternion (r);                               \
    } else {                                                                    \
       PyErr_Format(PyExc_TypeError,                                            \
-                   "%s() argument must be a number, not '%.200s'",             \
-                   #name, Py_TYPE(arg)->tp_name);                              \
+                   "%s() argument must be a number or QuaternionArray,"        \
+                   " not '%.200s'", #name, Py_TYPE(arg)->tp_name);             \
    }                                                                           \
                                                                                \
    return result;                                                              \
@@ -128,11 +167,11 @@ BOOLEAN_ONE_ARGUMENT_FUNCTION (isnan)
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_sqrt__doc__,
-             "sqrt(q)\n"
+             "sqrt(q, *, out=None)\n"
              "\n"
              "Return a square root of q. When q is a negative real number with no\n"
              "imaginary parts, the result uses the j imaginary component, i.e.\n"
-             "   sqrt (Quaternion (-1, 0, 0, 0)) is Quaternion (0, 0, 1, 0)");
+             "   sqrt (Quaternion (-1, 0, 0, 0)) is Quaternion (0, 0, 1, 0)" ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (sqrt)
 
@@ -140,9 +179,9 @@ BASIC_ONE_ARGUMENT_FUNCTION (sqrt)
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_exp__doc__,
-             "exp(q)\n"
+             "exp(q, *, out=None)\n"
              "\n"
-             "Return the exponent of q.");
+             "Return the exponent of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (exp)
 
@@ -150,34 +189,50 @@ BASIC_ONE_ARGUMENT_FUNCTION (exp)
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_log__doc__,
-             "log(q [, base])\n"
+             "log(q [, base], *, out=None)\n"
              "\n"
              "Return the logarithm of q to the given base.\n"
-             "If the base not specified, returns the natural logarithm (base e) of q.");
+             "If the base not specified, returns the natural logarithm (base e) of q." ARRAY_DOC);
 
 static PyObject *
-qmath_log(PyObject *module, PyObject *args)
+qmath_log(PyObject *module, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
 {
    PyObject * result = NULL;
 
    PyObject *arg = NULL;
    PyObject *base = NULL;
-   int status;
+   PyObject *out = NULL;
+   double logBase_e = 1.0;
    bool s;
    Py_quaternion q;
    Py_quaternion r;
 
-   status = PyArg_ParseTuple (args, "O|O:quaternion.log", &arg, &base);
-   if (!status) {
+   s = qmath_parse_args (args, nargs, kwnames, 2, &arg, &base, &out, "log");
+   if (!s) {
       return NULL;
    }
 
-   /* Belts 'n' braces
-    */
-   if (arg == NULL) {
-      PyErr_Format(PyExc_TypeError,
-                   "quaternion.log() expected at least 1 arguments, got 0");
-      return NULL;
+   if (base != NULL) {
+      if (PyFloat_Check (base) || PyLong_Check (base)) {
+         /* We need PyNumber_AsDouble to complement PyNumber_Check
+          */
+         double b = PyFloat_Check (base) ? PyFloat_AsDouble (base) : PyLong_AsDouble (base);
+         logBase_e = 1.0 / log (b);
+
+      } else {
+         PyErr_Format(PyExc_TypeError,
+                      "quaternion.log() base must be 'float' or 'int'', not '%.200s'",
+                      Py_TYPE(base)->tp_name);
+         return NULL;
+      }
+   }
+
+   if (PyQuaternionArray_Check (arg)) {
+      return PyQuaternionArrayApply (arg, _Py_quat_log, logBase_e, out, "log");
+   }
+
+   if (out) {
+      return qmath_out_error (arg, "log");
    }
 
    /* extarct the input value if we can
@@ -189,29 +244,17 @@ qmath_log(PyObject *module, PyObject *args)
       r = _Py_quat_log (q);
 
       if (base != NULL) {
-         if (PyFloat_Check (base) || PyLong_Check (base)) {
-            /* We need PyNumber_AsDouble to complement PyNumber_Check
-             */
-            double b = PyFloat_Check (base) ? PyFloat_AsDouble (base) : PyLong_AsDouble (base);
-            double logBase_e = 1.0 / log (b);
-
-            r.w *= logBase_e;
-            r.x *= logBase_e;
-            r.y *= logBase_e;
-            r.z *= logBase_e;
-
-         } else {
-            PyErr_Format(PyExc_TypeError,
-                         "quaternion.log() base must be 'float' or 'int'', not '%.200s'",
-                         Py_TYPE(base)->tp_name);
-         }
+         r.w *= logBase_e;
+         r.x *= logBase_e;
+         r.y *= logBase_e;
+         r.z *= logBase_e;
       }
 
       result = PyQuaternion_FromCQuaternion (r);
 
    } else {
       PyErr_Format(PyExc_TypeError,
-                   "quaternion.log() must be a number, not '%.200s'",
+                   "quaternion.log() must be a number or QuaternionArray, not '%.200s'",
                    Py_TYPE(arg)->tp_name);
    }
 
@@ -222,27 +265,42 @@ qmath_log(PyObject *module, PyObject *args)
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_log10__doc__,
-             "log10(q)\n"
+             "log10(q, *, out=None)\n"
              "\n"
-             "Return the logarithm of q to base 10.");
+             "Return the logarithm of q to base 10." ARRAY_DOC);
 
 static PyObject *
-qmath_log10(PyObject *module, PyObject *arg)
+qmath_log10(PyObject *module, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
 {
+   /* Primitive log is log base e
+    * To get log base 10, multiply by log10(e) i.e.  0.4342944819032518
+    * which is the inverse of log.e(10)
+    */
+   static const double log10_e = 0.4342944819032518;
+
    PyObject * result = NULL;
+   PyObject * arg = NULL;
+   PyObject * out = NULL;
    bool s;
    Py_quaternion q;
    Py_quaternion r;
 
+   s = qmath_parse_args (args, nargs, kwnames, 1, &arg, NULL, &out, "log10");
+   if (!s) {
+      return NULL;
+   }
+
+   if (PyQuaternionArray_Check (arg)) {
+      return PyQuaternionArrayApply (arg, _Py_quat_log, log10_e, out, "log10");
+   }
+
+   if (out) {
+      return qmath_out_error (arg, "log10");
+   }
+
    s = PyObject_AsCQuaternion (arg, &q);
    if (s) {
       r = _Py_quat_log (q);
-
-      /* Primitive log is log base e
-       * To get log base 10, multiply by log10(e) i.e.  0.4342944819032518
-       * which is the inverse of log.e(10)
-       */
-      static const double log10_e = 0.4342944819032518;
       r.w *= log10_e;
       r.x *= log10_e;
       r.y *= log10_e;
@@ -250,7 +308,7 @@ qmath_log10(PyObject *module, PyObject *arg)
       result = PyQuaternion_FromCQuaternion (r);
    } else {
       PyErr_Format(PyExc_TypeError,
-                   "quaternion.log10() must be a number, not '%.200s'",
+                   "quaternion.log10() must be a number or QuaternionArray, not '%.200s'",
                    Py_TYPE(arg)->tp_name);
    }
 
@@ -261,108 +319,108 @@ qmath_log10(PyObject *module, PyObject *arg)
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_cos__doc__,
-             "cos(q)\n"
+             "cos(q, *, out=None)\n"
              "\n"
-             "Return the cosine of q.");
+             "Return the cosine of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (cos)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_sin__doc__,
-             "sin(q)\n"
+             "sin(q, *, out=None)\n"
              "\n"
-             "Return the sine of q.");
+             "Return the sine of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (sin)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_tan__doc__,
-             "tan(q)\n"
+             "tan(q, *, out=None)\n"
              "\n"
-             "Return the tangent of q.");
+             "Return the tangent of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (tan)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_acos__doc__,
-             "acos(q)\n"
+             "acos(q, *, out=None)\n"
              "\n"
-             "Return the arccosine of q.");
+             "Return the arccosine of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (acos)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_asin__doc__,
-             "asin(q)\n"
+             "asin(q, *, out=None)\n"
              "\n"
-             "Return the arcsine of q.");
+             "Return the arcsine of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (asin)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_atan__doc__,
-             "atan(q)\n"
+             "atan(q, *, out=None)\n"
              "\n"
-             "Return the arctangent of q.");
+             "Return the arctangent of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (atan)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_cosh__doc__,
-             "cosh(q)\n"
+             "cosh(q, *, out=None)\n"
              "\n"
-             "Return the hyperbolic cosine of q.");
+             "Return the hyperbolic cosine of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (cosh)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_sinh__doc__,
-             "sinh(q)\n"
+             "sinh(q, *, out=None)\n"
              "\n"
-             "Return the hyperbolic sine of q.");
+             "Return the hyperbolic sine of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (sinh)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_tanh__doc__,
-             "tanh(q)\n"
+             "tanh(q, *, out=None)\n"
              "\n"
-             "Return the hyperbolic tangent of q.");
+             "Return the hyperbolic tangent of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (tanh)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_acosh__doc__,
-             "acosh(q)\n"
+             "acosh(q, *, out=None)\n"
              "\n"
-             "Return the inverse hyperbolic cosine of q.");
+             "Return the inverse hyperbolic cosine of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (acosh)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_asinh__doc__,
-             "asinh(q)\n"
+             "asinh(q, *, out=None)\n"
              "\n"
-             "Return the inverse hyperbolic sine of q.");
+             "Return the inverse hyperbolic sine of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (asinh)
 
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(qmath_atanh__doc__,
-             "atanh(q)\n"
+             "atanh(q, *, out=None)\n"
              "\n"
-             "Return the inverse hyperbolic tangent of q.");
+             "Return the inverse hyperbolic tangent of q." ARRAY_DOC);
 
 BASIC_ONE_ARGUMENT_FUNCTION (atanh)
 
@@ -391,28 +449,30 @@ PyDoc_STRVAR(qmath_isclose__doc__,
              "only close to themselves.\n");
 
 static PyObject *
-qmath_isclose(PyObject *module, PyObject *args, PyObject *kwds)
+qmath_isclose(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+              PyObject *kwnames)
 {
-   static char *kwlist[] = {"a", "b", "rel_tol", "abs_tol", 0};
+   static const char *const keywords[] = {"a", "b", "rel_tol", "abs_tol", NULL};
 
    PyObject *result = NULL;
-   PyObject *a = NULL;
-   PyObject *b = NULL;
+   PyObject *values [4];
    double rel_tol = 1.0e-09;
    double abs_tol = 0.0;
-   int status;
    bool vstat;
    Py_quaternion ca;
    Py_quaternion cb;
 
-   status = PyArg_ParseTupleAndKeywords
-         (args, kwds, "OO|dd:quaternion.isclose", kwlist,
-          &a, &b, &rel_tol, &abs_tol);
-   if (!status) {
+   vstat = qmath_parse_fast (args, nargs, kwnames, keywords, 2, values, "isclose");
+   if (!vstat) {
       return NULL;
    }
 
-   vstat = two_qarg_validation(a, b, &ca, &cb, "isclose");
+   if ((values [2] && !qmath_as_double (values [2], &rel_tol)) ||
+       (values [3] && !qmath_as_double (values [3], &abs_tol))) {
+      return NULL;
+   }
+
+   vstat = two_qarg_validation(values [0], values [1], &ca, &cb, "isclose");
    if (!vstat) {
       return NULL;
    }
@@ -430,37 +490,61 @@ qmath_isclose(PyObject *module, PyObject *args, PyObject *kwds)
       return NULL;
    }
 
-   if (_Py_quat_eq (ca, cb)) {
-      /* Short circuit exact equality - needed to catch two infinities of
-       * the same sign. And perhaps speeds things up a bit sometimes.
-       */
-      result = Py_True;
+   result = _Py_quat_isclose (ca, cb, rel_tol, abs_tol) ? Py_True : Py_False;
+
+   Py_INCREF (result);
+   return result;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Array form of polar, axis and phase. Returns, as array.array('d') objects,
+ * the required polar coordinates of each item of arg, a QuaternionArray.
+ * When more than one array is required, these are returned as a tuple.
+ */
+static PyObject *
+qmath_array_polar (PyObject *arg, const bool wantRadius, const bool wantPhase,
+                   const bool wantAxis)
+{
+   PyObject * result = NULL;
+   PyObject * radiusObj = NULL;
+   PyObject * phaseObj = NULL;
+   PyObject * axisObj = NULL;
+   Py_ssize_t n;
+   double *data;
+
+   /* One allocation of 5 doubles per item holds all three outputs.
+    */
+   n = PyObject_Length (arg);
+   if (n < 0) {
+      return NULL;
+   }
+   data = PyMem_New (double, 5 * n + 1);
+   if (!data) {
+      return PyErr_NoMemory();
+   }
+
+   PyQuaternionArrayPolar (arg, wantRadius ? data : NULL, wantPhase ? data + n : NULL,
+                           wantAxis ? data + 2 * n : NULL);
+
+   if (wantRadius) radiusObj = PyQuaternionUtil_NewArray ('d', data, n * sizeof (double));
+   if (wantPhase) phaseObj = PyQuaternionUtil_NewArray ('d', data + n, n * sizeof (double));
+   if (wantAxis) axisObj = PyQuaternionUtil_NewArray ('d', data + 2 * n, 3 * n * sizeof (double));
+   PyMem_Free (data);
+
+   if ((wantRadius && !radiusObj) || (wantPhase && !phaseObj) || (wantAxis && !axisObj)) {
+      Py_XDECREF (radiusObj);
+      Py_XDECREF (phaseObj);
+      Py_XDECREF (axisObj);
+      return NULL;
+   }
+
+   if (wantRadius) {
+      result = Py_BuildValue ("NNN", radiusObj, phaseObj, axisObj);
    } else {
-      if (_Py_quat_isinf (ca) || _Py_quat_isinf (cb)) {
-         /* This catches the case of two infinities of opposite sign, or
-          * one infinity and one finite number. Two infinities of opposite
-          * sign would otherwise have an infinite relative tolerance.
-          * Two infinities of the same sign are caught by the equality check
-          * above.
-          */
-         result = Py_False;
-      } else {
-         /* Okay - now we get down to the nitty-gritty
-          */
-         Py_quaternion cd = _Py_quat_diff (ca, cb);
-         double diff = _Py_quat_abs (cd);
-         double absa = _Py_quat_abs (ca);
-         double absb = _Py_quat_abs (cb);
-
-         if (((diff <= rel_tol * absa) || (diff <= rel_tol * absb)) || (diff <= abs_tol)) {
-            result = Py_True;
-         } else {
-            result = Py_False;
-         }
-      }
+      result = wantPhase ? phaseObj : axisObj;
    }
 
-   Py_INCREF (result);
    return result;
 }
 
@@ -478,7 +562,11 @@ PyDoc_STRVAR(qmath_polar__doc__,
              "    unit = (x*i + y*j + z*k)\n"
              "\n"
              "Note: the axis is of unit length, i.e. |axis| is 1\n"
-             "      polar(q) is equivalent to (abs(q), phase(q), axis(q)).");
+             "      polar(q) is equivalent to (abs(q), phase(q), axis(q)).\n"
+             "\n"
+             "q may also be a QuaternionArray, in which case a tuple of three\n"
+             "array.array('d') objects is returned, holding the lengths, the phases\n"
+             "and the packed x, y, z axes of each item.");
 
 static PyObject *
 qmath_polar(PyObject *module, PyObject *arg)
@@ -487,6 +575,10 @@ qmath_polar(PyObject *module, PyObject *arg)
    Py_quaternion q;
    bool s;
 
+   if (PyQuaternionArray_Check (arg)) {
+      return qmath_array_polar (arg, true, true, true);
+   }
+
    s = PyObject_AsCQuaternion (arg, &q);
    if (s) {
       double radius;
@@ -516,7 +608,10 @@ PyDoc_STRVAR(qmath_axis__doc__,
              "where:\n"
              "    unit = (x*i + y*j + z*k)\n"
              "\n"
-             "Note: the axis is of unit length, i.e. |axis| is 1\n");
+             "Note: the axis is of unit length, i.e. |axis| is 1\n"
+             "\n"
+             "q may also be a QuaternionArray, in which case the packed x, y, z axes\n"
+             "of each item are returned in an array.array('d') object.");
 
 static PyObject *
 qmath_axis(PyObject *module, PyObject *arg)
@@ -525,6 +620,10 @@ qmath_axis(PyObject *module, PyObject *arg)
    Py_quaternion q;
    bool s;
 
+   if (PyQuaternionArray_Check (arg)) {
+      return qmath_array_polar (arg, false, false, true);
+   }
+
    s = PyObject_AsCQuaternion (arg, &q);
    if (s) {
       double radius;
@@ -554,7 +653,10 @@ PyDoc_STRVAR(qmath_phase__doc__,
              "where:\n"
              "    unit = (x*i + y*j + z*k)\n"
              "\n"
-             "Note: the axis is of unit length, i.e. |axis| is 1\n");
+             "Note: the axis is of unit length, i.e. |axis| is 1\n"
+             "\n"
+             "q may also be a QuaternionArray, in which case the phase of each item\n"
+             "is returned in an array.array('d') object.");
 
 static PyObject *
 qmath_phase(PyObject *module, PyObject *arg)
@@ -563,6 +665,10 @@ qmath_phase(PyObject *module, PyObject *arg)
    Py_quaternion q;
    bool s;
 
+   if (PyQuaternionArray_Check (arg)) {
+      return qmath_array_polar (arg, false, true, false);
+   }
+
    s = PyObject_AsCQuaternion (arg, &q);
    if (s) {
       double radius;
@@ -594,21 +700,24 @@ PyDoc_STRVAR(qmath_rect__doc__,
              "Note: axis is normalised such that |axis| = 1 if required.");
 
 static PyObject *
-qmath_rect(PyObject *module, PyObject *args)
+qmath_rect(PyObject *module, PyObject *const *args, Py_ssize_t nargs)
 {
+   static const char *const keywords[] = {"length", "phase", "axis", NULL};
+
    PyObject * result = NULL;
+   PyObject *values [3];
 
    double radius;
    double phase;
-   PyObject *unit = NULL;
    Py_quat_triple axis;
    int status;
    Py_quaternion r;
 
-   status = PyArg_ParseTuple (args, "ddO:quaternion.rect",
-                              &radius, &phase, &unit);
+   status = qmath_parse_fast (args, nargs, NULL, keywords, 3, values, "rect") &&
+            qmath_as_double (values [0], &radius) &&
+            qmath_as_double (values [1], &phase);
    if (status) {
-      status = PyQuaternionUtil_ParseTriple (unit, &axis, "quaternion.rect", "axis");
+      status = PyQuaternionUtil_ParseTriple (values [2], &axis, "quaternion.rect", "axis");
       if (status) {
          /* Note: _Py_quat_from_polar normalised axis if need be */
          r = _Py_quat_from_polar(radius, axis, phase);
@@ -629,24 +738,23 @@ PyDoc_STRVAR(qmath_dot__doc__,
              "\n"
              "This is equivilent to q@r\n");
 static PyObject *
-qmath_dot(PyObject *module, PyObject *args)
+qmath_dot(PyObject *module, PyObject *const *args, Py_ssize_t nargs)
 {
-   PyObject *result = NULL;
+   static const char *const keywords[] = {"q", "r", NULL};
 
-   PyObject *a = NULL;
-   PyObject *b = NULL;
-   int status;
+   PyObject *result = NULL;
+   PyObject *values [2];
    bool vstat;
    Py_quaternion qa;
    Py_quaternion qb;
    double r;
 
-   status = PyArg_ParseTuple (args, "OO:quaternion.dot", &a, &b);
-   if (!status) {
+   vstat = qmath_parse_fast (args, nargs, NULL, keywords, 2, values, "dot");
+   if (!vstat) {
       return NULL;
    }
 
-   vstat = two_qarg_validation(a, b, &qa, &qb, "dot");
+   vstat = two_qarg_validation(values [0], values [1], &qa, &qb, "dot");
    if (!vstat) {
       return NULL;
    }
@@ -671,24 +779,24 @@ PyDoc_STRVAR(qmath_lerp__doc__, "lerp(q1, q2, t)\n"
              "the t value, so that some level of extrapolation is possible.\n");
 
 static PyObject *
-qmath_lerp(PyObject *module, PyObject *args)
+qmath_lerp(PyObject *module, PyObject *const *args, Py_ssize_t nargs)
 {
-   PyObject *result = NULL;
+   static const char *const keywords[] = {"q1", "q2", "t", NULL};
 
-   PyObject *a1 = NULL;
-   PyObject *a2 = NULL;
+   PyObject *result = NULL;
+   PyObject *values [3];
    double t;
-   int status;
    bool vstat;
    Py_quaternion q1;
    Py_quaternion q2;
 
-   status = PyArg_ParseTuple (args, "OOd:quaternion.slerp", &a1, &a2, &t);
-   if (!status) {
+   vstat = qmath_parse_fast (args, nargs, NULL, keywords, 3, values, "lerp") &&
+           qmath_as_double (values [2], &t);
+   if (!vstat) {
       return NULL;
    }
 
-   vstat = two_qarg_validation(a1, a2, &q1, &q2, "slerp");
+   vstat = two_qarg_validation(values [0], values [1], &q1, &q2, "lerp");
    if (!vstat) {
       return NULL;
    }
@@ -707,7 +815,7 @@ qmath_lerp(PyObject *module, PyObject *args)
  * https://en.wikipedia.org/wiki/Slerp
  */
 PyDoc_STRVAR(qmath_slerp__doc__,
-             "slerp(q1, q2, t)\n"
+             "slerp(q1, q2, t, *, unit=False)\n"
              "\n"
              "Returns the spherical interpolation q1 and q2, by the amount specified\n"
              "by t such that: slerp(q1, q2, 0) == q1 (or -q1*) and slerp(q1, q2, 1) == q2\n"
@@ -717,27 +825,45 @@ PyDoc_STRVAR(qmath_slerp__doc__,
              "While t is notionally in the range 0 to 1, this function does not clamp\n"
              "the t value, so that some level of extrapolation is possible.\n"
              "q1 and q2 are nominally rotation quaternions, however the slerp function\n"
-             "does not enforce this.");
+             "does not enforce this. When unit is true, q1 and q2 are assumed to be unit\n"
+             "quaternions, and their magnitudes are not calculated.");
 
 static PyObject *
-qmath_slerp(PyObject *module, PyObject *args)
+qmath_slerp(PyObject *module, PyObject *const *args, Py_ssize_t nargs,
+            PyObject *kwnames)
 {
-   PyObject *result = NULL;
+   static const char *const keywords[] = {"q1", "q2", "t", "unit", NULL};
 
-   PyObject *a1 = NULL;
-   PyObject *a2 = NULL;
+   PyObject *result = NULL;
+   PyObject *values [4];
    double t;
-   int status;
+   int unit = 0;
    bool vstat;
    Py_quaternion q1;
    Py_quaternion q2;
 
-   status = PyArg_ParseTuple (args, "OOd:quaternion.slerp", &a1, &a2, &t);
-   if (!status) {
+   /* unit is keyword only
+    */
+   if (nargs > 3) {
+      PyErr_Format(PyExc_TypeError,
+                   "slerp() takes at most 3 positional arguments (%ld given)", nargs);
       return NULL;
    }
 
-   vstat = two_qarg_validation(a1, a2, &q1, &q2, "slerp");
+   vstat = qmath_parse_fast (args, nargs, kwnames, keywords, 3, values, "slerp") &&
+           qmath_as_double (values [2], &t);
+   if (!vstat) {
+      return NULL;
+   }
+
+   if (values [3]) {
+      unit = PyObject_IsTrue (values [3]);
+      if (unit < 0) {
+         return NULL;
+      }
+   }
+
+   vstat = two_qarg_validation(values [0], values [1], &q1, &q2, "slerp");
    if (!vstat) {
       return NULL;
    }
@@ -745,7 +871,7 @@ qmath_slerp(PyObject *module, PyObject *args)
 
    /* Both q1 and q2 are quaternion, do the basic slerp function.
     */
-   Py_quaternion r = _Py_quat_slerp(q1, q2, t);
+   Py_quaternion r = unit ? _Py_quat_unit_slerp(q1, q2, t) : _Py_quat_slerp(q1, q2, t);
    result = PyQuaternion_FromCQuaternion (r);
 
    return result;
@@ -794,45 +920,177 @@ static bool two_qarg_validation (PyObject *a, PyObject *b,
    return sa && sb;
 }
 
+/* -----------------------------------------------------------------------------
+ * Parses the (q [, base], *, out=None) arguments of the functions that also
+ * accept a QuaternionArray. base may be NULL when maxargs is 1.
+ * The outputs not specified are set NULL; out=None is also treated as NULL.
+ */
+static bool qmath_parse_args (PyObject *const *args, Py_ssize_t nargs,
+                              PyObject *kwnames, const Py_ssize_t maxargs,
+                              PyObject **arg, PyObject **base, PyObject **out,
+                              const char *fname)
+{
+   Py_ssize_t nkw = kwnames ? PyTuple_GET_SIZE (kwnames) : 0;
+   Py_ssize_t j;
+
+   *arg = NULL;
+   if (base) *base = NULL;
+   *out = NULL;
+
+   if (nargs < 1 || nargs > maxargs) {
+      PyErr_Format(PyExc_TypeError,
+                   "quaternion.%s() takes %s%ld positional argument%s (%ld given)",
+                   fname, maxargs > 1 ? "1 to " : "", maxargs,
+                   maxargs > 1 ? "s" : "", nargs);
+      return false;
+   }
+
+   for (j = 0; j < nkw; j++) {
+      PyObject *key = PyTuple_GET_ITEM (kwnames, j);
+      if (!PyUnicode_Check (key) || PyUnicode_CompareWithASCIIString (key, "out") != 0) {
+         PyErr_Format(PyExc_TypeError,
+                      "quaternion.%s() got an unexpected keyword argument '%S'",
+                      fname, key);
+         return false;
+      }
+      *out = args [nargs + j];
+   }
+
+   *arg = args [0];
+   if (nargs > 1) *base = args [1];
+   if (*out == Py_None) *out = NULL;
+   return true;
+}
+
+/* -----------------------------------------------------------------------------
+ * Parses METH_FASTCALL arguments, by position or, when kwnames is supplied, by
+ * name, into values. keywords is the NULL terminated list of argument names.
+ * The first nrequired values must be supplied, the other values are set to NULL
+ * if not supplied.
+ */
+static bool qmath_parse_fast (PyObject *const *args, Py_ssize_t nargs,
+                              PyObject *kwnames, const char *const *keywords,
+                              const Py_ssize_t nrequired, PyObject **values,
+                              const char *fname)
+{
+   Py_ssize_t nkw = kwnames ? PyTuple_GET_SIZE (kwnames) : 0;
+   Py_ssize_t max = 0;
+   Py_ssize_t j, k;
+
+   while (keywords [max]) max++;
+
+   if (nargs > max || (nkw == 0 && nargs < nrequired)) {
+      PyErr_Format(PyExc_TypeError,
+                   "quaternion.%s() takes %s %ld arguments (%ld given)",
+                   fname, nrequired == max ? "exactly" : nargs > max ? "at most" : "at least",
+                   nargs > max ? max : nrequired, nargs);
+      return false;
+   }
+
+   for (k = 0; k < max; k++) {
+      values [k] = k < nargs ? args [k] : NULL;
+   }
+
+   for (j = 0; j < nkw; j++) {
+      PyObject *key = PyTuple_GET_ITEM (kwnames, j);
+      for (k = 0; k < max; k++) {
+         if (PyUnicode_CompareWithASCIIString (key, keywords [k]) == 0) break;
+      }
+
+      if (k >= max) {
+         PyErr_Format(PyExc_TypeError,
+                      "quaternion.%s() got an unexpected keyword argument '%S'",
+                      fname, key);
+         return false;
+      }
+
+      if (values [k]) {
+         PyErr_Format(PyExc_TypeError,
+                      "quaternion.%s() got multiple values for argument '%s'",
+                      fname, keywords [k]);
+         return false;
+      }
+      values [k] = args [nargs + j];
+   }
+
+   for (k = 0; k < nrequired; k++) {
+      if (!values [k]) {
+         PyErr_Format(PyExc_TypeError,
+                      "quaternion.%s() missing required argument '%s' (pos %ld)",
+                      fname, keywords [k], k + 1);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/* -----------------------------------------------------------------------------
+ * As per the PyArg_ParseTuple "d" format, with a float short circuit.
+ */
+static bool qmath_as_double (PyObject *obj, double *value)
+{
+   if (PyFloat_CheckExact (obj)) {
+      *value = PyFloat_AS_DOUBLE (obj);
+      return true;
+   }
+
+   *value = PyFloat_AsDouble (obj);
+   return !(*value == -1.0 && PyErr_Occurred ());
+}
+
+/* -----------------------------------------------------------------------------
+ * Raises the error for out specified with a non array argument.
+ */
+static PyObject *qmath_out_error (PyObject *arg, const char *fname)
+{
+   PyErr_Format(PyExc_TypeError,
+                "quaternion.%s() out requires a QuaternionArray argument, not '%.200s'",
+                fname, Py_TYPE(arg)->tp_name);
+   return NULL;
+}
+
 /* -----------------------------------------------------------------------------
  * METH_O - one argument,  (in addition to the module argument)
+ * METH_FASTCALL - the other functions, which take positional arguments only
+ * METH_FASTCALL | METH_KEYWORDS - isclose and the functions that also accept a
+ *                                 QuaternionArray
  */
 static PyMethodDef qmath_methods[] = {
    {"isfinite", (PyCFunction)qmath_isfinite, METH_O,        qmath_isfinite__doc__},
    {"isinf",    (PyCFunction)qmath_isinf,    METH_O,        qmath_isinf__doc__},
    {"isnan",    (PyCFunction)qmath_isnan,    METH_O,        qmath_isnan__doc__},
-   {"sqrt",     (PyCFunction)qmath_sqrt,     METH_O,        qmath_sqrt__doc__},
-   {"exp",      (PyCFunction)qmath_exp,      METH_O,        qmath_exp__doc__},
-   {"log",      (PyCFunction)qmath_log,      METH_VARARGS,  qmath_log__doc__},
-   {"log10",    (PyCFunction)qmath_log10,    METH_O,        qmath_log10__doc__},
+   {"sqrt",     (PyCFunction)(void(*)(void))qmath_sqrt,  METH_FASTCALL | METH_KEYWORDS, qmath_sqrt__doc__},
+   {"exp",      (PyCFunction)(void(*)(void))qmath_exp,   METH_FASTCALL | METH_KEYWORDS, qmath_exp__doc__},
+   {"log",      (PyCFunction)(void(*)(void))qmath_log,   METH_FASTCALL | METH_KEYWORDS, qmath_log__doc__},
+   {"log10",    (PyCFunction)(void(*)(void))qmath_log10, METH_FASTCALL | METH_KEYWORDS, qmath_log10__doc__},
    
-   {"cos",      (PyCFunction)qmath_cos,      METH_O,        qmath_cos__doc__},
-   {"sin",      (PyCFunction)qmath_sin,      METH_O,        qmath_sin__doc__},
-   {"tan",      (PyCFunction)qmath_tan,      METH_O,        qmath_tan__doc__},
+   {"cos",      (PyCFunction)(void(*)(void))qmath_cos,   METH_FASTCALL | METH_KEYWORDS, qmath_cos__doc__},
+   {"sin",      (PyCFunction)(void(*)(void))qmath_sin,   METH_FASTCALL | METH_KEYWORDS, qmath_sin__doc__},
+   {"tan",      (PyCFunction)(void(*)(void))qmath_tan,   METH_FASTCALL | METH_KEYWORDS, qmath_tan__doc__},
 
-   {"acos",     (PyCFunction)qmath_acos,     METH_O,        qmath_acos__doc__},
-   {"asin",     (PyCFunction)qmath_asin,     METH_O,        qmath_asin__doc__},
-   {"atan",     (PyCFunction)qmath_atan,     METH_O,        qmath_atan__doc__},
+   {"acos",     (PyCFunction)(void(*)(void))qmath_acos,  METH_FASTCALL | METH_KEYWORDS, qmath_acos__doc__},
+   {"asin",     (PyCFunction)(void(*)(void))qmath_asin,  METH_FASTCALL | METH_KEYWORDS, qmath_asin__doc__},
+   {"atan",     (PyCFunction)(void(*)(void))qmath_atan,  METH_FASTCALL | METH_KEYWORDS, qmath_atan__doc__},
 
-   {"cosh",     (PyCFunction)qmath_cosh,     METH_O,        qmath_cosh__doc__},
-   {"sinh",     (PyCFunction)qmath_sinh,     METH_O,        qmath_sinh__doc__},
-   {"tanh",     (PyCFunction)qmath_tanh,     METH_O,        qmath_tanh__doc__},
+   {"cosh",     (PyCFunction)(void(*)(void))qmath_cosh,  METH_FASTCALL | METH_KEYWORDS, qmath_cosh__doc__},
+   {"sinh",     (PyCFunction)(void(*)(void))qmath_sinh,  METH_FASTCALL | METH_KEYWORDS, qmath_sinh__doc__},
+   {"tanh",     (PyCFunction)(void(*)(void))qmath_tanh,  METH_FASTCALL | METH_KEYWORDS, qmath_tanh__doc__},
 
-   {"acosh",    (PyCFunction)qmath_acosh,    METH_O,        qmath_acosh__doc__},
-   {"asinh",    (PyCFunction)qmath_asinh,    METH_O,        qmath_asinh__doc__},
-   {"atanh",    (PyCFunction)qmath_atanh,    METH_O,        qmath_atanh__doc__},
+   {"acosh",    (PyCFunction)(void(*)(void))qmath_acosh, METH_FASTCALL | METH_KEYWORDS, qmath_acosh__doc__},
+   {"asinh",    (PyCFunction)(void(*)(void))qmath_asinh, METH_FASTCALL | METH_KEYWORDS, qmath_asinh__doc__},
+   {"atanh",    (PyCFunction)(void(*)(void))qmath_atanh, METH_FASTCALL | METH_KEYWORDS, qmath_atanh__doc__},
 
-   {"isclose",  (PyCFunction)qmath_isclose,  METH_KEYWORDS |
-                                             METH_VARARGS,  qmath_isclose__doc__},
+   {"isclose",  (PyCFunction)(void(*)(void))qmath_isclose, METH_FASTCALL | METH_KEYWORDS, qmath_isclose__doc__},
 
    {"polar",    (PyCFunction)qmath_polar,    METH_O,        qmath_polar__doc__},
    {"axis",     (PyCFunction)qmath_axis,     METH_O,        qmath_axis__doc__},
    {"phase",    (PyCFunction)qmath_phase,    METH_O,        qmath_phase__doc__},
-   {"rect",     (PyCFunction)qmath_rect,     METH_VARARGS,  qmath_rect__doc__},
+   {"rect",     (PyCFunction)(void(*)(void))qmath_rect,  METH_FASTCALL, qmath_rect__doc__},
 
-   {"dot",      (PyCFunction)qmath_dot,      METH_VARARGS,  qmath_dot__doc__},
-   {"lerp",     (PyCFunction)qmath_lerp,     METH_VARARGS,  qmath_lerp__doc__},
-   {"slerp",    (PyCFunction)qmath_slerp,    METH_VARARGS,  qmath_slerp__doc__},
+   {"dot",      (PyCFunction)(void(*)(void))qmath_dot,   METH_FASTCALL, qmath_dot__doc__},
+   {"lerp",     (PyCFunction)(void(*)(void))qmath_lerp,  METH_FASTCALL, qmath_lerp__doc__},
+   {"slerp",    (PyCFunction)(void(*)(void))qmath_slerp, METH_FASTCALL | METH_KEYWORDS, qmath_slerp__doc__},
 
    {NULL, NULL, 0, NULL}  /* sentinel */
 };
@@ -42,11 +42,22 @@
 #include <Python.h>
 #include <pymath.h>
 
+/* We provide, rather than import, the C API.
+ */
+#define QUATERNION_MODULE 1
+
 #include "quaternion_basic.h"
 #include "quaternion_object.h"
 #include "quaternion_array.h"
 #include "quaternion_array_iter.h"
+#include "quaternion_array_stream.h"
 #include "quaternion_math.h"
+#include "quaternion_simd.h"
+#include "quaternion_parallel.h"
+#include "quaternion_allocator.h"
+#include "quaternion_interpolate.h"
+#include "quaternion_rotator.h"
+#include "quaternion_capi.h"
 
 static Py_quaternion q0 = {0.0, 0.0, 0.0, 0.0};
 static Py_quaternion q1 = {1.0, 0.0, 0.0, 0.0};
@@ -54,6 +65,49 @@ static Py_quaternion qi = {0.0, 1.0, 0.0, 0.0};
 static Py_quaternion qj = {0.0, 0.0, 1.0, 0.0};
 static Py_quaternion qk = {0.0, 0.0, 0.0, 1.0};
 
+/* The C API exported via the quaternion._C_API capsule - the type objects are
+ * filled in by module initialisation.
+ */
+static PyQuaternion_CAPI quaternionCAPI = {
+   PyQuaternion_CAPI_VERSION,
+   sizeof (PyQuaternion_CAPI),
+
+   NULL,
+   NULL,
+   NULL,
+
+   PyQuaternion_FromCQuaternion,
+   PyQuaternion_AsCQuaternion,
+   PyObject_AsCQuaternion,
+
+   PyQuaternionArrayNew,
+   PyQuaternionArrayAcquire,
+   PyQuaternionArrayRelease,
+   PyQuaternionArrayGather,
+   PyQuaternionArrayScatter,
+
+   _Py_quat_simd_sum,
+   _Py_quat_simd_diff,
+   _Py_quat_simd_prod,
+   _Py_quat_array_quot,
+   _Py_quat_simd_normalise,
+   _Py_quat_array_renormalise,
+   _Py_quat_simd_rotate,
+   _Py_quat_simd_unit_rotate,
+   _Py_quat_array_matrix_rotate,
+   _Py_quat_array_encode,
+   _Py_quat_array_decode,
+
+   _Py_quat_prod,
+   _Py_quat_quot,
+   _Py_quat_inverse,
+   _Py_quat_normalise,
+   _Py_quat_slerp,
+   _Py_quat_unit_slerp,
+   _Py_quat_rotate,
+   _Py_quat_to_rotation_matrix
+};
+
 
 static PyModuleDef QuaternionModule = {
    PyModuleDef_HEAD_INIT,       /* m_base */
@@ -172,16 +226,52 @@ PyInit_quaternion(void)
    if (PyType_Ready(quaternionArrayIterType) < 0)
       return NULL;
 
+   if (PyType_Ready(PyQuaternionArrayComponentType()) < 0)
+      return NULL;
+
+   PyTypeObject* quaternionArrayReaderType = PyQuaternionArrayReaderType();
+   if (PyType_Ready(quaternionArrayReaderType) < 0)
+      return NULL;
+
+   PyTypeObject* quaternionArrayWriterType = PyQuaternionArrayWriterType();
+   if (PyType_Ready(quaternionArrayWriterType) < 0)
+      return NULL;
+
+   PyTypeObject* quaternionRotatorType = PyQuaternionRotatorType();
+   if (PyType_Ready(quaternionRotatorType) < 0)
+      return NULL;
+
    QuaternionModule.m_methods = _PyQmathMethods ();
 
    module = PyModule_Create(&QuaternionModule);
    if (module == NULL)
       return NULL;
 
+   /* Select the SIMD kernel backend and add associated functions.
+    */
+   _Py_quat_simd_init ();
+   if (PyModule_AddFunctions(module, _PyQuaternionSimdMethods ()) < 0)
+      return NULL;
+
+   if (PyModule_AddFunctions(module, _PyQuaternionParallelMethods ()) < 0)
+      return NULL;
+
+   if (PyModule_AddFunctions(module, _PyQuaternionAllocatorMethods ()) < 0)
+      return NULL;
+
+   if (PyModule_AddFunctions(module, _PyQuaternionInterpolateMethods ()) < 0)
+      return NULL;
+
+   if (PyModule_AddFunctions(module, _PyQuaternionFreeListMethods ()) < 0)
+      return NULL;
+
    Py_INCREF(quaternionType);
    PyModule_AddObject(module, "Quaternion", (PyObject *)quaternionType);
    PyModule_AddObject(module, "QuaternionArray", (PyObject *)quaternionArrayType);
    PyModule_AddObject(module, "__ArrayIter", (PyObject *)quaternionArrayIterType);
+   PyModule_AddObject(module, "QuaternionArrayReader", (PyObject *)quaternionArrayReaderType);
+   PyModule_AddObject(module, "QuaternionArrayWriter", (PyObject *)quaternionArrayWriterType);
+   PyModule_AddObject(module, "Rotator", (PyObject *)quaternionRotatorType);
    PyModule_AddObject(module, "zero", PyQuaternion_FromCQuaternion(q0));
    PyModule_AddObject(module, "one", PyQuaternion_FromCQuaternion(q1));
    PyModule_AddObject(module, "i", PyQuaternion_FromCQuaternion(qi));
@@ -189,6 +279,14 @@ PyInit_quaternion(void)
    PyModule_AddObject(module, "k", PyQuaternion_FromCQuaternion(qk));
    PyModule_AddObject(module, "__version__", PyUnicode_FromString (__version__));
 
+   /* Export the C API for use by other extension modules.
+    */
+   quaternionCAPI.QuaternionType = quaternionType;
+   quaternionCAPI.QuaternionArrayType = quaternionArrayType;
+   quaternionCAPI.RotatorType = quaternionRotatorType;
+   PyModule_AddObject(module, "_C_API",
+                      PyCapsule_New (&quaternionCAPI, PyQuaternion_CAPSULE_NAME, NULL));
+
    /* Replicate math/cmath constants
     */
    PyModule_AddObject(module, "e",   PyFloat_FromDouble (Py_MATH_El));  // 2.718281828459045));
@@ -39,6 +39,7 @@
 
 #include "quaternion_object.h"
 #include "quaternion_utilities.h"
+#include "quaternion_rotator.h"
 #include <structmember.h>
 #include <string.h>
 
@@ -47,11 +48,26 @@
  */
 static bool do_brief_repr = false;
 
+/* Default maximum number of freed exact type Quaternion objects held for re-use.
+ */
+#define DEFAULT_FREE_LIST_LIMIT  100
+
+/* Free list of Quaternion objects, chained via ob_type - see quaternion_dealloc.
+ * Only accessed with the GIL held.
+ */
+static PyQuaternionObject *freeList = NULL;
+static Py_ssize_t numberFree = 0;
+static Py_ssize_t freeListLimit = DEFAULT_FREE_LIST_LIMIT;
+static unsigned long long freeListHits = 0;
+static unsigned long long freeListMisses = 0;
+
 
 /* Forward declarations
  */
 static PyObject *
 quaternion_subtype_from_c_quaternion(PyTypeObject *type, Py_quaternion qval);
+static void
+quaternion_dealloc (PyObject *op);
 
 /* We roll our own macro here because:
  * a) Py_ADJUST_ERANGE2 disappears in 3.11 and we have to be Py_BUILD_CORE to
@@ -154,178 +170,141 @@ to_c_quaternion(PyObject **pobj, Py_quaternion *pc)
    return false;
 }
 
-/* NOTE This wrapper macro may return and modify the obj to NULL! Nasty...
- * It also checks if obj is already Quaternion, thus saving function call
+/* ----------------------------------------------------------------------------
+ * Used internally by add, sub, mult etc. to identify real, i.e. float or int,
+ * operands, for which the cheaper real operand kernels may be used.
+ * Returns 1 and sets *real if obj is real, 0 if obj is not real, or -1 with an
+ * error set if the int conversion fails.
  */
-#define TO_C_QUATERNION(obj, c) {                                              \
-   if (PyQuaternion_Check(obj))                                                \
-      c = ((PyQuaternionObject *)(obj))->qval;                                 \
-   else if (!to_c_quaternion(&(obj), &(c)))                                    \
-      return (obj);                                                            \
+static int
+to_c_real(PyObject *obj, double *real)
+{
+   if (PyFloat_Check(obj)) {
+      *real = PyFloat_AS_DOUBLE(obj);
+      return 1;
+   }
+
+   if (PyLong_Check(obj)) {
+      *real = PyLong_AsDouble(obj);
+      if (*real == -1.0 && PyErr_Occurred()) {
+         return -1;
+      }
+      return 1;
+   }
+
+   return 0;
 }
 
-/* =============================================================================
- * init support functions.
+/* How the operands of a binary operation have been decoded.
  */
+typedef enum {
+   QN_QUATERNION_OPERANDS,  /* a and b set */
+   QN_REAL_LEFT,            /* v is real - real, a (the same value) and b set */
+   QN_REAL_RIGHT,           /* w is real - a, real and b (the same value) set */
+   QN_INVALID_OPERANDS      /* *invalid set to Py_NotImplemented or NULL */
+} Operand_kind;
 
-/* -----------------------------------------------------------------------------
- * a valid Quaternion string usually takes one of these forms:
- *
- *    <float><signed-float>i<signed-float>j<signed-float>k
- *    <float><signed-float>i<signed-float>j
- *    <float><signed-float>i<signed-float>k
- *    <float><signed-float>j<signed-float>k
- *    <float><signed-float>i
- *    <float><signed-float>j
- *    <float><signed-float>k
- *    <float>
- *
- *    <float>i<signed-float>j<signed-float>k
- *    <float>i<signed-float>j
- *    <float>i<signed-float>k
- *    <float>j<signed-float>k
- *
- *    <float>i
- *    <float>j
- *    <float>k
- *
- * where <float> represents any numeric string that's accepted by the
- * float constructor (including 'nan', 'inf', 'infinity', etc.), and
- * <signed-float> is any string of the form <float> whose first
- * character is '+' or '-'.
- *
- * i, j and k may be 'i', 'j', 'k' and/or 'I', 'J', 'K'
- * any real, i, j, k components may be ommitted, but must always be in order.
- *
- * Leading/trailing spaces allowed
- * Leading/trailing "(" and ")" allowed.
- *
- * This mirrors the complex type behaviour.
+/* ----------------------------------------------------------------------------
+ * Used internally by add, sub, mult etc. Decodes the operands straight into C
+ * values, without creating any intermediate objects.
  */
-static PyObject *
-quaternion_init_from_string_inner(const char *s, Py_ssize_t len, void *type)
+static Operand_kind
+decode_operands(PyObject *v, PyObject *w, Py_quaternion *a, Py_quaternion *b,
+                double *real, PyObject **invalid)
 {
-   Py_quaternion qval = { 0.0, 0.0, 0.0, 0.0 };  /* initialised working copy - when needed */
-
-   double r=0.0, x=0.0, y=0.0, z=0.0;
-   double dval;
-   int got_bracket=0;
-   const char *start;
-   char *end;
-   int e;
-   int allowed;
-   int at_least_one;
-
-   /* position on first non-blank */
-   start = s;
-
-   while (Py_ISSPACE(*s))
-      s++;
-
-   if (*s == '(') {
-      /* Skip over possible bracket from repr(). */
-      got_bracket = 1;
-      s++;
-      while (Py_ISSPACE(*s))
-         s++;
-   }
-
-   allowed = 1;
-   at_least_one = 0;
-   for (e = 0; e < 4; e++) {
-
-      /* first look for forms starting with <float> */
-      dval = PyOS_string_to_double(s, &end, NULL);
-      if (dval == -1.0 && PyErr_Occurred()) {
-         if (PyErr_ExceptionMatches(PyExc_ValueError))
-            PyErr_Clear();
-         else
-            return NULL;
-      }
+   PyObject *obj;
+   int status;
 
-      if (end == s) {
-         /* We did not read a float */
-         goto parse_error;
+   if (PyQuaternion_Check(v)) {
+      *a = ((PyQuaternionObject *)(v))->qval;
+      if (PyQuaternion_Check(w)) {
+         *b = ((PyQuaternionObject *)(w))->qval;
+         return QN_QUATERNION_OPERANDS;
       }
 
-      s = end;   /* skip to end of the float */
-
-      if ((allowed <= 1) &&
-          (*s != 'i')  && (*s != 'I')  &&
-          (*s != 'j')  && (*s != 'J')  &&
-          (*s != 'k')  && (*s != 'K')) {
-         r = dval;
-         at_least_one = 1;
-         allowed = 2;
-      } else if ((allowed <= 2) && (*s == 'i' || *s == 'I')) {
-         s++;
-         x = dval;
-         at_least_one = 1;
-         allowed = 3;
-      } else if ((allowed <= 3) && (*s == 'j' || *s == 'J')) {
-         s++;
-         y = dval;
-         at_least_one = 1;
-         allowed = 4;
-      } else if ((allowed <= 4) && (*s == 'k' || *s == 'K')) {
-         s++;
-         z = dval;
-         at_least_one = 1;
-         allowed = 5;
-      } else {
-         goto parse_error;
+      status = to_c_real(w, real);
+      if (status > 0) {
+         b->w = *real;
+         b->x = b->y = b->z = 0.0;
+         return QN_REAL_RIGHT;
       }
 
-      if (s-start == len) {
-         break;
-      }
+   } else if (PyQuaternion_Check(w)) {
+      *b = ((PyQuaternionObject *)(w))->qval;
 
-      if ((*s == ' ') || (*s == ')')) {
-         break;
+      status = to_c_real(v, real);
+      if (status > 0) {
+         a->w = *real;
+         a->x = a->y = a->z = 0.0;
+         return QN_REAL_LEFT;
       }
 
-      if ((allowed <= 5) && (*s == '+' || *s == '-')) {
-         /* okay */
-      } else {
-         goto parse_error;
-      }
+   } else {
+      status = 0;
    }
 
-   /* dissallow empty string */
-   if (!at_least_one)
-      goto parse_error;
+   if (status < 0) {
+      *invalid = NULL;
+      return QN_INVALID_OPERANDS;
+   }
 
-   /* trailing whitespace and closing bracket */
-   while (Py_ISSPACE(*s))
-      s++;
+   /* At least one of the operands is not a Quaternion or a real, e.g. complex.
+    */
+   obj = v;
+   if (!to_c_quaternion(&obj, a)) {
+      *invalid = obj;
+      return QN_INVALID_OPERANDS;
+   }
 
-   if (got_bracket) {
-      /* if there was an opening parenthesis, then the corresponding
-          closing parenthesis should be right here */
-      if (*s != ')')
-         goto parse_error;
-      s++;
-      while (Py_ISSPACE(*s))
-         s++;
+   obj = w;
+   if (!to_c_quaternion(&obj, b)) {
+      *invalid = obj;
+      return QN_INVALID_OPERANDS;
    }
 
-   /* we should now be at the end of the string */
-   if (s-start != len) {
-      goto parse_error;
+   return QN_QUATERNION_OPERANDS;
+}
+
+/* NOTE This wrapper macro may return from the calling function.
+ */
+#define DECODE_OPERANDS(v, w, a, b, real, kind) {                              \
+   PyObject *invalid = NULL;                                                   \
+   kind = decode_operands((v), (w), &(a), &(b), &(real), &invalid);            \
+   if (kind == QN_INVALID_OPERANDS)                                            \
+      return invalid;                                                          \
+}
+
+/* NOTE This wrapper macro may return and modify the obj to NULL! Nasty...
+ * It also checks if obj is already Quaternion, thus saving function call
+ */
+#define TO_C_QUATERNION(obj, c) {                                              \
+   if (PyQuaternion_Check(obj))                                                \
+      c = ((PyQuaternionObject *)(obj))->qval;                                 \
+   else if (!to_c_quaternion(&(obj), &(c)))                                    \
+      return (obj);                                                            \
+}
+
+/* =============================================================================
+ * init support functions.
+ */
+
+/* -----------------------------------------------------------------------------
+ * See _Py_quat_from_string for the valid Quaternion string forms.
+ */
+static PyObject *
+quaternion_init_from_string_inner(const char *s, Py_ssize_t len, void *type)
+{
+   Py_quaternion qval;
+
+   if (!_Py_quat_from_string (s, len, &qval)) {
+      if (!PyErr_Occurred()) {
+         PyErr_SetString(PyExc_ValueError,
+                         "Quaternion() arg is a malformed string");
+      }
+      return NULL;
    }
 
-   /* all good = copy the values
-    */
-   qval.w = r;
-   qval.x = x;
-   qval.y = y;
-   qval.z = z;
    return quaternion_subtype_from_c_quaternion (type, qval);
-
-parse_error:
-   PyErr_SetString(PyExc_ValueError,
-                   "Quaternion() arg is a malformed string");
-   return NULL;
 }
 
 /* -----------------------------------------------------------------------------
@@ -579,6 +558,72 @@ quaternion_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 #undef MMM
 }
 
+/* -----------------------------------------------------------------------------
+ * tp_vectorcall - used when QuaternionType (but not a subtype) is called.
+ * Up to four exact float and/or int positional arguments are decoded
+ * directly, otherwise this defers to quaternion_new.
+ */
+static PyObject *
+quaternion_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf,
+                      PyObject *kwnames)
+{
+   const Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+   PyObject *argsTuple = NULL;
+   PyObject *kwds = NULL;
+   PyObject *result = NULL;
+   Py_quaternion qval = { 0.0, 0.0, 0.0, 0.0 };
+   double* parts [4] = { &qval.w, &qval.x, &qval.y, &qval.z };
+   Py_ssize_t j;
+
+   if (!kwnames && nargs <= 4) {
+      for (j = 0; j < nargs; j++) {
+         PyObject *arg = args [j];
+         if (PyFloat_CheckExact(arg)) {
+            *parts [j] = PyFloat_AS_DOUBLE(arg);
+         } else if (PyLong_CheckExact(arg)) {
+            *parts [j] = PyLong_AsDouble(arg);
+            if (*parts [j] == -1.0 && PyErr_Occurred()) {
+               /* e.g. too large - let the general case report the error.
+                */
+               PyErr_Clear();
+               break;
+            }
+         } else {
+            break;
+         }
+      }
+
+      if (j == nargs) {
+         return quaternion_subtype_from_c_quaternion ((PyTypeObject *) type, qval);
+      }
+   }
+
+   /* The general case.
+    */
+   argsTuple = PyTuple_New(nargs);
+   if (!argsTuple) return NULL;
+   for (j = 0; j < nargs; j++) {
+      Py_INCREF(args [j]);
+      PyTuple_SET_ITEM(argsTuple, j, args [j]);
+   }
+
+   if (kwnames) {
+      kwds = PyDict_New();
+      if (!kwds) goto done;
+      for (j = 0; j < PyTuple_GET_SIZE(kwnames); j++) {
+         if (PyDict_SetItem(kwds, PyTuple_GET_ITEM(kwnames, j), args [nargs + j]) < 0)
+            goto done;
+      }
+   }
+
+   result = quaternion_new ((PyTypeObject *) type, argsTuple, kwds);
+
+done:
+   Py_XDECREF(kwds);
+   Py_DECREF(argsTuple);
+   return result;
+}
+
 /* =============================================================================
  * Methods
  */
@@ -960,32 +1005,36 @@ PyDoc_STRVAR(quaternion_round_doc,
 /* -----------------------------------------------------------------------------
  */
 PyDoc_STRVAR(quaternion_rotate_doc,
-             "quaternion.rotate (point, origin=None) -> point\n"
+             "quaternion.rotate (point, origin=None, unit=False) -> point\n"
              "\n"
              "Rotates the point using self. Self should be constructed using the angle/axis.\n"
              "option. At the very least self should be normalised.\n"
              "\n"
              "point    - is the point to be rotated, expects a tuple with 3 float elements\n"
              "origin   - the point about which the rotation occurs; when not specified or\n"
-             "           None the origin is deemed to be (0.0, 0.0, 0.0)\n");
+             "           None the origin is deemed to be (0.0, 0.0, 0.0)\n"
+             "unit     - when true, the quaternion is assumed to be a unit quaternion, and\n"
+             "           a faster rotation formula is used; the result is unspecified for a\n"
+             "           quaternion that is not of unit magnitude\n");
 
 static PyObject *
 quaternion_rotate(PyObject *self, PyObject *args, PyObject *kwds)
 {
-   static char *kwlist[] = {"point", "origin", NULL};
+   static char *kwlist[] = {"point", "origin", "unit", NULL};
 
    PyObject *result = NULL;
    PyObject *point = NULL;
    PyObject *origin = NULL;
 
+   int unit = 0;
    int s;
    Py_quat_triple c_point = { 0.0, 0.0, 0.0 };
    Py_quat_triple c_origin= { 0.0, 0.0, 0.0 };
    Py_quat_triple r_point;
 
-   /* Parse into two arguments
+   /* Parse into three arguments
     */
-   s = PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &point, &origin);
+   s = PyArg_ParseTupleAndKeywords(args, kwds, "O|Op", kwlist, &point, &origin, &unit);
    if (!s) {
       return NULL;
    }
@@ -1003,12 +1052,92 @@ quaternion_rotate(PyObject *self, PyObject *args, PyObject *kwds)
       }
    }
 
-   r_point = _Py_quat_rotate (((PyQuaternionObject *)self)->qval, c_point, c_origin);
+   if (unit) {
+      r_point = _Py_quat_unit_rotate (((PyQuaternionObject *)self)->qval, c_point, c_origin);
+   } else {
+      r_point = _Py_quat_rotate (((PyQuaternionObject *)self)->qval, c_point, c_origin);
+   }
 
    result = Py_BuildValue("(ddd)", r_point.x, r_point.y, r_point.z);
    return result;
 }
 
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_rotate_many_doc,
+             "quaternion.rotate_many (points, origin=None, out=None, unit=False) -> points\n"
+             "\n"
+             "Rotates many points using self, as per rotate(), without creating any\n"
+             "per point Python objects.\n"
+             "\n"
+             "points   - a buffer of packed x, y, z doubles, e.g. a bytes, bytearray,\n"
+             "           array.array('d') or memoryview object.\n"
+             "origin   - the point about which the rotation occurs; when not specified or\n"
+             "           None the origin is deemed to be (0.0, 0.0, 0.0)\n"
+             "out      - an optional writable buffer, the same size as points, into which\n"
+             "           the rotated points are written. This may be points itself.\n"
+             "unit     - when true, the quaternion is assumed to be a unit quaternion, and\n"
+             "           a faster rotation formula is used; the result is unspecified for a\n"
+             "           quaternion that is not of unit magnitude\n"
+             "\n"
+             "Returns out if specified, otherwise a new array.array('d') object.\n");
+
+static PyObject *
+quaternion_rotate_many(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   Py_quaternion_array single;
+
+   single.reserved = 0;
+   single.growth = 0.0;
+   single.allocated = 1;
+   single.count = 1;
+   single.qvalArray = &((PyQuaternionObject *)self)->qval;
+   single.layout = QA_LAYOUT_AOS;
+
+   return PyQuaternionUtil_RotatePoints (&single, 0, args, kwds, "rotate_many");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_rotator_doc,
+             "quaternion.rotator (origin=None) -> Rotator\n"
+             "\n"
+             "Returns a Rotator, which caches the rotation matrix of self, so that the\n"
+             "same rotation may be applied to many points at a cost of 9 multiply-adds\n"
+             "per point, e.g.:\n"
+             "\n"
+             "   r = q.rotator()\n"
+             "   for p in points:\n"
+             "      p2 = r(p)           # same as q.rotate(p)\n"
+             "\n"
+             "origin   - the point about which the rotation occurs; when not specified or\n"
+             "           None the origin is deemed to be (0.0, 0.0, 0.0)\n");
+
+static PyObject *
+quaternion_rotator(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"origin", NULL};
+
+   PyObject *origin = NULL;
+   Py_quat_triple c_origin= { 0.0, 0.0, 0.0 };
+   int s;
+
+   s = PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &origin);
+   if (!s) {
+      return NULL;
+   }
+
+   /* origin can be null or None */
+   if ((origin != NULL) && (origin != Py_None)) {
+      s = PyQuaternionUtil_ParseTriple (origin, &c_origin, "rotator", "origin");
+      if (!s) {
+         return NULL;
+      }
+   }
+
+   return PyQuaternionRotatorNew (((PyQuaternionObject *)self)->qval, c_origin);
+}
+
 /* -----------------------------------------------------------------------------
  * static methods
  */
@@ -1184,29 +1313,7 @@ quaternion_str (PyQuaternionObject *v)
 static Py_hash_t
 quaternion_hash (PyQuaternionObject *v)
 {
-   PyObject *z1, *z2;
-   Py_uhash_t hashz1, hashz2, combined;
-
-   /* z1 is the complex part of v, z2 is the other part of v as a complex number.
-    * This ensures that numbers that compare equal return same hash value.
-    */
-   z1 = (PyObject *) PyComplex_FromDoubles (v->qval.w, v->qval.y);  /* w, j */
-   z2 = (PyObject *) PyComplex_FromDoubles (v->qval.x, v->qval.z);  /* i, k */
-
-   hashz1 = z1->ob_type->tp_hash (z1);
-   hashz2 = z2->ob_type->tp_hash (z2);
-
-   z1->ob_type->tp_free (z1);
-   z2->ob_type->tp_free (z2);
-
-   combined = hashz1 + (_PyHASH_MULTIPLIER + 0x5afe) * hashz2;
-
-   /* Don't allow -1 as a hash value.
-    */
-   if (combined == (Py_uhash_t)(-1))
-      combined = (Py_uhash_t)(-2);
-
-   return (Py_hash_t)combined;
+   return PyQuaternion_HashCQuaternion (v->qval, (PyObject *) v);
 }
 
 /* -----------------------------------------------------------------------------
@@ -1251,10 +1358,15 @@ quaternion_add(PyObject *v, PyObject *w)
 {
    Py_quaternion result;
    Py_quaternion a, b;
-   TO_C_QUATERNION(v, a);
-   TO_C_QUATERNION(w, b);
+   double real;
+   Operand_kind kind;
+   DECODE_OPERANDS(v, w, a, b, real, kind);
    PyFPE_START_PROTECT("quaternion_add", return 0)
-   result = _Py_quat_sum (a, b);
+   switch (kind) {
+      case QN_REAL_LEFT:  result = _Py_quat_sum_real (b, real); break;
+      case QN_REAL_RIGHT: result = _Py_quat_sum_real (a, real); break;
+      default:            result = _Py_quat_sum (a, b);         break;
+   }
    PyFPE_END_PROTECT(result)
    return PyQuaternion_FromCQuaternion(result);
 }
@@ -1266,10 +1378,15 @@ quaternion_sub(PyObject *v, PyObject *w)
 {
    Py_quaternion result;
    Py_quaternion a, b;
-   TO_C_QUATERNION(v, a);
-   TO_C_QUATERNION(w, b);
+   double real;
+   Operand_kind kind;
+   DECODE_OPERANDS(v, w, a, b, real, kind);
    PyFPE_START_PROTECT("quaternion_sub", return 0)
-   result = _Py_quat_diff(a, b);
+   switch (kind) {
+      case QN_REAL_LEFT:  result = _Py_quat_real_diff (real, b); break;
+      case QN_REAL_RIGHT: result = _Py_quat_diff_real (a, real); break;
+      default:            result = _Py_quat_diff (a, b);         break;
+   }
    PyFPE_END_PROTECT(result)
    return PyQuaternion_FromCQuaternion(result);
 }
@@ -1281,10 +1398,15 @@ quaternion_mul(PyObject *v, PyObject *w)
 {
    Py_quaternion result;
    Py_quaternion a, b;
-   TO_C_QUATERNION(v, a);
-   TO_C_QUATERNION(w, b);
+   double real;
+   Operand_kind kind;
+   DECODE_OPERANDS(v, w, a, b, real, kind);
    PyFPE_START_PROTECT("quaternion_mul", return 0)
-   result = _Py_quat_prod(a, b);
+   switch (kind) {
+      case QN_REAL_LEFT:  result = _Py_quat_prod_real (b, real); break;
+      case QN_REAL_RIGHT: result = _Py_quat_prod_real (a, real); break;
+      default:            result = _Py_quat_prod (a, b);         break;
+   }
    PyFPE_END_PROTECT(result)
    return PyQuaternion_FromCQuaternion(result);
 }
@@ -1311,11 +1433,16 @@ quaternion_true_div(PyObject *v, PyObject *w)
 {
    Py_quaternion result;
    Py_quaternion a, b;
-   TO_C_QUATERNION(v, a);
-   TO_C_QUATERNION(w, b);
+   double real;
+   Operand_kind kind;
+   DECODE_OPERANDS(v, w, a, b, real, kind);
    PyFPE_START_PROTECT("quaternion_div", return 0)
    errno = 0;
-   result = _Py_quat_quot(a, b);
+   if (kind == QN_REAL_RIGHT) {
+      result = _Py_quat_quot_real (a, real);
+   } else {
+      result = _Py_quat_quot (a, b);
+   }
    PyFPE_END_PROTECT(result)
    if (errno == EDOM) {
       PyErr_SetString(PyExc_ZeroDivisionError, "quaternion division by zero");
@@ -1358,7 +1485,7 @@ quaternion_pow(PyObject *v, PyObject *w, PyObject *z)
 {   
    Py_quaternion result;
    Py_quaternion a;   /* v or w as appropriate */
-   double real;
+   double real = 0.0;
    bool real_is_okay;
 
    /* Cannot modulo a Quaternion, 3rd parameter not allowed.
@@ -1380,10 +1507,8 @@ quaternion_pow(PyObject *v, PyObject *w, PyObject *z)
          return Py_NotImplemented;
       }
 
-      TO_C_QUATERNION(v, a);
-      real_is_okay = PyQuaternionUtil_NumberAsDouble (w, &real);
-      if (!real_is_okay) {
-         PyErr_SetString(PyExc_TypeError, "Quaternion pow() argument 2 didn't return a float");
+      a = ((PyQuaternionObject *)(v))->qval;
+      if (to_c_real (w, &real) < 0) {
          return NULL;
       }
 
@@ -1407,10 +1532,8 @@ quaternion_pow(PyObject *v, PyObject *w, PyObject *z)
          return Py_NotImplemented;
       }
 
-      TO_C_QUATERNION(w, a);
-      real_is_okay = PyQuaternionUtil_NumberAsDouble (v, &real);
-      if (!real_is_okay) {
-         PyErr_SetString(PyExc_TypeError, "Quaternion pow() argument 1 didn't return a float");
+      a = ((PyQuaternionObject *)(w))->qval;
+      if (to_c_real (v, &real) < 0) {
          return NULL;
       }
 
@@ -1677,6 +1800,10 @@ static PyMethodDef QuaternionMethods [] = {
    {"axis",           (PyCFunction)quaternion_axis,         METH_NOARGS,   quaternion_axis_doc},
    {"rotate",         (PyCFunction)quaternion_rotate,       METH_VARARGS |
                                                             METH_KEYWORDS, quaternion_rotate_doc},
+   {"rotate_many",    (PyCFunction)quaternion_rotate_many,  METH_VARARGS |
+                                                            METH_KEYWORDS, quaternion_rotate_many_doc},
+   {"rotator",        (PyCFunction)quaternion_rotator,      METH_VARARGS |
+                                                            METH_KEYWORDS, quaternion_rotator_doc},
    {"for_repr_use_str",(PyCFunction)quaternion_for_repr_use_str, METH_STATIC |
                                                             METH_NOARGS,   quaternion_for_repr_use_str_doc},
    {"repr_reset",     (PyCFunction)quaternion_repr_reset,   METH_STATIC |
@@ -1806,7 +1933,7 @@ static PyTypeObject QuaternionType = {
    "quaternion.Quaternion",                   /* tp_name */
    sizeof(PyQuaternionObject),                /* tp_basicsize */
    0,                                         /* tp_itemsize */
-   0,                                         /* tp_dealloc */
+   (destructor)quaternion_dealloc,            /* tp_dealloc */
    0,                                         /* tp_print */
    0,                                         /* tp_getattr */
    0,                                         /* tp_setattr */
@@ -1840,7 +1967,17 @@ static PyTypeObject QuaternionType = {
    0,                                         /* tp_init */
    (allocfunc)PyType_GenericAlloc,            /* tp_alloc */
    (newfunc)quaternion_new,                   /* tp_new */
-   PyObject_Del                               /* tp_free */
+   PyObject_Del,                              /* tp_free */
+   0,                                         /* tp_is_gc */
+   0,                                         /* tp_bases */
+   0,                                         /* tp_mro */
+   0,                                         /* tp_cache */
+   0,                                         /* tp_subclasses */
+   0,                                         /* tp_weaklist */
+   0,                                         /* tp_del */
+   0,                                         /* tp_version_tag */
+   0,                                         /* tp_finalize */
+   (vectorcallfunc)quaternion_vectorcall      /* tp_vectorcall */
 };
 
 /* Allow module defn code to access the Quaternion PyTypeObject.
@@ -1884,6 +2021,62 @@ Py_quaternion PyQuaternion_AsCQuaternion(PyObject *obj)
    return r;
 }
 
+/* -----------------------------------------------------------------------------
+ * Returns a new exact type Quaternion object, qval is not set.
+ * Objects are taken from the free list when available, otherwise allocated.
+ */
+static PyQuaternionObject *
+quaternion_alloc (void)
+{
+   PyQuaternionObject *op = freeList;
+
+   if (op) {
+      freeList = (PyQuaternionObject *) Py_TYPE(op);
+      numberFree--;
+      freeListHits++;
+   } else {
+      op = (PyQuaternionObject *) PyObject_MALLOC(sizeof(PyQuaternionObject));  /* Inline PyObject_New */
+      if (op == NULL)
+         return (PyQuaternionObject *) PyErr_NoMemory();
+      freeListMisses++;
+   }
+
+   (void)PyObject_INIT(op, &QuaternionType);   /* sets ref count to 1 plus stuff */
+   return op;
+}
+
+/* -----------------------------------------------------------------------------
+ * tp_dealloc - exact type Quaternion objects are put on the free list, subject
+ * to the limit. Subtype objects also end up here via subtype_dealloc.
+ */
+static void
+quaternion_dealloc (PyObject *op)
+{
+   if (Py_IS_TYPE(op, &QuaternionType) && numberFree < freeListLimit) {
+      /* Chain the free list via ob_type, cf. the float free list.
+       */
+      Py_SET_TYPE(op, (PyTypeObject *) freeList);
+      freeList = (PyQuaternionObject *) op;
+      numberFree++;
+      return;
+   }
+   Py_TYPE(op)->tp_free(op);
+}
+
+/* -----------------------------------------------------------------------------
+ * Releases free list objects until there are no more than limit.
+ */
+static void
+quaternion_trim_free_list (const Py_ssize_t limit)
+{
+   while (freeList && numberFree > limit) {
+      PyQuaternionObject *op = freeList;
+      freeList = (PyQuaternionObject *) Py_TYPE(op);
+      numberFree--;
+      PyObject_FREE(op);
+   }
+}
+
 /* -----------------------------------------------------------------------------
  * Returns a reference to a PyObject set to qval
  */
@@ -1892,6 +2085,9 @@ quaternion_subtype_from_c_quaternion(PyTypeObject *type, Py_quaternion qval)
 {
     PyObject *op;
 
+    if (type == &QuaternionType)
+        return PyQuaternion_FromCQuaternion(qval);
+
     op = type->tp_alloc(type, 0);
     if (op != NULL)
         ((PyQuaternionObject *)op)->qval = qval;
@@ -1905,16 +2101,139 @@ PyObject *
 PyQuaternion_FromCQuaternion(const Py_quaternion qval)
 {
    PyQuaternionObject *op;
-   op = (PyQuaternionObject *) PyObject_MALLOC(sizeof(PyQuaternionObject));  /* Inline PyObject_New */
+   op = quaternion_alloc ();
    if (op == NULL)
-      return PyErr_NoMemory();
-
-   (void)PyObject_INIT(op, &QuaternionType);   /* sets ref count to 1 plus stuff */
+      return NULL;
 
    op->qval = qval;
    return (PyObject *) op;
 }
 
+
+/* -----------------------------------------------------------------------------
+ * Free list module functions
+ * -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(free_list_stats_doc,
+             "free_list_stats() -> dict\n"
+             "\n"
+             "Returns a dictionary with the Quaternion free list statistics: size, the\n"
+             "number of objects currently held, limit, the maximum number held, hits, the\n"
+             "number of allocations satisfied from the free list, and misses, the number of\n"
+             "allocations that were not.");
+
+static PyObject *
+free_list_stats (PyObject *module, PyObject *noargs)
+{
+   return Py_BuildValue("{snsnsKsK}",
+                        "size", numberFree,
+                        "limit", freeListLimit,
+                        "hits", freeListHits,
+                        "misses", freeListMisses);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(set_free_list_limit_doc,
+             "set_free_list_limit(n, /)\n"
+             "\n"
+             "Sets the maximum number of freed Quaternion objects held for re-use. 0 disables\n"
+             "the free list. The default is 100. Objects in excess of the new limit are freed.");
+
+static PyObject *
+set_free_list_limit (PyObject *module, PyObject *arg)
+{
+   Py_ssize_t n;
+
+   if (!PyLong_Check (arg)) {
+      PyErr_Format(PyExc_TypeError,
+                   "set_free_list_limit() argument must be int, not '%.200s'",
+                   Py_TYPE(arg)->tp_name);
+      return NULL;
+   }
+
+   n = PyLong_AsSsize_t (arg);
+   if (n == -1 && PyErr_Occurred ())
+      return NULL;
+
+   if (n < 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "set_free_list_limit() argument can't be negative (got %ld)", n);
+      return NULL;
+   }
+
+   freeListLimit = n;
+   quaternion_trim_free_list (n);
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef free_list_methods[] = {
+   {"free_list_stats",     (PyCFunction)free_list_stats,     METH_NOARGS, free_list_stats_doc},
+   {"set_free_list_limit", (PyCFunction)set_free_list_limit, METH_O,      set_free_list_limit_doc},
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ * Allow module definition code to access the free list PyMethodDef.
+ */
+PyMethodDef* _PyQuaternionFreeListMethods ()
+{
+   return free_list_methods;
+}
+
+/* -----------------------------------------------------------------------------
+ * From Python 3.10, NaN values hash as per the object identity.
+ */
+#if PY_VERSION_HEX >= 0x030A0000
+#define QN_HASH_DOUBLE(inst, v)  _Py_HashDouble ((inst), (v))
+#else
+#define QN_HASH_DOUBLE(inst, v)  _Py_HashDouble ((v))
+#endif
+
+/* -----------------------------------------------------------------------------
+ * Returns the hash of the complex number (a + b.j), as per the complex type.
+ */
+static inline Py_uhash_t
+quaternion_complex_hash (PyObject *inst, const double a, const double b)
+{
+   Py_uhash_t hasha, hashb, combined;
+
+   hasha = (Py_uhash_t) QN_HASH_DOUBLE (inst, a);
+   hashb = (Py_uhash_t) QN_HASH_DOUBLE (inst, b);
+
+   combined = hasha + _PyHASH_IMAG * hashb;
+   if (combined == (Py_uhash_t)(-1))
+      combined = (Py_uhash_t)(-2);
+
+   return combined;
+}
+
+/* -----------------------------------------------------------------------------
+ * The complex part of q (w, j) and the other part (i, k) are hashed as complex
+ * numbers, and combined. This ensures that numbers that compare equal return
+ * same hash value, e.g. hash (Quaternion (z)) == hash (z).
+ * The hashes are calculated directly, i.e. without creating complex objects.
+ */
+Py_hash_t
+PyQuaternion_HashCQuaternion (const Py_quaternion qval, PyObject *inst)
+{
+   Py_uhash_t hashz1, hashz2, combined;
+
+   hashz1 = quaternion_complex_hash (inst, qval.w, qval.y);  /* w, j */
+   hashz2 = quaternion_complex_hash (inst, qval.x, qval.z);  /* i, k */
+
+   combined = hashz1 + (_PyHASH_MULTIPLIER + 0x5afe) * hashz2;
+
+   /* Don't allow -1 as a hash value.
+    */
+   if (combined == (Py_uhash_t)(-1))
+      combined = (Py_uhash_t)(-2);
+
+   return (Py_hash_t)combined;
+}
+
 /* -----------------------------------------------------------------------------
  * Returns the object convert to a PyQuaternionObject or NULL
  */
@@ -51,6 +51,10 @@ typedef struct {
  */
 PyAPI_FUNC (PyTypeObject*) PyQuaternionType ();
 
+/* Provides a reference to the free list module functions provided by quaternion_object.c
+ */
+PyAPI_FUNC (PyMethodDef*) _PyQuaternionFreeListMethods ();
+
 /* Quaternion type check functions
  * We use functions as opposed to macros like the complex type
  * as we need to access to the PyQuaternionType anyway.
@@ -62,6 +66,13 @@ PyAPI_FUNC (bool) PyQuaternion_CheckExact (PyObject *op);
  */
 PyAPI_FUNC (Py_quaternion) PyQuaternion_AsCQuaternion(PyObject *op);
 
+/* Returns the hash of qval, as per hash (Quaternion (qval)). This is consistent
+ * with the float and complex hashes, i.e. hash (Quaternion (z)) == hash (z).
+ * NaN components hash as per inst (from Python 3.10).
+ * This does not create any objects, and so may be called without the GIL.
+ */
+PyAPI_FUNC (Py_hash_t) PyQuaternion_HashCQuaternion (const Py_quaternion qval, PyObject *inst);
+
 /* Return Python Quaternion from C quaternion (new object)
  */
 PyAPI_FUNC (PyObject *) PyQuaternion_FromCQuaternion(const Py_quaternion);
@@ -0,0 +1,357 @@
+/* quaternion_parallel.c
+ *
+ * This file is part of the Python quaternion module. It provides a small worker
+ * thread pool used to split large QuaternionArray operations across threads.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#include "quaternion_parallel.h"
+#include <pythread.h>
+#include <errno.h>
+
+#if defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#endif
+
+/* Default minimum number of items for which an operation is split across threads.
+ */
+#define DEFAULT_THRESHOLD  65536
+
+/* Chunk sizes are rounded up to a multiple of this (8 quaternions = 256 bytes),
+ * so that chunk boundaries fall on cache line and SIMD group boundaries.
+ */
+#define CHUNK_GRANULE  8
+
+/* Each worker thread waits on its start lock, which the dispatcher releases
+ * once the task details have been set up. When the task is complete, the
+ * worker releases its done lock, on which the dispatcher waits.
+ * Note: PyThread locks are not owned, so may be released by any thread.
+ */
+typedef struct {
+   PyThread_type_lock start;
+   PyThread_type_lock done;
+   Py_quat_parallel_task task;
+   void* context;
+   int chunk;
+   size_t begin;
+   size_t end;
+   int error;
+} Worker;
+
+static Worker workers [QUAT_PARALLEL_MAX_THREADS - 1];
+static int numberStarted = 0;          /* number of worker threads running */
+static int numberThreads = 0;          /* number of threads to use, 0 means not set yet */
+static Py_ssize_t threshold = DEFAULT_THRESHOLD;
+static PyThread_type_lock poolLock = NULL;
+
+#if defined(HAVE_FORK)
+static pid_t poolPid = 0;              /* the process that started the workers */
+#endif
+
+
+/* -----------------------------------------------------------------------------
+ * Returns the number of online processors, or 1 if this cannot be determined.
+ */
+static int
+default_number_threads (void)
+{
+   long result = 1;
+
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+   result = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+   if (result < 1) result = 1;
+   if (result > QUAT_PARALLEL_MAX_THREADS) result = QUAT_PARALLEL_MAX_THREADS;
+   return (int) result;
+}
+
+/* -----------------------------------------------------------------------------
+ * Worker thread main loop - never returns. The worker threads have no Python
+ * thread state, and so do not hinder interpreter finalisation.
+ */
+static void
+worker_main (void* arg)
+{
+   Worker* worker = (Worker*) arg;
+
+   for (;;) {
+      PyThread_acquire_lock (worker->start, WAIT_LOCK);
+      errno = 0;
+      worker->task (worker->context, worker->chunk, worker->begin, worker->end);
+      worker->error = errno;
+      PyThread_release_lock (worker->done);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ * Ensure at least required worker threads are running, GIL must be held.
+ * Returns the number of worker threads actually available.
+ */
+static int
+start_workers (const int required)
+{
+#if defined(HAVE_FORK)
+   /* After a fork, only the forking thread exists in the child process.
+    * The child just abandons the old locks and starts afresh.
+    */
+   if (numberStarted > 0 && poolPid != getpid ()) {
+      numberStarted = 0;
+      poolLock = NULL;
+   }
+#endif
+
+   if (!poolLock) {
+      poolLock = PyThread_allocate_lock ();
+      if (!poolLock) return 0;
+   }
+
+   while (numberStarted < required) {
+      Worker* worker = &workers [numberStarted];
+
+      worker->start = PyThread_allocate_lock ();
+      worker->done = PyThread_allocate_lock ();
+      if (worker->start && worker->done) {
+         /* Both locks start off held by the dispatcher.
+          */
+         PyThread_acquire_lock (worker->start, WAIT_LOCK);
+         PyThread_acquire_lock (worker->done, WAIT_LOCK);
+         if (PyThread_start_new_thread (worker_main, worker) != PYTHREAD_INVALID_THREAD_ID) {
+            numberStarted++;
+            continue;
+         }
+      }
+
+      /* Not able to start another thread - make do with what we have.
+       */
+      if (worker->start) PyThread_free_lock (worker->start);
+      if (worker->done) PyThread_free_lock (worker->done);
+      break;
+   }
+
+#if defined(HAVE_FORK)
+   poolPid = getpid ();
+#endif
+
+   return numberStarted < required ? numberStarted : required;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+int
+_Py_quat_parallel_run (Py_quat_parallel_task task, void* context, const size_t n)
+{
+   size_t size;
+   int chunks;
+   int error;
+   int k;
+
+   if (n < (size_t) threshold || n == 0) {
+      errno = 0;
+      task (context, 0, 0, n);
+      return 1;
+   }
+
+   if (numberThreads == 0) {
+      numberThreads = default_number_threads ();
+   }
+
+   /* If another thread is already using the pool, we just use this thread.
+    */
+   chunks = 1;
+   if (numberThreads > 1) {
+      chunks = 1 + start_workers (numberThreads - 1);
+      if (chunks > 1 && !PyThread_acquire_lock (poolLock, NOWAIT_LOCK)) {
+         chunks = 1;
+      }
+   }
+
+   size = (n + chunks - 1) / chunks;
+   size = ((size + CHUNK_GRANULE - 1) / CHUNK_GRANULE) * CHUNK_GRANULE;
+   k = (int) ((n + size - 1) / size);
+   if (k < chunks) {
+      /* Only happens for small arrays, i.e. when the threshold has been lowered
+       */
+      if (k == 1) PyThread_release_lock (poolLock);
+      chunks = k;
+   }
+
+   Py_BEGIN_ALLOW_THREADS
+
+   for (k = 1; k < chunks; k++) {
+      Worker* worker = &workers [k - 1];
+      worker->task = task;
+      worker->context = context;
+      worker->chunk = k;
+      worker->begin = k * size;
+      worker->end = (k + 1) * size < n ? (k + 1) * size : n;
+      worker->error = 0;
+      PyThread_release_lock (worker->start);
+   }
+
+   /* The calling thread does the first chunk.
+    */
+   errno = 0;
+   task (context, 0, 0, size < n ? size : n);
+   error = errno;
+
+   for (k = 1; k < chunks; k++) {
+      Worker* worker = &workers [k - 1];
+      PyThread_acquire_lock (worker->done, WAIT_LOCK);
+      if (error == 0) error = worker->error;
+   }
+
+   Py_END_ALLOW_THREADS
+
+   if (chunks > 1) {
+      PyThread_release_lock (poolLock);
+   }
+
+   errno = error;
+   return chunks;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Module functions
+ * -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(num_threads_doc,
+             "num_threads() -> int\n"
+             "\n"
+             "Returns the number of threads, including the calling thread, used for large\n"
+             "QuaternionArray operations. The default is the number of online processors.");
+
+static PyObject *
+num_threads (PyObject *module, PyObject *noargs)
+{
+   if (numberThreads == 0) {
+      numberThreads = default_number_threads ();
+   }
+   return PyLong_FromLong (numberThreads);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(set_num_threads_doc,
+             "set_num_threads(n, /)\n"
+             "\n"
+             "Sets the number of threads, including the calling thread, used for large\n"
+             "QuaternionArray operations. n must be in the range 1 to 64, or 0 to restore\n"
+             "the default. Worker threads are started when first needed.");
+
+static PyObject *
+set_num_threads (PyObject *module, PyObject *arg)
+{
+   long n;
+
+   if (!PyLong_Check (arg)) {
+      PyErr_Format(PyExc_TypeError,
+                   "set_num_threads() argument must be int, not '%.200s'",
+                   Py_TYPE(arg)->tp_name);
+      return NULL;
+   }
+
+   n = PyLong_AsLong (arg);
+   if (n == -1 && PyErr_Occurred ())
+      return NULL;
+
+   if (n < 0 || n > QUAT_PARALLEL_MAX_THREADS) {
+      PyErr_Format(PyExc_ValueError,
+                   "set_num_threads() argument must be in range 0 to %d (got %ld)",
+                   QUAT_PARALLEL_MAX_THREADS, n);
+      return NULL;
+   }
+
+   numberThreads = n > 0 ? (int) n : default_number_threads ();
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(parallel_threshold_doc,
+             "parallel_threshold() -> int\n"
+             "\n"
+             "Returns the minimum number of items for which QuaternionArray operations\n"
+             "release the GIL and are split across threads.");
+
+static PyObject *
+parallel_threshold (PyObject *module, PyObject *noargs)
+{
+   return PyLong_FromSsize_t (threshold);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(set_parallel_threshold_doc,
+             "set_parallel_threshold(n, /)\n"
+             "\n"
+             "Sets the minimum number of items for which QuaternionArray operations\n"
+             "release the GIL and are split across threads. The default is 65536.");
+
+static PyObject *
+set_parallel_threshold (PyObject *module, PyObject *arg)
+{
+   Py_ssize_t n;
+
+   if (!PyLong_Check (arg)) {
+      PyErr_Format(PyExc_TypeError,
+                   "set_parallel_threshold() argument must be int, not '%.200s'",
+                   Py_TYPE(arg)->tp_name);
+      return NULL;
+   }
+
+   n = PyLong_AsSsize_t (arg);
+   if (n == -1 && PyErr_Occurred ())
+      return NULL;
+
+   if (n < 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "set_parallel_threshold() argument can't be negative (got %ld)", n);
+      return NULL;
+   }
+
+   threshold = n;
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef parallel_methods[] = {
+   {"num_threads",            (PyCFunction)num_threads,            METH_NOARGS, num_threads_doc},
+   {"parallel_threshold",     (PyCFunction)parallel_threshold,     METH_NOARGS, parallel_threshold_doc},
+   {"set_num_threads",        (PyCFunction)set_num_threads,        METH_O,      set_num_threads_doc},
+   {"set_parallel_threshold", (PyCFunction)set_parallel_threshold, METH_O,      set_parallel_threshold_doc},
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ * Allow module definition code to access the parallel PyMethodDef.
+ */
+PyMethodDef* _PyQuaternionParallelMethods ()
+{
+   return parallel_methods;
+}
+
+/* end */
@@ -0,0 +1,63 @@
+/* quaternion_parallel.h
+ *
+ * This file is part of the Python quaternion module. It provides a small worker
+ * thread pool used to split large QuaternionArray operations across threads.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#ifndef QUATERNION_PARALLEL_H
+#define QUATERNION_PARALLEL_H 1
+
+#include <Python.h>
+#include <stddef.h>
+
+/* The maximum number of threads, including the calling thread, and hence also
+ * the maximum number of chunks into which an operation is split.
+ */
+#define QUAT_PARALLEL_MAX_THREADS  64
+
+/* A task processes items [begin, end) of an operation. The chunk number is in
+ * the range 0 to QUAT_PARALLEL_MAX_THREADS - 1, and allows a task to store a
+ * per chunk partial result.
+ * Tasks are called without the GIL, and so must not use the Python C-API.
+ * A task may report an error by setting errno, as per the bulk functions.
+ */
+typedef void (*Py_quat_parallel_task) (void* context, const int chunk,
+                                       const size_t begin, const size_t end);
+
+/* Runs task over items [0, n). This must be called with the GIL held.
+ * When n is at least the parallel threshold, the GIL is released and the
+ * range is split across the worker threads and the calling thread, otherwise
+ * the task is just called directly as task (context, 0, 0, n).
+ *
+ * Returns the number of chunks used, i.e. 1 to QUAT_PARALLEL_MAX_THREADS.
+ * On return, errno is zero or is the first non-zero errno from any chunk.
+ */
+int _Py_quat_parallel_run (Py_quat_parallel_task task, void* context, const size_t n);
+
+/* Provides a reference to the module level functions provided by quaternion_parallel.c
+ */
+PyAPI_FUNC (PyMethodDef*) _PyQuaternionParallelMethods ();
+
+#endif  /* QUATERNION_PARALLEL_H */
@@ -0,0 +1,431 @@
+/* quaternion_rotator.c
+ *
+ * This file is part of the Python quaternion module. It provides the Rotator
+ * type, which caches the rotation matrix of a quaternion, so that rotating many
+ * points with the same quaternion costs 9 multiply-adds per point.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#include "quaternion_rotator.h"
+#include "quaternion_object.h"
+#include "quaternion_parallel.h"
+#include "quaternion_utilities.h"
+
+static PyTypeObject QuaternionRotatorType;
+
+/* -----------------------------------------------------------------------------
+ * Allocates a new rotator of the given type, and calculates the matrix.
+ */
+static PyObject *
+rotator_alloc(PyTypeObject *type, const Py_quaternion q, const Py_quat_triple origin)
+{
+   PyQuaternionRotatorObject *self;
+
+   self = (PyQuaternionRotatorObject *) type->tp_alloc(type, 0);
+   if (!self)
+      return NULL;
+
+   self->qval = q;
+   self->origin = origin;
+   _Py_quat_to_scaled_rotation_matrix (q, &self->matrix);
+
+   return (PyObject *) self;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyObject *
+PyQuaternionRotatorNew(const Py_quaternion q, const Py_quat_triple origin)
+{
+   return rotator_alloc (&QuaternionRotatorType, q, origin);
+}
+
+/* -----------------------------------------------------------------------------
+ * Decode a point - tuples of floats, by far the common case, are decoded directly.
+ */
+static bool
+rotator_parse_point(PyObject *obj, Py_quat_triple* point, const char* fname)
+{
+   if (PyTuple_CheckExact (obj) && PyTuple_GET_SIZE (obj) == 3 &&
+       PyFloat_CheckExact (PyTuple_GET_ITEM (obj, 0)) &&
+       PyFloat_CheckExact (PyTuple_GET_ITEM (obj, 1)) &&
+       PyFloat_CheckExact (PyTuple_GET_ITEM (obj, 2))) {
+      point->x = PyFloat_AS_DOUBLE (PyTuple_GET_ITEM (obj, 0));
+      point->y = PyFloat_AS_DOUBLE (PyTuple_GET_ITEM (obj, 1));
+      point->z = PyFloat_AS_DOUBLE (PyTuple_GET_ITEM (obj, 2));
+      return true;
+   }
+
+   return PyQuaternionUtil_ParseTriple (obj, point, fname, "point");
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+rotator_rotate_point(PyQuaternionRotatorObject *self, PyObject *point,
+                     const char* fname)
+{
+   Py_quat_triple p;
+   Py_quat_triple r;
+
+   if (!rotator_parse_point (point, &p, fname)) {
+      return NULL;
+   }
+
+   r = _Py_quat_matrix_rotate (&self->matrix, p, self->origin);
+   return Py_BuildValue("(ddd)", r.x, r.y, r.z);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_rotator_rotate_doc,
+             "rotate(self, point, /) -> point\n"
+             "Rotates the point, a sequence of 3 floats, as per Quaternion.rotate(),\n"
+             "using the cached matrix. Calling the rotator, i.e. r(point), is equivalent.");
+
+static PyObject *
+quaternion_rotator_rotate(PyObject *self, PyObject *point)
+{
+   return rotator_rotate_point ((PyQuaternionRotatorObject *) self, point, "rotate");
+}
+
+/* -----------------------------------------------------------------------------
+ * tp_call
+ */
+static PyObject *
+quaternion_rotator_call(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   if (!PyTuple_Check (args) || PyTuple_GET_SIZE (args) != 1 ||
+       (kwds && PyDict_GET_SIZE (kwds) != 0)) {
+      PyErr_SetString(PyExc_TypeError, "Rotator() takes exactly one positional argument");
+      return NULL;
+   }
+
+   return rotator_rotate_point ((PyQuaternionRotatorObject *) self,
+                                PyTuple_GET_ITEM (args, 0), "Rotator");
+}
+
+/* -----------------------------------------------------------------------------
+ * Rotates a chunk of points - large numbers of points are split across threads.
+ */
+typedef struct {
+   const Py_quat_matrix* matrix;
+   const Py_quat_triple* points;
+   Py_quat_triple* r;
+   Py_quat_triple origin;
+} rotator_context;
+
+static void
+rotator_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   rotator_context* c = (rotator_context*) context;
+
+   _Py_quat_array_matrix_rotate (c->matrix, c->points + begin, c->r + begin,
+                                 end - begin, c->origin);
+}
+
+static void
+rotator_rotate_points (PyQuaternionRotatorObject *self,
+                       const void* points, void* r, const size_t n)
+{
+   rotator_context context;
+
+   context.matrix = &self->matrix;
+   context.points = (const Py_quat_triple*) points;
+   context.r = (Py_quat_triple*) r;
+   context.origin = self->origin;
+   _Py_quat_parallel_run (rotator_task, &context, n);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_rotator_rotate_many_doc,
+             "rotate_many(self, points, out=None) -> points\n"
+             "Rotates many points using the cached matrix, as per Quaternion.rotate_many(),\n"
+             "without creating any per point Python objects.\n"
+             "\n"
+             "points   - a buffer of packed x, y, z doubles, e.g. a bytes, bytearray,\n"
+             "           array.array('d') or memoryview object.\n"
+             "out      - an optional writable buffer, the same size as points, into which\n"
+             "           the rotated points are written. This may be points itself.\n"
+             "\n"
+             "Returns out if specified, otherwise a new array.array('d') object.");
+
+static PyObject *
+quaternion_rotator_rotate_many(PyObject *self, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"points", "out", NULL};
+   static const char* fname = "rotate_many";
+
+   PyQuaternionRotatorObject *pObj = (PyQuaternionRotatorObject *) self;
+   PyObject *result = NULL;
+   PyObject *pointsObj = NULL;
+   PyObject *outObj = NULL;
+   Py_buffer points;
+   Py_buffer out;
+   Py_ssize_t npoints;
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &pointsObj, &outObj)) {
+      return NULL;
+   }
+
+   if (!PyQuaternionUtil_GetDoubleBuffer (pointsObj, &points, false, 3, fname, "points")) {
+      return NULL;
+   }
+
+   npoints = points.len / sizeof (Py_quat_triple);
+
+   if ((outObj != NULL) && (outObj != Py_None)) {
+      if (!PyQuaternionUtil_GetDoubleBuffer (outObj, &out, true, 3, fname, "out")) {
+         PyBuffer_Release(&points);
+         return NULL;
+      }
+
+      if (out.len != points.len) {
+         PyErr_Format(PyExc_ValueError,
+                      "%.200s (out): buffer length %ld differs from points buffer length %ld",
+                      fname, out.len, points.len);
+         PyBuffer_Release(&out);
+         PyBuffer_Release(&points);
+         return NULL;
+      }
+
+      rotator_rotate_points (pObj, points.buf, out.buf, npoints);
+
+      PyBuffer_Release(&out);
+      Py_INCREF(outObj);
+      result = outObj;
+
+   } else {
+      /* Create a copy of the points as an array of doubles, and rotate in place.
+       */
+      result = PyQuaternionUtil_NewArray ('d', points.buf, points.len);
+      if (result) {
+         if (PyQuaternionUtil_GetDoubleBuffer (result, &out, true, 3, fname, "out")) {
+            rotator_rotate_points (pObj, out.buf, out.buf, npoints);
+            PyBuffer_Release(&out);
+         } else {
+            Py_CLEAR(result);
+         }
+      }
+   }
+
+   PyBuffer_Release(&points);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+quaternion_rotator_get_quaternion(PyQuaternionRotatorObject *self, void *closure)
+{
+   return PyQuaternion_FromCQuaternion (self->qval);
+}
+
+static PyObject *
+quaternion_rotator_get_origin(PyQuaternionRotatorObject *self, void *closure)
+{
+   return Py_BuildValue("(ddd)", self->origin.x, self->origin.y, self->origin.z);
+}
+
+static PyObject *
+quaternion_rotator_get_matrix(PyQuaternionRotatorObject *self, void *closure)
+{
+   const Py_quat_matrix* m = &self->matrix;
+   return Py_BuildValue("((ddd)(ddd)(ddd))",
+                        m->r11, m->r12, m->r13,
+                        m->r21, m->r22, m->r23,
+                        m->r31, m->r32, m->r33);
+}
+
+static PyGetSetDef quaternion_rotator_getset[] = {
+   {"quaternion", (getter)quaternion_rotator_get_quaternion, NULL,
+    "the rotation quaternion", NULL},
+   {"origin",     (getter)quaternion_rotator_get_origin,     NULL,
+    "the point about which the rotation occurs", NULL},
+   {"matrix",     (getter)quaternion_rotator_get_matrix,     NULL,
+    "the cached 3x3 matrix, as a tuple of row tuples", NULL},
+   {NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+quaternion_rotator_reduce(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+   PyQuaternionRotatorObject *pObj = (PyQuaternionRotatorObject *) self;
+   PyObject *q;
+   PyObject *result;
+
+   q = PyQuaternion_FromCQuaternion (pObj->qval);
+   if (!q) return NULL;
+   result = Py_BuildValue("(O(O(ddd)))", Py_TYPE(self), q,
+                          pObj->origin.x, pObj->origin.y, pObj->origin.z);
+   Py_DECREF(q);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef quaternion_rotator_methods[] = {
+   {"rotate",      (PyCFunction)quaternion_rotator_rotate,      METH_O,
+                                                      quaternion_rotator_rotate_doc      },
+   {"rotate_many", (PyCFunction)quaternion_rotator_rotate_many, METH_VARARGS | METH_KEYWORDS,
+                                                      quaternion_rotator_rotate_many_doc },
+   {"__reduce__",  (PyCFunction)quaternion_rotator_reduce,      METH_NOARGS,  NULL },
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+quaternion_rotator_repr(PyQuaternionRotatorObject *self)
+{
+   PyObject *q;
+   PyObject *origin;
+   PyObject *result = NULL;
+
+   q = PyQuaternion_FromCQuaternion (self->qval);
+   origin = quaternion_rotator_get_origin (self, NULL);
+   if (q && origin) {
+      result = PyUnicode_FromFormat("%s(%R, origin=%R)", Py_TYPE(self)->tp_name, q, origin);
+   }
+   Py_XDECREF(origin);
+   Py_XDECREF(q);
+   return result;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyObject *
+quaternion_rotator_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+   static char *kwlist[] = {"q", "origin", NULL};
+
+   PyObject *qObj = NULL;
+   PyObject *originObj = NULL;
+   Py_quaternion q;
+   Py_quat_triple origin = { 0.0, 0.0, 0.0 };
+
+   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O:Rotator", kwlist, &qObj, &originObj))
+      return NULL;
+
+   if (!PyObject_AsCQuaternion (qObj, &q)) {
+      PyErr_Format(PyExc_TypeError,
+                   "Rotator() q must be a number or Quaternion, not '%.200s'",
+                   Py_TYPE(qObj)->tp_name);
+      return NULL;
+   }
+
+   if ((originObj != NULL) && (originObj != Py_None)) {
+      if (!PyQuaternionUtil_ParseTriple (originObj, &origin, "Rotator", "origin"))
+         return NULL;
+   }
+
+   return rotator_alloc (type, q, origin);
+}
+
+/* -----------------------------------------------------------------------------
+ * tp_dealloc
+ */
+static void
+quaternion_rotator_dealloc(PyObject *self)
+{
+   Py_TYPE(self)->tp_free(self);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(quaternion_rotator_doc,
+             "Rotator(q, origin=None)\n"
+             "Rotates points using the quaternion q, about origin, as per q.rotate(), but\n"
+             "with the rotation matrix calculated the once, so each point costs just\n"
+             "9 multiply-adds. Also available as q.rotator(origin=None).\n"
+             "\n"
+             "Like q.rotate(), the matrix includes the abs(q)**2 scaling of q * p * q^,\n"
+             "so q should be a rotation, i.e. unit, quaternion.\n"
+             "\n"
+             "   r(point), r.rotate(point)          - rotate one point.\n"
+             "   r.rotate_many(points, out=None)    - rotate a buffer of packed points.\n"
+             "   quaternion, origin, matrix         - read only attributes.");
+
+static PyTypeObject QuaternionRotatorType = {
+   PyVarObject_HEAD_INIT(NULL, 0)
+   "quaternion.Rotator",                        /* tp_name */
+   sizeof(PyQuaternionRotatorObject),           /* tp_basicsize */
+   0,                                           /* tp_itemsize */
+   (destructor)quaternion_rotator_dealloc,      /* tp_dealloc */
+   0,                                           /* tp_print */
+   0,                                           /* tp_getattr */
+   0,                                           /* tp_setattr */
+   0,                                           /* tp_reserved / tp_as_async */
+   (reprfunc)quaternion_rotator_repr,           /* tp_repr */
+   0,                                           /* tp_as_number */
+   0,                                           /* tp_as_sequence */
+   0,                                           /* tp_as_mapping */
+   (hashfunc)0,                                 /* tp_hash */
+   (ternaryfunc)quaternion_rotator_call,        /* tp_call */
+   (reprfunc)0,                                 /* tp_str */
+   (getattrofunc)0,                             /* tp_getattro */
+   0,                                           /* tp_setattro */
+   0,                                           /* tp_as_buffer */
+   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,    /* tp_flags */
+   quaternion_rotator_doc,                      /* tp_doc */
+   0,                                           /* tp_traverse */
+   0,                                           /* tp_clear */
+   0,                                           /* tp_richcompare */
+   0,                                           /* tp_weaklistoffset */
+   0,                                           /* tp_iter */
+   0,                                           /* tp_iternext */
+   quaternion_rotator_methods,                  /* tp_methods */
+   0,                                           /* tp_members */
+   quaternion_rotator_getset,                   /* tp_getset */
+   0,                                           /* tp_base */
+   0,                                           /* tp_dict */
+   0,                                           /* tp_descr_get */
+   0,                                           /* tp_descr_set */
+   0,                                           /* tp_dictoffset */
+   0,                                           /* tp_init */
+   (allocfunc)PyType_GenericAlloc,              /* tp_alloc */
+   (newfunc)quaternion_rotator_new,             /* tp_new */
+   PyObject_Del                                 /* tp_free */
+};
+
+
+/* -----------------------------------------------------------------------------
+ * Allow module definiton code to access the Rotator PyTypeObject.
+ */
+PyTypeObject* PyQuaternionRotatorType()
+{
+   return &QuaternionRotatorType;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+bool PyQuaternionRotator_Check(PyObject *op)
+{
+   return PyObject_TypeCheck(op, &QuaternionRotatorType);
+}
+
+/* end */
@@ -0,0 +1,58 @@
+/* quaternion_rotator.h
+ *
+ * This file is part of the Python quaternion module. It provides the Rotator
+ * type, which caches the rotation matrix of a quaternion for repeated use.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#ifndef QUATERNION_ROTATOR_H
+#define QUATERNION_ROTATOR_H 1
+
+#include <Python.h>
+#include <stdbool.h>
+#include "quaternion_basic.h"
+
+/* -----------------------------------------------------------------------------
+ */
+typedef struct {
+   PyObject_HEAD
+   /* Type-specific fields go here. */
+   Py_quaternion qval;                /* the rotation quaternion */
+   Py_quat_triple origin;             /* the point about which the rotation occurs */
+   Py_quat_matrix matrix;             /* as per _Py_quat_to_scaled_rotation_matrix */
+} PyQuaternionRotatorObject;
+
+
+/* Returns a new Rotator for q about origin, or NULL with error set.
+ */
+PyAPI_FUNC (PyObject *)
+PyQuaternionRotatorNew(const Py_quaternion q, const Py_quat_triple origin);
+
+/* Used by module setup
+ */
+PyAPI_FUNC (PyTypeObject*) PyQuaternionRotatorType ();
+
+PyAPI_FUNC (bool) PyQuaternionRotator_Check (PyObject *op);
+
+#endif  /* QUATERNION_ROTATOR_H */
@@ -0,0 +1,865 @@
+/* quaternion_simd.c
+ *
+ * This file is part of the Python quaternion module. It provides the SIMD
+ * kernel layer for the bulk quaternion array operations.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#include "quaternion_simd.h"
+#include <float.h>
+#include <string.h>
+
+/* The AVX2 backend needs the gcc/clang target attribute and cpu detection
+ * built-ins, so that it can be compiled without -mavx2, and only selected at
+ * run time when the cpu supports it. Note: we do not enable fma, as this would
+ * allow the compiler to contract multiplies and adds, and then the results
+ * would no longer match the scalar results.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define QUAT_SIMD_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__ ((target ("avx2")))
+#endif
+
+/* NEON is mandatory on aarch64, so no run time check is required.
+ */
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#define QUAT_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* -----------------------------------------------------------------------------
+ * The arithmetic is common to all backends. These macros work equally well with
+ * doubles and gcc/clang vector types, and replicate the order of evaluation used
+ * by _Py_quat_prod, thus ensuring identical results.
+ */
+#define QUAT_PROD(rw, rx, ry, rz, aw, ax, ay, az, bw, bx, by, bz) {      \
+   rw = (aw * bw) - (ax * bx) - (ay * by) - (az * bz);                   \
+   rx = (aw * bx) + (ax * bw) + (ay * bz) - (az * by);                   \
+   ry = (aw * by) + (ay * bw) + (az * bx) - (ax * bz);                   \
+   rz = (aw * bz) + (az * bw) + (ax * by) - (ay * bx);                   \
+}
+
+/* As _Py_quat_unit_rotate, less the origin offset, two being 2.0 (or a vector
+ * thereof).
+ */
+#define QUAT_UNIT_ROTATE(rx, ry, rz, aw, ax, ay, az, px, py, pz, two) {   \
+   tx = two * ((ay * pz) - (az * py));                                   \
+   ty = two * ((az * px) - (ax * pz));                                   \
+   tz = two * ((ax * py) - (ay * px));                                   \
+   rx = px + (aw * tx) + ((ay * tz) - (az * ty));                        \
+   ry = py + (aw * ty) + ((az * tx) - (ax * tz));                        \
+   rz = pz + (aw * tz) + ((ax * ty) - (ay * tx));                        \
+}
+
+/* -----------------------------------------------------------------------------
+ * The kernel dispatch table.
+ */
+typedef void (*binary_kernel) (const Py_quaternion* a, const size_t sa,
+                               const Py_quaternion* b, const size_t sb,
+                               Py_quaternion* r, const size_t n);
+
+typedef void (*normalise_kernel) (const Py_quaternion* a,
+                                  Py_quaternion* r, const size_t n);
+
+typedef void (*rotate_kernel) (const Py_quaternion* a, const size_t sa,
+                               const Py_quat_triple* points,
+                               Py_quat_triple* r, const size_t n,
+                               const Py_quat_triple origin);
+
+typedef struct {
+   const char* name;
+   binary_kernel sum;
+   binary_kernel diff;
+   binary_kernel prod;
+   normalise_kernel normalise;
+   rotate_kernel rotate;
+   rotate_kernel unit_rotate;
+} Kernels;
+
+static const Kernels scalarKernels = {
+   "scalar",
+   _Py_quat_array_sum,
+   _Py_quat_array_diff,
+   _Py_quat_array_prod,
+   _Py_quat_array_normalise,
+   _Py_quat_array_rotate,
+   _Py_quat_array_unit_rotate
+};
+
+static const Kernels* kernels = &scalarKernels;
+
+
+#ifdef QUAT_SIMD_AVX2
+/* =============================================================================
+ * AVX2 backend - 4 quaternions, i.e. 4 x 4 doubles, at a time.
+ * =============================================================================
+ */
+
+/* -----------------------------------------------------------------------------
+ * Transpose a 4x4 matrix of doubles. Rows of quaternions become vectors of
+ * w, x, y and z components, and vice versa.
+ */
+#define AVX2_TRANSPOSE(r0, r1, r2, r3, c0, c1, c2, c3) {                 \
+   __m256d t0 = _mm256_unpacklo_pd (r0, r1);   /* r0[0] r1[0] r0[2] r1[2] */ \
+   __m256d t1 = _mm256_unpackhi_pd (r0, r1);   /* r0[1] r1[1] r0[3] r1[3] */ \
+   __m256d t2 = _mm256_unpacklo_pd (r2, r3);                             \
+   __m256d t3 = _mm256_unpackhi_pd (r2, r3);                             \
+   c0 = _mm256_permute2f128_pd (t0, t2, 0x20);                           \
+   c1 = _mm256_permute2f128_pd (t1, t3, 0x20);                           \
+   c2 = _mm256_permute2f128_pd (t0, t2, 0x31);                           \
+   c3 = _mm256_permute2f128_pd (t1, t3, 0x31);                           \
+}
+
+/* Load 4 consecutive quaternions as w, x, y, z component vectors.
+ */
+#define AVX2_LOAD4(p, vw, vx, vy, vz) {                                  \
+   const double* d = (const double*) (p);                                \
+   __m256d q0 = _mm256_loadu_pd (d + 0);                                 \
+   __m256d q1 = _mm256_loadu_pd (d + 4);                                 \
+   __m256d q2 = _mm256_loadu_pd (d + 8);                                 \
+   __m256d q3 = _mm256_loadu_pd (d + 12);                                \
+   AVX2_TRANSPOSE (q0, q1, q2, q3, vw, vx, vy, vz);                      \
+}
+
+/* Store w, x, y, z component vectors as 4 consecutive quaternions.
+ */
+#define AVX2_STORE4(p, vw, vx, vy, vz) {                                 \
+   double* d = (double*) (p);                                            \
+   __m256d q0, q1, q2, q3;                                               \
+   AVX2_TRANSPOSE (vw, vx, vy, vz, q0, q1, q2, q3);                      \
+   _mm256_storeu_pd (d + 0,  q0);                                        \
+   _mm256_storeu_pd (d + 4,  q1);                                        \
+   _mm256_storeu_pd (d + 8,  q2);                                        \
+   _mm256_storeu_pd (d + 12, q3);                                        \
+}
+
+/* Broadcast the one quaternion as w, x, y, z component vectors.
+ */
+#define AVX2_BROADCAST(p, vw, vx, vy, vz) {                              \
+   vw = _mm256_set1_pd ((p)->w);                                         \
+   vx = _mm256_set1_pd ((p)->x);                                         \
+   vy = _mm256_set1_pd ((p)->y);                                         \
+   vz = _mm256_set1_pd ((p)->z);                                         \
+}
+
+/* -----------------------------------------------------------------------------
+ * Sum and difference do not need to be transposed, one quaternion is one vector.
+ */
+AVX2_TARGET static void
+avx2_sum (const Py_quaternion* a, const size_t sa,
+          const Py_quaternion* b, const size_t sb,
+          Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      __m256d va = _mm256_loadu_pd ((const double*) &a[j*sa]);
+      __m256d vb = _mm256_loadu_pd ((const double*) &b[j*sb]);
+      _mm256_storeu_pd ((double*) &r[j], _mm256_add_pd (va, vb));
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+AVX2_TARGET static void
+avx2_diff (const Py_quaternion* a, const size_t sa,
+           const Py_quaternion* b, const size_t sb,
+           Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      __m256d va = _mm256_loadu_pd ((const double*) &a[j*sa]);
+      __m256d vb = _mm256_loadu_pd ((const double*) &b[j*sb]);
+      _mm256_storeu_pd ((double*) &r[j], _mm256_sub_pd (va, vb));
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+AVX2_TARGET static void
+avx2_prod (const Py_quaternion* a, const size_t sa,
+           const Py_quaternion* b, const size_t sb,
+           Py_quaternion* r, const size_t n)
+{
+   __m256d aw, ax, ay, az;
+   __m256d bw, bx, by, bz;
+   __m256d rw, rx, ry, rz;
+   size_t j;
+
+   if (sa > 1 || sb > 1) {
+      _Py_quat_array_prod (a, sa, b, sb, r, n);
+      return;
+   }
+
+
+   for (j = 0; j + 4 <= n; j += 4) {
+      /* A zero stride means the one quaternion is applied to every item.
+       */
+      if (sa) AVX2_LOAD4 (&a[j], aw, ax, ay, az) else AVX2_BROADCAST (a, aw, ax, ay, az);
+      if (sb) AVX2_LOAD4 (&b[j], bw, bx, by, bz) else AVX2_BROADCAST (b, bw, bx, by, bz);
+      QUAT_PROD (rw, rx, ry, rz, aw, ax, ay, az, bw, bx, by, bz);
+      AVX2_STORE4 (&r[j], rw, rx, ry, rz);
+   }
+
+   /* Do the remainder, if any, the old fashioned way.
+    */
+   _Py_quat_array_prod (&a[j*sa], sa, &b[j*sb], sb, &r[j], n - j);
+}
+
+/* -----------------------------------------------------------------------------
+ * This replicates _Py_quat_abs and _Py_quat_normalise. Any group of four that
+ * includes a zero, infinite or NaN item is handed to the scalar function.
+ */
+AVX2_TARGET static void
+avx2_normalise (const Py_quaternion* a, Py_quaternion* r, const size_t n)
+{
+   const __m256d signBit = _mm256_set1_pd (-0.0);
+   const __m256d zero = _mm256_setzero_pd ();
+   const __m256d maxFinite = _mm256_set1_pd (DBL_MAX);
+   __m256d aw, ax, ay, az;
+   __m256d rw, rx, ry, rz;
+   size_t j;
+
+   for (j = 0; j + 4 <= n; j += 4) {
+      __m256d fw, fx, fy, fz, m, ok, len;
+      __m256d sw, sx, sy, sz;
+
+      AVX2_LOAD4 (&a[j], aw, ax, ay, az);
+
+      fw = _mm256_andnot_pd (signBit, aw);
+      fx = _mm256_andnot_pd (signBit, ax);
+      fy = _mm256_andnot_pd (signBit, ay);
+      fz = _mm256_andnot_pd (signBit, az);
+
+      /* All finite and the max element > 0 ?
+       * Note: ordered compares are false for NaNs.
+       */
+      m = _mm256_max_pd (_mm256_max_pd (fw, fx), _mm256_max_pd (fy, fz));
+      ok = _mm256_cmp_pd (m, zero, _CMP_GT_OQ);
+      ok = _mm256_and_pd (ok, _mm256_cmp_pd (fw, maxFinite, _CMP_LE_OQ));
+      ok = _mm256_and_pd (ok, _mm256_cmp_pd (fx, maxFinite, _CMP_LE_OQ));
+      ok = _mm256_and_pd (ok, _mm256_cmp_pd (fy, maxFinite, _CMP_LE_OQ));
+      ok = _mm256_and_pd (ok, _mm256_cmp_pd (fz, maxFinite, _CMP_LE_OQ));
+
+      if (_mm256_movemask_pd (ok) != 0x0F) {
+         _Py_quat_array_normalise (&a[j], &r[j], 4);
+         continue;
+      }
+
+      sw = aw / m;
+      sx = ax / m;
+      sy = ay / m;
+      sz = az / m;
+      len = m * _mm256_sqrt_pd ((sw * sw) + (sx * sx) + (sy * sy) + (sz * sz));
+
+      rw = aw / len;
+      rx = ax / len;
+      ry = ay / len;
+      rz = az / len;
+      AVX2_STORE4 (&r[j], rw, rx, ry, rz);
+   }
+
+   _Py_quat_array_normalise (&a[j], &r[j], n - j);
+}
+
+/* -----------------------------------------------------------------------------
+ * This replicates _Py_quat_rotate, i.e. a * p * a^
+ */
+AVX2_TARGET static void
+avx2_rotate (const Py_quaternion* a, const size_t sa,
+             const Py_quat_triple* points,
+             Py_quat_triple* r, const size_t n,
+             const Py_quat_triple origin)
+{
+   const __m256d signBit = _mm256_set1_pd (-0.0);
+   const __m256i index = _mm256_set_epi64x (9, 6, 3, 0);
+   const __m256d ox = _mm256_set1_pd (origin.x);
+   const __m256d oy = _mm256_set1_pd (origin.y);
+   const __m256d oz = _mm256_set1_pd (origin.z);
+   const __m256d pw = _mm256_setzero_pd ();
+   __m256d aw, ax, ay, az;
+   __m256d cw, cx, cy, cz;
+   size_t j;
+
+   if (sa > 1) {
+      _Py_quat_array_rotate (a, sa, points, r, n, origin);
+      return;
+   }
+
+   for (j = 0; j + 4 <= n; j += 4) {
+      const double* d = (const double*) &points[j];
+      __m256d px, py, pz;
+      __m256d tw, tx, ty, tz;
+      __m256d uw, ux, uy, uz;
+      double rx [4], ry [4], rz [4];
+      int k;
+
+      if (sa) AVX2_LOAD4 (&a[j], aw, ax, ay, az) else AVX2_BROADCAST (a, aw, ax, ay, az);
+
+      /* Form the conjugate - sign flip, not 0.0 - a.x, to preserve signed zeros.
+       */
+      cw = aw;
+      cx = _mm256_xor_pd (ax, signBit);
+      cy = _mm256_xor_pd (ay, signBit);
+      cz = _mm256_xor_pd (az, signBit);
+
+      px = _mm256_i64gather_pd (d + 0, index, 8);
+      py = _mm256_i64gather_pd (d + 1, index, 8);
+      pz = _mm256_i64gather_pd (d + 2, index, 8);
+
+      px = px - ox;
+      py = py - oy;
+      pz = pz - oz;
+
+      QUAT_PROD (tw, tx, ty, tz, aw, ax, ay, az, pw, px, py, pz);
+      QUAT_PROD (uw, ux, uy, uz, tw, tx, ty, tz, cw, cx, cy, cz);
+      (void) uw;
+
+      _mm256_storeu_pd (rx, ux + ox);
+      _mm256_storeu_pd (ry, uy + oy);
+      _mm256_storeu_pd (rz, uz + oz);
+
+      for (k = 0; k < 4; k++) {
+         r[j + k].x = rx[k];
+         r[j + k].y = ry[k];
+         r[j + k].z = rz[k];
+      }
+   }
+
+   _Py_quat_array_rotate (&a[j*sa], sa, &points[j], &r[j], n - j, origin);
+}
+
+/* -----------------------------------------------------------------------------
+ * This replicates _Py_quat_unit_rotate.
+ */
+AVX2_TARGET static void
+avx2_unit_rotate (const Py_quaternion* a, const size_t sa,
+                  const Py_quat_triple* points,
+                  Py_quat_triple* r, const size_t n,
+                  const Py_quat_triple origin)
+{
+   const __m256i index = _mm256_set_epi64x (9, 6, 3, 0);
+   const __m256d two = _mm256_set1_pd (2.0);
+   const __m256d ox = _mm256_set1_pd (origin.x);
+   const __m256d oy = _mm256_set1_pd (origin.y);
+   const __m256d oz = _mm256_set1_pd (origin.z);
+   __m256d aw, ax, ay, az;
+   size_t j;
+
+   if (sa > 1) {
+      _Py_quat_array_unit_rotate (a, sa, points, r, n, origin);
+      return;
+   }
+
+   for (j = 0; j + 4 <= n; j += 4) {
+      const double* d = (const double*) &points[j];
+      __m256d px, py, pz;
+      __m256d tx, ty, tz;
+      __m256d ux, uy, uz;
+      double rx [4], ry [4], rz [4];
+      int k;
+
+      if (sa) AVX2_LOAD4 (&a[j], aw, ax, ay, az) else AVX2_BROADCAST (a, aw, ax, ay, az);
+
+      px = _mm256_i64gather_pd (d + 0, index, 8);
+      py = _mm256_i64gather_pd (d + 1, index, 8);
+      pz = _mm256_i64gather_pd (d + 2, index, 8);
+
+      px = px - ox;
+      py = py - oy;
+      pz = pz - oz;
+
+      QUAT_UNIT_ROTATE (ux, uy, uz, aw, ax, ay, az, px, py, pz, two);
+
+      _mm256_storeu_pd (rx, ux + ox);
+      _mm256_storeu_pd (ry, uy + oy);
+      _mm256_storeu_pd (rz, uz + oz);
+
+      for (k = 0; k < 4; k++) {
+         r[j + k].x = rx[k];
+         r[j + k].y = ry[k];
+         r[j + k].z = rz[k];
+      }
+   }
+
+   _Py_quat_array_unit_rotate (&a[j*sa], sa, &points[j], &r[j], n - j, origin);
+}
+
+static const Kernels avx2Kernels = {
+   "avx2",
+   avx2_sum,
+   avx2_diff,
+   avx2_prod,
+   avx2_normalise,
+   avx2_rotate,
+   avx2_unit_rotate
+};
+
+#endif  /* QUAT_SIMD_AVX2 */
+
+
+#ifdef QUAT_SIMD_NEON
+/* =============================================================================
+ * NEON backend - 2 quaternions, i.e. 2 x 4 doubles, at a time.
+ * The vld4q/vst4q and vld3q/vst3q instructions do the de-interleaving for us.
+ * =============================================================================
+ */
+#define NEON_BROADCAST(p, vw, vx, vy, vz) {                              \
+   vw = vdupq_n_f64 ((p)->w);                                            \
+   vx = vdupq_n_f64 ((p)->x);                                            \
+   vy = vdupq_n_f64 ((p)->y);                                            \
+   vz = vdupq_n_f64 ((p)->z);                                            \
+}
+
+#define NEON_LOAD2(p, vw, vx, vy, vz) {                                  \
+   float64x2x4_t q = vld4q_f64 ((const double*) (p));                    \
+   vw = q.val[0];                                                        \
+   vx = q.val[1];                                                        \
+   vy = q.val[2];                                                        \
+   vz = q.val[3];                                                        \
+}
+
+#define NEON_STORE2(p, vw, vx, vy, vz) {                                 \
+   float64x2x4_t q;                                                      \
+   q.val[0] = vw;                                                        \
+   q.val[1] = vx;                                                        \
+   q.val[2] = vy;                                                        \
+   q.val[3] = vz;                                                        \
+   vst4q_f64 ((double*) (p), q);                                         \
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+neon_sum (const Py_quaternion* a, const size_t sa,
+          const Py_quaternion* b, const size_t sb,
+          Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      const double* da = (const double*) &a[j*sa];
+      const double* db = (const double*) &b[j*sb];
+      double* dr = (double*) &r[j];
+      float64x2_t lo = vaddq_f64 (vld1q_f64 (da),     vld1q_f64 (db));
+      float64x2_t hi = vaddq_f64 (vld1q_f64 (da + 2), vld1q_f64 (db + 2));
+      vst1q_f64 (dr, lo);
+      vst1q_f64 (dr + 2, hi);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+neon_diff (const Py_quaternion* a, const size_t sa,
+           const Py_quaternion* b, const size_t sb,
+           Py_quaternion* r, const size_t n)
+{
+   size_t j;
+   for (j = 0; j < n; j++) {
+      const double* da = (const double*) &a[j*sa];
+      const double* db = (const double*) &b[j*sb];
+      double* dr = (double*) &r[j];
+      float64x2_t lo = vsubq_f64 (vld1q_f64 (da),     vld1q_f64 (db));
+      float64x2_t hi = vsubq_f64 (vld1q_f64 (da + 2), vld1q_f64 (db + 2));
+      vst1q_f64 (dr, lo);
+      vst1q_f64 (dr + 2, hi);
+   }
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+neon_prod (const Py_quaternion* a, const size_t sa,
+           const Py_quaternion* b, const size_t sb,
+           Py_quaternion* r, const size_t n)
+{
+   float64x2_t aw, ax, ay, az;
+   float64x2_t bw, bx, by, bz;
+   float64x2_t rw, rx, ry, rz;
+   size_t j;
+
+   if (sa > 1 || sb > 1) {
+      _Py_quat_array_prod (a, sa, b, sb, r, n);
+      return;
+   }
+
+
+   for (j = 0; j + 2 <= n; j += 2) {
+      /* A zero stride means the one quaternion is applied to every item.
+       */
+      if (sa) NEON_LOAD2 (&a[j], aw, ax, ay, az) else NEON_BROADCAST (a, aw, ax, ay, az);
+      if (sb) NEON_LOAD2 (&b[j], bw, bx, by, bz) else NEON_BROADCAST (b, bw, bx, by, bz);
+      QUAT_PROD (rw, rx, ry, rz, aw, ax, ay, az, bw, bx, by, bz);
+      NEON_STORE2 (&r[j], rw, rx, ry, rz);
+   }
+
+   _Py_quat_array_prod (&a[j*sa], sa, &b[j*sb], sb, &r[j], n - j);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+neon_normalise (const Py_quaternion* a, Py_quaternion* r, const size_t n)
+{
+   const float64x2_t zero = vdupq_n_f64 (0.0);
+   const float64x2_t maxFinite = vdupq_n_f64 (DBL_MAX);
+   float64x2_t aw, ax, ay, az;
+   float64x2_t rw, rx, ry, rz;
+   size_t j;
+
+   for (j = 0; j + 2 <= n; j += 2) {
+      float64x2_t fw, fx, fy, fz, m, len;
+      float64x2_t sw, sx, sy, sz;
+      uint64x2_t ok;
+
+      NEON_LOAD2 (&a[j], aw, ax, ay, az);
+
+      fw = vabsq_f64 (aw);
+      fx = vabsq_f64 (ax);
+      fy = vabsq_f64 (ay);
+      fz = vabsq_f64 (az);
+
+      m = vmaxq_f64 (vmaxq_f64 (fw, fx), vmaxq_f64 (fy, fz));
+      ok = vcgtq_f64 (m, zero);
+      ok = vandq_u64 (ok, vcleq_f64 (fw, maxFinite));
+      ok = vandq_u64 (ok, vcleq_f64 (fx, maxFinite));
+      ok = vandq_u64 (ok, vcleq_f64 (fy, maxFinite));
+      ok = vandq_u64 (ok, vcleq_f64 (fz, maxFinite));
+
+      if ((vgetq_lane_u64 (ok, 0) & vgetq_lane_u64 (ok, 1)) == 0) {
+         _Py_quat_array_normalise (&a[j], &r[j], 2);
+         continue;
+      }
+
+      sw = aw / m;
+      sx = ax / m;
+      sy = ay / m;
+      sz = az / m;
+      len = m * vsqrtq_f64 ((sw * sw) + (sx * sx) + (sy * sy) + (sz * sz));
+
+      rw = aw / len;
+      rx = ax / len;
+      ry = ay / len;
+      rz = az / len;
+      NEON_STORE2 (&r[j], rw, rx, ry, rz);
+   }
+
+   _Py_quat_array_normalise (&a[j], &r[j], n - j);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+neon_rotate (const Py_quaternion* a, const size_t sa,
+             const Py_quat_triple* points,
+             Py_quat_triple* r, const size_t n,
+             const Py_quat_triple origin)
+{
+   const float64x2_t ox = vdupq_n_f64 (origin.x);
+   const float64x2_t oy = vdupq_n_f64 (origin.y);
+   const float64x2_t oz = vdupq_n_f64 (origin.z);
+   const float64x2_t pw = vdupq_n_f64 (0.0);
+   float64x2_t aw, ax, ay, az;
+   float64x2_t cw, cx, cy, cz;
+   size_t j;
+
+   if (sa > 1) {
+      _Py_quat_array_rotate (a, sa, points, r, n, origin);
+      return;
+   }
+
+   for (j = 0; j + 2 <= n; j += 2) {
+      float64x2x3_t p;
+      float64x2_t tw, tx, ty, tz;
+      float64x2_t uw, ux, uy, uz;
+
+      if (sa) NEON_LOAD2 (&a[j], aw, ax, ay, az) else NEON_BROADCAST (a, aw, ax, ay, az);
+
+      cw = aw;
+      cx = vnegq_f64 (ax);
+      cy = vnegq_f64 (ay);
+      cz = vnegq_f64 (az);
+
+      p = vld3q_f64 ((const double*) &points[j]);
+      p.val[0] = p.val[0] - ox;
+      p.val[1] = p.val[1] - oy;
+      p.val[2] = p.val[2] - oz;
+
+      QUAT_PROD (tw, tx, ty, tz, aw, ax, ay, az, pw, p.val[0], p.val[1], p.val[2]);
+      QUAT_PROD (uw, ux, uy, uz, tw, tx, ty, tz, cw, cx, cy, cz);
+      (void) uw;
+
+      p.val[0] = ux + ox;
+      p.val[1] = uy + oy;
+      p.val[2] = uz + oz;
+      vst3q_f64 ((double*) &r[j], p);
+   }
+
+   _Py_quat_array_rotate (&a[j*sa], sa, &points[j], &r[j], n - j, origin);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static void
+neon_unit_rotate (const Py_quaternion* a, const size_t sa,
+                  const Py_quat_triple* points,
+                  Py_quat_triple* r, const size_t n,
+                  const Py_quat_triple origin)
+{
+   const float64x2_t two = vdupq_n_f64 (2.0);
+   const float64x2_t ox = vdupq_n_f64 (origin.x);
+   const float64x2_t oy = vdupq_n_f64 (origin.y);
+   const float64x2_t oz = vdupq_n_f64 (origin.z);
+   float64x2_t aw, ax, ay, az;
+   size_t j;
+
+   if (sa > 1) {
+      _Py_quat_array_unit_rotate (a, sa, points, r, n, origin);
+      return;
+   }
+
+   for (j = 0; j + 2 <= n; j += 2) {
+      float64x2x3_t p;
+      float64x2_t px, py, pz;
+      float64x2_t tx, ty, tz;
+      float64x2_t ux, uy, uz;
+
+      if (sa) NEON_LOAD2 (&a[j], aw, ax, ay, az) else NEON_BROADCAST (a, aw, ax, ay, az);
+
+      p = vld3q_f64 ((const double*) &points[j]);
+      px = p.val[0] - ox;
+      py = p.val[1] - oy;
+      pz = p.val[2] - oz;
+
+      QUAT_UNIT_ROTATE (ux, uy, uz, aw, ax, ay, az, px, py, pz, two);
+
+      p.val[0] = ux + ox;
+      p.val[1] = uy + oy;
+      p.val[2] = uz + oz;
+      vst3q_f64 ((double*) &r[j], p);
+   }
+
+   _Py_quat_array_unit_rotate (&a[j*sa], sa, &points[j], &r[j], n - j, origin);
+}
+
+static const Kernels neonKernels = {
+   "neon",
+   neon_sum,
+   neon_diff,
+   neon_prod,
+   neon_normalise,
+   neon_rotate,
+   neon_unit_rotate
+};
+
+#endif  /* QUAT_SIMD_NEON */
+
+
+/* =============================================================================
+ * Dispatch
+ * =============================================================================
+ */
+
+/* -----------------------------------------------------------------------------
+ * Returns the best kernels available on this cpu.
+ */
+static const Kernels* best_kernels (void)
+{
+#ifdef QUAT_SIMD_AVX2
+   __builtin_cpu_init ();
+   if (__builtin_cpu_supports ("avx2")) {
+      return &avx2Kernels;
+   }
+#endif
+
+#ifdef QUAT_SIMD_NEON
+   return &neonKernels;
+#endif
+
+   return &scalarKernels;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_simd_init (void)
+{
+   kernels = best_kernels ();
+}
+
+/* -----------------------------------------------------------------------------
+ */
+const char* _Py_quat_simd_get_backend (void)
+{
+   return kernels->name;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+bool _Py_quat_simd_set_backend (const char* name)
+{
+   const Kernels* best = best_kernels ();
+
+   if (strcmp (name, "auto") == 0) {
+      kernels = best;
+      return true;
+   }
+
+   if (strcmp (name, scalarKernels.name) == 0) {
+      kernels = &scalarKernels;
+      return true;
+   }
+
+   /* Any other backend is only available if it is the best backend.
+    */
+   if (strcmp (name, best->name) == 0) {
+      kernels = best;
+      return true;
+   }
+
+   return false;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_simd_sum (const Py_quaternion* a, const size_t sa,
+                        const Py_quaternion* b, const size_t sb,
+                        Py_quaternion* r, const size_t n)
+{
+   kernels->sum (a, sa, b, sb, r, n);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_simd_diff (const Py_quaternion* a, const size_t sa,
+                         const Py_quaternion* b, const size_t sb,
+                         Py_quaternion* r, const size_t n)
+{
+   kernels->diff (a, sa, b, sb, r, n);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_simd_prod (const Py_quaternion* a, const size_t sa,
+                         const Py_quaternion* b, const size_t sb,
+                         Py_quaternion* r, const size_t n)
+{
+   kernels->prod (a, sa, b, sb, r, n);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_simd_normalise (const Py_quaternion* a,
+                              Py_quaternion* r, const size_t n)
+{
+   kernels->normalise (a, r, n);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_simd_rotate (const Py_quaternion* a, const size_t sa,
+                           const Py_quat_triple* points,
+                           Py_quat_triple* r, const size_t n,
+                           const Py_quat_triple origin)
+{
+   kernels->rotate (a, sa, points, r, n, origin);
+}
+
+/* -----------------------------------------------------------------------------
+ */
+void _Py_quat_simd_unit_rotate (const Py_quaternion* a, const size_t sa,
+                                const Py_quat_triple* points,
+                                Py_quat_triple* r, const size_t n,
+                                const Py_quat_triple origin)
+{
+   kernels->unit_rotate (a, sa, points, r, n, origin);
+}
+
+
+/* =============================================================================
+ * Module level functions
+ * =============================================================================
+ */
+PyDoc_STRVAR(simd_backend_doc,
+             "simd_backend() -> str\n"
+             "\n"
+             "Returns the name of the kernel backend used by the bulk QuaternionArray\n"
+             "operations, i.e. 'avx2', 'neon' or 'scalar'.");
+
+static PyObject *
+simd_backend (PyObject *module, PyObject *noargs)
+{
+   return PyUnicode_FromString (_Py_quat_simd_get_backend ());
+}
+
+/* -----------------------------------------------------------------------------
+ */
+PyDoc_STRVAR(set_simd_backend_doc,
+             "set_simd_backend(name, /)\n"
+             "\n"
+             "Selects the kernel backend used by the bulk QuaternionArray operations.\n"
+             "name may be 'auto' (the best available, and the default), 'scalar', or\n"
+             "the name of a backend supported by this cpu, i.e. 'avx2' or 'neon'.\n"
+             "This is mainly intended for testing and benchmarking.");
+
+static PyObject *
+set_simd_backend (PyObject *module, PyObject *arg)
+{
+   const char* name;
+
+   if (!PyUnicode_Check (arg)) {
+      PyErr_Format(PyExc_TypeError,
+                   "set_simd_backend() argument must be str, not '%.200s'",
+                   Py_TYPE(arg)->tp_name);
+      return NULL;
+   }
+
+   name = PyUnicode_AsUTF8 (arg);
+   if (!name) return NULL;
+
+   if (!_Py_quat_simd_set_backend (name)) {
+      PyErr_Format(PyExc_ValueError,
+                   "set_simd_backend() backend '%.200s' is not available", name);
+      return NULL;
+   }
+
+   Py_RETURN_NONE;
+}
+
+/* -----------------------------------------------------------------------------
+ */
+static PyMethodDef simd_methods[] = {
+   {"simd_backend",     (PyCFunction)simd_backend,     METH_NOARGS, simd_backend_doc},
+   {"set_simd_backend", (PyCFunction)set_simd_backend, METH_O,      set_simd_backend_doc},
+   {NULL, NULL, 0, NULL}  /* sentinel */
+};
+
+/* -----------------------------------------------------------------------------
+ * Allow module definition code to access the SIMD PyMethodDef.
+ */
+PyMethodDef* _PyQuaternionSimdMethods ()
+{
+   return simd_methods;
+}
+
+/* end */
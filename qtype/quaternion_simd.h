@@ -0,0 +1,88 @@
+/* quaternion_simd.h
+ *
+ * This file is part of the Python quaternion module. It provides the SIMD
+ * kernel layer for the bulk quaternion array operations.
+ *
+ * Copyright (c) 2024  Andrew C. Starritt
+ *
+ * The quaternion module is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The quaternion module is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the quaternion module.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Contact details:
+ * andrew.starritt@gmail.com
+ * PO Box 3118, Prahran East, Victoria 3181, Australia.
+ *
+ * source formatting:
+ *    indent -kr -pcs -i3 -cli3 -nbbo -nut -l96
+ */
+
+#ifndef QUATERNION_SIMD_H
+#define QUATERNION_SIMD_H 1
+
+#include <Python.h>
+#include <stdbool.h>
+#include "quaternion_basic.h"
+
+/* The kernels have the same signatures and semantics as the corresponding
+ * bulk functions in quaternion_basic.h, which remain the reference and the
+ * fallback implementation. The kernels process several quaternions per
+ * instruction when an AVX2 (x86-64) or NEON (aarch64) backend is available.
+ *
+ * Each backend performs exactly the same sequence of floating point operations
+ * as the scalar reference, so, save for any compiler contraction of multiply
+ * and add operations, the results are bit for bit identical.
+ */
+
+/* Select the best available backend - called once by module initialisation.
+ */
+void _Py_quat_simd_init (void);
+
+/* Returns the name of the current backend, i.e. "avx2", "neon" or "scalar".
+ */
+const char* _Py_quat_simd_get_backend (void);
+
+/* Select backend by name: "auto", "avx2", "neon" or "scalar".
+ * Returns false if the named backend is not available.
+ */
+bool _Py_quat_simd_set_backend (const char* name);
+
+void _Py_quat_simd_sum  (const Py_quaternion* a, const size_t sa,
+                         const Py_quaternion* b, const size_t sb,
+                         Py_quaternion* r, const size_t n);
+
+void _Py_quat_simd_diff (const Py_quaternion* a, const size_t sa,
+                         const Py_quaternion* b, const size_t sb,
+                         Py_quaternion* r, const size_t n);
+
+void _Py_quat_simd_prod (const Py_quaternion* a, const size_t sa,
+                         const Py_quaternion* b, const size_t sb,
+                         Py_quaternion* r, const size_t n);
+
+void _Py_quat_simd_normalise (const Py_quaternion* a,
+                              Py_quaternion* r, const size_t n);
+
+void _Py_quat_simd_rotate (const Py_quaternion* a, const size_t sa,
+                           const Py_quat_triple* points,
+                           Py_quat_triple* r, const size_t n,
+                           const Py_quat_triple origin);
+
+void _Py_quat_simd_unit_rotate (const Py_quaternion* a, const size_t sa,
+                                const Py_quat_triple* points,
+                                Py_quat_triple* r, const size_t n,
+                                const Py_quat_triple origin);
+
+/* Provides a reference to the module level functions provided by quaternion_simd.c
+ */
+PyAPI_FUNC (PyMethodDef*) _PyQuaternionSimdMethods ();
+
+#endif  /* QUATERNION_SIMD_H */
@@ -25,6 +25,9 @@
  */
 
 #include "quaternion_utilities.h"
+#include "quaternion_simd.h"
+#include "quaternion_parallel.h"
+#include <string.h>
 
 
 /* ----------------------------------------------------------------------------
@@ -35,6 +38,14 @@ PyQuaternionUtil_NumberAsDouble(PyObject *obj, double* value)
    bool result = true;
 
    PyObject *float_obj = NULL;
+
+   /* Short circuit - no need to create a new object.
+    */
+   if (PyFloat_Check (obj)) {
+      *value = PyFloat_AS_DOUBLE (obj);
+      return true;
+   }
+
    /* Return as a PyFloatObject or NULL
     */
    float_obj = PyNumber_Float (obj);
@@ -43,6 +54,7 @@ PyQuaternionUtil_NumberAsDouble(PyObject *obj, double* value)
       /* Extract C double from Python float.
       */
       *value = PyFloat_AsDouble (float_obj);
+      Py_DECREF (float_obj);
       result = true;
    } else {
       result = false;
@@ -164,5 +176,273 @@ PyQuaternionUtil_ParseTriple(PyObject *obj, Py_quat_triple* triple,
    return status;
 }
 
+/* ----------------------------------------------------------------------------
+ * Only native doubles, or raw bytes interpreted as native doubles, are accepted.
+ */
+static bool
+is_double_format(const char* format)
+{
+   if (format == NULL) return true;   /* implies "B" */
+
+   /* Allow native byte order/size prefix.
+    */
+   if (format[0] == '@' || format[0] == '=') format++;
+
+   return (strcmp(format, "d") == 0) ||
+          (strcmp(format, "B") == 0) ||
+          (strcmp(format, "b") == 0) ||
+          (strcmp(format, "c") == 0);
+}
+
+/* ----------------------------------------------------------------------------
+ */
+bool
+PyQuaternionUtil_GetDoubleBuffer(PyObject *obj,
+                                 Py_buffer *view,
+                                 const bool writable,
+                                 const Py_ssize_t groupSize,
+                                 const char* fname,
+                                 const char* aname)
+{
+   int flags;
+   Py_ssize_t groupBytes;
+
+   if (!PyObject_CheckBuffer(obj)) {
+      PyErr_Format(PyExc_TypeError,
+                   "%.200s (%.200s): a bytes-like object is required, not '%.200s'",
+                   fname, aname, Py_TYPE(obj)->tp_name);
+      return false;
+   }
+
+   flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+   if (writable) {
+      flags |= PyBUF_WRITABLE;
+   }
+
+   if (PyObject_GetBuffer(obj, view, flags) < 0) {
+      /* PyObject_GetBuffer has already set the error.
+       */
+      return false;
+   }
+
+   if (!is_double_format(view->format)) {
+      PyErr_Format(PyExc_TypeError,
+                   "%.200s (%.200s): buffer format must be 'd' (got '%.200s')",
+                   fname, aname, view->format);
+      PyBuffer_Release(view);
+      return false;
+   }
+
+   groupBytes = groupSize * sizeof(double);
+   if ((view->len % groupBytes) != 0) {
+      PyErr_Format(PyExc_ValueError,
+                   "%.200s (%.200s): buffer length %ld not a multiple of %ld",
+                   fname, aname, view->len, groupBytes);
+      PyBuffer_Release(view);
+      return false;
+   }
+
+   return true;
+}
+
+/* ----------------------------------------------------------------------------
+ */
+PyObject *
+PyQuaternionUtil_NewArray(const char typecode,
+                          const void* data,
+                          const Py_ssize_t nbytes)
+{
+   static PyObject* arrayType = NULL;
+
+   PyObject *result = NULL;
+   PyObject *memory = NULL;
+   PyObject *status = NULL;
+
+   if (!arrayType) {
+      PyObject *arrayModule;
+      arrayModule = PyImport_ImportModule("array");
+      if (!arrayModule) return NULL;
+      arrayType = PyObject_GetAttrString(arrayModule, "array");
+      Py_DECREF(arrayModule);
+      if (!arrayType) return NULL;
+   }
+
+   result = PyObject_CallFunction(arrayType, "C", typecode);
+   if (!result) return NULL;
+
+   if (nbytes > 0) {
+      /* The memory view adds no copy of its own, so the data is copied just
+       * the once, directly into the array.array buffer.
+       */
+      memory = PyMemoryView_FromMemory((char *)data, nbytes, PyBUF_READ);
+      if (!memory) {
+         Py_DECREF(result);
+         return NULL;
+      }
+
+      status = PyObject_CallMethod(result, "frombytes", "O", memory);
+      Py_DECREF(memory);
+      if (!status) {
+         Py_DECREF(result);
+         return NULL;
+      }
+      Py_DECREF(status);
+   }
+
+   return result;
+}
+
+/* ----------------------------------------------------------------------------
+ * Rotates a chunk of points - large numbers of points are split across threads.
+ */
+typedef struct {
+   const Py_quaternion_array* qvals;
+   size_t stride;
+   const Py_quat_triple* points;
+   Py_quat_triple* r;
+   Py_quat_triple origin;
+   bool unit;
+} rotate_context;
+
+/* A SoA layout array is staged through blocks of this many quaternions.
+ */
+#define ROTATE_BLOCK  128
+
+static void
+rotate_task (void* context, const int chunk, const size_t begin, const size_t end)
+{
+   rotate_context* c = (rotate_context*) context;
+   void (*kernel) (const Py_quaternion*, const size_t, const Py_quat_triple*,
+                   Py_quat_triple*, const size_t, const Py_quat_triple);
+   Py_quaternion t [ROTATE_BLOCK];
+   size_t j;
+   size_t m;
+
+   kernel = c->unit ? _Py_quat_simd_unit_rotate : _Py_quat_simd_rotate;
+
+   if (c->stride == 0 || c->qvals->layout == QA_LAYOUT_AOS) {
+      kernel (c->qvals->qvalArray + begin * c->stride, c->stride,
+              c->points + begin, c->r + begin, end - begin, c->origin);
+      return;
+   }
+
+   for (j = begin; j < end; j += m) {
+      m = end - j < ROTATE_BLOCK ? end - j : ROTATE_BLOCK;
+      PyQuaternionArrayGather (c->qvals, j, t, m);
+      kernel (t, 1, c->points + j, c->r + j, m, c->origin);
+   }
+}
+
+static void
+rotate_points (const Py_quaternion_array* qvals, const size_t stride,
+               const void* points, void* r, const size_t n, const Py_quat_triple origin,
+               const bool unit)
+{
+   rotate_context context;
+
+   context.qvals = qvals;
+   context.stride = stride;
+   context.points = (const Py_quat_triple*) points;
+   context.r = (Py_quat_triple*) r;
+   context.origin = origin;
+   context.unit = unit;
+   _Py_quat_parallel_run (rotate_task, &context, n);
+}
+
+/* ----------------------------------------------------------------------------
+ */
+PyObject *
+PyQuaternionUtil_RotatePoints(const Py_quaternion_array* qvals,
+                              const size_t stride,
+                              PyObject *args,
+                              PyObject *kwds,
+                              const char* fname)
+{
+   static char *kwlist[] = {"points", "origin", "out", "unit", NULL};
+
+   PyObject *result = NULL;
+   PyObject *pointsObj = NULL;
+   PyObject *originObj = NULL;
+   PyObject *outObj = NULL;
+   Py_quat_triple origin = { 0.0, 0.0, 0.0 };
+   Py_buffer points;
+   Py_buffer out;
+   Py_ssize_t npoints;
+   bool status;
+   int unit = 0;
+   int s;
+
+   s = PyArg_ParseTupleAndKeywords(args, kwds, "O|OOp", kwlist,
+                                   &pointsObj, &originObj, &outObj, &unit);
+   if (!s) {
+      return NULL;
+   }
+
+   /* origin can be null or None */
+   if ((originObj != NULL) && (originObj != Py_None)) {
+      status = PyQuaternionUtil_ParseTriple (originObj, &origin, fname, "origin");
+      if (!status) {
+         return NULL;
+      }
+   }
+
+   status = PyQuaternionUtil_GetDoubleBuffer (pointsObj, &points, false, 3, fname, "points");
+   if (!status) {
+      return NULL;
+   }
+
+   npoints = points.len / sizeof (Py_quat_triple);
+
+   if ((stride != 0) && (npoints != qvals->count)) {
+      PyErr_Format(PyExc_ValueError,
+                   "%.200s (points): number of points %ld differs from number of quaternions %ld",
+                   fname, npoints, qvals->count);
+      PyBuffer_Release(&points);
+      return NULL;
+   }
+
+   if ((outObj != NULL) && (outObj != Py_None)) {
+      /* Caller has supplied the output buffer - this may be the same object
+       * as the points buffer.
+       */
+      status = PyQuaternionUtil_GetDoubleBuffer (outObj, &out, true, 3, fname, "out");
+      if (!status) {
+         PyBuffer_Release(&points);
+         return NULL;
+      }
+
+      if (out.len != points.len) {
+         PyErr_Format(PyExc_ValueError,
+                      "%.200s (out): buffer length %ld differs from points buffer length %ld",
+                      fname, out.len, points.len);
+         PyBuffer_Release(&out);
+         PyBuffer_Release(&points);
+         return NULL;
+      }
+
+      rotate_points (qvals, stride, points.buf, out.buf, npoints, origin, unit);
+
+      PyBuffer_Release(&out);
+      Py_INCREF(outObj);
+      result = outObj;
+
+   } else {
+      /* Create a copy of the points as an array of doubles, and rotate in place.
+       */
+      result = PyQuaternionUtil_NewArray ('d', points.buf, points.len);
+      if (result) {
+         status = PyQuaternionUtil_GetDoubleBuffer (result, &out, true, 3, fname, "out");
+         if (status) {
+            rotate_points (qvals, stride, out.buf, out.buf, npoints, origin, unit);
+            PyBuffer_Release(&out);
+         } else {
+            Py_CLEAR(result);
+         }
+      }
+   }
+
+   PyBuffer_Release(&points);
+   return result;
+}
 
 /* end */
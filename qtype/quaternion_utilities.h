@@ -29,6 +29,7 @@
 #include <Python.h>
 #include <stdbool.h>
 #include "quaternion_basic.h"
+#include "quaternion_array.h"
 
 
 /* Return true if the object can be converted to double else returns false.
@@ -68,4 +69,42 @@ PyQuaternionUtil_ParseTriple(PyObject *obj,
                              const char* fname,
                              const char* aname);
 
+/* Get a C contiguous buffer view of obj and check that it may be interpreted
+ * as an array of native doubles, i.e. format 'd' or raw bytes, and that the
+ * length is a multiple of groupSize doubles, e.g. 3 for packed xyz points.
+ * Returns true if all okay, otherwise calls PyErr_Format(...) and returns false.
+ * On success, the caller is responsible for calling PyBuffer_Release (view).
+ */
+bool
+PyQuaternionUtil_GetDoubleBuffer(PyObject *obj,
+                                 Py_buffer *view,
+                                 const bool writable,
+                                 const Py_ssize_t groupSize,
+                                 const char* fname,
+                                 const char* aname);
+
+
+/* Create a new array.array object with the given type code, initialised with
+ * a copy of nbytes of data. This allows functions returning bulk numerical
+ * data to do so without any per-element Python object creation.
+ * Returns NULL (and error set) on failure.
+ */
+PyObject *
+PyQuaternionUtil_NewArray(const char typecode,
+                          const void* data,
+                          const Py_ssize_t nbytes);
+
+/* Common implementation of Quaternion.rotate_many and QuaternionArray.rotate_points.
+ * Parses the (points, origin=None, out=None, unit=False) arguments and rotates the packed
+ * xyz points with qvals. When stride is 0, the first quaternion rotates every
+ * point, otherwise there must be one quaternion for each point.
+ * Returns out when specified, otherwise a new array.array('d') object.
+ */
+PyObject *
+PyQuaternionUtil_RotatePoints(const Py_quaternion_array* qvals,
+                              const size_t stride,
+                              PyObject *args,
+                              PyObject *kwds,
+                              const char* fname);
+
 #endif    /* QUATERNION_UTILITIES_H */
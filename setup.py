@@ -36,9 +36,15 @@ with open("qtype/quaternion_module.c", 'r') as f:
 m = Extension("quaternion",
               sources = ["qtype/quaternion_basic.c",
                          "qtype/quaternion_object.c",
+                         "qtype/quaternion_allocator.c",
                          "qtype/quaternion_array.c",
                          "qtype/quaternion_array_iter.c",
+                         "qtype/quaternion_array_stream.c",
+                         "qtype/quaternion_interpolate.c",
                          "qtype/quaternion_math.c",
+                         "qtype/quaternion_parallel.c",
+                         "qtype/quaternion_rotator.c",
+                         "qtype/quaternion_simd.c",
                          "qtype/quaternion_utilities.c",
                          "qtype/quaternion_module.c"])
 
@@ -50,6 +56,10 @@ setup(name="quaternion",
       description="""Provides a Quaternion type and associated maths functions together
                      with a QuaternionArray type.
                   """,
+      headers=["qtype/quaternion_capi.h",
+               "qtype/quaternion_array.h",
+               "qtype/quaternion_object.h",
+               "qtype/quaternion_basic.h"],
       ext_modules=[m])
 
 # end
@@ -105,6 +105,26 @@ def test_init():
     except BaseException:
         raise
 
+    # Component forms, both the float/int fast path and the general path.
+    #
+    assert Quaternion(1.2, -3.4, 5.6, -7.8) == a
+    assert Quaternion(1, 2, 3, 4) == Quaternion(1.0, 2.0, 3.0, 4.0)
+    assert Quaternion(1.5, 2) == Quaternion(w=1.5, x=2)
+    assert Quaternion(True, 2.0) == Quaternion(1, 2)
+    assert Quaternion(1, 2, z=4) == Quaternion(1, 2, 0, 4)
+
+    class Sub(Quaternion):
+        pass
+
+    assert type(Sub(1.0, 2.0)) is Sub and Sub(1.0, 2.0) == Quaternion(1, 2)
+
+    for args in ((1, 2, 3, 4, 5), (1, "2"), (10**400,), (1, 10**400), (10**400, 0, 0, 0)):
+        try:
+            Quaternion(*args)
+            assert False, "Expecting TypeError"
+        except TypeError:
+            pass
+
 
 def test_equal():
     """ Test equality and non-equality
@@ -406,6 +426,13 @@ def test_hash():
     assert hash(j) != hash(k)
     assert hash(k) != hash(i)
 
+    # Also where the j component is the imaginary part, and for -1.
+    #
+    assert hash(Quaternion(1.5, 0, 2, 0)) == hash(complex(1.5, 2))
+    assert hash(Quaternion(-1)) == hash(-1)
+    assert hash(Quaternion(1, 2, 3, 4)) == hash(Quaternion(1, 2, 3, 4))
+    assert hash(Quaternion(1, 2, 3, 4)) != hash(Quaternion(1, 4, 3, 2))
+
 
 def test_buffer_api():
     print('test_buffer_api')
@@ -414,6 +441,104 @@ def test_buffer_api():
     assert bytes(a) == bytes(b), "bytes(a) failed"
 
 
+def test_mixed_mode():
+    print('test_mixed_mode')
+    q = Quaternion(1.5, -2.0, 0.25, 8.0)
+    r = Quaternion(0.5)
+
+    # Real operands give the same values as the equivalent Quaternion operand.
+    #
+    for x in (0.5, 3, -7, True, 2**60):
+        y = Quaternion(x)
+        assert q + x == q + y and x + q == y + q, "add fail"
+        assert q - x == q - y and x - q == y - q, "sub fail"
+        assert q * x == q * y and x * q == y * q, "mul fail"
+        assert q / x == q / y and x / q == y / q, "div fail"
+
+    assert q * 0.5 == Quaternion(0.75, -1.0, 0.125, 4.0), "scale fail"
+    assert q * 0.5 + r * 0.25 == Quaternion(0.875, -1.0, 0.125, 4.0), "integrate fail"
+    assert 1 - q == Quaternion(-0.5, 2.0, -0.25, -8.0), "rsub fail"
+
+    # Complex operands, which do not commute.
+    #
+    z = 2 + 3j
+    assert q * z == q * Quaternion(z) and z * q == Quaternion(z) * q, "complex fail"
+    assert q * z != z * q, "complex commute fail"
+
+    # Errors
+    #
+    for x in (0, 0.0, False):
+        try:
+            q / x
+            assert False, "Expecting a ZeroDivisionError"
+        except ZeroDivisionError:
+            pass
+
+    try:
+        q * 10**400
+        assert False, "Expecting an OverflowError"
+    except OverflowError:
+        pass
+
+    try:
+        q ** 10**400
+        assert False, "Expecting an OverflowError"
+    except OverflowError:
+        pass
+
+    for x in ("fred", None, [1]):
+        try:
+            q + x
+            assert False, "Expecting a TypeError"
+        except TypeError:
+            pass
+
+    assert abs(q ** 2 - q * q) < 1.0e-12 and abs(2 ** q - 2.0 ** q) == 0, "pow fail"
+
+
+def test_free_list():
+    print('test_free_list')
+    stats = quaternion.free_list_stats()
+    assert stats["limit"] == 100, "default limit fail"
+
+    # Short lived results re-use freed objects.
+    #
+    before = quaternion.free_list_stats()
+    for n in range(1000):
+        c = a * b + a
+    after = quaternion.free_list_stats()
+    assert after["hits"] - before["hits"] >= 1000, "free list hits fail"
+    assert after["misses"] - before["misses"] < 10, "free list misses fail"
+    assert c == a * b + a, "free list value fail"
+
+    # Subtypes are not put on the free list.
+    #
+    class Sub(Quaternion):
+        pass
+
+    s = Sub(1, 2, 3, 4)
+    assert type(s + 0) is Quaternion and type(s) is Sub, "subtype fail"
+    del s
+
+    try:
+        quaternion.set_free_list_limit(2)
+        garbage = [Quaternion(n) for n in range(10)]
+        del garbage
+        assert quaternion.free_list_stats()["size"] == 2, "limit fail"
+
+        quaternion.set_free_list_limit(0)
+        assert quaternion.free_list_stats()["size"] == 0, "trim fail"
+        assert Quaternion(1, 2) + 1 == Quaternion(2, 2), "no free list fail"
+    finally:
+        quaternion.set_free_list_limit(stats["limit"])
+
+    try:
+        quaternion.set_free_list_limit(-1)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+
 def run_stuff():
     print('run_stuff')
     n = Quaternion()
@@ -533,6 +658,8 @@ if __name__ == "__main__":
     test_pow2()
     test_hash()
     test_buffer_api()
+    test_mixed_mode()
+    test_free_list()
 #   run_stuff()
 
 # end
@@ -73,6 +73,26 @@ def test_isclose():
     assert quaternion.isclose(a, b)
     assert quaternion.isclose(a, a)
 
+    # Keyword arguments
+    #
+    assert not quaternion.isclose(a, b, rel_tol=1.0e-20)
+    assert quaternion.isclose(a=a, b=b, abs_tol=0.01, rel_tol=0.0)
+    assert not quaternion.isclose(a, b, 0.0)
+
+    for args, kwds in (((a,), {}), ((a, b), {"a": a}), ((a, b), {"fred": 1}),
+                       ((a, b, 1, 2, 3), {}), ((a, b), {"rel_tol": "x"})):
+        try:
+            quaternion.isclose(*args, **kwds)
+            assert False, "Expecting a TypeError"
+        except TypeError:
+            pass
+
+    try:
+        quaternion.isclose(a, b, rel_tol=-1)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
 
 def test_exp():
     print("test_exp")
@@ -334,6 +354,20 @@ def test_lerp():
     e = abs(c - d)
     assert e < 1.0e-15
 
+    for f in (quaternion.lerp, quaternion.slerp):
+        for args in ((a, b), (a, b, "x"), (a, b, 0.5, 1)):
+            try:
+                f(*args)
+                assert False, "Expecting a TypeError"
+            except TypeError:
+                pass
+
+    try:
+        quaternion.lerp(a, b, t=0.5)
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
 
 if __name__ == "__main__":
     test_isclose()
@@ -1,10 +1,13 @@
 #!/usr/bin/env python
 #
 
+import array
 import math
+import pickle
 import quaternion as qn
 
 Qn = qn.Quaternion
+Qa = qn.QuaternionArray
 
 tau = qn.tau
 
@@ -354,6 +357,393 @@ def test_rotation6():
     assert t <= 1.0e-15, "Quaternion/matrix multiplication comparison failure (2)"
 
 
+def test_rotate_many():
+    print("test_rotate_many")
+    q = Qn(angle=tau / 7, axis=(1, 2, 3))
+    points = [(1.0, 2.0, 3.0), (-4.0, 0.5, 2.0), (0.0, 0.0, 0.0), (7.0, -8.0, 9.0)]
+    flat = [c for p in points for c in p]
+
+    a = array.array('d', flat)
+    r = q.rotate_many(a)
+    assert isinstance(r, array.array), "rotate_many result type failure"
+    expected = [c for p in points for c in q.rotate(p)]
+    assert list(r) == expected, "rotate_many failure"
+
+    # With an origin and from a bytes object
+    #
+    origin = (1.0, -1.0, 0.5)
+    r = q.rotate_many(a.tobytes(), origin=origin)
+    expected = [c for p in points for c in q.rotate(p, origin)]
+    assert list(r) == expected, "rotate_many with origin failure"
+
+    # In place
+    #
+    b = array.array('d', flat)
+    r = q.rotate_many(b, out=b)
+    assert r is b, "rotate_many out failure"
+    assert list(b) == list(q.rotate_many(a)), "rotate_many in place failure"
+
+    # Per point rotation
+    #
+    qa = Qa([q, Qn(angle=1, axis=(0, 0, 1)), Qn(1), Qn(angle=-2, axis=(1, 0, 0))])
+    out = bytearray(len(a) * a.itemsize)
+    r = qa.rotate_points(memoryview(a), out=out)
+    assert r is out, "rotate_points out failure"
+    r = array.array('d', out)
+    expected = [c for x, p in zip(qa, points) for c in x.rotate(p)]
+    assert list(r) == expected, "rotate_points failure"
+
+    # Expected errors
+    #
+    try:
+        q.rotate_many(array.array('d', flat[:-1]))
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        q.rotate_many(array.array('f', flat))
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    try:
+        qa.rotate_points(array.array('d', flat[:-3]))
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        q.rotate_many(a, out=bytes(len(a) * 8))
+        assert False, "Expecting a BufferError"
+    except BufferError:
+        pass
+
+
+def test_rotator():
+    print("test_rotator")
+
+    def close(a, b, tol=1.0e-12):
+        return all(abs(x - y) <= tol for x, y in zip(a, b))
+
+    q = Qn(angle=tau / 7, axis=(1, 2, 3))
+    points = [(1.0, 2.0, 3.0), (-4.0, 0.5, 2.0), (0.0, 0.0, 0.0), (7.0, -8.0, 9.0)]
+    flat = array.array('d', [c for p in points for c in p])
+    origin = (1.0, -1.0, 0.5)
+
+    r = q.rotator()
+    assert isinstance(r, qn.Rotator), "rotator type failure"
+    assert r.quaternion == q and r.origin == (0.0, 0.0, 0.0), "rotator attribute failure"
+    for j in range(3):
+        assert close(r.matrix[j], q.matrix()[j]), "rotator matrix failure"
+
+    for p in points:
+        assert close(r(p), q.rotate(p)), "rotator call failure"
+        assert close(r.rotate(list(p)), q.rotate(p)), "rotator rotate failure"
+
+    r = qn.Rotator(q, origin=origin)
+    assert close(r((1, 2, 3)), q.rotate((1, 2, 3), origin)), "rotator origin failure"
+    assert close(r.rotate_many(flat), q.rotate_many(flat, origin)), "rotator many failure"
+
+    b = array.array('d', flat)
+    assert r.rotate_many(b, out=b) is b, "rotator out failure"
+    assert close(b, q.rotate_many(flat, origin)), "rotator in place failure"
+
+    # As per rotate, non-unit quaternions scale by abs(q)**2
+    #
+    assert close((2 * q).rotator()((1, 2, 3)), (2 * q).rotate((1, 2, 3))), "scaled failure"
+
+    s = pickle.loads(pickle.dumps(r))
+    assert s.quaternion == r.quaternion and s.origin == r.origin, "rotator pickle failure"
+    assert repr(r).startswith("quaternion.Rotator("), "rotator repr failure"
+
+    # Expected errors
+    #
+    for action in (lambda: r(), lambda: r((1, 2)), lambda: r((1, 2, 3), (0, 0, 0)),
+                   lambda: r(p=(1, 2, 3)), lambda: qn.Rotator("fred"),
+                   lambda: r.rotate_many(array.array('f', flat))):
+        try:
+            action()
+            assert False, "Expecting a TypeError"
+        except TypeError:
+            pass
+
+    try:
+        r.rotate_many(flat, out=bytearray(8))
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+
+def test_interpolate():
+    print("test_interpolate")
+    keys = Qa([Qn(angle=0.3 * j, axis=(1, j, 2)) for j in range(6)])
+    keys[3] = -keys[3]        # same rotation, opposite hemisphere
+    times = array.array('d', [0.0, 1.0, 1.5, 3.0, 3.5, 5.0])
+    samples = array.array('d', [-1.0, 0.0, 0.2, 0.9, 1.0, 1.25, 2.0, 3.0,
+                                3.2, 4.9, 5.0, 6.0, 0.1])
+
+    def segment(t):
+        for j in range(len(times) - 1):
+            if times[j] <= t < times[j + 1]:
+                return j, (t - times[j]) / (times[j + 1] - times[j])
+        return None, None
+
+    r = qn.interpolate(keys, times, samples)
+    assert isinstance(r, Qa) and len(r) == len(samples), "interpolate result failure"
+    for t, q in zip(samples, r):
+        j, u = segment(t)
+        if j is None:
+            expected = keys[0] if t <= times[0] else keys[-1]
+        else:
+            expected = qn.slerp(keys[j], keys[j + 1], u)
+        assert abs(q - expected) < 1.0e-15, "slerp interpolate failure"
+
+    r = qn.interpolate(keys, times, samples, method="nlerp")
+    for t, q in zip(samples, r):
+        j, u = segment(t)
+        if j is not None:
+            a, b = keys[j], keys[j + 1]
+            if qn.dot(a, b) < 0:
+                a = -a
+            assert abs(q - qn.lerp(a, b, u).normalise()) < 1.0e-15, "nlerp failure"
+
+    # squad passes through the keys, and each item is a (near, as slerp goes
+    # linear for very small angles) unit quaternion close to the slerp path.
+    #
+    r = qn.interpolate(keys, times, times, method="squad")
+    assert all(abs(q - k) < 1.0e-15 for q, k in zip(r, keys)), "squad keys failure"
+    s = qn.interpolate(keys, times, samples, method="squad")
+    lin = qn.interpolate(keys, times, samples)
+    for q, p in zip(s, lin):
+        assert abs(abs(q) - 1.0) < 1.0e-4, "squad unit failure"
+        assert min(abs(q - p), abs(q + p)) < 0.05, "squad path failure"
+
+    # Into an existing (structure of arrays) array, and in multiple threads.
+    #
+    out = Qa([0] * len(samples), layout="soa")
+    assert qn.interpolate(keys, times, samples, "squad", out) is out, "out failure"
+    assert out == s, "out value failure"
+
+    dense = array.array('d', [j * 0.001 for j in range(-100, 5200)])
+    expected = qn.interpolate(keys, times, dense)
+    threshold = qn.parallel_threshold()
+    try:
+        qn.set_num_threads(4)
+        qn.set_parallel_threshold(0)
+        assert qn.interpolate(keys, times, dense) == expected, "parallel failure"
+    finally:
+        qn.set_num_threads(0)
+        qn.set_parallel_threshold(threshold)
+
+    # A single key is just held.
+    #
+    r = qn.interpolate(Qa([keys[2]]), array.array('d', [7.0]), samples)
+    assert r == Qa([keys[2]] * len(samples)), "single key failure"
+    assert qn.interpolate(keys, times, array.array('d')) == Qa(), "no samples failure"
+
+    # Expected errors
+    #
+    try:
+        qn.interpolate(keys, times[:-1], samples)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.interpolate(keys, array.array('d', [0, 1, 1, 2, 3, 4]), samples)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.interpolate(keys, times, samples, method="fred")
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.interpolate(Qa(), array.array('d'), samples)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.interpolate(keys, times, samples, out=Qa([0]))
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.interpolate(list(keys), times, samples)
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+
+def test_unit_fast_paths():
+    print("test_unit_fast_paths")
+
+    def close(a, b, tol=1.0e-12):
+        return all(abs(x - y) <= tol for x, y in zip(a, b))
+
+    q = Qn(angle=tau / 7, axis=(1, 2, 3))
+    points = [(1.0, 2.0, 3.0), (-4.0, 0.5, 2.0), (0.0, 0.0, 0.0), (7.0, -8.0, 9.0),
+              (0.25, 1.0e3, -2.0)]
+    flat = array.array('d', [c for p in points for c in p])
+    origin = (1.0, -1.0, 0.5)
+
+    for p in points:
+        assert close(q.rotate(p, unit=True), q.rotate(p)), "unit rotate failure"
+        assert close(q.rotate(p, origin, True), q.rotate(p, origin)), "unit rotate origin failure"
+
+    assert close(q.rotate_many(flat, origin, unit=True),
+                 q.rotate_many(flat, origin)), "unit rotate_many failure"
+
+    qa = Qa([Qn(angle=0.1 * j, axis=(j, 1, -2)) for j in range(len(points))])
+    expected = qa.rotate_points(flat)
+    for layout in ("aos", "soa"):
+        r = Qa(qa, layout=layout).rotate_points(flat, unit=True)
+        assert close(r, expected), "unit rotate_points failure " + layout
+
+    # The simd kernels must match the scalar reference exactly.
+    #
+    backend = qn.simd_backend()
+    try:
+        qn.set_simd_backend("scalar")
+        scalar = qa.rotate_points(flat, origin, unit=True)
+    finally:
+        qn.set_simd_backend(backend)
+    assert qa.rotate_points(flat, origin, unit=True) == scalar, "unit simd failure"
+
+    # A non-unit quaternion is not corrected for, unlike the general case.
+    #
+    assert close((2 * q).rotate((1, 2, 3)), [4 * c for c in q.rotate((1, 2, 3))])
+    assert not close((2 * q).rotate((1, 2, 3), unit=True), (2 * q).rotate((1, 2, 3)))
+
+    # Interpolation
+    #
+    keys = Qa([Qn(angle=0.3 * j, axis=(1, j, 2)) for j in range(6)])
+    times = array.array('d', [0.0, 1.0, 2.5, 3.0, 4.0, 6.0])
+    samples = array.array('d', [-1.0, 0.0, 0.3, 1.2, 2.7, 3.5, 5.9, 6.0, 8.0])
+    for method in ("slerp", "nlerp", "squad"):
+        a = qn.interpolate(keys, times, samples, method=method)
+        b = qn.interpolate(keys, times, samples, method=method, unit=True)
+        for x, y in zip(a, b):
+            assert abs(x - y) < 1.0e-12, "unit interpolate failure " + method
+
+    for t in (-0.5, 0.0, 0.3, 1.0, 1.7):
+        x = qn.slerp(keys[1], -keys[4], t)
+        y = qn.slerp(keys[1], -keys[4], t, unit=True)
+        assert abs(x - y) < 1.0e-12, "unit slerp failure"
+    assert qn.slerp(q1=keys[0], q2=keys[2], t=0.5, unit=True) == \
+        qn.slerp(keys[0], keys[2], 0.5, unit=True), "slerp keyword failure"
+    try:
+        qn.slerp(keys[0], keys[2], 0.5, True)
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    # Cheap renormalisation
+    #
+    drifted = Qa([x * (1.0 + 1.0e-4 * (j - 2)) for j, x in enumerate(qa)])
+    r = Qa(drifted)
+    assert r.irenormalise() is None, "in place methods should return None"
+    for x in r:
+        assert abs(abs(x) - 1.0) < 1.0e-7, "irenormalise failure"
+    for x, y in zip(r, drifted.normalise()):
+        assert abs(x - y) < 1.0e-7, "irenormalise direction failure"
+    r.irenormalise()
+    for x in r:
+        assert abs(abs(x) - 1.0) < 1.0e-14, "irenormalise convergence failure"
+
+    s = Qa(drifted, layout="soa")
+    s.irenormalise()
+    t = Qa(drifted)
+    t.irenormalise()
+    assert list(s) == list(t), "irenormalise soa failure"
+
+
+def _same_rotation(a, b):
+    return min(abs(a - b), abs(a + b)) < 1.0e-12
+
+
+def test_array_conversions():
+    print("test_array_conversions")
+    axes = {'x': (1, 0, 0), 'y': (0, 1, 0), 'z': (0, 0, 1)}
+    items = [Qn(angle=0.1 * j, axis=(1, -j, j * j - 3)) for j in range(50)]
+    a = Qa(items)
+
+    # Matrices
+    #
+    m = a.to_matrices()
+    assert isinstance(m, array.array) and len(m) == 9 * len(a), "to_matrices type fail"
+    for j, q in enumerate(a):
+        assert tuple(m[9*j:9*j + 9]) == sum(q.matrix(), ()), "to_matrices fail"
+
+    out = array.array('d', bytes(len(m) * 8))
+    assert a.to_matrices(out=out) is out and out == m, "to_matrices out fail"
+    b = Qa.from_matrices(m)
+    for j, q in enumerate(a):
+        assert _same_rotation(b[j], Qn(matrix=q.matrix())), "from_matrices fail"
+
+    # Axis and angle
+    #
+    v, t = a.to_axis_angle()
+    assert len(v) == 3 * len(a) and len(t) == len(a), "to_axis_angle length fail"
+    for j, q in enumerate(a):
+        assert tuple(v[3*j:3*j + 3]) == q.axis(), "to_axis_angle axis fail"
+        assert abs(t[j] - q.angle()) < 1.0e-12, "to_axis_angle angle fail"
+    b = Qa.from_axis_angle(v, t)
+    for p, q in zip(a, b):
+        assert _same_rotation(p, q), "from_axis_angle fail"
+
+    # Euler angles, for each order and including gimbal lock.
+    #
+    orders = [x + y + z for x in "xyz" for y in "xyz" for z in "xyz" if x != y and y != z]
+    assert len(orders) == 12
+    for order in orders:
+        b = Qa(a)
+        for middle in (0.0, tau / 4, -tau / 4, tau / 2):
+            b.append(Qn(angle=0.3, axis=axes[order[0]]) *
+                     Qn(angle=middle, axis=axes[order[1]]) *
+                     Qn(angle=0.2, axis=axes[order[2]]))
+        e = b.to_euler(order)
+        for j, q in enumerate(b):
+            r = Qn(1)
+            for k in range(3):
+                assert abs(e[3*j + k]) <= tau / 2, "to_euler range fail"
+                r *= Qn(angle=e[3*j + k], axis=axes[order[k]])
+            assert _same_rotation(r, q), "to_euler fail " + order
+        c = Qa.from_euler(e, order=order)
+        for p, q in zip(b, c):
+            assert _same_rotation(p, q), "from_euler fail " + order
+
+    q = Qn(angle=0.3, axis=(0, 0, 1)) * Qn(angle=0.2, axis=(0, 1, 0)) * Qn(angle=0.1, axis=(1, 0, 0))
+    e = Qa([q]).to_euler()
+    assert max(abs(x - y) for x, y in zip(e, (0.3, 0.2, 0.1))) < 1.0e-15, "yaw pitch roll fail"
+
+    assert Qa().to_matrices() == array.array('d'), "empty fail"
+    assert Qa.from_euler(b'') == Qa(), "empty fail"
+
+    for func, args in ((a.to_euler, ("xxy",)), (a.to_euler, ("xy",)), (a.to_euler, ("abc",)),
+                       (a.to_matrices, (array.array('d', [0] * 9),)),
+                       (Qa.from_matrices, (array.array('d', [0] * 10),)),
+                       (Qa.from_axis_angle, (v, t[1:])),
+                       (Qa.from_axis_angle, (array.array('d', [0, 0, 0]), array.array('d', [1])))):
+        try:
+            func(*args)
+            assert False, "Expecting a ValueError"
+        except ValueError:
+            pass
+
+    try:
+        Qa.from_euler([0.0, 1.0, 2.0])
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+
 if __name__ == "__main__":
     test_construct()
     test_expected_errors()
@@ -363,5 +753,10 @@ if __name__ == "__main__":
     test_rotation4()
     test_rotation5()
     test_rotation6()
+    test_rotate_many()
+    test_rotator()
+    test_interpolate()
+    test_unit_fast_paths()
+    test_array_conversions()
 
 # end
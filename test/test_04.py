@@ -2,7 +2,10 @@
 #
 
 import array
+import io
+import os
 import pickle
+import struct
 import quaternion as qn
 
 Qn = qn.Quaternion
@@ -239,6 +242,163 @@ def test_array_reserve():
         assert n == m, f"Reserve - expecting {m}, got {n}"
 
 
+def test_array_growth():
+    print("test_array_growth")
+    for growth, limit in ((None, 40), (2.0, 25), (1.0, 10000)):
+        a = Qa(growth=growth)
+        assert a.growth == (growth or 1.5), "growth attribute fail"
+        changes = 0
+        allocated = a.allocated
+        for j in range(100000):
+            a.append(qx)
+            assert a.allocated >= len(a), "allocated fail"
+            if a.allocated != allocated:
+                changes += 1
+                allocated = a.allocated
+        assert changes <= limit, f"growth {growth}: {changes} reallocations"
+
+    # Geometric growth applies to extend as well.
+    #
+    a = Qa()
+    for j in range(100):
+        a.extend(ql)
+    assert a.allocated < 1.5 * len(a) + 10, "extend growth fail"
+
+    a.shrink_to_fit()
+    assert a.allocated == len(a) == 400, "shrink_to_fit fail"
+    a.append(q1)
+    assert a.allocated == 601, "regrow fail"
+    del a[10:]
+    a.shrink_to_fit()
+    assert a.allocated == 10, "shrink_to_fit after delete fail"
+
+    # Stepped deletes must not read beyond the end of an exactly sized array.
+    #
+    for layout in ("aos", "soa"):
+        for step in (2, 3, 4, 7, -3):
+            items = [Qn(j, -j, 2 * j, 3) for j in range(10)]
+            a = Qa(items, layout=layout)
+            a.shrink_to_fit()
+            del a[::step]
+            del items[::step]
+            assert a == Qa(items), "shrink_to_fit stepped delete fail"
+
+    # The reserved size is still honoured.
+    #
+    a = Qa(ql, reserve=100)
+    a.shrink_to_fit()
+    assert a.allocated == 100 and a == Qa(ql), "shrink_to_fit reserve fail"
+
+    a.set_growth(3)
+    assert a.growth == 3.0, "set_growth fail"
+    a.set_growth(None)
+    assert a.growth == 1.5, "set_growth default fail"
+
+    for growth in (0.5, 4.5, float('nan')):
+        try:
+            Qa(growth=growth)
+            assert False, "Expecting a ValueError"
+        except ValueError:
+            pass
+
+    try:
+        a.set_growth("fred")
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    # Items are kept as the allocation changes, for both layouts.
+    #
+    for layout in ("aos", "soa"):
+        a = Qa(ql * 100, layout=layout)
+        a.shrink_to_fit()
+        a.extend(qr)
+        del a[3:400]
+        a.shrink_to_fit()
+        assert list(a) == list(ql[:3]) + list(qr), layout + " items fail"
+
+    b = Qa(ql)
+    m = memoryview(b)
+    try:
+        b.shrink_to_fit()
+        assert False, "Expecting a BufferError"
+    except BufferError:
+        pass
+    m.release()
+
+
+def test_array_allocator():
+    print("test_array_allocator")
+    assert qn.array_allocator() == "default", "default allocator fail"
+
+    # Buffers are 64 byte aligned, and stay so as they are reallocated.
+    #
+    a = Qa(ql)
+    for j in range(2000):
+        assert a.buffer_info()[0] % 64 == 0, "alignment fail"
+        a.append(qx)
+    for layout in ("aos", "soa"):
+        a = Qa(ql * 1000, layout=layout)
+        a.shrink_to_fit()
+        assert a.buffer_info()[0] % 64 == 0, layout + " alignment fail"
+        assert list(a[:4]) == list(ql), layout + " items fail"
+
+    for name in ("hugepage", "shared"):
+        try:
+            qn.set_array_allocator(name)
+        except ValueError:
+            continue   # not available on this platform
+        try:
+            assert qn.array_allocator() == name, name + " allocator fail"
+            a = Qa(ql)
+            for j in range(200000):
+                a.append(qx)
+            a.extend(ql)
+            assert a.buffer_info()[0] % 64 == 0, name + " alignment fail"
+            assert a[:4] == Qa(ql) and a[-4:] == Qa(ql), name + " items fail"
+            del a[4:]
+            a.shrink_to_fit()
+            assert a == Qa(ql), name + " shrink fail"
+        finally:
+            qn.set_array_allocator("default")
+
+        # Arrays outlive a change of allocator.
+        #
+        a.extend(ql * 100000)
+        assert a[-4:] == Qa(ql), name + " extend after change fail"
+        del a
+
+    # Items of a 'shared' array modified by a forked child are visible to the parent.
+    #
+    if hasattr(os, "fork"):
+        try:
+            qn.set_array_allocator("shared")
+            a = Qa(ql)
+        except ValueError:
+            a = None
+        finally:
+            qn.set_array_allocator("default")
+        if a is not None:
+            pid = os.fork()
+            if pid == 0:
+                a[0] = qx
+                os._exit(0)
+            os.waitpid(pid, 0)
+            assert a[0] == qx, "shared allocator fork fail"
+
+    try:
+        qn.set_array_allocator("fred")
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.set_array_allocator(1)
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+
 def test_array_to_from_bytes():
     print("test_array_to_from_bytes")
     a = Qa(ql)
@@ -273,6 +433,45 @@ def test_array_buffer_api():
     assert bytes(a) == bytes(b), "bytes(a) failed"
     assert bytes(a) == a.tobytes(), "bytes(a) != a.tobytes()"
 
+    # The buffer is a 2-D (count, 4) array of doubles.
+    #
+    a = Qa(ql)
+    m = memoryview(a)
+    assert m.format == 'd' and m.itemsize == 8, "buffer format fail"
+    assert m.shape == (4, 4) and m.strides == (32, 8), "buffer shape fail"
+    assert m.c_contiguous and not m.readonly, "buffer contiguous fail"
+    assert m.tolist() == [[q.w, q.x, q.y, q.z] for q in ql], "buffer values fail"
+    assert list(m.cast('B').cast('d')) == [c for q in ql for c in (q.w, q.x, q.y, q.z)], "buffer cast fail"
+
+    # Zero copy - writes through the view are seen by the array.
+    #
+    m[1, 2] = -6.5
+    assert a[1] == Qn(4, 5, -6.5, 7), "buffer write fail"
+
+    # The array may be modified, but not resized, while exported.
+    #
+    for resize in (lambda: a.append(qx), lambda: a.extend(ql), lambda: a.pop(),
+                   lambda: a.clear(), lambda: a.reserve(100), lambda: a.__delitem__(0)):
+        try:
+            resize()
+            assert False, "Expecting a BufferError"
+        except BufferError:
+            pass
+    a[0] = qx
+    assert m[0, 3] == qx.z, "buffer modify fail"
+    assert len(a) == 4, "array resized"
+
+    m.release()
+    a.append(qx)
+    assert len(a) == 5, "append after release fail"
+
+    # Empty arrays, and other consumers of the buffer.
+    #
+    m = memoryview(Qa())
+    assert m.shape == (0, 4) and m.tolist() == [], "empty buffer fail"
+    assert array.array('d', bytes(Qa(ql))).tolist() == [c for q in ql for c in (q.w, q.x, q.y, q.z)]
+    assert bytearray(a) == a.tobytes(), "bytearray fail"
+
 
 def test_array_to_from_file():
     print("test_array_to_from_file")
@@ -302,6 +501,457 @@ def test_array_to_from_file():
         assert False, "Expecting an EOFError"
 
 
+def test_array_strings():
+    print("test_array_strings")
+    for layout in ("aos", "soa"):
+        a = Qa(ql * 10 + (Qn(1.5, -2, 3e-9, float("inf")),), layout=layout)
+        text = a.format()
+        assert text.split("\n")[-1] == "(1.5-2i+3e-09j+infk)", "format fail"
+        assert text == "\n".join(str(q) for q in a), "format str fail"
+        b = Qa(layout=layout)
+        b.fromstrings(text)
+        assert b == a, "format round trip fail"
+
+        data = a.format(".3f", sep=",", brackets=False, as_bytes=True)
+        assert isinstance(data, bytes), "format bytes fail"
+        assert data.split(b",")[-1] == b"1.500-2.000i+0.000j+infk", "format spec fail"
+        b = Qa(layout=layout)
+        b.fromstrings(data, ",")
+        assert b.format(".3f", ",", False) == data.decode(), "fromstrings bytes fail"
+
+    a = Qa([q0])
+    a.fromstrings("1.2+3.4i+2.6j-2k\r\n(1)\n\n 2j \n")
+    assert a == Qa([q0, Qn(1.2, 3.4, 2.6, -2), Qn(1), Qn(0, 0, 2, 0)]), "fromstrings fail"
+    a = Qa()
+    a.fromstrings(" 1+2i  3k\t4\n", None)
+    assert a == Qa([Qn(1, 2), Qn(0, 0, 0, 3), Qn(4)]), "fromstrings whitespace fail"
+    a.fromstrings(["5i", b"6j"])
+    a.fromstrings(bytearray(b"7::8k"), "::")
+    a.fromstrings(memoryview(b"9"))
+    assert a[3:] == Qa([Qn(0, 5), Qn(0, 0, 6), Qn(7), Qn(0, 0, 0, 8), Qn(9)]), "fromstrings types fail"
+
+    assert Qa().format() == "", "empty format fail"
+    assert Qa(ql).format("e") == "\n".join(
+        "(%e%+ei%+ej%+ek)" % (q.w, q.x, q.y, q.z) for q in ql), "format e fail"
+
+    # Errors leave the array unchanged.
+    #
+    a = Qa(ql)
+    for data, sep, error in (("1+2i\n1+2x\n3", "\n", ValueError),
+                             ("1,2", "", ValueError),
+                             ("1,2", 1, TypeError),
+                             (["1", 2], "\n", TypeError),
+                             (["1", "(2"], "\n", ValueError),
+                             ("1_000", "\n", ValueError)):
+        try:
+            a.fromstrings(data, sep)
+            assert False, "Expecting a " + error.__name__
+        except error:
+            pass
+        assert a == Qa(ql), "fromstrings error fail"
+
+    for spec in (".r", "3f", ".f", "ff", ">10"):
+        try:
+            a.format(spec)
+            assert False, "Expecting a ValueError"
+        except ValueError:
+            pass
+
+
+class _Liar:
+    """ An iterable whose length does not match the number of items. """
+    def __init__(self, length, items):
+        self.length = length
+        self.items = items
+
+    def __len__(self):
+        return self.length
+
+    def __iter__(self):
+        return iter(self.items)
+
+
+def test_array_mmap():
+    print("test_array_mmap")
+    fname = '/tmp/test_array_mmap.dat'
+    a = Qa(ql + qr)
+
+    with open(fname, 'wb') as f:
+        f.write(b"header..")
+        a.tofile(f)
+
+    # read only
+    #
+    m = Qa.mmap(fname, offset=8)
+    assert m == a, "mmap r failure"
+    assert m.readonly and not a.readonly, "readonly attribute failure"
+    assert memoryview(m).readonly, "readonly buffer failure"
+    assert Qa.mmap(fname, 'r', 40, 3) == a[1:4], "mmap offset/count failure"
+    assert m.mul(qx) == a.mul(qx), "mmap arithmetic failure"
+
+    for action in (lambda: m.__setitem__(0, qx), lambda: m.imul(qx),
+                   lambda: m.append(qx), lambda: m.reverse(), lambda: qn.exp(a, out=m)):
+        try:
+            action()
+            assert False, "Expecting a TypeError"
+        except TypeError:
+            pass
+    assert m == a, "read only mmap modified"
+    del m
+
+    # copy on write - changes are not written to the file
+    #
+    m = Qa.mmap(fname, mode='c', offset=8)
+    m[0] = qx
+    m.imul(2)
+    assert m[0] == 2 * qx, "mmap c failure"
+    m.append(q1)     # leaves the mapping
+    assert len(m) == 9 and m[1:8] == a[1:].mul(2), "mmap c resize failure"
+    m[7] = qx
+    assert Qa.mmap(fname, offset=8) == a, "copy on write mmap modified file"
+    del m
+
+    # shared - changes are written to the file
+    #
+    m = Qa.mmap(fname, mode='r+', offset=8)
+    m[2] = qx
+    m.w[3] = 99.0
+    try:
+        m.append(q1)
+        assert False, "Expecting a BufferError"
+    except BufferError:
+        pass
+    for n in (1, 50):
+        try:
+            m[4:7] = _Liar(3, [qx] * n)
+            assert False, "Expecting a BufferError"
+        except BufferError:
+            pass
+        assert len(m) == len(a) and m[4:] == a[4:], "mmap r+ liar fail"
+    del m
+
+    c = Qa()
+    with open(fname, 'rb') as f:
+        f.read(8)
+        c.fromfile(f, len(a))
+    assert c[2] == qx and c[3].w == 99.0 and c[4:] == a[4:], "mmap r+ failure"
+
+    # Errors
+    #
+    for args, error in ((("fred", 8), ValueError), (("r", 0), ValueError),
+                        (("r", 4), ValueError), (("r", 8, 9), EOFError),
+                        (("r", 400), ValueError), (("r", 8, -2), ValueError)):
+        try:
+            Qa.mmap(fname, *args)
+            assert False, "Expecting an error"
+        except error:
+            pass
+
+    with open(fname, 'wb') as f:
+        pass
+    assert Qa.mmap(fname) == Qa(), "mmap empty file failure"
+
+
+def _shared_memory_worker(a):
+    # Runs in a worker process - the array arrives via pickle.
+    a[0] = qx
+    return len(a), a.shared_memory is not None
+
+
+def test_array_shared_memory():
+    print("test_array_shared_memory")
+    a = Qa(ql * 2500)
+    b = a.to_shared_memory()
+    shm = b.shared_memory
+    try:
+        assert b == a and len(b) == 10000, "to_shared_memory fail"
+        assert a.shared_memory is None, "shared_memory attribute fail"
+        assert shm.size >= 10000 * 32, "segment size fail"
+
+        # Only the segment name, offset and count are pickled.
+        #
+        p = pickle.dumps(b)
+        assert len(p) < 200, "pickle size fail"
+        c = pickle.loads(p)
+        assert c == a, "pickle items fail"
+        c[1] = qx
+        assert b[1] == qx, "pickle not shared fail"
+        b[1] = ql[1]
+
+        # Attach by name, with an offset and count.
+        #
+        d = Qa.from_shared_memory(shm.name, offset=64, count=8, readonly=True)
+        assert list(d) == list(ql[2:] + ql * 1 + ql[:2]), "from_shared_memory fail"
+        assert d.readonly, "readonly fail"
+        try:
+            d[0] = qx
+            assert False, "Expecting a TypeError"
+        except TypeError:
+            pass
+        e = pickle.loads(pickle.dumps(d))
+        assert e.readonly and e == d, "readonly pickle fail"
+
+        e = Qa.from_shared_memory(shm, 32 * 9996)
+        assert list(e) == list(ql), "from_shared_memory object fail"
+
+        for bad in (dict(offset=3), dict(offset=-8), dict(count=-2),
+                    dict(offset=32 * 10001), dict(count=10001)):
+            try:
+                Qa.from_shared_memory(shm, **bad)
+                assert False, "Expecting an error for %s" % bad
+            except (ValueError, EOFError):
+                pass
+
+        try:
+            b.append(qx)
+            assert False, "Expecting a BufferError"
+        except BufferError:
+            pass
+
+        # Workers modify the items in place.
+        #
+        import multiprocessing
+        if "fork" in multiprocessing.get_all_start_methods():
+            with multiprocessing.get_context("fork").Pool(2) as pool:
+                r = pool.apply(_shared_memory_worker, (b,))
+            assert r == (10000, True), "worker result fail"
+            assert a[0] != qx and b[0] == qx, "worker update fail"
+
+        del c, d, e
+        f = Qa().to_shared_memory()
+        assert len(f) == 0 and len(pickle.loads(pickle.dumps(f))) == 0, "empty fail"
+        f.shared_memory.unlink()
+        del f
+    finally:
+        del b
+        shm.close()
+        shm.unlink()
+
+
+def test_array_stream():
+    print("test_array_stream")
+    fname = '/tmp/test_array_stream.dat'
+    a = Qa(ql * 2500)
+
+    with qn.QuaternionArrayWriter(fname) as w:
+        w.write(a)
+        w.writelines([Qa(qr), Qa(qr, layout="soa")])
+        assert w.count == 10008, "writer count fail"
+    assert w.closed, "writer closed fail"
+
+    with open(fname, 'rb') as f:
+        data = f.read()
+    assert len(data) == 32 + 10008 * 32, "stream size fail"
+    assert data[:8] == b"QUATARRY", "stream magic fail"
+    assert data[32:32 + 32 * 10000] == a.tobytes(), "stream items fail"
+
+    # Chunks are refilled unless a reference is held.
+    #
+    r = qn.QuaternionArrayReader(fname, chunk=3000)
+    assert r.count == 10008 and r.version == 1 and r.layout == "aos", "reader attributes fail"
+    lengths = []
+    ids = set()
+    for c in r:
+        lengths.append(len(c))
+        ids.add(id(c))
+    assert lengths == [3000, 3000, 3000, 1008], "chunk lengths fail"
+    assert len(ids) == 2, "chunk reuse fail"
+    assert r.position == 10008, "reader position fail"
+    r.close()
+
+    with qn.QuaternionArrayReader(fname, chunk=3000, layout="soa") as r:
+        chunks = list(r)
+    assert [len(c) for c in chunks] == [3000, 3000, 3000, 1008], "kept chunks fail"
+    assert len(set(id(c) for c in chunks)) == 4, "kept chunks distinct fail"
+    assert chunks[0].layout == "soa", "reader layout fail"
+    b = Qa(layout="soa")
+    for c in chunks:
+        b.extend(c)
+    assert b == a + Qa(qr) + Qa(qr), "chunk items fail"
+
+    with open(fname, 'rb') as f:
+        with qn.QuaternionArrayReader(f) as r:
+            assert r.read(5) == Qa(ql + ql[:1]), "read(n) fail"
+            assert r.read() == a[5:] + Qa(qr) + Qa(qr), "read() fail"
+            assert len(r.read()) == 0 and len(r.read(10)) == 0, "read at end fail"
+            assert list(r) == [], "iterate at end fail"
+        assert not f.closed, "reader closed file it does not own"
+
+    # A soa layout writer, and a non-seekable file.
+    #
+    class Pipe(object):
+        def __init__(self):
+            self.data = io.BytesIO()
+
+        def write(self, b):
+            return self.data.write(b)
+
+        def flush(self):
+            pass
+
+    p = Pipe()
+    w = qn.QuaternionArrayWriter(p, layout="soa")
+    w.write(Qa(ql, layout="soa"))
+    w.write(a)
+    w.close()
+    p.data.seek(0)
+    r = qn.QuaternionArrayReader(p.data)
+    assert r.count is None and r.layout == "soa", "unknown count fail"
+    assert r.read() == Qa(ql) + a, "unknown count read fail"
+
+    # The other byte order is swapped on reading.
+    #
+    order = '>' if struct.pack('=H', 1) == struct.pack('<H', 1) else '<'
+    items = b"".join(struct.pack(order + "4d", q.w, q.x, q.y, q.z) for q in ql)
+    other = b"QUATARRY" + struct.pack(order + "HccIQQ", 1, order.encode(), b"a", 32, 4, 0)
+    r = qn.QuaternionArrayReader(io.BytesIO(other + items))
+    assert r.byteorder == ("big" if order == '>' else "little"), "byteorder fail"
+    assert r.read() == Qa(ql), "byteswap fail"
+
+    # Errors.
+    #
+    for bad in (b"", b"NOTQUATS" + bytes(24), other[:10] + b"?" + other[11:],
+                other[:8] + struct.pack(order + "H", 2) + other[10:]):
+        try:
+            qn.QuaternionArrayReader(io.BytesIO(bad))
+            assert False, "Expecting a ValueError"
+        except ValueError:
+            pass
+
+    try:
+        qn.QuaternionArrayReader(io.BytesIO(other + items[:-32])).read()
+        assert False, "Expecting an EOFError"
+    except EOFError:
+        pass
+
+    unknown = other[:16] + b"\xff" * 8 + other[24:]
+    try:
+        qn.QuaternionArrayReader(io.BytesIO(unknown + items[:-8])).read()
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.QuaternionArrayReader(fname, chunk=0)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        w.write(a)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    w = qn.QuaternionArrayWriter(io.BytesIO())
+    try:
+        w.write([q0])
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    r.close()
+    try:
+        r.read()
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+    os.remove(fname)
+
+
+def test_array_encode():
+    print("test_array_encode")
+
+    def rotation_close(x, y, tolerance):
+        # A unit rotation encoding may change the sign.
+        #
+        u = y / abs(y)
+        return abs(x - u) < tolerance or abs(x + u) < tolerance
+
+    # Include items close to the worst case, i.e. all components of similar
+    # magnitude, so the largest component is recovered with the largest error.
+    #
+    worst = tuple(Qn(0.5 + 1.0e-4 * j, -0.5, 0.5 - 1.0e-4 * j, 0.5 + 3.0e-5 * j)
+                  for j in range(100))
+
+    for layout in ("aos", "soa"):
+        a = Qa(ql * 300 + worst, layout=layout)
+
+        f = a.encode()
+        assert isinstance(f, array.array) and f.typecode == 'f', "f4 type fail"
+        assert len(f) == 4 * len(a), "f4 length fail"
+        b = Qa.decode(f, layout=layout)
+        assert b.layout == layout and len(b) == len(a), "f4 decode fail"
+        for x, y in zip(b, a):
+            assert abs(x - y) < 1.0e-6 * abs(y), "f4 round trip fail"
+
+        assert Qa.decode(a.encode('f8'), 'f8') == a, "f8 round trip fail"
+
+        # The worst case error is sqrt(6)/(2^bits - 1) - see the README.
+        #
+        for encoding, size, tolerance in (("u8", 8, 2.4e-6), ("u6", 6, 7.6e-5)):
+            e = a.encode(encoding)
+            assert e.typecode == 'B' and len(e) == size * len(a), "unit size fail"
+            b = Qa.decode(bytes(e), encoding, layout)
+            for x, y in zip(b, a):
+                assert abs(abs(x) - 1.0) < tolerance, "unit norm fail"
+                assert rotation_close(x, y, tolerance), "unit round trip fail"
+
+            out = bytearray(size * len(a))
+            assert a.encode(encoding, out=out) is out, "encode out fail"
+            assert out == e.tobytes(), "encode out data fail"
+
+    # Encoded streams.
+    #
+    a = Qa(ql * 1000)
+    for encoding in ("f8", "f4", "u8", "u6"):
+        f = io.BytesIO()
+        with qn.QuaternionArrayWriter(f, layout="soa", encoding=encoding) as w:
+            w.write(a)
+            w.write(Qa(qr, layout="soa"))
+            assert w.encoding == encoding, "writer encoding fail"
+        data = f.getvalue()
+        expected = a.encode(encoding).tobytes() + Qa(qr).encode(encoding).tobytes()
+        assert data[32:] == expected, "stream encoded items fail"
+
+        with qn.QuaternionArrayReader(io.BytesIO(data), chunk=1500) as r:
+            assert r.encoding == encoding and r.count == 4004, "reader encoding fail"
+            assert r.version == (1 if encoding == "f8" else 2), "reader version fail"
+            assert r.layout == "soa", "reader layout fail"
+            b = r.read()
+        assert b == Qa.decode(expected, encoding), "stream decode fail"
+
+    # Errors.
+    #
+    try:
+        Qa([q0, Qn(0)]).encode('u8')
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.QuaternionArrayWriter(io.BytesIO(), encoding='u6').write(Qa([Qn(0)]))
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    for args, kwds, error in (((), {'encoding': 'f2'}, ValueError),
+                              ((), {'encoding': 8}, TypeError),
+                              ((), {'out': bytearray(3)}, ValueError),
+                              ((), {'out': bytes(64)}, BufferError)):
+        try:
+            Qa(ql[:1]).encode(*args, **kwds)
+            assert False, "Expecting a " + error.__name__
+        except error:
+            pass
+
+    try:
+        Qa.decode(bytes(10), 'u8')
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+
 def test_array_pickle():
     print("test_array_pickle")
     a = Qa(ql, reserve=131)
@@ -311,6 +961,48 @@ def test_array_pickle():
 
     assert a.reserved == c.reserved, "pickle/unpickle reserved failure"
 
+    for protocol in range(pickle.HIGHEST_PROTOCOL + 1):
+        for layout in ("aos", "soa"):
+            a = Qa(ql * 100, reserve=131, layout=layout)
+            c = pickle.loads(pickle.dumps(a, protocol=protocol))
+            assert a == c and c.layout == layout, "pickle protocol failure"
+            assert c.reserved == 131, "pickle protocol reserved failure"
+
+    # Protocol 5 sends the items out of band, and the unpickled array adopts
+    # the buffer, copying it if the array is resized.
+    #
+    a = Qa(ql * 100)
+    buffers = []
+    s = pickle.dumps(a, protocol=5, buffer_callback=buffers.append)
+    assert len(buffers) == 1 and len(s) < 100, "out of band failure"
+    data = bytearray(buffers[0].raw())
+    c = pickle.loads(s, buffers=[data])
+    assert a == c, "out of band unpickle failure"
+    c[0] = q3
+    assert data[:32] == Qa([q3]).tobytes(), "out of band adopt failure"
+    c.append(q0)
+    c[0] = q1
+    assert data[:32] == Qa([q3]).tobytes(), "out of band resize failure"
+    assert c == Qa([q1]) + a[1:] + Qa([q0]), "out of band resize items failure"
+
+    c = pickle.loads(s, buffers=[bytes(data)])
+    assert not c.readonly and c[0] == q3, "out of band read only failure"
+    c[0] = q0
+    assert c == a, "out of band copy failure"
+
+    # The version 1 format is still readable.
+    #
+    c = Qa()
+    c.__setstate__((1, 5, Qa(ql).tobytes()))
+    assert c == Qa(ql) and c.reserved == 5, "version 1 state failure"
+
+    # The state items are always 'aos', and are not adopted by an 'soa' array.
+    #
+    for version, data in ((1, bytes), (2, bytes), (2, bytearray)):
+        c = Qa(layout="soa")
+        c.__setstate__((version, 0, data(Qa(ql).tobytes())))
+        assert c == Qa(ql) and c.layout == "soa", "soa state failure"
+
 
 def test_array_concat():
     print("test_array_concat")
@@ -405,6 +1097,48 @@ def test_array_iteration():
             j += 1
         i += 1
 
+    # The iterator gives a length hint, and releases the array once exhausted.
+    #
+    it = iter(a)
+    assert it.__length_hint__() == 4, "Iteration length hint error"
+    next(it)
+    assert it.__length_hint__() == 3, "Iteration length hint error"
+    assert list(it) == list(ql[1:]), "Iteration remainder error"
+    assert it.__length_hint__() == 0, "Iteration exhausted hint error"
+    a.append(q0)
+    assert list(it) == [], "Iteration restart error"
+
+
+def test_array_tolist():
+    print("test_array_tolist")
+    for layout in ("aos", "soa"):
+        a = Qa(ql * 100, layout=layout)
+        b = a.tolist()
+        assert isinstance(b, list) and b == list(ql * 100), "tolist error"
+        assert Qa().tolist() == [], "empty tolist error"
+
+        c = list(a.iter_components())
+        assert c == [(q.w, q.x, q.y, q.z) for q in ql * 100], "iter_components error"
+        assert all(type(t) is tuple for t in c), "iter_components type error"
+
+        it = a.iter_chunks(150)
+        assert it.__length_hint__() == 3, "iter_chunks hint error"
+        chunks = list(it)
+        assert [len(c) for c in chunks] == [150, 150, 100], "iter_chunks length error"
+        assert all(c.base is a and c.layout == layout for c in chunks), "iter_chunks view error"
+        d = Qa(layout=layout)
+        for c in chunks:
+            d += c
+        assert d == a, "iter_chunks items error"
+        del c, chunks, it
+        a.append(q0)
+
+    try:
+        a.iter_chunks(0)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
 
 def equivilent(a, b):
     if isinstance(a, (tuple, list, array.array, qn.QuaternionArray)) and  \
@@ -489,6 +1223,346 @@ def test_array_slice():
     assert equivilent(a, b), "Array del error"
 
 
+def test_array_view():
+    print("test_array_view")
+    for layout in ("aos", "soa"):
+        a = Qa(ql * 5, layout=layout)
+        v = a.view(2, 9)
+        assert v == a[2:9] and v.layout == layout, "view items fail"
+        assert v.base is a and a.base is None, "view base fail"
+        assert a.view(-3) == a[-3:] and len(a.view(9, 2)) == 0, "view range fail"
+
+        # Changes are visible both ways, including same size slice assignment.
+        #
+        v[0] = q3
+        assert a[2] == q3, "view set item fail"
+        a[3] = q1
+        assert v[1] == q1, "view get item fail"
+        v[2:4] = [q0, q2]
+        assert a[4] == q0 and a[5] == q2 and v.base is a, "view slice assign fail"
+        v.imul(2.0)
+        assert a[2] == 2.0 * q3, "view in place fail"
+        assert v.mul(q1) == a[2:9].mul(q1), "view element-wise fail"
+        assert v.x.tolist() == a.x.tolist()[2:9], "view component fail"
+
+        w = v.view(1, 3)
+        assert w == a[3:5] and w.base is v, "nested view fail"
+
+        # A value whose length is wrong may not resize the view in place.
+        #
+        for n in (1, 50):
+            before = Qa(a)
+            try:
+                v[0:3] = _Liar(3, [q0] * n)
+                assert False, "Expecting a BufferError"
+            except BufferError:
+                pass
+            assert a == before and v.base is a and len(v) == 7, "view liar fail"
+
+        # The parent may not be resized while a view exists.
+        #
+        try:
+            a.append(q0)
+            assert False, "Expecting a BufferError"
+        except BufferError:
+            pass
+
+        c = pickle.loads(pickle.dumps(v, protocol=5))
+        assert c == v and c.base is None, "view pickle fail"
+
+        # Resizing a view detaches it.
+        #
+        del w
+        expected = a[2:9]
+        v.append(q0)
+        assert v.base is None and v == expected + Qa([q0]), "view resize fail"
+        v[0] = q1
+        assert a[2] == expected[0], "view detach fail"
+        a.append(q0)
+
+
+def test_array_soa_layout():
+    print("test_array_soa_layout")
+    assert Qa(ql).layout == "aos", "default layout fail"
+
+    s = Qa(ql, layout="soa")
+    a = Qa(ql)
+    assert s.layout == "soa", "layout fail"
+    assert s == a, "soa != aos"
+    assert list(s) == list(ql), "soa items fail"
+    assert str(s) == str(a), "soa str fail"
+    assert s.tobytes() == a.tobytes(), "soa tobytes fail"
+    assert bytes(s) == bytes(a), "soa bytes fail"
+
+    m = memoryview(s)
+    assert m.shape == (4, 4) and m.format == 'd', "soa buffer fail"
+    assert m.tolist()[2] == [8.0, 9.0, 10.0, 11.0], "soa buffer values fail"
+    del m
+
+    # Copies between layouts, and layout preserved by the array operations.
+    #
+    assert Qa(s).layout == "aos", "copy layout fail"
+    assert Qa(a, layout="soa") == a, "copy to soa fail"
+    assert (s + a).layout == "soa" and s + a == a + a, "concat fail"
+    assert (s * 3).layout == "soa" and s * 3 == a * 3, "repeat fail"
+    assert s[1:3].layout == "soa" and s[1:3] == a[1:3], "slice fail"
+
+    # Grow well beyond the initial allocation, which relocates the components.
+    #
+    for j in range(100):
+        s.append(Qn(j, -j, 2 * j, 0.5))
+        a.append(Qn(j, -j, 2 * j, 0.5))
+    assert s == a, "append fail"
+
+    s.insert(3, qx)
+    a.insert(3, qx)
+    s.extend(qr)
+    a.extend(qr)
+    s += s
+    a += a
+    assert s == a, "insert/extend fail"
+    assert s.pop(7) == a.pop(7) and s == a, "pop fail"
+    s.remove(qx)
+    a.remove(qx)
+    del s[20:150:3]
+    del a[20:150:3]
+    s[5:9] = ql + ql
+    a[5:9] = ql + ql
+    s[::10] = a[::10][::-1]
+    a[::10] = a[::10][::-1]
+    assert s == a, "remove/slice fail"
+    assert s.count(q2) == a.count(q2) and s.index(q3) == a.index(q3), "count/index fail"
+    s.reverse()
+    a.reverse()
+    assert s == a, "reverse fail"
+    s.byteswap()
+    assert s.tobytes() != a.tobytes(), "byteswap fail"
+    s.byteswap()
+    assert s == a, "byteswap fail"
+
+    t = Qa(layout="soa")
+    t.frombytes(a.tobytes())
+    assert t == a, "frombytes fail"
+
+    # Element-wise maths with any combination of layouts.
+    #
+    assert s.mul(a) == a.mul(a) and a.mul(s) == a.mul(a), "mul fail"
+    assert s.rsub(qx) == a.rsub(qx), "rsub fail"
+    assert s.normalise() == a.normalise(), "normalise fail"
+    p = array.array('d', range(3 * len(a)))
+    assert s.rotate_points(p) == a.rotate_points(p), "rotate_points fail"
+    t = Qa(s, layout="soa")
+    t.imul(qx)
+    assert t == a.mul(qx) and t.layout == "soa", "imul fail"
+
+    c = pickle.loads(pickle.dumps(s))
+    assert c == s and c.layout == "soa", "pickle fail"
+
+    s.clear()
+    assert len(s) == 0 and s.layout == "soa", "clear fail"
+
+    for bad, error in (("fred", ValueError), (4, TypeError)):
+        try:
+            Qa(layout=bad)
+            assert False, "Expecting a %s" % error.__name__
+        except error:
+            pass
+
+
+def test_array_component_views():
+    print("test_array_component_views")
+    for layout in ("aos", "soa"):
+        a = Qa(ql, layout=layout)
+        assert a.w.tolist() == [0.0, 4.0, 8.0, 12.0], "w view fail"
+        assert a.x.tolist() == [1.0, 5.0, 9.0, 13.0], "x view fail"
+        assert list(a.y) == [2.0, 6.0, 10.0, 14.0], "y view fail"
+        assert list(a.z) == [3.0, 7.0, 11.0, 15.0], "z view fail"
+
+        # The views are writable, and refer to the array data.
+        #
+        z = a.z
+        z[2] = -1.0
+        assert a[2] == Qn(8, 9, 10, -1), "view write fail"
+
+        # The array may not be resized while a view exists.
+        #
+        try:
+            a.append(qx)
+            assert False, "Expecting a BufferError"
+        except BufferError:
+            pass
+        a[0] = qx   # but it may be modified
+        assert z[0] == qx.z, "view write fail"
+
+        z.release()
+        a.append(qx)
+        assert len(a) == 5, "append after release fail"
+
+def test_array_from_buffer():
+    print("test_array_from_buffer")
+
+    # Generators are consumed once only.
+    #
+    assert Qa(q for q in ql) == Qa(ql), "generator fail"
+
+    values = [float(j) for j in range(24)]
+    d = array.array('d', values)
+
+    # A one dimensional buffer provides real items, as per a list of floats.
+    #
+    assert Qa(d) == Qa(values), "1-D fail"
+    assert Qa(array.array('i', range(5))) == Qa(range(5)), "1-D int fail"
+    assert Qa(b"\x01\x02") == Qa([1, 2]), "bytes fail"
+    assert Qa(array.array('f', [0.5, 1.5])) == Qa([0.5, 1.5]), "1-D float fail"
+
+    # (n, 4), (n, 3) and (n, 2) buffers.
+    #
+    m = memoryview(d).cast('B').cast('d', (6, 4))
+    expected = Qa([Qn(*values[4*j:4*j + 4]) for j in range(6)])
+    assert Qa(m) == expected, "(n, 4) fail"
+    assert Qa(m, layout="soa") == expected, "(n, 4) soa fail"
+    assert Qa(expected) == Qa(memoryview(expected)), "round trip fail"
+
+    m = memoryview(d).cast('B').cast('d', (8, 3))
+    assert Qa(m) == Qa([Qn(0, *values[3*j:3*j + 3]) for j in range(8)]), "(n, 3) fail"
+
+    m = memoryview(d).cast('B').cast('d', (12, 2))
+    assert Qa(m) == Qa([complex(*values[2*j:2*j + 2]) for j in range(12)]), "(n, 2) fail"
+
+    # Non-contiguous buffers, including a soa array's own buffer.
+    #
+    m = memoryview(d).cast('B').cast('d', (6, 4))[::2]
+    assert Qa(m) == expected[::2], "strided fail"
+    assert Qa(memoryview(d)[::3]) == Qa(values[::3]), "1-D strided fail"
+    s = Qa(expected, layout="soa")
+    assert Qa(memoryview(s)) == expected, "soa buffer fail"
+
+    # extend and slice assignment use the same path.
+    #
+    a = Qa(ql)
+    a.extend(memoryview(Qa(qr)))
+    assert a == Qa(ql + qr), "extend fail"
+    a.extend(a)
+    assert a == Qa((ql + qr) * 2), "extend self fail"
+
+    a = Qa(ql)
+    a[1:3] = memoryview(Qa([qx, qx, qx]))
+    assert a == Qa([q0, qx, qx, qx, q3]), "slice assign fail"
+    a[::2] = array.array('d', [1, 2, 3])
+    assert a == Qa([1, qx, 2, qx, 3]), "extended slice assign fail"
+
+    # Large arrays.
+    #
+    n = 100000
+    big = array.array('d', range(4 * n))
+    a = Qa(memoryview(big).cast('B').cast('d', (n, 4)))
+    assert len(a) == n, "large length fail"
+    assert a[n - 1] == Qn(*big[-4:]), "large value fail"
+    assert a.tobytes() == big.tobytes(), "large bytes fail"
+
+    # Errors leave the array unaltered.
+    #
+    a = Qa(ql)
+    try:
+        a.extend([q1, "fred", q2])
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+    assert a == Qa(ql), "failed extend modified array"
+
+    try:
+        a[1:2] = [q1, None]
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+    assert a == Qa(ql), "failed assign modified array"
+
+    for bad in (memoryview(d).cast('B').cast('d', (4, 6)), 42):
+        try:
+            Qa(bad)
+            assert False, "Expecting a TypeError"
+        except TypeError:
+            pass
+
+
+def test_c_api():
+    print("test_c_api")
+    import ctypes
+
+    class CQuaternion(ctypes.Structure):
+        _fields_ = [("w", ctypes.c_double), ("x", ctypes.c_double),
+                    ("y", ctypes.c_double), ("z", ctypes.c_double)]
+
+    class CArray(ctypes.Structure):
+        _fields_ = [("reserved", ctypes.c_ssize_t), ("growth", ctypes.c_double),
+                    ("allocated", ctypes.c_ssize_t), ("count", ctypes.c_ssize_t),
+                    ("qvalArray", ctypes.POINTER(CQuaternion)), ("layout", ctypes.c_int)]
+
+    normalise_kernel = ctypes.CFUNCTYPE(None, ctypes.POINTER(CQuaternion),
+                                        ctypes.POINTER(CQuaternion), ctypes.c_size_t)
+
+    class CAPI(ctypes.Structure):
+        _fields_ = [("version", ctypes.c_int), ("size", ctypes.c_size_t),
+                    ("QuaternionType", ctypes.c_void_p),
+                    ("QuaternionArrayType", ctypes.c_void_p),
+                    ("RotatorType", ctypes.c_void_p),
+                    ("Quaternion_FromCQuaternion",
+                     ctypes.PYFUNCTYPE(ctypes.py_object, CQuaternion)),
+                    ("Quaternion_AsCQuaternion", ctypes.c_void_p),
+                    ("Object_AsCQuaternion", ctypes.c_void_p),
+                    ("Array_New", ctypes.c_void_p),
+                    ("Array_Acquire",
+                     ctypes.PYFUNCTYPE(ctypes.POINTER(CArray), ctypes.py_object, ctypes.c_bool)),
+                    ("Array_Release", ctypes.PYFUNCTYPE(None, ctypes.py_object)),
+                    ("Array_Gather", ctypes.c_void_p),
+                    ("Array_Scatter", ctypes.c_void_p),
+                    ("Array_Sum", ctypes.c_void_p),
+                    ("Array_Diff", ctypes.c_void_p),
+                    ("Array_Prod", ctypes.c_void_p),
+                    ("Array_Quot", ctypes.c_void_p),
+                    ("Array_Normalise", normalise_kernel)]
+
+    capsule = qn._C_API
+    assert type(capsule).__name__ == "PyCapsule", "capsule type failure"
+
+    get_pointer = ctypes.pythonapi.PyCapsule_GetPointer
+    get_pointer.restype = ctypes.c_void_p
+    get_pointer.argtypes = [ctypes.py_object, ctypes.c_char_p]
+    api = CAPI.from_address(get_pointer(capsule, b"quaternion._C_API"))
+
+    assert api.version >= 1, "version failure"
+    assert api.size >= ctypes.sizeof(CAPI), "size failure"
+    assert api.QuaternionType == id(Qn), "Quaternion type failure"
+    assert api.QuaternionArrayType == id(Qa), "QuaternionArray type failure"
+    assert api.RotatorType == id(qn.Rotator), "Rotator type failure"
+
+    q = api.Quaternion_FromCQuaternion(CQuaternion(1.0, 2.0, 3.0, 4.0))
+    assert q == Qn(1, 2, 3, 4), "converter failure"
+
+    # Raw array access, the array may not be resized while acquired.
+    #
+    a = Qa(ql + qr)
+    aval = api.Array_Acquire(a, True)
+    assert aval.contents.count == len(a), "acquire count failure"
+    assert aval.contents.qvalArray[2].w == a[2].w, "acquire items failure"
+    try:
+        a.append(qx)
+        assert False, "Expecting a BufferError"
+    except BufferError:
+        pass
+    api.Array_Normalise(aval.contents.qvalArray, aval.contents.qvalArray, aval.contents.count)
+    api.Array_Release(a)
+    a.append(qx)
+    assert a[:-1] == Qa(ql + qr).normalise(), "kernel failure"
+
+    try:
+        api.Array_Acquire([1, 2], False)
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+
+
 if __name__ == "__main__":
     test_array_assign()
     test_array_attributes()
@@ -504,13 +1578,26 @@ if __name__ == "__main__":
     test_array_remove()
     test_array_reverse()
     test_array_reserve()
+    test_array_growth()
+    test_array_allocator()
     test_array_to_from_bytes()
     test_array_buffer_api()
     test_array_to_from_file()
+    test_array_strings()
+    test_array_mmap()
+    test_array_shared_memory()
+    test_array_stream()
+    test_array_encode()
     test_array_pickle()
     test_array_concat()
     test_array_repeat()
     test_array_iteration()
+    test_array_tolist()
     test_array_slice()
+    test_array_view()
+    test_array_soa_layout()
+    test_array_component_views()
+    test_array_from_buffer()
+    test_c_api()
 
 # end
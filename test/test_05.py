@@ -0,0 +1,625 @@
+#!/usr/bin/env python
+#
+# QuaternionArray element-wise maths tests.
+#
+
+import array
+import quaternion as qn
+
+Qn = qn.Quaternion
+Qa = qn.QuaternionArray
+
+Qn.for_repr_use_str()
+
+q0 = Qn(0, 1, 2, 3)
+q1 = Qn(4, 5, 6, 7)
+q2 = Qn(8, 9, 10, 11)
+q3 = Qn(12, 13, 14, 15)
+
+ql = (q0, q1, q2, q3)
+qr = (q3, q2, q1, q0)
+
+qx = Qn(2, -1, 8, -4)
+
+
+def test_array_arithmetic():
+    print("test_array_arithmetic")
+    a = Qa(ql)
+    b = Qa(qr)
+
+    # array op array
+    #
+    assert a.add(b) == Qa([x + y for x, y in zip(ql, qr)]), "add fail"
+    assert a.sub(b) == Qa([x - y for x, y in zip(ql, qr)]), "sub fail"
+    assert a.mul(b) == Qa([x * y for x, y in zip(ql, qr)]), "mul fail"
+    assert b.div(a) == Qa([y / x for x, y in zip(ql, qr)]), "div fail"
+
+    # array op quaternion and the reflected forms
+    #
+    assert a.add(qx) == Qa([x + qx for x in ql]), "add fail"
+    assert a.sub(qx) == Qa([x - qx for x in ql]), "sub fail"
+    assert a.rsub(qx) == Qa([qx - x for x in ql]), "rsub fail"
+    assert a.mul(qx) == Qa([x * qx for x in ql]), "mul fail"
+    assert a.rmul(qx) == Qa([qx * x for x in ql]), "rmul fail"
+    assert a.div(qx) == Qa([x / qx for x in ql]), "div fail"
+    assert b.rdiv(qx) == Qa([qx / y for y in qr]), "rdiv fail"
+
+    # array op number
+    #
+    assert a.add(2) == Qa([x + 2 for x in ql]), "add number fail"
+    assert a.mul(2.5) == Qa([x * 2.5 for x in ql]), "mul number fail"
+    assert a.mul(1j) == Qa([x * 1j for x in ql]), "mul complex fail"
+
+    # Real operands give exactly the same results as the Quaternion operators,
+    # including signed zeros.
+    #
+    zl = (Qn(1, -0.0, 0, 0), Qn(-0.0, 0.0, -0.0, 3), q1)
+    for layout in ("aos", "soa"):
+        z = Qa(zl, layout=layout)
+        for r in (2, -0.5, 0.0, -0.0):
+            for got, want in ((z.add(r), [x + r for x in zl]),
+                              (z.sub(r), [x - r for x in zl]),
+                              (z.rsub(r), [r - x for x in zl]),
+                              (z.mul(r), [x * r for x in zl]),
+                              (z.rmul(r), [r * x for x in zl])):
+                assert [x.data for x in got] == [x.data for x in want], "real operand fail"
+        got = z.div(-4)
+        assert [x.data for x in got] == [(x / -4).data for x in zl], "real div fail"
+        got = Qa(z)
+        got.imul(-0.0)
+        assert [x.data for x in got] == [(x * -0.0).data for x in zl], "real imul fail"
+
+    try:
+        a.div(0)
+        assert False, "Expecting a ZeroDivisionError"
+    except ZeroDivisionError:
+        pass
+
+    # originals are untouched
+    #
+    assert a == Qa(ql), "original modified"
+
+    # empty arrays are okay
+    #
+    assert Qa().mul(qx) == Qa(), "empty array fail"
+
+    try:
+        a.mul(Qa(ql[:3]))
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        a.mul("fred")
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    try:
+        a.div(Qa([q1, q2, 0, q3]))
+        assert False, "Expecting a ZeroDivisionError"
+    except ZeroDivisionError:
+        pass
+
+
+def test_array_inplace_arithmetic():
+    print("test_array_inplace_arithmetic")
+    a = Qa(ql)
+    r = a.imul(qx)
+    assert r is None, "in place methods should return None"
+    assert a == Qa([x * qx for x in ql]), "imul fail"
+
+    a = Qa(ql)
+    a.iadd(Qa(qr))
+    assert a == Qa([x + y for x, y in zip(ql, qr)]), "iadd fail"
+
+    a = Qa(ql)
+    a.isub(1)
+    assert a == Qa([x - 1 for x in ql]), "isub fail"
+
+    a = Qa(qr)
+    a.idiv(a)
+    assert a == Qa([1, 1, 1, 1]), "idiv self fail"
+
+    # the same array as both operands
+    #
+    a = Qa(ql)
+    a.imul(a)
+    assert a == Qa([x * x for x in ql]), "imul self fail"
+
+
+def _simd_data(n):
+    """ n pseudo random quaternions """
+    s = 12345
+    result = []
+    for j in range(n):
+        c = []
+        for k in range(4):
+            s = (s * 1103515245 + 12345) % 2147483648
+            c.append(s / 1073741824.0 - 1.0)
+        result.append(Qn(*c))
+    return result
+
+
+def test_simd_backends():
+    print("test_simd_backends")
+    backend = qn.simd_backend()
+    assert isinstance(backend, str), "simd_backend type fail"
+
+    # Lengths chosen so that there is a tail after the vector groups.
+    #
+    a = Qa(_simd_data(13))
+    b = Qa(_simd_data(27)[14:])
+    z = Qa([Qn(0), Qn(float('inf'), 1, 2, 3), Qn(1, float('nan'), 0, 0), q1, q2])
+    points = array.array('d', [1.0, 2.0, 3.0, 0.5, -4.0, 2.0] * 6 + [7.0, 0.0, -1.0])
+
+    def evaluate():
+        return (a.add(b), a.sub(qx), a.rsub(2), a.mul(b), a.mul(qx), a.rmul(qx),
+                a.normalise(), list(a.rotate_points(points)),
+                list(qx.rotate_many(points, origin=(1, 1, 1))))
+
+    try:
+        qn.set_simd_backend("scalar")
+        assert qn.simd_backend() == "scalar", "set scalar fail"
+        expected = evaluate()
+        zn_expected = [str(q) for q in z.normalise()]
+    finally:
+        qn.set_simd_backend("auto")
+    assert qn.simd_backend() == backend, "auto backend fail"
+
+    actual = evaluate()
+    for e, r in zip(expected, actual):
+        assert len(e) == len(r), "length fail"
+        for u, v in zip(e, r):
+            assert abs(u - v) < 1.0e-12, "backend mismatch"
+    assert len(actual[7]) == 3 * len(a), "rotate_points length fail"
+
+    # Zero, infinite and nan items use the scalar path in each backend.
+    #
+    assert [str(q) for q in z.normalise()] == zn_expected, "special values fail"
+
+    for q, r in zip(a, a.normalise()):
+        assert abs(r - q.normalise()) < 1.0e-15, "normalise fail"
+
+    c = Qa(a)
+    assert c.inormalise() is None, "in place methods should return None"
+    assert c == a.normalise(), "inormalise fail"
+
+    try:
+        qn.set_simd_backend("fred")
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+    assert qn.simd_backend() == backend, "backend changed"
+
+
+def test_parallel():
+    print("test_parallel")
+    threads = qn.num_threads()
+    threshold = qn.parallel_threshold()
+    assert threads >= 1, "num_threads fail"
+    assert threshold == 65536, "parallel_threshold fail"
+
+    a = Qa(_simd_data(1001))
+    b = Qa(_simd_data(2002)[1001:])
+    a[500] = qx
+    a[999] = qx
+    points = array.array('d', range(3 * len(a)))
+
+    def evaluate():
+        r = Qa(a)
+        r.reverse()
+        s = Qa(a)
+        s.byteswap()
+        n = Qa(a)
+        n.inormalise()
+        return (a.mul(b), a.add(qx), a.rdiv(b), a.normalise(), n, r, s,
+                a.count(qx), list(a.rotate_points(points)), list(a.hashes()))
+
+    expected = evaluate()
+
+    try:
+        # Force even these small arrays to be split across threads.
+        #
+        qn.set_num_threads(4)
+        qn.set_parallel_threshold(0)
+        assert qn.num_threads() == 4, "set_num_threads fail"
+        assert qn.parallel_threshold() == 0, "set_parallel_threshold fail"
+        actual = evaluate()
+
+        qn.set_num_threads(1)
+        single = evaluate()
+
+        # Errors from any chunk are reported.
+        #
+        c = Qa(a)
+        c[777] = 0
+        try:
+            qn.set_num_threads(4)
+            a.div(c)
+            assert False, "Expecting a ZeroDivisionError"
+        except ZeroDivisionError:
+            pass
+
+    finally:
+        qn.set_num_threads(0)
+        qn.set_parallel_threshold(threshold)
+
+    assert expected == actual, "parallel results fail"
+    assert expected == single, "single thread results fail"
+    assert expected[7] == 2, "parallel count fail"
+    assert qn.num_threads() == threads, "default num_threads fail"
+
+    try:
+        qn.set_num_threads(-1)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.set_parallel_threshold(1.5)
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+
+def test_array_hashes():
+    print("test_array_hashes")
+    a = Qa(_simd_data(100) + [Qn(-1), Qn(2.5, 0, 1), Qn(7)])
+    h = a.hashes()
+    assert isinstance(h, array.array) and h.typecode == 'q', "hashes type fail"
+    assert list(h) == [hash(q) for q in a], "hashes fail"
+    assert list(Qa(a, layout="soa").hashes()) == list(h), "soa hashes fail"
+
+    out = array.array('q', [0] * len(a))
+    assert a.hashes(out=out) is out, "hashes out fail"
+    assert out == h, "hashes out value fail"
+    assert list(Qa().hashes()) == [], "empty hashes fail"
+
+    for out in (array.array('q', [0] * 3), array.array('d', [0] * len(a))):
+        try:
+            a.hashes(out=out)
+            assert False, "Expecting a ValueError"
+        except ValueError:
+            pass
+
+    try:
+        a.hashes(out=bytes(8 * len(a)))
+        assert False, "Expecting a BufferError"
+    except BufferError:
+        pass
+
+
+def test_array_reductions():
+    print("test_array_reductions")
+    a = Qa(_simd_data(301))
+    a[7] = 0
+    a[8] = -4
+
+    def close(x, y):
+        return abs(x - y) <= 1.0e-12 * (1.0 + abs(y))
+
+    expected_sum = Qn(0)
+    expected_product = Qn(1)
+    for q in a[:20]:
+        expected_product *= q
+    for q in a:
+        expected_sum += q
+
+    def evaluate(b):
+        return (b.sum(), b[:20].product(), b.mean(), list(b.norms()),
+                list(b.quadrances()), list(b.dots(qx)), list(b.dots(b)),
+                list(b.isclose(b[5])), b.argmin(), b.argmax())
+
+    expected = evaluate(a)
+    assert close(expected[0], expected_sum), "sum fail"
+    assert close(expected[1], expected_product), "product fail"
+    assert close(expected[2], expected_sum / len(a)), "mean fail"
+    assert expected[3] == [abs(q) for q in a], "norms fail"
+    assert expected[4] == [q.quadrance() for q in a], "quadrances fail"
+    assert expected[5] == [qn.dot(q, qx) for q in a], "dots fail"
+    assert expected[6] == expected[4], "dots self fail"
+    assert expected[7] == [int(q == a[5]) for q in a], "isclose fail"
+    assert expected[8] == 7, "argmin fail"
+    assert expected[9] == 8, "argmax fail"
+    assert a.index(a[100]) == 100, "index fail"
+
+    threshold = qn.parallel_threshold()
+    try:
+        qn.set_num_threads(4)
+        qn.set_parallel_threshold(0)
+        actual = evaluate(Qa(a, layout="soa"))
+        assert a.index(a[100]) == 100, "parallel index fail"
+        assert a.index(a[299]) == 299, "parallel index fail"
+    finally:
+        qn.set_num_threads(0)
+        qn.set_parallel_threshold(threshold)
+
+    assert expected[:3] == actual[:3], "parallel reduction fail"
+    assert expected[3:] == actual[3:], "parallel measure fail"
+
+    # Long arrays are reduced in fixed blocks, so the results are the same for
+    # any number of threads, and the compensation is carried across blocks.
+    #
+    b = Qa([1.0e16] + [Qn(1, 1, 2, 3)] * 10000 + [-1.0e16])
+    c = Qa(_simd_data(20011))
+    c.inormalise()
+    results = []
+    try:
+        for threads, limit in ((1, threshold), (2, 0), (3, 1), (7, 1)):
+            qn.set_num_threads(threads)
+            qn.set_parallel_threshold(limit)
+            assert b.sum() == Qn(10000, 10000, 20000, 30000), "block compensation fail"
+            results.append((c.sum(), c.mean(), c.product(), c.average_rotation()))
+    finally:
+        qn.set_num_threads(0)
+        qn.set_parallel_threshold(threshold)
+    assert results.count(results[0]) == len(results), "reduction threads fail"
+
+    # Compensated summation, empty arrays and NaN.
+    #
+    assert Qa([1.0e16, Qn(1, 1, 2, 3), -1.0e16]).sum() == Qn(1, 1, 2, 3), "compensation fail"
+    assert Qa().sum() == Qn(0), "empty sum fail"
+    assert Qa().product() == Qn(1), "empty product fail"
+    assert Qa([1, float('inf')]).sum() == Qn(float('inf')), "infinite sum fail"
+    assert Qa([float('nan'), 2, 3]).argmax() == 2, "nan argmax fail"
+    assert list(Qa([q1, qx]).isclose(Qa([q1 * (1 + 1.0e-6), qx]), rel_tol=1.0e-5)) == [1, 1]
+    assert list(Qa([q1]).isclose(q1 + 0.5, abs_tol=0.25)) == [0], "abs_tol fail"
+
+    for func in (Qa().mean, Qa().argmin, Qa([float('nan')]).argmax, Qa([0]).average_rotation):
+        try:
+            func()
+            assert False, "Expecting a ValueError"
+        except ValueError:
+            pass
+
+    for args in ((Qa(ql[:3]),), (qx, -1.0)):
+        try:
+            a.isclose(*args)
+            assert False, "Expecting a ValueError"
+        except ValueError:
+            pass
+
+    try:
+        a.dots("fred")
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+
+def test_average_rotation():
+    print("test_average_rotation")
+    r = Qn(0.9, 0.1, -0.3, 0.2).normalise()
+    assert abs(Qa([r]).average_rotation() - r) < 1.0e-15, "single fail"
+    assert abs(Qa([-r, 2 * r]).average_rotation() - r) < 1.0e-15, "sign fail"
+
+    # Small rotations, either side of r, average to r.
+    #
+    items = []
+    for d in _simd_data(200):
+        n = Qn(1, d.x * 0.01, d.y * 0.01, d.z * 0.01).normalise()
+        items.append(r * n)
+        items.append(-(r * n.conjugate()))
+    assert abs(Qa(items).average_rotation() - r) < 1.0e-6, "average fail"
+
+    w = array.array('d', [1.0, 3.0])
+    x = Qa([Qn(1), Qn(0, 1, 0, 0)]).average_rotation(weights=w)
+    assert x == Qn(0, 1, 0, 0), "weights fail"
+
+    try:
+        Qa([q1]).average_rotation(weights=w)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+
+def test_cumprod():
+    print("test_cumprod")
+    items = [Qn(1, d.x * 0.01, d.y * 0.01, d.z * 0.01) for d in _simd_data(1003)]
+    a = Qa(items)
+    initial = Qn(0.5, 0.5, 0.5, 0.5)
+
+    def expected(every):
+        s = initial
+        result = []
+        for k, q in enumerate(items):
+            s = s * q
+            if every and (k + 1) % every == 0:
+                s = s.normalise()
+            result.append(s)
+        return result
+
+    threshold = qn.parallel_threshold()
+    for every in (0, 7, 100):
+        e = expected(every)
+        r = a.cumprod(initial, every)
+        assert list(r) == e, "cumprod fail"
+
+        try:
+            qn.set_num_threads(4)
+            qn.set_parallel_threshold(0)
+            p = Qa(a, layout="soa").cumprod(initial=initial, renormalise_every=every)
+        finally:
+            qn.set_num_threads(0)
+            qn.set_parallel_threshold(threshold)
+
+        assert p.layout == "soa", "cumprod layout fail"
+        for u, v in zip(e, p):
+            assert abs(u - v) < 1.0e-13, "parallel cumprod fail"
+
+    # Long arrays are scanned in fixed blocks, so the results are the same for
+    # any number of threads, and close to those of a sequential scan.
+    #
+    items = [Qn(1, d.x * 0.01, d.y * 0.01, d.z * 0.01) for d in _simd_data(10007)]
+    a = Qa(items)
+    for every in (0, 7, 5000):
+        e = expected(every)
+        results = []
+        try:
+            for threads, limit in ((1, threshold), (2, 0), (3, 1), (7, 1)):
+                qn.set_num_threads(threads)
+                qn.set_parallel_threshold(limit)
+                results.append(a.cumprod(initial, every).tobytes())
+        finally:
+            qn.set_num_threads(0)
+            qn.set_parallel_threshold(threshold)
+
+        assert results.count(results[0]) == len(results), "cumprod threads fail"
+        r = Qa()
+        r.frombytes(results[0])
+        for u, v in zip(e, r):
+            assert abs(u - v) < 1.0e-13 * abs(u), "long cumprod fail"
+
+    assert a[:3].cumprod() == Qa([a[0], a[0] * a[1], a[0] * a[1] * a[2]]), "default fail"
+    assert abs(abs(a.cumprod(renormalise_every=1)[-1]) - 1) < 1.0e-15, "renormalise fail"
+    assert Qa().cumprod() == Qa(), "empty fail"
+
+    for args, error in (((initial, -1), ValueError), (("fred",), TypeError)):
+        try:
+            a.cumprod(*args)
+            assert False, "Expecting an exception"
+        except error:
+            pass
+
+
+def test_integrate():
+    print("test_integrate")
+    omega = array.array('d', [0.1, 0.2, -0.3] * 1000)
+    r = Qa.integrate(omega, 0.01)
+    dq = qn.exp(Qn(0, 0.0005, 0.001, -0.0015))
+    assert len(r) == 1000, "integrate length fail"
+    assert abs(r[0] - dq) < 1.0e-15, "integrate first fail"
+    assert abs(r[-1] - dq ** 1000) < 1.0e-12, "integrate fail"
+
+    r = Qa.integrate(omega, 0.01, initial=qx, renormalise_every=10)
+    assert abs(r[9] - (qx * dq ** 10).normalise()) < 1.0e-15, "integrate initial fail"
+    assert Qa.integrate(array.array('d', [0, 0, 0]), 1.0) == Qa([1]), "zero rate fail"
+    assert Qa.integrate(b'', 1.0) == Qa(), "empty fail"
+
+    class SubArray(Qa):
+        pass
+
+    assert type(SubArray.integrate(omega, 0.01)) is SubArray, "integrate subclass fail"
+
+    try:
+        Qa.integrate(omega[:4], 0.01)
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+
+def test_array_math_functions():
+    print("test_array_math_functions")
+    a = Qa(_simd_data(300))
+    a[7] = 0
+    a[8] = -4
+    names = ("sqrt", "exp", "log", "log10", "cos", "sin", "tan", "acos", "asin",
+             "atan", "cosh", "sinh", "tanh", "acosh", "asinh", "atanh")
+
+    def same(x, y):
+        return str(x) == str(y) or abs(x - y) < 1.0e-12
+
+    for name in names:
+        func = getattr(qn, name)
+        r = func(a)
+        assert isinstance(r, Qa), name + " type fail"
+        assert len(r) == len(a), name + " length fail"
+        for q, v in zip(a, r):
+            assert same(func(q), v), name + " value fail"
+
+        # Into an existing array and, via the out array, in place.
+        #
+        out = Qa([0] * len(a))
+        assert func(a, out=out) is out, name + " out fail"
+        assert out == r or str(out) == str(r), name + " out value fail"
+
+        c = Qa(a)
+        func(c, out=c)
+        assert c == r or str(c) == str(r), name + " in place fail"
+
+    r = qn.log(a, 2)
+    for q, v in zip(a, r):
+        assert same(qn.log(q, 2), v), "log base fail"
+
+    # Mixed layouts and multiple threads give the same results.
+    #
+    s = Qa(a, layout="soa")
+    out = Qa([0] * len(a), layout="soa")
+    assert qn.exp(s) == qn.exp(a), "soa fail"
+    assert qn.exp(a, out=out).layout == "soa", "soa out fail"
+    assert qn.exp(s, out=Qa(a)) == qn.exp(a), "soa to aos fail"
+    assert out == qn.exp(a), "aos to soa fail"
+
+    threshold = qn.parallel_threshold()
+    try:
+        qn.set_num_threads(4)
+        qn.set_parallel_threshold(0)
+        assert qn.sin(a) == Qa([qn.sin(q) for q in a]), "parallel fail"
+        assert list(qn.phase(s)) == [qn.phase(q) for q in a], "parallel phase fail"
+    finally:
+        qn.set_num_threads(0)
+        qn.set_parallel_threshold(threshold)
+
+    # The polar coordinate functions return array.array('d') objects.
+    #
+    length, phase, axis = qn.polar(a)
+    assert isinstance(phase, array.array), "polar type fail"
+    assert list(length) == [abs(q) for q in a], "polar length fail"
+    assert list(phase) == list(qn.phase(a)), "polar phase fail"
+    assert list(axis) == list(qn.axis(s)), "polar axis fail"
+    for j, q in enumerate(a):
+        assert (length[j], phase[j], tuple(axis[3*j:3*j + 3])) == qn.polar(q), "polar fail"
+
+    assert qn.exp(Qa()) == Qa(), "empty array fail"
+    assert qn.polar(Qa()) == (array.array('d'), array.array('d'), array.array('d'))
+
+    try:
+        qn.exp(a, out=Qa(ql))
+        assert False, "Expecting a ValueError"
+    except ValueError:
+        pass
+
+    try:
+        qn.exp(q0, out=Qa([q1]))
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    try:
+        qn.exp(a, out=[])
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    try:
+        qn.sqrt(a, fred=a)
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    try:
+        qn.log10()
+        assert False, "Expecting a TypeError"
+    except TypeError:
+        pass
+
+    # The single quaternion forms still work as before.
+    #
+    assert qn.sqrt(Qn(-1)) == Qn(0, 0, 1, 0), "sqrt fail"
+    assert qn.exp(q0, out=None) == qn.exp(q0), "exp out=None fail"
+    assert abs(qn.log(Qn(100), 10) - 2) < 1.0e-15, "log base fail"
+
+
+if __name__ == "__main__":
+    test_array_arithmetic()
+    test_array_inplace_arithmetic()
+    test_simd_backends()
+    test_parallel()
+    test_array_hashes()
+    test_array_reductions()
+    test_average_rotation()
+    test_cumprod()
+    test_integrate()
+    test_array_math_functions()
+
+# end